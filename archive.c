@@ -0,0 +1,589 @@
+/* --archive, reading the members of tar, gzip compressed tar and zip files straight from the archive without extracting them
+ * a tar is a 512 byte header before the contents of every member so it is read in order, a tar.gz is the same tar inflated
+ * a window at a time as it is read so only that window of it is ever in memory, and a zip has a central directory at its end
+ * with where every member starts so each of its members can be inflated on its own
+ * NOTE: the whole archive has to be in memory, it is mapped like any other input, the checksums of the contents are not checked
+ */
+
+#define TAR_BLOCK_SIZE 512
+
+/* how much of a tar.gz is inflated at a time, the window that the matches go back into is kept at the start of it */
+#define TAR_STREAM_BUFFER_SIZE (1 << 20)
+
+/* gnu long names and pax headers larger than this are taken for a damaged archive */
+#define TAR_MAX_EXTENDED_HEADER_SIZE (1 << 20)
+
+/* the end of the central directory of a zip is 22 bytes with a comment of up to 65535 bytes after it */
+#define ZIP_END_RECORD_SIZE 22
+#define ZIP_MAX_COMMENT_SIZE 65535
+
+typedef enum archive_format
+{
+    TAR_ARCHIVE,
+    TAR_GZIP_ARCHIVE,
+    ZIP_ARCHIVE
+} archive_format;
+
+/* a member of an archive as its header describes it */
+typedef struct archive_entry
+{
+    /* NULL at the end of the archive, NOTE: this is not null terminated */
+    char const *name;
+    size_t name_size;
+
+    /* false for directories, links and anything else without contents of its own */
+    bool is_file;
+
+    /* why the member is skipped or NULL, the members of a zip that are encrypted or compressed with anything but deflate are */
+    char const *unsupported;
+
+    ULONGLONG size;
+
+    /* the data_size bytes of the member in the archive, deflated or the contents as they are,
+     * NULL for a member of a tar.gz whose contents are read with read_archive_entry
+     */
+    unsigned char const *data;
+    size_t data_size;
+    bool deflated;
+} archive_entry;
+
+typedef struct archive_reader
+{
+    archive_format format;
+    unsigned char const *data;
+    size_t size;
+
+    /* the next byte of a tar, of the gzip members of a tar.gz or of the central directory of a zip */
+    size_t offset;
+
+    /* how many entries of the central directory of a zip are left */
+    ULONGLONG entry_count;
+
+    /* a tar.gz, what the inflater wrote before out_offset was read, member_ended is set once a gzip member ended */
+    inflater *z;
+    unsigned char *out;
+    size_t out_offset;
+    bool member_ended;
+
+    /* the bytes of the current member of a tar and the padding after it that were not read yet */
+    ULONGLONG remaining;
+
+    /* the name and the size of the next member of a tar from a gnu long name or a pax header */
+    path_builder long_name;
+    bool has_long_name;
+    ULONGLONG pax_size;
+    bool has_pax_size;
+
+    /* the contents of the last gnu long name or pax header and the name of a ustar member with a prefix */
+    path_builder extended;
+    char name[256];
+} archive_reader;
+
+static DWORD read_little_endian_16(unsigned char const *data)
+{
+    return (DWORD)data[0] | ((DWORD)data[1] << 8);
+}
+
+static DWORD read_little_endian_32(unsigned char const *data)
+{
+    return (DWORD)data[0] | ((DWORD)data[1] << 8) | ((DWORD)data[2] << 16) | ((DWORD)data[3] << 24);
+}
+
+static ULONGLONG read_little_endian_64(unsigned char const *data)
+{
+    return ((ULONGLONG)read_little_endian_32(data + 4) << 32) | read_little_endian_32(data);
+}
+
+/* gets up to size of the next bytes of a tar or of the tar inflated from a tar.gz, available is how many there are, 0 at the end
+ * of the archive, returns a description of what went wrong or NULL
+ */
+static char const *read_tar_stream(archive_reader *reader, size_t size, unsigned char const **data, size_t *available)
+{
+    if (reader->format == TAR_ARCHIVE) {
+        size_t const left = reader->size - reader->offset;
+        *available = size < left ? size : left;
+        *data = reader->data + reader->offset;
+        reader->offset += *available;
+        return NULL;
+    }
+
+    inflater *z = reader->z;
+    while (reader->out_offset == z->out_size) {
+        if (!reader->member_ended) {
+            if (z->out_size == z->out_capacity) {
+                inflate_slide(z);
+                reader->out_offset = z->out_size;
+            }
+            inflate_status const status = inflate_run(z);
+            if (status == INFLATE_ERROR) {
+                return "could not inflate";
+            }
+            if (status == INFLATE_DONE) {
+                /* the crc and the size of the member come after it */
+                reader->offset = (size_t)(inflate_input_end(z) - reader->data) + 8;
+                if (reader->offset > reader->size) {
+                    return "is truncated";
+                }
+                reader->member_ended = true;
+            }
+            continue;
+        }
+
+        /* a gzip file can be several members one after another, anything else after them is ignored the way gzip does */
+        size_t const header_size = gzip_header_size(reader->data + reader->offset, reader->size - reader->offset);
+        if (header_size == 0) {
+            *available = 0;
+            return NULL;
+        }
+        reader->offset += header_size;
+        inflate_start(z, reader->data + reader->offset, reader->size - reader->offset, reader->out, TAR_STREAM_BUFFER_SIZE);
+        reader->out_offset = 0;
+        reader->member_ended = false;
+    }
+
+    size_t const left = z->out_size - reader->out_offset;
+    *available = size < left ? size : left;
+    *data = reader->out + reader->out_offset;
+    reader->out_offset += *available;
+    return NULL;
+}
+
+/* copies the next size bytes of a tar to out, returns a description of what went wrong or NULL */
+static char const *copy_tar_stream(archive_reader *reader, void *out, size_t size)
+{
+    unsigned char *to = out;
+    while (size != 0) {
+        unsigned char const *data;
+        size_t available;
+        char const *error = read_tar_stream(reader, size, &data, &available);
+        if (error != NULL) return error;
+        if (available == 0) return "is truncated";
+
+        size -= available;
+        while (available-- != 0) {
+            *to++ = *data++;
+        }
+    }
+    return NULL;
+}
+
+static char const *skip_tar_stream(archive_reader *reader, ULONGLONG size)
+{
+    while (size != 0) {
+        unsigned char const *data;
+        size_t available;
+        char const *error = read_tar_stream(reader, size > TAR_STREAM_BUFFER_SIZE ? TAR_STREAM_BUFFER_SIZE : (size_t)size, &data, &available);
+        if (error != NULL) return error;
+        if (available == 0) return "is truncated";
+        size -= available;
+    }
+    return NULL;
+}
+
+/* the numbers of a tar header are octal text, the ones too large for it are big endian after a first byte with its top bit set */
+static bool parse_tar_number(unsigned char const *field, size_t size, ULONGLONG *value)
+{
+    *value = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < size; ++i) {
+            if (*value >> 56) return false;
+            *value = (*value << 8) | field[i];
+        }
+        return true;
+    }
+
+    size_t i = 0;
+    while (i < size && field[i] == ' ') ++i;
+    for (; i < size && field[i] >= '0' && field[i] <= '7'; ++i) {
+        if (*value >> 61) return false;
+        *value = (*value << 3) | (ULONGLONG)(field[i] - '0');
+    }
+    return i == size || field[i] == ' ' || field[i] == '\0';
+}
+
+/* the checksum of a header is the sum of its bytes with the ones of the checksum itself taken as spaces */
+static bool tar_checksum_matches(unsigned char const *header)
+{
+    ULONGLONG expected;
+    if (!parse_tar_number(header + 148, 8, &expected)) return false;
+
+    DWORD sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; ++i) {
+        sum += i >= 148 && i < 156 ? ' ' : header[i];
+    }
+    return sum == expected;
+}
+
+/* the size of a field of a header that is null terminated unless it fills the field */
+static size_t tar_field_size(unsigned char const *field, size_t size)
+{
+    size_t field_size = 0;
+    while (field_size < size && field[field_size] != '\0') ++field_size;
+    return field_size;
+}
+
+/* takes the path and the size of the next member from the records of the pax header in reader->extended,
+ * every record is "length key=value\n" with the length of the whole record in decimal
+ */
+static char const *parse_pax_header(archive_reader *reader)
+{
+    char const *pos = reader->extended.data;
+    char const *const end = pos + reader->extended.size;
+    while (pos != end) {
+        size_t length = 0;
+        char const *key = pos;
+        while (key != end && *key >= '0' && *key <= '9' && length <= TAR_MAX_EXTENDED_HEADER_SIZE) {
+            length = length * 10 + (size_t)(*key++ - '0');
+        }
+        if (key == end || *key++ != ' ' || length > (size_t)(end - pos) || pos + length <= key || pos[length - 1] != '\n') {
+            return "has a damaged pax header";
+        }
+
+        char const *const record_end = pos + length - 1;
+        char const *value = key;
+        while (value != record_end && *value != '=') ++value;
+        if (value == record_end) {
+            return "has a damaged pax header";
+        }
+        size_t const key_size = (size_t)(value - key);
+        ++value;
+
+        if (key_size == 4 && bytes_equal(key, "path", 4)) {
+            path_truncate(&reader->long_name, 0);
+            if (!path_append(&reader->long_name, value, (size_t)(record_end - value))) {
+                return "could not allocate memory for";
+            }
+            reader->has_long_name = true;
+        }
+        else if (key_size == 4 && bytes_equal(key, "size", 4)) {
+            reader->pax_size = 0;
+            for (; value != record_end; ++value) {
+                if (*value < '0' || *value > '9' || (reader->pax_size >> 59)) return "has a damaged pax header";
+                reader->pax_size = (reader->pax_size << 3) + (reader->pax_size << 1) + (ULONGLONG)(*value - '0');
+            }
+            reader->has_pax_size = true;
+        }
+        pos += length;
+    }
+    return NULL;
+}
+
+static char const *next_tar_entry(archive_reader *reader, archive_entry *entry)
+{
+    for (;;) {
+        /* the rest of the member before and the padding after it */
+        char const *error = skip_tar_stream(reader, reader->remaining);
+        reader->remaining = 0;
+        if (error != NULL) return error;
+
+        unsigned char header[TAR_BLOCK_SIZE];
+        unsigned char const *data;
+        size_t available;
+        error = read_tar_stream(reader, TAR_BLOCK_SIZE, &data, &available);
+        if (error != NULL) return error;
+        if (available == 0) {
+            /* an archive that ends without the two empty blocks is read up to where it ends */
+            return NULL;
+        }
+        for (size_t i = 0; i < available; ++i) {
+            header[i] = data[i];
+        }
+        error = copy_tar_stream(reader, header + available, TAR_BLOCK_SIZE - available);
+        if (error != NULL) return error;
+
+        bool empty = true;
+        for (size_t i = 0; i < TAR_BLOCK_SIZE && empty; ++i) {
+            empty = header[i] == 0;
+        }
+        if (empty) {
+            return NULL;
+        }
+        if (!tar_checksum_matches(header)) {
+            return "has a damaged tar header";
+        }
+
+        ULONGLONG size;
+        if (!parse_tar_number(header + 124, 12, &size)) {
+            return "has a damaged tar header";
+        }
+        if (reader->has_pax_size) {
+            size = reader->pax_size;
+            reader->has_pax_size = false;
+        }
+        reader->remaining = (size + TAR_BLOCK_SIZE - 1) & ~(ULONGLONG)(TAR_BLOCK_SIZE - 1);
+
+        char const type = (char)header[156];
+        if (type == 'L' || type == 'x') {
+            /* a gnu long name or the pax header of the next member */
+            if (size > TAR_MAX_EXTENDED_HEADER_SIZE) {
+                return "has a damaged tar header";
+            }
+            path_truncate(&reader->extended, 0);
+            for (size_t left = (size_t)size; left != 0; left -= available) {
+                error = read_tar_stream(reader, left, &data, &available);
+                if (error != NULL) return error;
+                if (available == 0) return "is truncated";
+                if (!path_append(&reader->extended, (char const *)data, available)) return "could not allocate memory for";
+            }
+            reader->remaining -= size;
+
+            if (type == 'x') {
+                error = parse_pax_header(reader);
+                if (error != NULL) return error;
+            }
+            else {
+                path_truncate(&reader->long_name, 0);
+                if (!path_append(&reader->long_name, reader->extended.data, tar_field_size((unsigned char const *)reader->extended.data, reader->extended.size))) {
+                    return "could not allocate memory for";
+                }
+                reader->has_long_name = true;
+            }
+            continue;
+        }
+        if (type == 'g' || type == 'K') {
+            /* a pax header of every member after it and the long target of a link */
+            continue;
+        }
+
+        *entry = (archive_entry) { .size = size };
+        if (reader->has_long_name) {
+            entry->name = reader->long_name.data;
+            entry->name_size = reader->long_name.size;
+            reader->has_long_name = false;
+        }
+        else {
+            /* the name of a posix ustar header can have a prefix, gnu tar uses the same bytes for something else */
+            size_t const prefix_size = bytes_equal((char const *)header + 257, "ustar\0", 6) ? tar_field_size(header + 345, 155) : 0;
+            size_t const name_size = tar_field_size(header, 100);
+            size_t size_so_far = 0;
+            for (size_t i = 0; i < prefix_size; ++i) {
+                reader->name[size_so_far++] = (char)header[345 + i];
+            }
+            if (prefix_size != 0) {
+                reader->name[size_so_far++] = '/';
+            }
+            for (size_t i = 0; i < name_size; ++i) {
+                reader->name[size_so_far++] = (char)header[i];
+            }
+            entry->name = reader->name;
+            entry->name_size = size_so_far;
+        }
+
+        /* the members are under the directory the archive was made in */
+        while (entry->name_size != 0 && (entry->name[0] == '/' || (entry->name_size >= 2 && entry->name[0] == '.' && entry->name[1] == '/'))) {
+            size_t const skipped = entry->name[0] == '/' ? 1 : 2;
+            entry->name += skipped;
+            entry->name_size -= skipped;
+        }
+
+        /* 7 is a contiguous file which is a regular file for anything that reads it */
+        entry->is_file = (type == '0' || type == '\0' || type == '7') && entry->name_size != 0 && entry->name[entry->name_size - 1] != '/';
+        if (reader->format == TAR_ARCHIVE) {
+            if (size > reader->size - reader->offset) {
+                return "is truncated";
+            }
+            entry->data = reader->data + reader->offset;
+            entry->data_size = (size_t)size;
+        }
+        return NULL;
+    }
+}
+
+static char const *open_zip(archive_reader *reader)
+{
+    unsigned char const *const data = reader->data;
+    size_t const size = reader->size;
+    if (size < ZIP_END_RECORD_SIZE) {
+        return "is not a tar, tar.gz or zip archive";
+    }
+
+    size_t end = size - ZIP_END_RECORD_SIZE;
+    size_t const lowest = end > ZIP_MAX_COMMENT_SIZE ? end - ZIP_MAX_COMMENT_SIZE : 0;
+    while (read_little_endian_32(data + end) != 0x06054b50) {
+        if (end == lowest) return "is not a tar, tar.gz or zip archive";
+        --end;
+    }
+
+    ULONGLONG count = read_little_endian_16(data + end + 10);
+    ULONGLONG offset = read_little_endian_32(data + end + 16);
+
+    /* a zip64 archive has the numbers that do not fit in a record that a locator right before this one points to */
+    if ((count == 0xffff || offset == 0xffffffff) && end >= 20 && read_little_endian_32(data + end - 20) == 0x07064b50) {
+        ULONGLONG const record = read_little_endian_64(data + end - 20 + 8);
+        if (size < 56 || record > size - 56 || read_little_endian_32(data + (size_t)record) != 0x06064b50) {
+            return "has a damaged zip64 central directory";
+        }
+        count = read_little_endian_64(data + (size_t)record + 32);
+        offset = read_little_endian_64(data + (size_t)record + 48);
+    }
+    if (offset > end) {
+        return "has a damaged central directory";
+    }
+    reader->offset = (size_t)offset;
+    reader->entry_count = count;
+    return NULL;
+}
+
+static char const *next_zip_entry(archive_reader *reader, archive_entry *entry)
+{
+    if (reader->entry_count == 0) {
+        return NULL;
+    }
+    --reader->entry_count;
+
+    unsigned char const *const header = reader->data + reader->offset;
+    size_t const left = reader->size - reader->offset;
+    if (left < 46 || read_little_endian_32(header) != 0x02014b50) {
+        return "has a damaged central directory";
+    }
+    size_t const name_size = read_little_endian_16(header + 28);
+    size_t const extra_size = read_little_endian_16(header + 30);
+    size_t const comment_size = read_little_endian_16(header + 32);
+    if (left - 46 < name_size + extra_size + comment_size) {
+        return "has a damaged central directory";
+    }
+    reader->offset += 46 + name_size + extra_size + comment_size;
+
+    DWORD const flags = read_little_endian_16(header + 8);
+    DWORD const method = read_little_endian_16(header + 10);
+    ULONGLONG data_size = read_little_endian_32(header + 20);
+    ULONGLONG size = read_little_endian_32(header + 24);
+    ULONGLONG local_offset = read_little_endian_32(header + 42);
+
+    /* the numbers that do not fit are in the zip64 extra field in this order */
+    unsigned char const *extra = header + 46 + name_size;
+    unsigned char const *const extra_end = extra + extra_size;
+    while (extra_end - extra >= 4) {
+        unsigned char const *field = extra + 4;
+        unsigned char const *const field_end = field + read_little_endian_16(extra + 2);
+        if (field_end > extra_end) break;
+        if (read_little_endian_16(extra) == 1) {
+            if (size == 0xffffffff && field_end - field >= 8) {
+                size = read_little_endian_64(field);
+                field += 8;
+            }
+            if (data_size == 0xffffffff && field_end - field >= 8) {
+                data_size = read_little_endian_64(field);
+                field += 8;
+            }
+            if (local_offset == 0xffffffff && field_end - field >= 8) {
+                local_offset = read_little_endian_64(field);
+            }
+            break;
+        }
+        extra = field_end;
+    }
+
+    /* a zip made on unix has the mode of the file in the top of the external attributes */
+    bool const symbolic_link = (read_little_endian_16(header + 4) >> 8) == 3 && ((read_little_endian_32(header + 38) >> 16) & 0170000) == 0120000;
+    *entry = (archive_entry) {
+        .name = (char const *)header + 46,
+        .name_size = name_size,
+        .is_file = name_size != 0 && !is_path_separator(header[46 + name_size - 1]) && !symbolic_link,
+        .size = size
+    };
+    if (!entry->is_file) {
+        return NULL;
+    }
+    if (flags & 1) {
+        entry->unsupported = "skipped, it is encrypted";
+        return NULL;
+    }
+    if (method != 0 && method != 8) {
+        entry->unsupported = "skipped, it is compressed with something else than deflate";
+        return NULL;
+    }
+
+    /* the contents come after the local header which can have another extra field than the central directory */
+    if (local_offset > reader->size || reader->size - (size_t)local_offset < 30) {
+        return "has a damaged local header";
+    }
+    unsigned char const *const local = reader->data + (size_t)local_offset;
+    if (read_little_endian_32(local) != 0x04034b50) {
+        return "has a damaged local header";
+    }
+    size_t const data_offset = (size_t)local_offset + 30 + read_little_endian_16(local + 26) + read_little_endian_16(local + 28);
+    if (data_offset > reader->size || data_size > reader->size - data_offset || (method == 0 && data_size != size)) {
+        return "is truncated";
+    }
+    entry->data = reader->data + data_offset;
+    entry->data_size = (size_t)data_size;
+    entry->deflated = method == 8;
+    return NULL;
+}
+
+/* finds out which kind of archive the size bytes at data are, returns a description of what went wrong or NULL,
+ * the reader has to be closed with close_archive either way
+ */
+static char const *open_archive(archive_reader *reader, unsigned char const *data, size_t size)
+{
+    *reader = (archive_reader) { .data = data, .size = size };
+    if (!path_append(&reader->long_name, "", 0) || !path_append(&reader->extended, "", 0)) {
+        return "could not allocate memory for";
+    }
+
+    if (gzip_header_size(data, size) != 0) {
+        reader->format = TAR_GZIP_ARCHIVE;
+        reader->z = make_inflater();
+        reader->out = HeapAlloc(GetProcessHeap(), 0, TAR_STREAM_BUFFER_SIZE);
+        if (reader->z == NULL || reader->out == NULL) {
+            return "could not allocate memory for";
+        }
+        /* the first gzip member is started by the first read */
+        inflate_start(reader->z, data, 0, reader->out, TAR_STREAM_BUFFER_SIZE);
+        reader->member_ended = true;
+        return NULL;
+    }
+    /* an empty tar is only the blocks of zeros that end every tar */
+    bool empty = size >= TAR_BLOCK_SIZE;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE && empty; ++i) {
+        empty = data[i] == 0;
+    }
+    if (empty || (size >= TAR_BLOCK_SIZE && tar_checksum_matches(data))) {
+        reader->format = TAR_ARCHIVE;
+        return NULL;
+    }
+
+    /* a zip is found by the end of its central directory, anything can come before its first member */
+    reader->format = ZIP_ARCHIVE;
+    return open_zip(reader);
+}
+
+/* reads the header of the next member, entry->name is NULL at the end of the archive, returns a description of what went wrong or NULL
+ * NOTE: the name of the entry is only valid until the next call
+ */
+static char const *next_archive_entry(archive_reader *reader, archive_entry *entry)
+{
+    *entry = (archive_entry) { 0 };
+    return reader->format == ZIP_ARCHIVE ? next_zip_entry(reader, entry) : next_tar_entry(reader, entry);
+}
+
+/* copies the first size bytes of the contents of the member of a tar.gz that next_archive_entry read last to out,
+ * returns a description of what went wrong or NULL
+ */
+static char const *read_archive_entry(archive_reader *reader, void *out, size_t size)
+{
+    reader->remaining -= size;
+    return copy_tar_stream(reader, out, size);
+}
+
+/* inflates the first size bytes of a deflated member of a zip to out, returns a description of what went wrong or NULL */
+static char const *inflate_zip_entry(inflater *z, unsigned char const *data, size_t data_size, void *out, size_t size)
+{
+    inflate_start(z, data, data_size, out, size);
+    inflate_status const status = inflate_run(z);
+    return status == INFLATE_ERROR || z->out_size != size ? "could not inflate" : NULL;
+}
+
+static void close_archive(archive_reader *reader)
+{
+    if (reader->z != NULL) {
+        HeapFree(GetProcessHeap(), 0, reader->z);
+    }
+    if (reader->out != NULL) {
+        HeapFree(GetProcessHeap(), 0, reader->out);
+    }
+    path_free(&reader->long_name);
+    path_free(&reader->extended);
+    *reader = (archive_reader) { 0 };
+}
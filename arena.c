@@ -0,0 +1,166 @@
+/* a bump allocator for memory that is all freed at once or back to a mark
+ * the directory walkers keep every path of a directory level in one of these instead of a heap allocation per path,
+ * blocks are kept after a release so a walk reuses the same few blocks for every directory
+ */
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK_SIZE (1 << 12)
+#define ARENA_MAX_BLOCK_SIZE (1 << 20)
+
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t capacity;
+    size_t used;
+
+    /* NOTE: the header is padded so the data after it starts aligned */
+    size_t padding;
+} arena_block;
+
+typedef struct arena
+{
+    /* the first block and the one that is currently allocated from, the blocks after current are empty */
+    arena_block *first;
+    arena_block *current;
+} arena;
+
+/* everything allocated after a mark is freed by releasing it */
+typedef struct arena_mark
+{
+    arena_block *block;
+    size_t used;
+} arena_mark;
+
+static char *arena_block_data(arena_block *block)
+{
+    return (char *)(block + 1);
+}
+
+/* returns NULL when out of memory, the memory is not zeroed */
+static void *arena_alloc(arena *a, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    arena_block *block = a->current;
+    if (block != NULL && block->capacity - block->used >= size) {
+        void *result = arena_block_data(block) + block->used;
+        block->used += size;
+        return result;
+    }
+
+    /* move on to the next free block that is big enough */
+    arena_block *previous = block;
+    for (block = block == NULL ? a->first : block->next; block != NULL; previous = block, block = block->next) {
+        if (block->capacity >= size) break;
+    }
+
+    if (block == NULL) {
+        /* every new block is twice as big as the last so a large directory needs few of them */
+        size_t capacity = previous == NULL ? ARENA_MIN_BLOCK_SIZE : previous->capacity * 2;
+        if (capacity > ARENA_MAX_BLOCK_SIZE) {
+            capacity = ARENA_MAX_BLOCK_SIZE;
+        }
+        if (capacity < size) {
+            capacity = size;
+        }
+
+        block = HeapAlloc(GetProcessHeap(), 0, sizeof(arena_block) + capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->capacity = capacity;
+
+        /* link it in right after the current block so the empty blocks stay after it */
+        arena_block **link = a->current == NULL ? &a->first : &a->current->next;
+        block->next = *link;
+        *link = block;
+    }
+    else if (previous != a->current) {
+        /* the free block that was big enough is moved right after the current block */
+        previous->next = block->next;
+        arena_block **link = a->current == NULL ? &a->first : &a->current->next;
+        block->next = *link;
+        *link = block;
+    }
+
+    block->used = size;
+    a->current = block;
+    return arena_block_data(block);
+}
+
+static arena_mark arena_get_mark(arena const *a)
+{
+    return (arena_mark) { .block = a->current, .used = a->current == NULL ? 0 : a->current->used };
+}
+
+/* frees everything that was allocated after mark was taken */
+static void arena_release(arena *a, arena_mark mark)
+{
+    if (a->current == NULL) return;
+
+    for (arena_block *block = mark.block == NULL ? a->first : mark.block->next; block != a->current->next; block = block->next) {
+        block->used = 0;
+    }
+
+    if (mark.block != NULL) {
+        mark.block->used = mark.used;
+    }
+    a->current = mark.block;
+}
+
+static void arena_free(arena *a)
+{
+    for (arena_block *block = a->first; block != NULL; ) {
+        arena_block *next = block->next;
+        HeapFree(GetProcessHeap(), 0, block);
+        block = next;
+    }
+    a->first = a->current = NULL;
+}
+
+/* a path that components are added to and taken off the end of without going over the rest of it again */
+typedef struct path_builder
+{
+    /* NOTE: data is always null terminated */
+    char *data;
+    size_t size;
+    size_t capacity;
+} path_builder;
+
+/* returns false when out of memory */
+static bool path_append(path_builder *path, char const *str, size_t size)
+{
+    if (path->size + size + 1 > path->capacity) {
+        size_t capacity = (path->size + size + 1) * 2;
+        char *data = path->data == NULL
+            ? HeapAlloc(GetProcessHeap(), 0, capacity)
+            : HeapReAlloc(GetProcessHeap(), 0, path->data, capacity);
+        if (data == NULL) {
+            return false;
+        }
+        path->data = data;
+        path->capacity = capacity;
+    }
+
+    for (char *first = path->data + path->size; size != 0; --size) {
+        *first++ = *str++;
+        ++path->size;
+    }
+    path->data[path->size] = '\0';
+    return true;
+}
+
+/* takes the end of the path off so it is size bytes long */
+static void path_truncate(path_builder *path, size_t size)
+{
+    path->size = size;
+    path->data[size] = '\0';
+}
+
+static void path_free(path_builder *path)
+{
+    if (path->data != NULL) {
+        HeapFree(GetProcessHeap(), 0, path->data);
+    }
+    *path = (path_builder) { 0 };
+}
@@ -0,0 +1,4 @@
+@echo off
+call build.bat
+cl.exe -nologo -Oi -O2 -GS- bench.c -link -subsystem:console -nodefaultlib kernel32.lib shell32.lib
+bench.exe %*
@@ -0,0 +1,566 @@
+/* an on disk cache of what reading each file gave so that files that did not change since the last run are not read again
+ * the cache file is only ever appended to, every entry holds the key of a file and what reading it wrote and counted,
+ * a later entry for the same key replaces an earlier one, the file is mapped when it is opened and the entries are walked by their sizes
+ * NOTE: a run that crashes can leave a partly written entry at the end, it is cut off the next time the cache is opened
+ * and entries with bad contents fail their checksum when they are looked up
+ */
+
+#define ROTATE_LEFT(value, count) (((value) << (count)) | ((value) >> (32 - (count))))
+
+static DWORD hash_mix(DWORD hash, DWORD value)
+{
+    value *= 0xcc9e2d51;
+    value = ROTATE_LEFT(value, 15);
+    value *= 0x1b873593;
+    hash ^= value;
+    hash = ROTATE_LEFT(hash, 13);
+    return hash * 5 + 0xe6546b64;
+}
+
+static DWORD hash_finish(DWORD hash, size_t size)
+{
+    hash ^= (DWORD)size;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/* two murmur3 lanes that take every other 4 bytes, 32 bit builds have no 64 bit multiplication without the crt */
+static ULONGLONG hash_bytes(char const *data, size_t size)
+{
+    unsigned char const *pos = (unsigned char const *)data;
+    unsigned char const *const end = pos + size;
+    DWORD low = 0x9747b28c;
+    DWORD high = 0x2f8c4a1d;
+
+    for (; end - pos >= 8; pos += 8) {
+        low = hash_mix(low, pos[0] | (pos[1] << 8) | (pos[2] << 16) | ((DWORD)pos[3] << 24));
+        high = hash_mix(high, pos[4] | (pos[5] << 8) | (pos[6] << 16) | ((DWORD)pos[7] << 24));
+    }
+
+    if (pos != end) {
+        DWORD tail[2] = { 0, 0 };
+        for (int i = 0; pos != end; ++i) {
+            tail[i >> 2] |= (DWORD)*pos++ << ((i & 3) * 8);
+        }
+        low = hash_mix(low, tail[0]);
+        high = hash_mix(high, tail[1]);
+    }
+
+    return ((ULONGLONG)hash_finish(high, size) << 32) | hash_finish(low, size);
+}
+
+typedef struct cache_header
+{
+    char magic[4];
+    DWORD version;
+} cache_header;
+
+#define CACHE_VERSION 2
+
+/* every entry is a multiple of 8 bytes long so the fields of the next one stay aligned in the mapping */
+typedef struct cache_entry
+{
+    /* the size of the whole entry including the path, the output and the zero padding after them */
+    ULONGLONG size;
+
+    /* hash of everything after this field */
+    ULONGLONG checksum;
+
+    /* the options the output was made with, entries made with other options are other keys
+     * content_mode is the comment mode that was picked from the contents of a file without an extension and 0 for other files
+     */
+    DWORD options;
+    DWORD content_mode;
+
+    /* when the size and the write time match the file did not change, when only the size matches the content hash decides,
+     * a write time of 0 means the file was written too close to when it was read for the write time to be trusted
+     */
+    ULONGLONG file_size;
+    ULONGLONG write_time;
+    ULONGLONG content_hash;
+
+    ULONGLONG c_comment_count;
+    ULONGLONG cc_comment_count;
+    ULONGLONG asm_comment_count;
+    ULONGLONG python_comment_count;
+    ULONGLONG rust_comment_count;
+    ULONGLONG line_comment_count;
+    ULONGLONG block_comment_count;
+
+    /* followed by the path and then the output */
+    ULONGLONG path_size;
+    ULONGLONG output_size;
+} cache_entry;
+
+typedef struct cache_slot
+{
+    ULONGLONG hash;
+
+    /* offset of the latest entry of the key, 0 if the slot is empty */
+    size_t offset;
+} cache_slot;
+
+typedef struct result_cache
+{
+    char const *path;
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+
+    /* the entries that were in the file when it was opened */
+    char const *data;
+    size_t size;
+
+    /* open addressing table from the key of a file to its latest entry */
+    cache_slot *slots;
+    size_t slot_count;
+    size_t entry_count;
+
+    /* the size of the entries that were replaced by later ones */
+    size_t dead_size;
+
+    /* write times from this time on are stored as 0, file systems only keep write times to a few seconds at worst */
+    ULONGLONG recent_time;
+
+    /* the entries added by this run are collected here and appended when there are enough of them */
+    SRWLOCK lock;
+    char *pending;
+    size_t pending_size;
+    size_t pending_capacity;
+    bool write_failed;
+} result_cache;
+
+#define CACHE_PENDING_SIZE (1 << 20)
+
+/* two seconds in the 100 nanosecond units of a FILETIME */
+#define CACHE_TIME_SLACK 20000000ull
+
+static ULONGLONG cache_key_hash(char const *path, size_t path_size, DWORD options)
+{
+    return hash_bytes(path, path_size) ^ ((ULONGLONG)hash_finish(options, path_size) << 32);
+}
+
+static char const *cache_entry_path(cache_entry const *entry)
+{
+    return (char const *)(entry + 1);
+}
+
+static char const *cache_entry_output(cache_entry const *entry)
+{
+    return cache_entry_path(entry) + (size_t)entry->path_size;
+}
+
+static comment_count cache_entry_count(cache_entry const *entry)
+{
+    return (comment_count) {
+        .c_comment_count = (size_t)entry->c_comment_count,
+        .cc_comment_count = (size_t)entry->cc_comment_count,
+        .asm_comment_count = (size_t)entry->asm_comment_count,
+        .python_comment_count = (size_t)entry->python_comment_count,
+        .rust_comment_count = (size_t)entry->rust_comment_count,
+        .line_comment_count = (size_t)entry->line_comment_count,
+        .block_comment_count = (size_t)entry->block_comment_count
+    };
+}
+
+static bool cache_entry_has_key(cache_entry const *entry, char const *path, size_t path_size, DWORD options)
+{
+    if (entry->options != options || entry->path_size != path_size) {
+        return false;
+    }
+
+    char const *entry_path = cache_entry_path(entry);
+    for (size_t i = 0; i < path_size; ++i) {
+        if (entry_path[i] != path[i]) return false;
+    }
+    return true;
+}
+
+/* returns the slot of the key or the empty slot where it would go */
+static cache_slot *cache_find_slot(result_cache const *cache, ULONGLONG hash, char const *path, size_t path_size, DWORD options)
+{
+    size_t const mask = cache->slot_count - 1;
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask) {
+        cache_slot *slot = &cache->slots[i];
+        if (slot->offset == 0) {
+            return slot;
+        }
+        if (slot->hash == hash && cache_entry_has_key((cache_entry const *)(cache->data + slot->offset), path, path_size, options)) {
+            return slot;
+        }
+    }
+}
+
+static bool cache_grow_slots(result_cache *cache)
+{
+    size_t const slot_count = cache->slot_count == 0 ? 1024 : cache->slot_count * 2;
+    cache_slot *slots = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(cache_slot) * slot_count);
+    if (slots == NULL) {
+        return false;
+    }
+
+    cache_slot *old_slots = cache->slots;
+    size_t const old_slot_count = cache->slot_count;
+    cache->slots = slots;
+    cache->slot_count = slot_count;
+
+    for (size_t i = 0; i < old_slot_count; ++i) {
+        if (old_slots[i].offset == 0) continue;
+
+        size_t const mask = slot_count - 1;
+        size_t j = (size_t)old_slots[i].hash & mask;
+        while (slots[j].offset != 0) {
+            j = (j + 1) & mask;
+        }
+        slots[j] = old_slots[i];
+    }
+
+    if (old_slots != NULL) {
+        HeapFree(GetProcessHeap(), 0, old_slots);
+    }
+    return true;
+}
+
+/* returns the size of the entry at offset or 0 if it is not a whole entry */
+static size_t cache_entry_size(result_cache const *cache, size_t offset)
+{
+    size_t const remaining = cache->size - offset;
+    if (remaining < sizeof(cache_entry)) {
+        return 0;
+    }
+
+    cache_entry const *entry = (cache_entry const *)(cache->data + offset);
+    if ((entry->size & 7) != 0 || entry->size > remaining
+        || entry->path_size > remaining || entry->output_size > remaining
+        || sizeof(cache_entry) + entry->path_size + entry->output_size > entry->size) {
+        return 0;
+    }
+
+    return (size_t)entry->size;
+}
+
+static bool cache_map(result_cache *cache)
+{
+    cache->mapping_handle = CreateFileMappingA(cache->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (cache->mapping_handle == NULL) {
+        return false;
+    }
+
+    cache->data = MapViewOfFile(cache->mapping_handle, FILE_MAP_READ, 0, 0, cache->size);
+    if (cache->data == NULL) {
+        CloseHandle(cache->mapping_handle);
+        cache->mapping_handle = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+static void cache_unmap(result_cache *cache)
+{
+    if (cache->data != NULL) {
+        UnmapViewOfFile(cache->data);
+        CloseHandle(cache->mapping_handle);
+        cache->data = NULL;
+        cache->mapping_handle = NULL;
+    }
+}
+
+static bool cache_write(HANDLE handle, char const *data, size_t size)
+{
+    while (size != 0) {
+        DWORD chunk_size = size > (1 << 30) ? (1 << 30) : (DWORD)size;
+        DWORD bytes_written = 0;
+        if (WriteFile(handle, data, chunk_size, &bytes_written, NULL) == FALSE) {
+            return false;
+        }
+        data += bytes_written;
+        size -= bytes_written;
+    }
+
+    return true;
+}
+
+/* drops everything after offset and moves the file pointer there so the next entries are appended to it */
+static bool cache_truncate(result_cache *cache, size_t offset)
+{
+    cache_unmap(cache);
+
+    LARGE_INTEGER position = { .QuadPart = offset };
+    if (SetFilePointerEx(cache->file_handle, position, NULL, FILE_BEGIN) == FALSE || SetEndOfFile(cache->file_handle) == FALSE) {
+        return false;
+    }
+
+    cache->size = offset;
+    if (offset == 0) {
+        cache_header header = { .magic = { 'C', 'M', 'C', 'A' }, .version = CACHE_VERSION };
+        if (!cache_write(cache->file_handle, (char const *)&header, sizeof(header))) {
+            return false;
+        }
+        cache->size = sizeof(header);
+    }
+
+    return cache->size == sizeof(cache_header) || cache_map(cache);
+}
+
+static void cache_free(result_cache *cache)
+{
+    cache_unmap(cache);
+    if (cache->file_handle != NULL && cache->file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(cache->file_handle);
+    }
+    if (cache->slots != NULL) {
+        HeapFree(GetProcessHeap(), 0, cache->slots);
+    }
+    if (cache->pending != NULL) {
+        HeapFree(GetProcessHeap(), 0, cache->pending);
+    }
+    cache->file_handle = NULL;
+    cache->slots = NULL;
+    cache->pending = NULL;
+}
+
+/* writes the latest entry of every key to a new file and puts it in place of the cache, the cache is closed afterwards */
+static void cache_compact(result_cache *cache)
+{
+    char temporary_path[MAX_PATH];
+    int path_size = lstrlenA(cache->path);
+    if (path_size + 5 > MAX_PATH) {
+        cache_free(cache);
+        return;
+    }
+    lstrcpyA(temporary_path, cache->path);
+    lstrcpyA(temporary_path + path_size, ".tmp");
+
+    HANDLE handle = CreateFileA(temporary_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        cache_free(cache);
+        return;
+    }
+
+    /* the header and the entries are copied through a buffer so there is not a WriteFile for each one */
+    char *buffer = HeapAlloc(GetProcessHeap(), 0, CACHE_PENDING_SIZE);
+    bool written = buffer != NULL && cache_write(handle, cache->data, sizeof(cache_header));
+    size_t buffer_size = 0;
+    for (size_t i = 0; written && i < cache->slot_count; ++i) {
+        if (cache->slots[i].offset == 0) continue;
+
+        char const *entry = cache->data + cache->slots[i].offset;
+        size_t const entry_size = (size_t)((cache_entry const *)entry)->size;
+        if (buffer_size + entry_size > CACHE_PENDING_SIZE) {
+            written = cache_write(handle, buffer, buffer_size);
+            buffer_size = 0;
+        }
+
+        if (entry_size > CACHE_PENDING_SIZE) {
+            written = written && cache_write(handle, entry, entry_size);
+            continue;
+        }
+        for (size_t j = 0; j < entry_size; ++j) {
+            buffer[buffer_size++] = entry[j];
+        }
+    }
+    written = written && cache_write(handle, buffer, buffer_size);
+    HeapFree(GetProcessHeap(), 0, buffer);
+    CloseHandle(handle);
+
+    /* NOTE: the cache can not be replaced while it is open, if anything fails the old one is still complete */
+    cache_free(cache);
+    if (!written || MoveFileExA(temporary_path, cache->path, MOVEFILE_REPLACE_EXISTING) == FALSE) {
+        DeleteFileA(temporary_path);
+    }
+}
+
+static char const *cache_load(result_cache *cache, char const *path, bool compact)
+{
+    *cache = (result_cache) { .path = path };
+    InitializeSRWLock(&cache->lock);
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    cache->recent_time = (((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime) - CACHE_TIME_SLACK;
+
+    cache->file_handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (cache->file_handle == INVALID_HANDLE_VALUE) {
+        return "could not open the cache";
+    }
+
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(cache->file_handle, &file_size) == FALSE) {
+        cache_free(cache);
+        return "could not get the file size of the cache";
+    }
+
+    /* a cache that is not one or is from another version or does not fit in memory is started over */
+    cache_header const *header = NULL;
+    if ((ULONGLONG)file_size.QuadPart >= sizeof(cache_header) && (ULONGLONG)file_size.QuadPart <= ((size_t)-1 >> 1)) {
+        cache->size = (size_t)file_size.QuadPart;
+        if (cache_map(cache)) {
+            header = (cache_header const *)cache->data;
+        }
+    }
+
+    bool const valid = header != NULL
+        && header->magic[0] == 'C' && header->magic[1] == 'M' && header->magic[2] == 'C' && header->magic[3] == 'A'
+        && header->version == CACHE_VERSION;
+    size_t offset = valid ? sizeof(cache_header) : 0;
+
+    if (valid && !cache_grow_slots(cache)) {
+        cache_free(cache);
+        return "could not allocate memory for the cache";
+    }
+
+    for (size_t entry_size; valid && (entry_size = cache_entry_size(cache, offset)) != 0; offset += entry_size) {
+        if (cache->entry_count * 2 >= cache->slot_count && !cache_grow_slots(cache)) {
+            cache_free(cache);
+            return "could not allocate memory for the cache";
+        }
+
+        cache_entry const *entry = (cache_entry const *)(cache->data + offset);
+        size_t const path_size = (size_t)entry->path_size;
+        ULONGLONG const hash = cache_key_hash(cache_entry_path(entry), path_size, entry->options);
+        cache_slot *slot = cache_find_slot(cache, hash, cache_entry_path(entry), path_size, entry->options);
+        if (slot->offset != 0) {
+            cache->dead_size += (size_t)((cache_entry const *)(cache->data + slot->offset))->size;
+        }
+        else {
+            ++cache->entry_count;
+        }
+        slot->hash = hash;
+        slot->offset = offset;
+    }
+
+    /* cut off what is left of an entry that was being written when a run crashed */
+    if ((!valid || offset != cache->size) && !cache_truncate(cache, offset)) {
+        cache_free(cache);
+        return "could not write to the cache";
+    }
+
+    /* once most of the cache is entries that were replaced it is written again with only the latest ones */
+    if (compact && cache->dead_size > (1 << 20) && cache->dead_size * 2 > cache->size) {
+        cache_compact(cache);
+        return cache_load(cache, path, false);
+    }
+
+    LARGE_INTEGER end = { .QuadPart = 0 };
+    if (SetFilePointerEx(cache->file_handle, end, NULL, FILE_END) == FALSE) {
+        cache_free(cache);
+        return "could not write to the cache";
+    }
+
+    return NULL;
+}
+
+/* opens or creates the cache at path, returns a description of what went wrong or NULL on success */
+static char const *cache_open(result_cache *cache, char const *path)
+{
+    return cache_load(cache, path, true);
+}
+
+/* returns the latest entry of path that was made with options or NULL if there is none or it is damaged */
+static cache_entry const *cache_find(result_cache const *cache, char const *path, DWORD options)
+{
+    if (cache->entry_count == 0) {
+        return NULL;
+    }
+
+    size_t const path_size = lstrlenA(path);
+    cache_slot const *slot = cache_find_slot(cache, cache_key_hash(path, path_size, options), path, path_size, options);
+    if (slot->offset == 0) {
+        return NULL;
+    }
+
+    cache_entry const *entry = (cache_entry const *)(cache->data + slot->offset);
+    char const *checked = (char const *)&entry->options;
+    if (hash_bytes(checked, (size_t)entry->size - 16) != entry->checksum) {
+        return NULL;
+    }
+
+    return entry;
+}
+
+static bool cache_flush(result_cache *cache)
+{
+    if (cache->pending_size != 0 && !cache_write(cache->file_handle, cache->pending, cache->pending_size)) {
+        cache->write_failed = true;
+    }
+    cache->pending_size = 0;
+    return !cache->write_failed;
+}
+
+/* adds an entry for path, this can be called from any thread */
+static bool cache_add(result_cache *cache, char const *path, DWORD options, DWORD content_mode, ULONGLONG file_size, ULONGLONG write_time,
+                      ULONGLONG content_hash, comment_count count, char const *output, size_t output_size)
+{
+    size_t const path_size = lstrlenA(path);
+    size_t const unpadded_size = sizeof(cache_entry) + path_size + output_size;
+    size_t const size = (unpadded_size + 7) & ~(size_t)7;
+
+    cache_entry entry = {
+        .size = size,
+        .options = options,
+        .content_mode = content_mode,
+        .file_size = file_size,
+        .write_time = write_time >= cache->recent_time ? 0 : write_time,
+        .content_hash = content_hash,
+        .c_comment_count = count.c_comment_count,
+        .cc_comment_count = count.cc_comment_count,
+        .asm_comment_count = count.asm_comment_count,
+        .python_comment_count = count.python_comment_count,
+        .rust_comment_count = count.rust_comment_count,
+        .line_comment_count = count.line_comment_count,
+        .block_comment_count = count.block_comment_count,
+        .path_size = path_size,
+        .output_size = output_size
+    };
+
+    AcquireSRWLockExclusive(&cache->lock);
+
+    if (cache->pending_size + size > cache->pending_capacity) {
+        cache_flush(cache);
+        if (size > cache->pending_capacity) {
+            size_t capacity = size > CACHE_PENDING_SIZE ? size : CACHE_PENDING_SIZE;
+            char *pending = HeapAlloc(GetProcessHeap(), 0, capacity);
+            if (pending == NULL) {
+                ReleaseSRWLockExclusive(&cache->lock);
+                return false;
+            }
+            HeapFree(GetProcessHeap(), 0, cache->pending);
+            cache->pending = pending;
+            cache->pending_capacity = capacity;
+        }
+    }
+
+    /* the entry is put together in the pending buffer so the checksum can be taken over it in one piece */
+    char *first = cache->pending + cache->pending_size;
+    char *pos = first;
+    for (size_t i = 0; i < sizeof(entry); ++i) {
+        *pos++ = ((char const *)&entry)[i];
+    }
+    for (size_t i = 0; i < path_size; ++i) {
+        *pos++ = path[i];
+    }
+    for (size_t i = 0; i < output_size; ++i) {
+        *pos++ = output[i];
+    }
+    while (pos != first + size) {
+        *pos++ = 0;
+    }
+    ((cache_entry *)first)->checksum = hash_bytes((char const *)&((cache_entry *)first)->options, size - 16);
+    cache->pending_size += size;
+
+    bool const written = cache->pending_size < CACHE_PENDING_SIZE || cache_flush(cache);
+    ReleaseSRWLockExclusive(&cache->lock);
+    return written;
+}
+
+/* appends what is left of the new entries and closes the cache, returns false if anything could not be written */
+static bool cache_close(result_cache *cache)
+{
+    bool const written = cache_flush(cache);
+    cache_free(cache);
+    return written;
+}
@@ -1,861 +1,4264 @@
-#include <windows.h>
-#include <stdbool.h>
-
-#include "argva.c"
-
-HANDLE stdout = NULL;
-HANDLE stderr = NULL;
-
-__declspec(noreturn) static void error_messagea(size_t count, char const **messages)
-{
-    for (size_t i = 0; i < count; ++i) {
-        char const *message = messages[i];
-        WriteFile(stderr, message, lstrlenA(message), NULL, NULL);
-    }
-    ExitProcess(GetLastError());
-}
-
-#define error_messagea(...) error_messagea(sizeof((char const*[]){__VA_ARGS__}) / sizeof(char const *), (char const*[]){__VA_ARGS__})
-#define WriteFile(filepath, ...) if(!WriteFile(__VA_ARGS__)) { error_messagea("Error could not write to ", filepath); }
-
-typedef enum comment_display
-{
-    NO_COMMENT_DISPLAY = 0x0,
-    C_COMMENT_DISPLAY = 0x1,
-    CC_COMMENT_DISPLAY = C_COMMENT_DISPLAY << 1,
-    ASM_COMMENT_DISPLAY = CC_COMMENT_DISPLAY << 1,
-    PYTHON_COMMENT_DISPLAY = ASM_COMMENT_DISPLAY << 1,
-    RUST_COMMENT_DISPLAY = PYTHON_COMMENT_DISPLAY << 1,
-    AUTO_COMMENT_DISPLAY = RUST_COMMENT_DISPLAY << 1,
-    C_AND_CC_COMMENT_DISPLAY = C_COMMENT_DISPLAY | CC_COMMENT_DISPLAY,
-    ALL_COMMENT_DISPLAY = C_COMMENT_DISPLAY | CC_COMMENT_DISPLAY | ASM_COMMENT_DISPLAY
-} comment_display;
-
-typedef struct comment_count
-{
-    /* c comment count */
-    size_t c_comment_count;
-
-    /* c++ comment count */
-    size_t cc_comment_count;
-
-    /* asm comment count */
-    size_t asm_comment_count;
-
-    /* python comment count */
-    size_t python_comment_count;
-
-    /* rust comment count */
-    size_t rust_comment_count;
-} comment_count;
-
-static void output_number(size_t number)
-{
-    /* log10(2^64) is around 20 meaning this should be able to hold all numbers inputed */
-    char digits[20] = { '0' };
-
-    /* get the reversed digets of the number */
-    int i = number == 0 ? 1 : 0; /* check if number is zero */
-    for (; number != 0; ++i) {
-        digits[i] = (number % 10) + '0';
-        number /= 10;
-    }
-
-    /* reverse the reversed digets of the number */
-    for (int j = 0; j < i / 2; ++j) {
-        char temp_digit = digits[j];
-        digits[j] = digits[i - 1 - j];
-        digits[i - 1 - j] = temp_digit;
-    }
-
-    /* print the reversed number */
-    WriteFile("stdout", stdout, digits, i, NULL, NULL);
-}
-
-static char const *is_continuing_backslash(char const *str)
-{
-    /* NOTE: the loop is needed because cotinuing backslashs can nested like \\\\\ */
-    if (*str != '\\') return NULL;
-    while (*str != '\0') {
-        switch (*str) {
-            case '\r':
-                break;
-            case '\n':
-                return str + 1;
-            case '\\':
-                break;
-            default:
-                return NULL;
-        }
-
-        ++str;
-    }
-
-    return NULL;
-}
-
-static comment_display get_comment_mode(char const *str)
-{
-    char const *file_extension_pos = str;
-
-    /* find location of the file extension in the string */
-    {
-        char const *temp_pos = NULL;
-        while (*file_extension_pos != '\0') {
-            if (*file_extension_pos == '.') {
-                temp_pos = file_extension_pos;
-            }
-            ++file_extension_pos;
-        }
-
-        if (temp_pos == NULL) {
-            return C_AND_CC_COMMENT_DISPLAY;
-        }
-
-        file_extension_pos = temp_pos;
-    }
-
-    /* file extensions of languages the use c/c++ style comments */
-    static char const *const cc_file_extensions[] = {
-        ".c",
-        ".cpp",
-        ".h",
-        ".hpp",
-        ".cc",
-        ".hh",
-        ".java",
-        ".cs",
-        ".cu",
-        ".cuh",
-        ".go"
-        ".hxx",
-        ".cxx",
-        ".c++",
-        ".h++",
-    };
-
-    /* check if the file extension is of a programming language that uses c/c++ style comments */
-    for (size_t i = 0; i < (sizeof(cc_file_extensions) / sizeof(char const *const)); ++i) {
-        if (!lstrcmpiA(file_extension_pos, cc_file_extensions[i])) {
-            return C_AND_CC_COMMENT_DISPLAY;
-        }
-    }
-
-    if (!lstrcmpiA(file_extension_pos, ".asm") || !lstrcmpiA(file_extension_pos, ".s")) {
-        return ASM_COMMENT_DISPLAY;
-    }
-    else if (!lstrcmpiA(file_extension_pos, ".py")) {
-        return PYTHON_COMMENT_DISPLAY;
-    }
-    else if (!lstrcmpiA(file_extension_pos, ".rs")) {
-        return RUST_COMMENT_DISPLAY;
-    }
-    else {
-        return NO_COMMENT_DISPLAY;
-    }
-}
-
-/* NOTE: this function requires a null terminated string */
-static comment_count read_comments(char const *str, bool show_lines, comment_display comment_mode)
-{
-    /* check if can even display comments */
-    if (comment_mode == NO_COMMENT_DISPLAY) {
-        return (comment_count) { 0 };
-    }
-
-    comment_count result = { 0 };
-
-    /* keep reading the next char until we reach a null terminator*/
-    size_t bytes_since_newline = 1;
-    size_t newline_count = 1;
-    while (*str != '\0') {
-        switch (*str) {
-            /* handle "" and '' */
-            case '"':
-            case '\'': {
-                /* we need to read the current char to know what type of quote we are using
-                 * once we have already read the current char so we need to go to the next one
-                 */
-                char quote_type = *str++;
-
-                /* check for python doc string */
-                if (str[0] == quote_type && str[1] == quote_type) {
-                    ++result.python_comment_count;
-                    if ((comment_mode & PYTHON_COMMENT_DISPLAY)) {
-                        /* add space before comment*/
-                        do {
-                            WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                        } while (bytes_since_newline-- != 0);
-                        ++bytes_since_newline;
-
-                        str += 2;
-                        while (*str != '\0') {
-                            if (str[0] == quote_type && str[1] == quote_type && str[2] == quote_type) {
-                                if (show_lines) {
-                                    WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                    output_number(newline_count);
-                                }
-
-                                str += 2;
-                                if (str[1] == '\n' || (str[1] == '\r' && str[2] == '\n')) {
-                                    str += str[0] == '\n' ? 1 : 2;
-                                    ++newline_count;
-                                }
-                                break;
-                            }
-
-                            WriteFile("stdout", stdout, str, 1, NULL, NULL);
-
-                            ++str;
-
-                            while (str[0] == '\n' || (str[0] == '\r' && str[1] == '\n')) {
-                                if (show_lines) {
-                                    /* output a number before the end of the line */
-                                    WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                    output_number(newline_count);
-                                }
-
-                                WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-
-                                str += str[0] == '\n' ? 1 : 2;
-                                ++newline_count;
-                            }
-                        }
-
-                        WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-                    }
-                    break;
-                }
-
-
-                while (*str != '\0' && *str != quote_type) {
-                    /* just skip escape codes as the could containe " or ' */
-                    if (*str == '\\') {
-                        ++str;
-                    }
-
-                    if (*str == '\n') {
-                        ++newline_count;
-                    }
-                    ++str;
-                }
-
-                break;
-            }
-
-
-            case '/':
-                ++str;
-                switch (*str) {
-                    case '/':
-                        ++result.cc_comment_count;
-                        ++result.rust_comment_count;
-                        if ((comment_mode & RUST_COMMENT_DISPLAY) || (comment_mode & CC_COMMENT_DISPLAY)) {
-
-                            /* add space before comment*/
-                            do {
-                                WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                            } while (bytes_since_newline-- != 0);
-                            ++bytes_since_newline;
-
-                            if (RUST_COMMENT_DISPLAY & comment_mode) {
-                                if (str[1] == '!') {
-                                    str += 2;
-                                }
-                                else if (str[1] == '/') {
-                                    WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                    str += str[2] == '!' ? 3 : 2;
-                                }
-                                else {
-                                    ++str;
-                                }
-                            }
-                            else {
-                                ++str;
-                            }
-                            while (*str != '\0') {
-
-                                /* stop when we reach the end of the line */
-                                if (str[0] == '\n' || (str[0] == '\r' && str[1] == '\n')) {
-                                    if (show_lines) {
-                                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                        output_number(newline_count);
-                                    }
-
-                                    /* NOTE: when we increment the string before going to the end of loop
-                                     * we must add to the string pointer by 1 less since we already
-                                     * increment the string pointer at the end of the loop
-                                     */
-                                    str += str[0] == '\n' ? 0 : 1;
-                                    ++newline_count;
-                                    break;
-                                }
-
-                                /* if we detect \\ treat the next line as a comment */
-                                char const *continuing_backslash_pos;
-                                if ((continuing_backslash_pos = is_continuing_backslash(str)) != NULL) {
-
-                                    /* since we are moving to a newline output the current line number */
-                                    if (show_lines) {
-                                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                        output_number(newline_count);
-                                    }
-
-                                    WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-
-                                    str = continuing_backslash_pos;
-                                    ++newline_count;
-                                }
-
-                                WriteFile("stdout", stdout, str, 1, NULL, NULL);
-
-                                ++str;
-                            }
-                            WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-                        }
-                        break;
-
-                    case '*':
-                        if (comment_mode & RUST_COMMENT_DISPLAY) {
-                            ++result.rust_comment_count;
-                            /* add space before comment */
-                            do {
-                                WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                            } while (bytes_since_newline-- != 0);
-                            ++bytes_since_newline;
-
-                            size_t bracket_count = 1;
-                            str += str[1] == '!' ? 2 : 1;
-                            while (*str != '\0' && bracket_count != 0) {
-                                while (str[0] == '/' && str[1] == '*') {
-                                    str += str[2] == '!' ? 4 : 3;
-                                    ++bracket_count;
-                                }
-
-                                if (str[0] == '*' && str[1] == '/') {
-                                    if (show_lines) {
-                                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                        output_number(newline_count);
-                                    }
-
-                                    ++str;
-                                    if (str[1] == '\n' || (str[1] == '\r' && str[2] == '\n')) {
-                                        WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-
-                                        str += str[0] == '\n' ? 1 : 2;
-                                        ++newline_count;
-                                    }
-                                    --bracket_count;
-                                }
-                                else {
-                                    if (str[0] == '\n' || (str[0] == '\r' && str[1] == '\n')) {
-                                        if (show_lines) {
-                                            /* output a number before the end of the line */
-                                            WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                            output_number(newline_count);
-                                        }
-
-                                        WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-
-                                        str += str[0] == '\n' ? 0 : 1;
-                                        ++newline_count;
-                                    }
-                                    else {
-
-                                        WriteFile("stdout", stdout, str, 1, NULL, NULL);
-                                    }
-                                }
-                                ++str;
-                            }
-
-                            WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-                        }
-                        else if ((comment_mode & C_COMMENT_DISPLAY)) {
-                            ++result.c_comment_count;
-                            /* add space before comment */
-                            do {
-                                WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                            } while (bytes_since_newline-- != 0);
-                            ++bytes_since_newline;
-
-                            while (*str != '\0') {
-                                ++str;
-                                if (str[0] == '*' && str[1] == '/') {
-                                    if (show_lines) {
-                                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                        output_number(newline_count);
-                                    }
-
-                                    ++str;
-                                    if (str[1] == '\n' || (str[1] == '\r' && str[2] == '\n')) {
-                                        str += str[0] == '\n' ? 1 : 2;
-                                        ++newline_count;
-                                    }
-                                    break;
-                                }
-
-                                if (str[0] == '\n' || (str[0] == '\r' && str[1] == '\n')) {
-                                    if (show_lines) {
-                                        /* output a number before the end of the line */
-                                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                        output_number(newline_count);
-                                    }
-
-                                    WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-
-                                    str += str[0] == '\n' ? 0 : 1;
-                                    ++newline_count;
-                                }
-                                else {
-                                    WriteFile("stdout", stdout, str, 1, NULL, NULL);
-                                }
-                            }
-
-                            WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-                        }
-                        break;
-                }
-                break;
-
-            case '\n':
-                bytes_since_newline = 0;
-                ++newline_count;
-                break;
-
-            case ';':
-                ++result.asm_comment_count;
-                if ((comment_mode & ASM_COMMENT_DISPLAY)) {
-                    /* add space before comment*/
-                    do {
-                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                    } while (bytes_since_newline-- != 0);
-                    ++bytes_since_newline;
-
-                    ++str;
-                    while (*str != '\0') {
-                        if (str[0] == '\n' || (str[0] == '\r' && str[1] == '\n')) {
-                            if (show_lines) {
-                                WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                output_number(newline_count);
-                            }
-
-                            ++newline_count;
-                            break;
-                        }
-
-                        WriteFile("stdout", stdout, str, 1, NULL, NULL);
-                        ++str;
-                    }
-
-                    WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-                }
-                break;
-
-            case '#':
-                ++result.python_comment_count;
-                if ((comment_mode & PYTHON_COMMENT_DISPLAY)) {
-                    /* add space before comment*/
-                    do {
-                        WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                    } while (bytes_since_newline-- != 0);
-                    ++bytes_since_newline;
-
-                    ++str;
-                    while (*str != '\0') {
-                        if (str[0] == '\n' || (str[0] == '\r' && str[1] == '\n')) {
-                            if (show_lines) {
-                                WriteFile("stdout", stdout, " ", 1, NULL, NULL);
-                                output_number(newline_count);
-                            }
-
-                            str += str[0] == '\n' ? 0 : 1;
-                            ++newline_count;
-                            break;
-                        }
-
-                        WriteFile("stdout", stdout, str, 1, NULL, NULL);
-                        ++str;
-                    }
-
-                    WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-                }
-                break;
-        }
-        ++str;
-        bytes_since_newline += *str == '\t' ? 4 : 1; /* handle tabs */
-    }
-
-    return result;
-}
-
-static void read_file_comments(char const *filename, comment_display comment_mode, bool show_line_number, bool display_comment_count)
-{
-    if (comment_mode & AUTO_COMMENT_DISPLAY) {
-        comment_mode = get_comment_mode(filename);
-    }
-
-    if (comment_mode & ~NO_COMMENT_DISPLAY) {
-        WriteFile("stdout", stdout, filename, lstrlenA(filename), NULL, NULL);
-        WriteFile("stdout", stdout, ": \r\n", 4, NULL, NULL);
-    }
-    else {
-        return;
-    }
-
-    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN | FILE_ATTRIBUTE_NORMAL, NULL);
-    if (file_handle == INVALID_HANDLE_VALUE) {
-        error_messagea("Error: could not open file \"", filename, "\"");
-    }
-
-    /* get the file size */
-    LARGE_INTEGER file_size;
-    if (GetFileSizeEx(file_handle, &file_size) == FALSE) {
-        error_messagea("Error: could not get the file size of \"", filename, "\\");
-    }
-
-    char *file_buffer = HeapAlloc(GetProcessHeap(), 0, file_size.QuadPart + 1);
-    file_buffer[file_size.QuadPart] = '\0'; /* add a null terminator */
-
-    /* read the file into the file buffer */
-    DWORD bytes_read = 0;
-    if (ReadFile(file_handle, file_buffer, file_size.LowPart, &bytes_read, NULL) == FALSE || bytes_read != file_size.QuadPart) {
-        error_messagea("Error: could not read ", filename);
-    }
-
-    /* process the file and read the comments */
-    {
-        comment_count count = read_comments(file_buffer, show_line_number, comment_mode);
-        if (display_comment_count) {
-            if (comment_mode & CC_COMMENT_DISPLAY) {
-                WriteFile("stdout", stdout, "c++ style comments: ", 20, NULL, NULL);
-                output_number(count.cc_comment_count);
-                WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-            }
-
-            if (comment_mode & C_COMMENT_DISPLAY) {
-                WriteFile("stdout", stdout, "c style comments: ", 18, NULL, NULL);
-                output_number(count.c_comment_count);
-                WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-            }
-
-            if (comment_mode & RUST_COMMENT_DISPLAY) {
-                WriteFile("stdout", stdout, "rust style comments: ", 21, NULL, NULL);
-                output_number(count.rust_comment_count);
-                WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-            }
-
-            if (comment_mode & ASM_COMMENT_DISPLAY) {
-                WriteFile("stdout", stdout, "asm style comments: ", 20, NULL, NULL);
-                output_number(count.asm_comment_count);
-                WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-            }
-
-            if (comment_mode & PYTHON_COMMENT_DISPLAY) {
-                WriteFile("stdout", stdout, "python style comments: ", 23, NULL, NULL);
-                output_number(count.python_comment_count);
-                WriteFile("stdout", stdout, "\r\n", 2, NULL, NULL);
-            }
-        }
-    }
-}
-
-typedef struct string
-{
-    size_t size;
-    size_t capacity;
-    char *data;
-} string_t;
-
-string_t make_string(char const *string)
-{
-    /* get the length of the string */
-    size_t string_length = lstrlenA(string);
-
-    string_t result = {
-        .size = string_length,
-        .capacity = string_length,
-        .data = HeapAlloc(GetProcessHeap(), 0, string_length + 1)
-    };
-
-    /* copy the string to result */
-    for (char *first = result.data; first != result.data + result.size; ) {
-        *first++ = *string++;
-    }
-
-    /* null terminator */
-    result.data[result.size] = '\0';
-
-    return result;
-}
-
-void string_cat(string_t *self, char const *string)
-{
-    if (string[0] == '\0') return;
-
-    size_t string_length = lstrlenA(string);
-    self->size += string_length;
-    if (self->size > self->capacity) {
-        self->capacity = self->size * 2;
-        self->data = HeapReAlloc(GetProcessHeap(), 0, self->data, (self->capacity + 1));
-    }
-    lstrcatA(self->data, string);
-}
-
-void string_free(string_t self)
-{
-    HeapFree(GetProcessHeap(), 0, self.data);
-}
-
-void read_comments_in_directory(char const *input_path, comment_display comment_mode, bool show_line_number, bool display_comment_count)
-{
-    size_t stack_capacity = 1000;
-    size_t stack_size = 1;
-    string_t *stack_base = HeapAlloc(GetProcessHeap(), 0, sizeof(string_t) * stack_capacity);
-    string_t *stack_ptr = stack_base;
-
-    *stack_ptr++ = make_string(input_path);
-    while (stack_ptr != stack_base) {
-        string_t path = stack_ptr[-1];
-        string_t spec = make_string(path.data);
-        string_cat(&spec, "\\*");
-        --stack_ptr;
-        --stack_size;
-
-        WIN32_FIND_DATAA file_find_data;
-        HANDLE find_handle = FindFirstFileA(spec.data, &file_find_data);
-        if (find_handle == INVALID_HANDLE_VALUE) {
-            string_free(spec);
-            string_free(path);
-            HeapFree(GetProcessHeap(), 0, stack_base);
-            error_messagea("Error: FindFirstFileA failed");
-        }
-
-        do {
-            if (lstrcmpA(file_find_data.cFileName, ".") != 0 &&
-                lstrcmpA(file_find_data.cFileName, "..") != 0) {
-                if (file_find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                    ++stack_size;
-                    if (stack_size > stack_capacity) {
-                        stack_capacity = stack_size * 2;
-                        stack_base = HeapReAlloc(GetProcessHeap(), 0, stack_base, sizeof(string_t) * stack_capacity);
-                        stack_ptr = stack_base + stack_size - 1;
-                    }
-                    *stack_ptr++ = make_string(path.data);
-                    string_cat(stack_ptr - 1, "\\");
-                    string_cat(stack_ptr - 1, file_find_data.cFileName);
-                }
-                else {
-                    string_t file_name = make_string(path.data);
-                    string_cat(&file_name, "\\");
-                    string_cat(&file_name, file_find_data.cFileName);
-                    read_file_comments(file_name.data, comment_mode, show_line_number, display_comment_count);
-                    string_free(file_name);
-                }
-            }
-        } while (FindNextFileA(find_handle, &file_find_data) != 0);
-
-        if (GetLastError() != ERROR_NO_MORE_FILES) {
-            FindClose(find_handle);
-            error_messagea("Error: FindNextFileA failed");
-        }
-
-        FindClose(find_handle);
-        string_free(spec);
-        string_free(path);
-    }
-
-    HeapFree(GetProcessHeap(), 0, stack_base);
-}
-
-void read_comments_in_directory_non_recursive(char const *input_path, comment_display comment_mode, bool show_line_number, bool display_comment_count)
-{
-    string_t spec = make_string(input_path);
-    string_cat(&spec, "\\*");
-
-    WIN32_FIND_DATAA file_find_data;
-    HANDLE find_handle = FindFirstFileA(spec.data, &file_find_data);
-    if (find_handle == INVALID_HANDLE_VALUE) {
-        string_free(spec);
-        error_messagea("Error: FindFirstFileA failed");
-    }
-
-    string_t file_name = make_string(input_path);
-    string_cat(&file_name, "\\");
-    do {
-        if (lstrcmpA(file_find_data.cFileName, ".") != 0 &&
-            lstrcmpA(file_find_data.cFileName, "..") != 0) {
-            if (file_find_data.dwFileAttributes & ~FILE_ATTRIBUTE_DIRECTORY) {
-                string_cat(&file_name, file_find_data.cFileName);
-                read_file_comments(file_name.data, comment_mode, show_line_number, display_comment_count);
-                file_name.data[spec.size - 1] = '\0';
-                file_name.size = spec.size - 1;
-            }
-        }
-    } while (FindNextFileA(find_handle, &file_find_data) != 0);
-
-    FindClose(find_handle);
-    string_free(spec);
-    string_free(file_name);
-}
-
-void __cdecl mainCRTStartup(void)
-{
-    static char const *help_message = "Usage: comments [--help] [-r false or true or --recursive= false or true] [-l or --line] [-c or --count] [-nl or --no_line] [-e [mode] or --enable=[mode]] [-m [mode] or --mode=[mode]] [-d [mode] or --disable=[mode]] [--display_comment_count or -dcc] [--hide_comment_count -hcc] [file1 ...]\n\
-                                         Flags: \n\
-                                        --help: displays this message \n\
-                                        -r or --recursive=: using this with true enables recursive directory searching and using with false disables recursive directory search\n\
-                                        -l or --line(disabled by default): makes it so the program shows the line number of each comment\n\
-                                        -nl or --no_line: has the oppsite effect of -l\n\
-                                        -e [mode] or --enable=[mode]: enables the comment mode to [mode] for example -e asm enables asm comments\n\
-                                        -m [mode] or --mode=[mode]: sets the comment mode  to [mode] for example -m asm only allows only asm comments\n\
-                                        -d [mode] or --disable=[mode]: disables the comment mode to [mode] for example -d asm disables asm comments\n\
-                                        [mode](the default mode auto): the different modes are \n\
-                                        c++ style comments //(cc, cxx, cpp), \n\
-                                        c style comments /**/ (c), \n\
-                                        python style comments (py), \n\
-                                        asm style comments ;(asm), \n\
-                                        c and c++ style comments /**/ //(c|c++), \n\
-                                        rust style comments which enables rust style comments /*/* comments can be nested */*/ // /// //!(rs), \n\
-                                        auto which detects the comment style based on file extension(auto), \n\
-                                        and all which enables all the available comment styles(all) \n\
-                                        -dcc or --display_comment_count(enabled by defualt): displays the number of comments found \n\
-                                        -hcc or --hides_comment_count: hides the number of comments found \n\
-                                        ";
-    stdout = GetStdHandle(STD_OUTPUT_HANDLE);
-    stderr = GetStdHandle(STD_ERROR_HANDLE);
-
-    /* get command line args */
-    int argc;
-    char **argv = CommandLineToArgvA(GetCommandLineA(), &argc) + 1;
-    --argc;
-
-    bool show_lines = false;
-    bool recursive_directory_search = false;
-    bool display_comment_count = true;
-    comment_display comment_mode = AUTO_COMMENT_DISPLAY;
-    DWORD file_type = -1;
-
-    /* this makes it easier to add flags */
-#define FIND_ARG(op)                                                        \
-    if (!lstrcmpiA(argv[i], "cc") || !lstrcmpiA(argv[i], "cxx")             \
-        || !lstrcmpiA(argv[i], "cpp")) {                                    \
-        comment_mode op CC_COMMENT_DISPLAY;                                 \
-    } else if (!lstrcmpiA(argv[i], "c")) {                                  \
-        comment_mode op C_COMMENT_DISPLAY;                                  \
-    } else if (!lstrcmpiA(argv[i], "asm")) {                                \
-        comment_mode op ASM_COMMENT_DISPLAY;                                \
-    } else if (!lstrcmpiA(argv[i], "c|c++")) {                              \
-        comment_mode op C_AND_CC_COMMENT_DISPLAY;                           \
-    } else if (!lstrcmpiA(argv[i], "auto")) {                               \
-        comment_mode op AUTO_COMMENT_DISPLAY;                               \
-    } else if(!lstrcmpiA(argv[i], "py")) {                                  \
-        comment_mode op PYTHON_COMMENT_DISPLAY;                             \
-    } else if(!lstrcmpiA(argv[i], "rs")) {                                  \
-        comment_mode op (RUST_COMMENT_DISPLAY);                             \
-    } else if (!lstrcmpiA(argv[i], "all")) {                                \
-        comment_mode op ALL_COMMENT_DISPLAY;                                \
-    } else {                                                                \
-        error_messagea("Error: invalid arguments\n", help_message);         \
-    }                                                                       \
-
-    /* parse command line args */
-    for (int i = 0; i < argc; ++i) {
-        if (!lstrcmpA(argv[i], "--line") || !lstrcmpA(argv[i], "-l")) {
-            show_lines = true;
-        }
-        else if (i + 1 < argc && !lstrcmpA(argv[i], "-r")) {
-            ++i;
-            if (!lstrcmpiA(argv[i], "true")) {
-                recursive_directory_search = true;
-            }
-            else if (!lstrcmpiA(argv[i], "false")) {
-                recursive_directory_search = false;
-            }
-            else {
-                error_messagea("Error: invalid arguments\n", help_message);
-            }
-        }
-        else if (argv[i][0] == '-' && argv[i][1] == '-'
-            && argv[i][2] == 'r' && argv[i][3] == 'e'
-            && argv[i][4] == 'c' && argv[i][5] == 'u'
-            && argv[i][6] == 'r' && argv[i][7] == 's'
-            && argv[i][8] == 'i' && argv[i][9] == 'v'
-            && argv[i][10] == 'e' && argv[i][11] == '=') {
-            argv[i] += 12;
-            if (!lstrcmpiA(argv[i], "true")) {
-                recursive_directory_search = true;
-            }
-            else if (!lstrcmpiA(argv[i], "false")) {
-                recursive_directory_search = false;
-            }
-            else {
-                error_messagea("Error: invalid arguments\n", help_message);
-            }
-        }
-        else if (!lstrcmpA(argv[i], "--no_line") || !lstrcmpA(argv[i], "-nl")) {
-            show_lines = false;
-        }
-        else if (!lstrcmpA(argv[i], "--display_comment_count") || !lstrcmpA(argv[i], "-dcc")) {
-            display_comment_count = true;
-        }
-        else if (!lstrcmpA(argv[i], "--hide_comment_count") || !lstrcmpA(argv[i], "-hcc")) {
-            display_comment_count = false;
-        }
-        else if (argv[i][0] == '-' && argv[i][1] == '-'
-            && argv[i][2] == 'm' && argv[i][3] == 'o'
-            && argv[i][4] == 'd' && argv[i][5] == 'e'
-            && argv[i][6] == '=') {
-            argv[i] += 7;
-            FIND_ARG(= );
-        }
-        else if (i + 1 < argc && !lstrcmpA(argv[i], "-m")) {
-            ++i;
-            FIND_ARG(= );
-        }
-        else if (argv[i][0] == '-' && argv[i][1] == '-'
-            && argv[i][2] == 'm' && argv[i][3] == 'o'
-            && argv[i][4] == 'd' && argv[i][5] == 'e'
-            && argv[i][6] == '=') {
-            argv[i] += 7;
-            FIND_ARG(= );
-        }
-        else if (i + 1 < argc && !lstrcmpA(argv[i], "-e")) {
-            ++i;
-            FIND_ARG(|= );
-        }
-        else if (argv[i][0] == '-' && argv[i][1] == '-'
-            && argv[i][2] == 'd' && argv[i][3] == 'i'
-            && argv[i][4] == 's' && argv[i][5] == 'a'
-            && argv[i][6] == 'b' && argv[i][7] == 'l'
-            && argv[i][8] == 'e' && argv[i][9] == '=') {
-            argv[i] += 10;
-            FIND_ARG(&= ~);
-        }
-        else if (i + 1 < argc && !lstrcmpA(argv[i], "-d")) {
-            ++i;
-            FIND_ARG(&= ~);
-        }
-        else if (!lstrcmpiA(argv[i], "--help")) {
-            WriteFile("stdout", stdout, help_message, lstrlenA(help_message), NULL, NULL);
-        }
-        else if (((file_type = GetFileAttributesA(argv[i])) & ~FILE_ATTRIBUTE_DIRECTORY) && file_type != INVALID_FILE_ATTRIBUTES) {
-            read_file_comments(argv[i], comment_mode, show_lines, display_comment_count);
-        }
-        else if (file_type != INVALID_FILE_ATTRIBUTES && (file_type & FILE_ATTRIBUTE_DIRECTORY)) {
-            if (recursive_directory_search) {
-                read_comments_in_directory(argv[i], comment_mode, show_lines, display_comment_count);
-            }
-            else {
-                read_comments_in_directory_non_recursive(argv[i], comment_mode, show_lines, display_comment_count);
-            }
-        }
-        else {
-            error_messagea("Error: invalid arguments\n", help_message);
-        }
-    }
-
-    /* cleanup */
-    LocalFree(argv - 1);
-
-    ExitProcess(0);
+#include <windows.h>
+#include <stdbool.h>
+
+#include "argva.c"
+#include "shared.c"
+#include "extract.c"
+#include "match.c"
+#include "metrics.c"
+#include "stats.c"
+#include "input.c"
+#include "cache.c"
+#include "pool.c"
+#include "arena.c"
+#include "ignore.c"
+#include "inflate.c"
+#include "git.c"
+#include "archive.c"
+
+HANDLE stdout = NULL;
+HANDLE stderr = NULL;
+
+static void flush_stdout(void);
+
+__declspec(noreturn) static void error_messagea(size_t count, char const **messages)
+{
+    /* write out whatever was buffered so the error shows up after it */
+    flush_stdout();
+
+    for (size_t i = 0; i < count; ++i) {
+        char const *message = messages[i];
+        WriteFile(stderr, message, lstrlenA(message), NULL, NULL);
+    }
+    ExitProcess(GetLastError());
+}
+
+#define error_messagea(...) error_messagea(sizeof((char const*[]){__VA_ARGS__}) / sizeof(char const *), (char const*[]){__VA_ARGS__})
+#define WriteFile(filepath, ...) if(!WriteFile(__VA_ARGS__)) { error_messagea("Error could not write to ", filepath); }
+
+/* all output goes through one of these buffers so that we only call WriteFile once per flush
+ * instead of once per byte
+ */
+typedef struct output_buffer
+{
+    char *data;
+    size_t size;
+
+    /* stdout buffers are flushed once they hold this many bytes, memory buffers grow instead */
+    size_t capacity;
+    bool in_memory;
+} output_buffer;
+
+#define DEFAULT_OUTPUT_BUFFER_SIZE (1 << 20)
+#define DEFAULT_MEMORY_BUFFER_SIZE (1 << 12)
+
+/* the buffer for stdout */
+static output_buffer output = { .capacity = DEFAULT_OUTPUT_BUFFER_SIZE };
+
+static output_buffer make_memory_buffer(void)
+{
+    return (output_buffer) { .capacity = DEFAULT_MEMORY_BUFFER_SIZE, .in_memory = true };
+}
+
+static void output_write_handle(char const *data, size_t size)
+{
+    stats_span span = stats_begin();
+    stats_add_output(size);
+
+    /* WriteFile can only write a DWORD worth of bytes at a time */
+    while (size != 0) {
+        DWORD chunk_size = size > (1 << 30) ? (1 << 30) : (DWORD)size;
+        DWORD bytes_written = 0;
+        stats_count_call(WRITE_FILE_CALL);
+        WriteFile("stdout", stdout, data, chunk_size, &bytes_written, NULL);
+        data += bytes_written;
+        size -= bytes_written;
+    }
+    stats_end(span, WRITE_PHASE, "stdout");
+}
+
+static void output_flush(output_buffer *out)
+{
+    if (out->in_memory) return;
+
+    /* NOTE: reset the size before writing so that an error while writing does not try to flush again */
+    size_t size = out->size;
+    out->size = 0;
+    output_write_handle(out->data, size);
+}
+
+static void flush_stdout(void)
+{
+    output_flush(&output);
+}
+
+static void output_write(output_buffer *out, char const *data, size_t size)
+{
+    if (out->data == NULL) {
+        out->data = HeapAlloc(GetProcessHeap(), 0, out->capacity);
+        if (out->data == NULL) {
+            error_messagea("Error: could not allocate the output buffer");
+        }
+    }
+
+    if (out->size + size > out->capacity) {
+        if (out->in_memory) {
+            out->capacity = (out->size + size) * 2;
+            out->data = HeapReAlloc(GetProcessHeap(), 0, out->data, out->capacity);
+            if (out->data == NULL) {
+                error_messagea("Error: could not allocate the output buffer");
+            }
+        }
+        else {
+            output_flush(out);
+
+            /* large spans are written directly instead of being copied through the buffer */
+            if (size >= out->capacity) {
+                output_write_handle(data, size);
+                return;
+            }
+        }
+    }
+
+    for (char *first = out->data + out->size; size != 0; --size) {
+        *first++ = *data++;
+        ++out->size;
+    }
+}
+
+static void output_spaces(output_buffer *out, size_t count)
+{
+    static char const spaces[64] = "                                                                ";
+    while (count != 0) {
+        size_t chunk_size = count > sizeof(spaces) ? sizeof(spaces) : count;
+        output_write(out, spaces, chunk_size);
+        count -= chunk_size;
+    }
+}
+
+static void output_free(output_buffer *out)
+{
+    HeapFree(GetProcessHeap(), 0, out->data);
+    out->data = NULL;
+    out->size = 0;
+}
+
+static void output_set_capacity(output_buffer *out, size_t capacity)
+{
+    output_flush(out);
+    output_free(out);
+    out->capacity = capacity == 0 ? 1 : capacity;
+}
+
+/* --format, the record formats write one record per comment with where it is in the file instead of the text */
+typedef enum output_format
+{
+    TEXT_OUTPUT_FORMAT,
+    JSON_LINES_OUTPUT_FORMAT,
+    BINARY_OUTPUT_FORMAT,
+
+    /* only for --metrics */
+    CSV_OUTPUT_FORMAT
+} output_format;
+
+/* the settings that control how files are read and displayed */
+typedef struct read_options
+{
+    comment_display comment_mode;
+    bool show_line_number;
+    bool display_comment_count;
+
+    /* map files into memory instead of reading them into a heap buffer */
+    bool map_files;
+
+    /* only count the comments and print the totals of the whole run at the end */
+    bool count_only;
+
+    /* the extensions of the defined languages and of --language-map that come before the built in ones, NULL if there are none */
+    language_map const *languages;
+
+    output_format format;
+
+    /* --cache, NULL if files are always read */
+    result_cache *cache;
+
+    /* --jobs, a file of at least SPLIT_FILE_MIN_SIZE bytes is also split across this many threads */
+    size_t thread_count;
+
+    /* the workers of the walk that reads the files, a big file pushes its parts onto them, NULL outside of a parallel walk */
+    thread_pool *pool;
+
+    /* --match and --regex, NULL if every comment is written */
+    comment_filter const *filter;
+
+    /* --exclude, --include and --ignore-files, NULL if the walkers read every file */
+    ignore_options const *ignore;
+
+    /* --max-file-size, 0 if there is no limit, with --oversized=head the start of a larger file is read instead of skipping it */
+    ULONGLONG max_file_size;
+    bool read_oversized_head;
+
+    /* --binary, files that do not look like text are read anyway */
+    bool read_binary;
+
+    /* --metrics, the lines of each file are counted by what is on them and written instead of its comments */
+    bool metrics;
+} read_options;
+
+/* what was read over the whole run, for --count-only */
+typedef struct run_totals
+{
+    /* every comment style that was used for a file */
+    comment_display comment_mode;
+    size_t file_count;
+    comment_count count;
+
+    /* only counted for --metrics */
+    line_metrics lines;
+} run_totals;
+
+static run_totals totals;
+
+/* how many comments matched the filter over the whole run, only counted for --max-total which reads one file at a time */
+static size_t total_match_count;
+
+static bool total_matches_reached(read_options const *options)
+{
+    return options->filter != NULL && options->filter->max_total != 0 && total_match_count >= options->filter->max_total;
+}
+
+static void add_comment_count(comment_count *to, comment_count const *from)
+{
+    to->c_comment_count += from->c_comment_count;
+    to->cc_comment_count += from->cc_comment_count;
+    to->asm_comment_count += from->asm_comment_count;
+    to->python_comment_count += from->python_comment_count;
+    to->rust_comment_count += from->rust_comment_count;
+    to->line_comment_count += from->line_comment_count;
+    to->block_comment_count += from->block_comment_count;
+}
+
+static void add_totals(run_totals *to, run_totals const *from)
+{
+    to->comment_mode |= from->comment_mode;
+    to->file_count += from->file_count;
+    add_comment_count(&to->count, &from->count);
+    add_line_metrics(&to->lines, &from->lines);
+}
+
+static void output_number(output_buffer *out, size_t number)
+{
+    /* log10(2^64) is around 20 meaning this should be able to hold all numbers inputed */
+    char digits[20] = { '0' };
+
+    /* get the reversed digets of the number */
+    int i = number == 0 ? 1 : 0; /* check if number is zero */
+    for (; number != 0; ++i) {
+        digits[i] = (number % 10) + '0';
+        number /= 10;
+    }
+
+    /* reverse the reversed digets of the number */
+    for (int j = 0; j < i / 2; ++j) {
+        char temp_digit = digits[j];
+        digits[j] = digits[i - 1 - j];
+        digits[i - 1 - j] = temp_digit;
+    }
+
+    /* print the reversed number */
+    output_write(out, digits, i);
+}
+
+/* writes numbers that can be larger than a size_t like the offsets of stdin in 32 bit builds */
+static void output_offset(output_buffer *out, ULONGLONG number)
+{
+    if (number <= (size_t)-1) {
+        output_number(out, (size_t)number);
+        return;
+    }
+
+    /* NOTE: there is no 64 bit division in 32 bit builds without the crt so the digits are found by subtracting powers of ten */
+    static ULONGLONG const powers[] = {
+        10000000000000000000ull, 1000000000000000000ull, 100000000000000000ull, 10000000000000000ull,
+        1000000000000000ull, 100000000000000ull, 10000000000000ull, 1000000000000ull, 100000000000ull,
+        10000000000ull, 1000000000ull, 100000000ull, 10000000ull, 1000000ull, 100000ull, 10000ull, 1000ull,
+        100ull, 10ull, 1ull
+    };
+
+    char digits[20];
+    int count = 0;
+    for (int i = 0; i < (int)(sizeof(powers) / sizeof(powers[0])); ++i) {
+        char digit = '0';
+        while (number >= powers[i]) {
+            number -= powers[i];
+            ++digit;
+        }
+
+        if (digit != '0' || count != 0) {
+            digits[count++] = digit;
+        }
+    }
+    output_write(out, digits, count);
+}
+
+/* returns the size of the utf-8 sequence at str or 0 if it is not a valid one */
+static size_t utf8_sequence_size(char const *str, char const *end)
+{
+    unsigned char const *pos = (unsigned char const *)str;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    size_t size;
+    if (pos[0] >= 0xc2 && pos[0] <= 0xdf) {
+        size = 2;
+    }
+    else if (pos[0] >= 0xe0 && pos[0] <= 0xef) {
+        /* no overlong forms and no surrogates */
+        size = 3;
+        low = pos[0] == 0xe0 ? 0xa0 : low;
+        high = pos[0] == 0xed ? 0x9f : high;
+    }
+    else if (pos[0] >= 0xf0 && pos[0] <= 0xf4) {
+        /* no overlong forms and nothing above U+10FFFF */
+        size = 4;
+        low = pos[0] == 0xf0 ? 0x90 : low;
+        high = pos[0] == 0xf4 ? 0x8f : high;
+    }
+    else {
+        return 0;
+    }
+
+    if ((size_t)(end - str) < size || pos[1] < low || pos[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < size; ++i) {
+        if (pos[i] < 0x80 || pos[i] > 0xbf) {
+            return 0;
+        }
+    }
+
+    return size;
+}
+
+/* writes str as a json string, bytes that are not valid utf-8 are written as the latin-1 character with the same value
+ * NOTE: the byte offsets of the records can be used to get the exact bytes back from the file
+ */
+static void output_json_string(output_buffer *out, char const *str, size_t size)
+{
+    static char const hex_digits[] = "0123456789abcdef";
+
+    output_write(out, "\"", 1);
+
+    /* runs of bytes that do not need to be escaped are written at once */
+    char const *run = str;
+    char const *const end = str + size;
+    char const *pos = str;
+    while (pos != end) {
+        unsigned char const byte = (unsigned char)*pos;
+        if (byte >= 0x20 && byte < 0x80 && byte != '"' && byte != '\\') {
+            ++pos;
+            continue;
+        }
+        if (byte >= 0x80) {
+            size_t sequence_size = utf8_sequence_size(pos, end);
+            if (sequence_size != 0) {
+                pos += sequence_size;
+                continue;
+            }
+        }
+
+        output_write(out, run, pos - run);
+
+        char escape[6];
+        size_t escape_size = 2;
+        escape[0] = '\\';
+        switch (byte) {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex_digits[byte >> 4];
+                escape[5] = hex_digits[byte & 0xf];
+                escape_size = 6;
+                break;
+        }
+        output_write(out, escape, escape_size);
+        run = ++pos;
+    }
+
+    output_write(out, run, end - run);
+    output_write(out, "\"", 1);
+}
+
+/* a comment as it is written by the record formats */
+typedef struct comment_record
+{
+    comment_kind kind;
+
+    /* the offsets of the first byte of the comment and one past its last byte including the delimiters,
+     * comments that end at the end of a line stop before the new line
+     */
+    ULONGLONG begin;
+    ULONGLONG end;
+
+    /* the lines the comment starts and ends on */
+    size_t begin_line;
+    size_t end_line;
+} comment_record;
+
+/* the kinds of comments as they are named by --format=jsonl */
+static char const *const comment_kind_names[COMMENT_KIND_COUNT] = {
+    "c",
+    "cc",
+    "rust",
+    "asm",
+    "python_doc",
+    "python",
+    "line",
+    "block"
+};
+
+/* --format=binary starts with this header and is followed by records that are all a multiple of 8 bytes long
+ * so that a reader can map the output and go from record to record by their size without reading the text
+ * NOTE: every field is little endian
+ */
+typedef struct binary_header
+{
+    char magic[4];
+    DWORD version;
+} binary_header;
+
+#define BINARY_FORMAT_VERSION 1
+
+typedef enum binary_record_type
+{
+    /* a file starts, the text is its path and it holds until the next file record */
+    BINARY_FILE_RECORD = 1,
+
+    /* a comment of the last file, kind is a comment_kind */
+    BINARY_COMMENT_RECORD = 2
+} binary_record_type;
+
+typedef struct binary_record
+{
+    /* the size of the whole record including the text and the zero padding after it */
+    ULONGLONG size;
+    DWORD type;
+    DWORD kind;
+    ULONGLONG begin;
+    ULONGLONG end;
+    ULONGLONG begin_line;
+    ULONGLONG end_line;
+
+    /* the size of the text that follows the record */
+    ULONGLONG text_size;
+} binary_record;
+
+static void output_binary_header(output_buffer *out)
+{
+    binary_header header = { .magic = { 'C', 'M', 'N', 'T' }, .version = BINARY_FORMAT_VERSION };
+    output_write(out, (char const *)&header, sizeof(header));
+}
+
+static void output_binary_record(output_buffer *out, binary_record_type type, comment_record const *record, char const *text, size_t text_size)
+{
+    static char const padding[8] = { 0 };
+    size_t const padding_size = (8 - (text_size & 7)) & 7;
+
+    binary_record header = {
+        .size = sizeof(binary_record) + (ULONGLONG)text_size + padding_size,
+        .type = type,
+        .kind = record->kind,
+        .begin = record->begin,
+        .end = record->end,
+        .begin_line = record->begin_line,
+        .end_line = record->end_line,
+        .text_size = text_size
+    };
+    output_write(out, (char const *)&header, sizeof(header));
+    output_write(out, text, text_size);
+    output_write(out, padding, padding_size);
+}
+
+/* the text format writes the name of a file before its comments, jsonl writes it in every record instead */
+static void output_file_header(output_buffer *out, output_format format, char const *filename)
+{
+    size_t const size = lstrlenA(filename);
+    switch (format) {
+        case TEXT_OUTPUT_FORMAT:
+            output_write(out, filename, size);
+            output_write(out, ": \r\n", 4);
+            break;
+        case BINARY_OUTPUT_FORMAT:
+            output_binary_record(out, BINARY_FILE_RECORD, &(comment_record) { 0 }, filename, size);
+            break;
+        default:
+            break;
+    }
+}
+
+static void output_comment_record(output_buffer *out, output_format format, char const *filename,
+                                  comment_record const *record, char const *text, size_t text_size)
+{
+    if (format == BINARY_OUTPUT_FORMAT) {
+        output_binary_record(out, BINARY_COMMENT_RECORD, record, text, text_size);
+        return;
+    }
+
+    /* the records of a blob of --git-rev have a null file until they are written for one of its paths, see git_blob */
+    char const *kind = comment_kind_names[record->kind];
+    output_write(out, "{\"file\":", 8);
+    if (filename != NULL) {
+        output_json_string(out, filename, lstrlenA(filename));
+    }
+    else {
+        output_write(out, "null", 4);
+    }
+    output_write(out, ",\"kind\":\"", 9);
+    output_write(out, kind, lstrlenA(kind));
+    output_write(out, "\",\"start\":", 10);
+    output_offset(out, record->begin);
+    output_write(out, ",\"end\":", 7);
+    output_offset(out, record->end);
+    output_write(out, ",\"start_line\":", 14);
+    output_number(out, record->begin_line);
+    output_write(out, ",\"end_line\":", 12);
+    output_number(out, record->end_line);
+    output_write(out, ",\"text\":", 8);
+    output_json_string(out, text, text_size);
+    output_write(out, "}\n", 2);
+}
+
+/* one table per combination of the comment_display bits and one that only counts, they are built the first time they are needed */
+static lexer_table *volatile lexer_tables[2][AUTO_COMMENT_DISPLAY];
+
+/* the languages of the built in definitions and --languages, the tables that do not only count are built when the languages are added */
+static language_list defined_languages;
+static lexer_table *volatile defined_tables[2][MAX_DEFINED_LANGUAGES];
+
+static lexer_table const *get_lexer_table(comment_display comment_mode, bool count_only)
+{
+    bool const defined = (comment_mode & DEFINED_COMMENT_DISPLAY) != 0;
+    size_t const index = defined ? DEFINED_LANGUAGE_INDEX(comment_mode) : 0;
+    comment_mode &= AUTO_COMMENT_DISPLAY - 1;
+
+    lexer_table *volatile *slot = defined ? &defined_tables[count_only][index] : &lexer_tables[count_only][comment_mode];
+    lexer_table *table = *slot;
+    if (table != NULL) {
+        return table;
+    }
+
+    table = HeapAlloc(GetProcessHeap(), 0, sizeof(lexer_table));
+    if (table == NULL) {
+        return NULL;
+    }
+    if (defined) {
+        /* NOTE: the count table is a copy of the one that was already built */
+        lexer_table const *built = defined_tables[0][index];
+        char const *from = (char const *)built;
+        char *to = (char *)table;
+        for (size_t i = 0; i < sizeof(lexer_table); ++i) {
+            to[i] = from[i];
+        }
+    }
+    else {
+        build_lexer_table(table, comment_mode);
+    }
+    if (count_only) {
+        build_count_table(table);
+    }
+
+    /* NOTE: another thread may have built the same table in the mean time, keep theirs */
+    lexer_table *previous = InterlockedCompareExchangePointer((void *volatile *)slot, table, NULL);
+    if (previous != NULL) {
+        HeapFree(GetProcessHeap(), 0, table);
+        return previous;
+    }
+
+    return table;
+}
+
+static void output_line_end(output_buffer *out, bool show_lines, size_t line)
+{
+    if (show_lines) {
+        output_write(out, " ", 1);
+        output_number(out, line);
+    }
+    output_write(out, "\r\n", 2);
+}
+
+/* writes the comments the lexer finds in one of the output formats */
+typedef struct comment_writer
+{
+    output_buffer *out;
+    bool show_lines;
+    output_format format;
+
+    /* filename is only used by the record formats and the header of a filtered file, it is NULL for the blobs of --git-rev */
+    char const *filename;
+
+    /* with a record format the text of a comment is collected in record_text and written as one record when it ends */
+    comment_record record;
+    output_buffer record_text;
+
+    /* --match and --regex, NULL if every comment is written
+     * the text of a comment is collected in record_text to be matched, with the text format the indentation
+     * and where each line ended are kept so that it is only written out as the text sink would once it matched
+     */
+    comment_filter const *filter;
+    size_t column;
+    output_buffer line_ends;
+    comment_lexer *lexer;
+
+    /* the file header is written right before the first comment that matches so files without one are left out */
+    bool header_pending;
+
+    /* with --count-only the comments that match are counted and not written */
+    bool count_only;
+    size_t match_count;
+    comment_count matched;
+} comment_writer;
+
+/* returns whether the comment in record_text is written, the lexer is stopped once --max-count or --max-total is reached */
+static bool keep_comment(comment_writer *writer)
+{
+    comment_filter const *filter = writer->filter;
+    if (!filter_matches(filter, writer->record_text.data, writer->record_text.size)) {
+        return false;
+    }
+
+    count_comment(&writer->matched, writer->record.kind);
+    ++writer->match_count;
+    if (filter->max_total != 0) {
+        ++total_match_count;
+    }
+    if ((filter->max_count != 0 && writer->match_count >= filter->max_count)
+        || (filter->max_total != 0 && total_match_count >= filter->max_total)) {
+        lexer_stop(writer->lexer);
+    }
+
+    if (writer->header_pending) {
+        output_file_header(writer->out, writer->format, writer->filename);
+        writer->header_pending = false;
+    }
+    return !writer->count_only;
+}
+
+static void write_text_begin(void *context, comment_kind kind, ULONGLONG begin, size_t line, size_t column)
+{
+    (void)kind;
+    (void)begin;
+    (void)line;
+    comment_writer *writer = context;
+    output_spaces(writer->out, column + 1);
+}
+
+static void write_text(void *context, char const *text, size_t size)
+{
+    comment_writer *writer = context;
+    output_write(writer->out, text, size);
+}
+
+static void write_text_line_end(void *context, size_t line)
+{
+    comment_writer *writer = context;
+    output_line_end(writer->out, writer->show_lines, line);
+}
+
+static void write_text_end(void *context, ULONGLONG end, size_t line)
+{
+    (void)end;
+    comment_writer *writer = context;
+    output_line_end(writer->out, writer->show_lines, line);
+}
+
+static void write_record_begin(void *context, comment_kind kind, ULONGLONG begin, size_t line, size_t column)
+{
+    (void)column;
+    comment_writer *writer = context;
+    writer->record = (comment_record) { .kind = kind, .begin = begin, .begin_line = line };
+}
+
+static void write_record_text(void *context, char const *text, size_t size)
+{
+    comment_writer *writer = context;
+    output_write(&writer->record_text, text, size);
+}
+
+static void write_record_line_end(void *context, size_t line)
+{
+    (void)line;
+    comment_writer *writer = context;
+    output_write(&writer->record_text, "\n", 1);
+}
+
+static void write_record_end(void *context, ULONGLONG end, size_t line)
+{
+    comment_writer *writer = context;
+    writer->record.end = end;
+    writer->record.end_line = line;
+    if (writer->filter == NULL || keep_comment(writer)) {
+        output_comment_record(writer->out, writer->format, writer->filename, &writer->record, writer->record_text.data, writer->record_text.size);
+    }
+    writer->record_text.size = 0;
+}
+
+/* a line of a comment that is being filtered ended before the offset in record_text */
+typedef struct filtered_line_end
+{
+    size_t offset;
+    size_t line;
+} filtered_line_end;
+
+/* the text format with a filter, the comment is written as the text sink would once it is known to match */
+static void filter_text_begin(void *context, comment_kind kind, ULONGLONG begin, size_t line, size_t column)
+{
+    (void)begin;
+    (void)line;
+    comment_writer *writer = context;
+    writer->record.kind = kind;
+    writer->column = column;
+}
+
+static void filter_text_line_end(void *context, size_t line)
+{
+    comment_writer *writer = context;
+    filtered_line_end line_end = { .offset = writer->record_text.size, .line = line };
+    output_write(&writer->line_ends, (char const *)&line_end, sizeof(line_end));
+    output_write(&writer->record_text, "\n", 1);
+}
+
+static void filter_text_end(void *context, ULONGLONG end, size_t line)
+{
+    (void)end;
+    comment_writer *writer = context;
+    if (keep_comment(writer)) {
+        output_spaces(writer->out, writer->column + 1);
+        filtered_line_end const *line_end = (filtered_line_end const *)writer->line_ends.data;
+        filtered_line_end const *last = line_end + writer->line_ends.size / sizeof(filtered_line_end);
+        size_t offset = 0;
+        for (; line_end != last; ++line_end) {
+            output_write(writer->out, writer->record_text.data + offset, line_end->offset - offset);
+            output_line_end(writer->out, writer->show_lines, line_end->line);
+            offset = line_end->offset + 1;
+        }
+        output_write(writer->out, writer->record_text.data + offset, writer->record_text.size - offset);
+        output_line_end(writer->out, writer->show_lines, line);
+    }
+    writer->line_ends.size = 0;
+    writer->record_text.size = 0;
+}
+
+static comment_sink const text_sink = {
+    .begin = write_text_begin,
+    .text = write_text,
+    .line_end = write_text_line_end,
+    .end = write_text_end,
+    .doc_space = true
+};
+
+static comment_sink const record_sink = {
+    .begin = write_record_begin,
+    .text = write_record_text,
+    .line_end = write_record_line_end,
+    .end = write_record_end
+};
+
+static comment_sink const filter_text_sink = {
+    .begin = filter_text_begin,
+    .text = write_record_text,
+    .line_end = filter_text_line_end,
+    .end = filter_text_end,
+    .doc_space = true
+};
+
+/* with count_only nothing is written and the lexer has to be fed with lexer_count instead of lexer_feed
+ * NOTE: with a filter the text of the comments is needed so count_only is never set, the writer counts the ones that match
+ */
+static void start_comments(comment_lexer *lexer, comment_writer *writer, comment_display comment_mode, bool count_only,
+                           read_options const *options, char const *filename, output_buffer *out)
+{
+    *writer = (comment_writer) {
+        .out = out,
+        .show_lines = options->show_line_number,
+        .format = options->format,
+        .filename = filename,
+        .record_text = make_memory_buffer(),
+        .filter = options->filter,
+        .line_ends = make_memory_buffer(),
+        .lexer = lexer,
+        .header_pending = options->filter != NULL && filename != NULL,
+        .count_only = options->count_only
+    };
+
+    lexer_table const *table = get_lexer_table(comment_mode, count_only);
+    if (table == NULL) {
+        error_messagea("Error: could not allocate memory for the lexer");
+    }
+
+    bool const count_lines = !count_only && (options->show_line_number || options->format != TEXT_OUTPUT_FORMAT);
+    comment_sink const *sink = options->format != TEXT_OUTPUT_FORMAT ? &record_sink
+        : options->filter != NULL ? &filter_text_sink
+        : &text_sink;
+    lexer_init(lexer, table, sink, writer, count_lines);
+}
+
+static void feed_comments(comment_lexer *lexer, char const *str, size_t size)
+{
+    if (!lexer_feed(lexer, str, size)) {
+        error_messagea("Error: could not allocate memory for the lexer");
+    }
+}
+
+/* with a filter only the comments that matched are counted */
+static comment_count finish_comments(comment_lexer *lexer, comment_writer *writer)
+{
+    comment_count count = lexer_finish(lexer);
+    if (writer->record_text.data != NULL) {
+        output_free(&writer->record_text);
+    }
+    if (writer->line_ends.data != NULL) {
+        output_free(&writer->line_ends);
+    }
+    return writer->filter != NULL ? writer->matched : count;
+}
+
+static bool has_comments(comment_count const *count)
+{
+    return count->c_comment_count != 0 || count->cc_comment_count != 0 || count->asm_comment_count != 0
+        || count->python_comment_count != 0 || count->rust_comment_count != 0
+        || count->line_comment_count != 0 || count->block_comment_count != 0;
+}
+
+/* a file that is at least this big is split into parts that are read on every thread, see read_split_comments
+ * NOTE: with the runs from every state the work is two or three times that of reading the file in one go so it needs a few threads
+ */
+#define SPLIT_FILE_MIN_SIZE (1 << 24)
+#define SPLIT_MIN_THREAD_COUNT 4
+#define SPLIT_PART_MIN_SIZE (1 << 20)
+#define SPLIT_PARTS_PER_THREAD 4
+
+typedef struct split_part
+{
+    /* every part but the first starts right after a new line */
+    size_t begin;
+    size_t end;
+    size_t newline_count;
+    lexer_speculation speculation;
+
+    /* a part that starts in code is read from there to the next one that does, the others are read with the part before them */
+    bool starts_in_code;
+    size_t line;
+    output_buffer out;
+    comment_count count;
+} split_part;
+
+typedef struct split_input
+{
+    char const *str;
+    read_options const *options;
+    comment_display comment_mode;
+    bool count_only;
+    bool count_lines;
+    char const *filename;
+    lexer_table const *count_table;
+
+    split_part *parts;
+    size_t part_count;
+} split_input;
+
+typedef void split_part_function(split_input *input, split_part *part);
+
+/* one pass over the parts, the thread that reads the file and the tasks it pushes take the parts in turn
+ * NOTE: a task can start after every part was taken and the file is done, so whichever lets go of the pass last frees it
+ */
+typedef struct split_pass
+{
+    split_input *input;
+    split_part_function *run;
+    LONG part_count;
+    volatile LONG next_part;
+    volatile LONG done_count;
+    volatile LONG reference_count;
+} split_pass;
+
+static void release_split_pass(split_pass *pass)
+{
+    if (InterlockedDecrement(&pass->reference_count) == 0) {
+        HeapFree(GetProcessHeap(), 0, pass);
+    }
+}
+
+static void run_split_parts(split_pass *pass)
+{
+    LONG i;
+    while ((i = InterlockedIncrement(&pass->next_part) - 1) < pass->part_count) {
+        pass->run(pass->input, &pass->input->parts[i]);
+        InterlockedIncrement(&pass->done_count);
+    }
+}
+
+static void split_pass_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    (void)pool;
+    (void)worker_index;
+    run_split_parts(data);
+    release_split_pass(data);
+}
+
+/* the first task of the threads that are started for a file outside of a walk, it hands the pass to the others */
+static void spread_split_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    for (size_t i = 1; i < pool->thread_count; ++i) {
+        if (!pool_push(pool, worker_index, split_pass_task, data)) {
+            release_split_pass(data);
+        }
+    }
+    split_pass_task(pool, worker_index, data);
+}
+
+static void speculate_part(split_input *input, split_part *part)
+{
+    lexer_speculate(input->count_table, input->str + part->begin, part->end - part->begin, &part->speculation);
+    if (input->count_lines) {
+        part->newline_count = count_newlines(input->str + part->begin, input->str + part->end);
+    }
+}
+
+static void read_part(split_input *input, split_part *part)
+{
+    if (!part->starts_in_code) return;
+
+    split_part const *last = part + 1;
+    while (last != input->parts + input->part_count && !last->starts_in_code) {
+        ++last;
+    }
+    size_t const end = (last - 1)->end;
+
+    part->out = make_memory_buffer();
+    comment_lexer lexer;
+    comment_writer writer;
+    start_comments(&lexer, &writer, input->comment_mode, input->count_only, input->options, input->filename, &part->out);
+    writer.header_pending = false;
+    lexer_start_at(&lexer, part->begin, part->line, CODE_STATE, 0);
+    if (input->count_only) {
+        lexer_count(&lexer, input->str + part->begin, end - part->begin);
+    }
+    else {
+        feed_comments(&lexer, input->str + part->begin, end - part->begin);
+    }
+    part->count = finish_comments(&lexer, &writer);
+}
+
+/* runs a pass over the parts on this thread and on the others, inside a walk its pool is used so that a big file
+ * only takes the workers that are free and starts no threads of its own
+ */
+static void run_split_pass(split_input *input, split_part_function *run)
+{
+    thread_pool *walk_pool = input->options->pool;
+    size_t thread_count = walk_pool != NULL ? walk_pool->thread_count : input->options->thread_count;
+    if (thread_count > input->part_count) {
+        thread_count = input->part_count;
+    }
+
+    split_pass *pass = HeapAlloc(GetProcessHeap(), 0, sizeof(split_pass));
+    if (pass == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    *pass = (split_pass) { .input = input, .run = run, .part_count = (LONG)input->part_count, .reference_count = (LONG)thread_count };
+
+    if (thread_count == 1) {
+        run_split_parts(pass);
+    }
+    else if (walk_pool != NULL && pool_enter(walk_pool)) {
+        for (size_t i = 1; i < thread_count; ++i) {
+            if (!pool_push(walk_pool, 0, split_pass_task, pass)) {
+                release_split_pass(pass);
+            }
+        }
+        pool_leave(walk_pool);
+
+        /* the parts the other workers took may still be running after this thread runs out of them */
+        run_split_parts(pass);
+        for (size_t idle_count = 0; pass->done_count != pass->part_count;) {
+            pool_back_off(++idle_count);
+        }
+    }
+    else {
+        thread_pool pool;
+        if (!pool_start(&pool, thread_count - 1, NULL, spread_split_task, pass)) {
+            error_messagea("Error: could not start the worker threads");
+        }
+        run_split_parts(pass);
+        pool_join(&pool);
+    }
+    release_split_pass(pass);
+}
+
+/* reads a big file on every thread with the same output as reading it in one go
+ * the file is split at new lines and every part is first run from every state that can follow a new line,
+ * then the state each part really starts in is found by going through the parts in order, which only takes a look up per part,
+ * and the parts that start in code are read in full, in code the lexer carries nothing over a new line so their output
+ * only has to be put together and a comment that goes over the end of a part is read with the part it starts in
+ */
+static comment_count read_split_comments(char const *str, size_t size, read_options const *options, comment_display comment_mode,
+                                         bool count_only, char const *filename, output_buffer *out)
+{
+    split_input input = {
+        .str = str,
+        .options = options,
+        .comment_mode = comment_mode,
+        .count_only = count_only,
+        .count_lines = !count_only && (options->show_line_number || options->format != TEXT_OUTPUT_FORMAT),
+        .filename = filename,
+        .count_table = get_lexer_table(comment_mode, true)
+    };
+    if (input.count_table == NULL) {
+        error_messagea("Error: could not allocate memory for the lexer");
+    }
+
+    size_t part_count = options->thread_count * SPLIT_PARTS_PER_THREAD;
+    if (part_count > size / SPLIT_PART_MIN_SIZE) {
+        part_count = size / SPLIT_PART_MIN_SIZE;
+    }
+    input.parts = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(split_part) * part_count);
+    if (input.parts == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+
+    /* a part starts after the first new line from where it would start evenly, there is no part if that is in the next one */
+    delimiter_set const newline = DELIMITERS("\n");
+    size_t const part_size = size / part_count;
+    for (size_t i = 0; i < part_count; ++i) {
+        size_t begin = 0;
+        if (i != 0) {
+            char const *found = find_delimiter(str + i * part_size, str + (i + 1) * part_size, &newline, NULL);
+            if (found == str + (i + 1) * part_size) continue;
+            begin = (size_t)(found - str) + 1;
+        }
+
+        if (input.part_count != 0) {
+            input.parts[input.part_count - 1].end = begin;
+        }
+        input.parts[input.part_count++].begin = begin;
+    }
+    input.parts[input.part_count - 1].end = size;
+
+    run_split_pass(&input, speculate_part);
+
+    /* find the state every part starts in, a nested comment that goes over the end of a part has to be counted through */
+    lexer_state state = CODE_STATE;
+    size_t depth = 0;
+    size_t line = 1;
+    for (size_t i = 0; i < input.part_count; ++i) {
+        split_part *part = &input.parts[i];
+        part->starts_in_code = state == CODE_STATE;
+        part->line = line;
+        line += part->newline_count;
+        if (part->speculation.stopped) {
+            input.part_count = i + 1;
+            break;
+        }
+
+        if (depth == 0) {
+            depth = part->speculation.end_depths[state];
+            state = part->speculation.end_states[state];
+        }
+        else {
+            comment_lexer lexer;
+            lexer_init(&lexer, input.count_table, NULL, NULL, false);
+            lexer_start_at(&lexer, part->begin, 0, state, depth);
+            lexer_count(&lexer, str + part->begin, part->end - part->begin);
+            state = lexer.state;
+            depth = lexer.depth;
+        }
+    }
+
+    run_split_pass(&input, read_part);
+
+    comment_count count = { 0 };
+    for (size_t i = 0; i < input.part_count; ++i) {
+        add_comment_count(&count, &input.parts[i].count);
+    }
+
+    /* the parts do not write the header of a filtered file, it comes before the first part if any comment matched */
+    if (options->filter != NULL && filename != NULL && has_comments(&count)) {
+        output_file_header(out, options->format, filename);
+    }
+    for (size_t i = 0; i < input.part_count; ++i) {
+        split_part *part = &input.parts[i];
+        if (part->out.data != NULL) {
+            output_write(out, part->out.data, part->out.size);
+            output_free(&part->out);
+        }
+    }
+    HeapFree(GetProcessHeap(), 0, input.parts);
+    return count;
+}
+
+/* NOTE: str does not need to be null terminated, a null byte is still treated as the end of the input */
+static comment_count read_comments(char const *str, size_t size, read_options const *options, comment_display comment_mode,
+                                   char const *filename, output_buffer *out)
+{
+    /* check if can even display comments */
+    if (comment_mode == NO_COMMENT_DISPLAY) {
+        return (comment_count) { 0 };
+    }
+
+    /* NOTE: a limit on the matches has to see the comments in order so a file with one is not split */
+    bool const limited = options->filter != NULL && (options->filter->max_count != 0 || options->filter->max_total != 0);
+    if (size >= SPLIT_FILE_MIN_SIZE && options->thread_count >= SPLIT_MIN_THREAD_COUNT && !limited) {
+        return read_split_comments(str, size, options, comment_mode, false, filename, out);
+    }
+
+    comment_lexer lexer;
+    comment_writer writer;
+    start_comments(&lexer, &writer, comment_mode, false, options, filename, out);
+    feed_comments(&lexer, str, size);
+    return finish_comments(&lexer, &writer);
+}
+
+/* counts the comments in str without writing anything */
+static comment_count count_comments(char const *str, size_t size, read_options const *options, comment_display comment_mode)
+{
+    if (comment_mode == NO_COMMENT_DISPLAY) {
+        return (comment_count) { 0 };
+    }
+
+    if (size >= SPLIT_FILE_MIN_SIZE && options->thread_count >= SPLIT_MIN_THREAD_COUNT) {
+        return read_split_comments(str, size, options, comment_mode, true, NULL, NULL);
+    }
+
+    lexer_table const *table = get_lexer_table(comment_mode, true);
+    if (table == NULL) {
+        error_messagea("Error: could not allocate memory for the lexer");
+    }
+
+    comment_lexer lexer;
+    lexer_init(&lexer, table, NULL, NULL, false);
+    lexer_count(&lexer, str, size);
+    return lexer_finish(&lexer);
+}
+
+static void output_comment_count(output_buffer *out, comment_display comment_mode, comment_count count)
+{
+    if (comment_mode & CC_COMMENT_DISPLAY) {
+        output_write(out, "c++ style comments: ", 20);
+        output_number(out, count.cc_comment_count);
+        output_write(out, "\r\n", 2);
+    }
+
+    if (comment_mode & C_COMMENT_DISPLAY) {
+        output_write(out, "c style comments: ", 18);
+        output_number(out, count.c_comment_count);
+        output_write(out, "\r\n", 2);
+    }
+
+    if (comment_mode & RUST_COMMENT_DISPLAY) {
+        output_write(out, "rust style comments: ", 21);
+        output_number(out, count.rust_comment_count);
+        output_write(out, "\r\n", 2);
+    }
+
+    if (comment_mode & ASM_COMMENT_DISPLAY) {
+        output_write(out, "asm style comments: ", 20);
+        output_number(out, count.asm_comment_count);
+        output_write(out, "\r\n", 2);
+    }
+
+    if (comment_mode & PYTHON_COMMENT_DISPLAY) {
+        output_write(out, "python style comments: ", 23);
+        output_number(out, count.python_comment_count);
+        output_write(out, "\r\n", 2);
+    }
+
+    if (comment_mode & DEFINED_COMMENT_DISPLAY) {
+        output_write(out, "line comments: ", 15);
+        output_number(out, count.line_comment_count);
+        output_write(out, "\r\n", 2);
+        output_write(out, "block comments: ", 16);
+        output_number(out, count.block_comment_count);
+        output_write(out, "\r\n", 2);
+    }
+}
+
+/* the names of the built in comment modes in the rows of --metrics, a combination of them is written with a | between each */
+static struct
+{
+    comment_display comment_mode;
+    char const *name;
+} const comment_mode_names[] = {
+    { C_COMMENT_DISPLAY, "c" },
+    { CC_COMMENT_DISPLAY, "c++" },
+    { ASM_COMMENT_DISPLAY, "asm" },
+    { PYTHON_COMMENT_DISPLAY, "python" },
+    { RUST_COMMENT_DISPLAY, "rust" }
+};
+
+/* writes the name of a comment mode to name_buffer and returns its size, the buffer has to be at least 32 bytes */
+static size_t comment_mode_name(comment_display comment_mode, char *name_buffer)
+{
+    char const *name;
+    size_t size = 0;
+    if (comment_mode & DEFINED_COMMENT_DISPLAY) {
+        for (name = defined_languages.languages[DEFINED_LANGUAGE_INDEX(comment_mode)].name; *name != '\0'; ++name) {
+            name_buffer[size++] = *name;
+        }
+        return size;
+    }
+
+    for (size_t i = 0; i < sizeof(comment_mode_names) / sizeof(comment_mode_names[0]); ++i) {
+        if (!(comment_mode & comment_mode_names[i].comment_mode)) continue;
+        if (size != 0) {
+            name_buffer[size++] = '|';
+        }
+        for (name = comment_mode_names[i].name; *name != '\0'; ++name) {
+            name_buffer[size++] = *name;
+        }
+    }
+    if (size == 0) {
+        /* a file that was sniffed to have no comments */
+        for (name = "none"; *name != '\0'; ++name) {
+            name_buffer[size++] = *name;
+        }
+    }
+    return size;
+}
+
+/* the rows of --metrics, every file and directory and then every comment mode and the whole run */
+typedef enum metrics_row_kind
+{
+    FILE_METRICS_ROW,
+    DIRECTORY_METRICS_ROW,
+    LANGUAGE_METRICS_ROW,
+    TOTAL_METRICS_ROW
+} metrics_row_kind;
+
+static char const *const metrics_row_names[] = {
+    "file",
+    "directory",
+    "language",
+    "total"
+};
+
+/* writes a field of a csv row, it is quoted if it has to be */
+static void output_csv_field(output_buffer *out, char const *str, size_t size)
+{
+    bool quote = false;
+    for (size_t i = 0; i < size && !quote; ++i) {
+        quote = str[i] == ',' || str[i] == '"' || str[i] == '\n' || str[i] == '\r';
+    }
+    if (!quote) {
+        output_write(out, str, size);
+        return;
+    }
+
+    output_write(out, "\"", 1);
+    char const *run = str;
+    for (char const *pos = str; pos != str + size; ++pos) {
+        if (*pos == '"') {
+            output_write(out, run, pos + 1 - run);
+            run = pos;
+        }
+    }
+    output_write(out, run, str + size - run);
+    output_write(out, "\"", 1);
+}
+
+/* the header of --metrics --format=csv */
+static void output_csv_header(output_buffer *out)
+{
+    output_write(out, "kind,path,language,files,code,comment,mixed,blank\r\n", 51);
+}
+
+/* a row of --metrics, path is only written for files and directories and comment_mode only for files and languages */
+static void output_metrics_row(output_buffer *out, output_format format, metrics_row_kind kind, char const *path, size_t path_size,
+                               comment_display comment_mode, run_totals const *row_totals)
+{
+    char const *const kind_name = metrics_row_names[kind];
+    bool const has_path = kind == FILE_METRICS_ROW || kind == DIRECTORY_METRICS_ROW;
+    bool const has_language = kind == FILE_METRICS_ROW || kind == LANGUAGE_METRICS_ROW;
+    char language[32 + MAX_LANGUAGE_NAME_SIZE];
+    size_t const language_size = has_language ? comment_mode_name(comment_mode, language) : 0;
+    line_metrics const *lines = &row_totals->lines;
+
+    if (format == CSV_OUTPUT_FORMAT) {
+        output_write(out, kind_name, lstrlenA(kind_name));
+        output_write(out, ",", 1);
+        output_csv_field(out, path, has_path ? path_size : 0);
+        output_write(out, ",", 1);
+        output_write(out, language, language_size);
+        output_write(out, ",", 1);
+        output_number(out, row_totals->file_count);
+        output_write(out, ",", 1);
+        output_number(out, lines->code_lines);
+        output_write(out, ",", 1);
+        output_number(out, lines->comment_lines);
+        output_write(out, ",", 1);
+        output_number(out, lines->mixed_lines);
+        output_write(out, ",", 1);
+        output_number(out, lines->blank_lines);
+        output_write(out, "\r\n", 2);
+    }
+    else if (format == JSON_LINES_OUTPUT_FORMAT) {
+        output_write(out, "{\"kind\":\"", 9);
+        output_write(out, kind_name, lstrlenA(kind_name));
+        output_write(out, "\"", 1);
+        if (has_path) {
+            output_write(out, ",\"path\":", 8);
+            output_json_string(out, path, path_size);
+        }
+        if (has_language) {
+            output_write(out, ",\"language\":", 12);
+            output_json_string(out, language, language_size);
+        }
+        output_write(out, ",\"files\":", 9);
+        output_number(out, row_totals->file_count);
+        output_write(out, ",\"code\":", 8);
+        output_number(out, lines->code_lines);
+        output_write(out, ",\"comment\":", 11);
+        output_number(out, lines->comment_lines);
+        output_write(out, ",\"mixed\":", 9);
+        output_number(out, lines->mixed_lines);
+        output_write(out, ",\"blank\":", 9);
+        output_number(out, lines->blank_lines);
+        output_write(out, "}\n", 2);
+    }
+    else {
+        output_write(out, kind_name, lstrlenA(kind_name));
+        if (has_path) {
+            output_write(out, " ", 1);
+            output_write(out, path, path_size);
+        }
+        else if (kind == LANGUAGE_METRICS_ROW) {
+            output_write(out, " ", 1);
+            output_write(out, language, language_size);
+        }
+        if (kind == FILE_METRICS_ROW) {
+            output_write(out, ": language ", 11);
+            output_write(out, language, language_size);
+        }
+        else {
+            output_write(out, ": files ", 8);
+            output_number(out, row_totals->file_count);
+        }
+        output_write(out, ", code ", 7);
+        output_number(out, lines->code_lines);
+        output_write(out, ", comment ", 10);
+        output_number(out, lines->comment_lines);
+        output_write(out, ", mixed ", 8);
+        output_number(out, lines->mixed_lines);
+        output_write(out, ", blank ", 8);
+        output_number(out, lines->blank_lines);
+        output_write(out, "\r\n", 2);
+    }
+}
+
+/* --metrics, counts the lines of str, returns the comments it has */
+static comment_count count_line_metrics(char const *str, size_t size, comment_display comment_mode, line_metrics *lines)
+{
+    comment_count count;
+    lexer_table const *table = get_lexer_table(comment_mode, false);
+    if (table == NULL || !measure_lines(table, str, size, lines, &count)) {
+        error_messagea("Error: could not allocate memory for the lexer");
+    }
+    return count;
+}
+
+/* --metrics, counts the lines of str and writes the row of the file to out, returns the comments it has */
+static comment_count read_line_metrics(char const *str, size_t size, comment_display comment_mode, char const *filename,
+                                       output_format format, output_buffer *out, line_metrics *lines)
+{
+    run_totals file_totals = { .file_count = 1 };
+    file_totals.count = count_line_metrics(str, size, comment_mode, &file_totals.lines);
+    output_metrics_row(out, format, FILE_METRICS_ROW, filename, lstrlenA(filename), comment_mode, &file_totals);
+    *lines = file_totals.lines;
+    return file_totals.count;
+}
+
+/* --metrics, the directories of the files that were written so far whose rows are not written yet with the innermost last,
+ * a directory is written once a file that is not in it comes so its row follows everything under it,
+ * the walkers write the files of a directory together so each directory gets one row
+ * NOTE: this is only used by the main thread in the order of the output, the files themselves are read on every thread
+ */
+typedef struct metrics_directory
+{
+    size_t path_size;
+    run_totals totals;
+} metrics_directory;
+
+static output_buffer metrics_directories = { .capacity = DEFAULT_MEMORY_BUFFER_SIZE, .in_memory = true };
+
+/* the path of the innermost directory, the others are a prefix of it */
+static path_builder metrics_path;
+
+/* the totals of each built in comment mode and then of each defined language */
+static run_totals language_totals[AUTO_COMMENT_DISPLAY + MAX_DEFINED_LANGUAGES];
+
+static metrics_directory *innermost_metrics_directory(void)
+{
+    if (metrics_directories.size == 0) return NULL;
+    return (metrics_directory *)(metrics_directories.data + metrics_directories.size) - 1;
+}
+
+/* writes the row of the innermost directory and adds what is under it to the one it is in */
+static void leave_metrics_directory(output_format format)
+{
+    metrics_directory *directory = innermost_metrics_directory();
+    if (directory->totals.file_count != 0) {
+        output_metrics_row(&output, format, DIRECTORY_METRICS_ROW, metrics_path.data, directory->path_size, 0, &directory->totals);
+    }
+
+    /* NOTE: the directory stays where it is in the buffer until the next one is entered */
+    metrics_directories.size -= sizeof(metrics_directory);
+    metrics_directory *parent = innermost_metrics_directory();
+    if (parent != NULL) {
+        add_totals(&parent->totals, &directory->totals);
+    }
+    path_truncate(&metrics_path, parent != NULL ? parent->path_size : 0);
+}
+
+/* leaves the directories path is not in and enters the ones it is in, this has to be done before the row of the file is written */
+static void enter_metrics_directory(read_options const *options, char const *path)
+{
+    if (!options->metrics) return;
+
+    size_t directory_size = lstrlenA(path);
+    while (directory_size != 0 && !is_path_separator(path[directory_size - 1])) {
+        --directory_size;
+    }
+    if (directory_size != 0) {
+        --directory_size;
+    }
+
+    metrics_directory *directory;
+    while ((directory = innermost_metrics_directory()) != NULL) {
+        size_t const size = directory->path_size;
+        if (size <= directory_size && bytes_equal(metrics_path.data, path, size) && (size == directory_size || is_path_separator(path[size]))) {
+            break;
+        }
+        leave_metrics_directory(options->format);
+    }
+
+    /* a separator at the start of the path is not the end of a directory */
+    for (size_t i = metrics_path.size + 1; i <= directory_size; ++i) {
+        if (i == directory_size || is_path_separator(path[i])) {
+            metrics_directory entered = { .path_size = i };
+            output_write(&metrics_directories, (char const *)&entered, sizeof(entered));
+        }
+    }
+    metrics_path.size = 0;
+    if (!path_append(&metrics_path, path, directory_size)) {
+        error_messagea("Error: could not allocate memory for a path");
+    }
+}
+
+/* adds what was counted in a file to its directory and its comment mode */
+static void add_file_metrics(read_options const *options, run_totals const *file_totals)
+{
+    if (!options->metrics || file_totals->file_count == 0) return;
+
+    metrics_directory *directory = innermost_metrics_directory();
+    if (directory != NULL) {
+        add_totals(&directory->totals, file_totals);
+    }
+
+    comment_display const comment_mode = file_totals->comment_mode;
+    size_t const index = comment_mode & DEFINED_COMMENT_DISPLAY
+        ? AUTO_COMMENT_DISPLAY + DEFINED_LANGUAGE_INDEX(comment_mode)
+        : comment_mode & (AUTO_COMMENT_DISPLAY - 1);
+    add_totals(&language_totals[index], file_totals);
+}
+
+/* writes the rows of the directories that are left, of every comment mode that was read and of the whole run */
+static void finish_metrics(output_format format)
+{
+    while (innermost_metrics_directory() != NULL) {
+        leave_metrics_directory(format);
+    }
+    path_free(&metrics_path);
+    output_free(&metrics_directories);
+
+    for (size_t i = 0; i < sizeof(language_totals) / sizeof(language_totals[0]); ++i) {
+        if (language_totals[i].file_count != 0) {
+            comment_display const comment_mode = i < AUTO_COMMENT_DISPLAY ? (comment_display)i : DEFINED_LANGUAGE_MODE(i - AUTO_COMMENT_DISPLAY);
+            output_metrics_row(&output, format, LANGUAGE_METRICS_ROW, NULL, 0, comment_mode, &language_totals[i]);
+        }
+    }
+    output_metrics_row(&output, format, TOTAL_METRICS_ROW, NULL, 0, 0, &totals);
+}
+
+/* how much of the start of a file is searched for a null byte and how much of it is looked at byte by byte */
+#define BINARY_SNIFF_SIZE (1 << 13)
+#define TEXT_SNIFF_SIZE (1 << 10)
+
+/* returns why the start of a file does not look like source code or NULL if it does,
+ * a few control bytes or bytes that are not utf-8 are allowed for files in latin-1 and the like but a null byte never is
+ */
+static char const *sniff_binary(char const *str, size_t size)
+{
+    static delimiter_set const null_byte = DELIMITERS("\0");
+
+    unsigned char const *bytes = (unsigned char const *)str;
+    if (size >= 2 && ((bytes[0] == 0xff && bytes[1] == 0xfe) || (bytes[0] == 0xfe && bytes[1] == 0xff))) {
+        return "skipped, it is utf-16";
+    }
+
+    char const *end = str + (size < BINARY_SNIFF_SIZE ? size : BINARY_SNIFF_SIZE);
+    if (find_delimiter(str, end, &null_byte, NULL) != end) {
+        return "skipped, it has a null byte";
+    }
+
+    size_t const text_size = size < TEXT_SNIFF_SIZE ? size : TEXT_SNIFF_SIZE;
+    end = str + text_size;
+    size_t odd_count = 0;
+    for (char const *pos = str; pos != end;) {
+        unsigned char const byte = (unsigned char)*pos;
+        if (byte >= 0x80) {
+            size_t const sequence_size = utf8_sequence_size(pos, end);
+            if (sequence_size != 0) {
+                pos += sequence_size;
+                continue;
+            }
+            /* a sequence cut off by the end of what is looked at is not counted */
+            if (end - pos < 4 && text_size != size) {
+                break;
+            }
+            ++odd_count;
+        }
+        else if (byte < 0x20 && byte != '\t' && byte != '\n' && byte != '\r' && byte != '\f' && byte != '\v' && byte != 0x1b) {
+            ++odd_count;
+        }
+        ++pos;
+    }
+    if (odd_count > text_size / 10) {
+        return "skipped, it does not look like text";
+    }
+    return NULL;
+}
+
+static char const oversized_skip_note[] = "skipped, it is larger than --max-file-size";
+static char const oversized_head_note[] = "only the start was read, it is larger than --max-file-size";
+
+/* opens filename the way the options say, pending is the read of it if it was started ahead of time or NULL,
+ * returns a description of what went wrong or NULL, note is set to why the file is skipped or only partly read, or NULL
+ * NOTE: the data of file is NULL when it is skipped, it is not open then
+ */
+static char const *open_source_file(char const *filename, pending_input *pending, read_options const *options, input_file *file,
+                                    char const **note)
+{
+    *note = NULL;
+    char const *error;
+    if (pending != NULL) {
+        error = finish_input_read(pending, file);
+    }
+    else {
+        /* the size is looked at before reading so that a file that is skipped is never read */
+        error = open_input_handle(filename, file);
+        if (error == NULL) {
+            ULONGLONG size = file->file_size;
+            if (options->max_file_size != 0 && size > options->max_file_size) {
+                if (!options->read_oversized_head) {
+                    CloseHandle(file->file_handle);
+                    *file = (input_file) { 0 };
+                    *note = oversized_skip_note;
+                    return NULL;
+                }
+                size = options->max_file_size;
+            }
+            error = load_input_file(file, options->map_files, size);
+        }
+    }
+    if (error != NULL) {
+        return error;
+    }
+
+    /* a read that was started ahead has the whole file */
+    if (options->max_file_size != 0 && file->file_size > options->max_file_size) {
+        if (!options->read_oversized_head) {
+            close_input_file(file);
+            *note = oversized_skip_note;
+            return NULL;
+        }
+        file->size = (size_t)options->max_file_size;
+        *note = oversized_head_note;
+    }
+
+    if (!options->read_binary) {
+        char const *binary = sniff_binary(file->data, file->size);
+        if (binary != NULL) {
+            close_input_file(file);
+            *note = binary;
+        }
+    }
+    return NULL;
+}
+
+/* --skip-report, the files that were skipped or only partly read and why, in the order of the output */
+static bool keep_skip_report;
+static output_buffer skip_report = { .capacity = DEFAULT_MEMORY_BUFFER_SIZE, .in_memory = true };
+static size_t skipped_file_count;
+static size_t partly_read_file_count;
+
+static void add_skip_note(char const *filename, char const *note)
+{
+    if (note == NULL || !keep_skip_report) return;
+
+    size_t filename_size = 0;
+    while (filename[filename_size] != '\0') ++filename_size;
+    size_t note_size = 0;
+    while (note[note_size] != '\0') ++note_size;
+
+    output_write(&skip_report, filename, filename_size);
+    output_write(&skip_report, ": ", 2);
+    output_write(&skip_report, note, note_size);
+    output_write(&skip_report, "\r\n", 2);
+    if (note != oversized_head_note) {
+        ++skipped_file_count;
+    }
+    else {
+        ++partly_read_file_count;
+    }
+}
+
+/* writes the skip report to report_handle with how many files it has */
+static void write_skip_report(HANDLE report_handle)
+{
+    output_write(&skip_report, "skipped files: ", 15);
+    output_number(&skip_report, skipped_file_count);
+    output_write(&skip_report, "\r\npartly read files: ", 21);
+    output_number(&skip_report, partly_read_file_count);
+    output_write(&skip_report, "\r\n", 2);
+
+    DWORD bytes_written;
+    WriteFile("skip report", report_handle, skip_report.data, (DWORD)skip_report.size, &bytes_written, NULL);
+    output_free(&skip_report);
+}
+
+/* reads the comments of filename to out, returns a description of what went wrong or NULL */
+/* pending is the read of the file if it was started ahead of time or NULL, lines is only set with --metrics,
+ * a comment_mode of AUTO_COMMENT_DISPLAY is replaced by the mode that is sniffed from the contents
+ */
+static char const *scan_file(char const *filename, pending_input *pending, read_options const *options, comment_display *comment_mode,
+                             output_buffer *out, comment_count *count, line_metrics *lines, char const **note)
+{
+    stats_span span = stats_begin();
+    input_file file;
+    char const *error = open_source_file(filename, pending, options, &file, note);
+    stats_end(span, READ_PHASE, filename);
+    if (error == NULL && file.data == NULL) {
+        return NULL;
+    }
+
+    /* with a filter the writer only writes the header if something matched, --metrics writes a row once the file is read */
+    if (options->filter == NULL && !options->metrics) {
+        output_file_header(out, options->format, filename);
+    }
+    if (error != NULL) {
+        return error;
+    }
+    stats_add_file(file.size);
+
+    span = stats_begin();
+    if (*comment_mode == AUTO_COMMENT_DISPLAY) {
+        *comment_mode = sniff_comment_mode(file.data, file.size);
+    }
+
+    *count = options->metrics ? read_line_metrics(file.data, file.size, *comment_mode, filename, options->format, out, lines)
+        : options->count_only && options->filter == NULL ? count_comments(file.data, file.size, options, *comment_mode)
+        : read_comments(file.data, file.size, options, *comment_mode, filename, out);
+    stats_end(span, LEX_PHASE, filename);
+    close_input_file(&file);
+    return NULL;
+}
+
+/* the delimiters of a defined language are part of the key of its files so that changing them does not give old output */
+static DWORD language_key(language_definition const *language)
+{
+    DWORD hash = 0x811c9dc5;
+    for (size_t i = 0; i < language->delimiter_count; ++i) {
+        language_delimiter const *delimiter = &language->delimiters[i];
+        hash = (hash ^ delimiter->type) * 0x01000193;
+        for (size_t j = 0; j < delimiter->opener_size; ++j) {
+            hash = (hash ^ (unsigned char)delimiter->opener[j]) * 0x01000193;
+        }
+        hash = (hash ^ 0x100) * 0x01000193;
+        for (size_t j = 0; j < delimiter->closer_size; ++j) {
+            hash = (hash ^ (unsigned char)delimiter->closer[j]) * 0x01000193;
+        }
+        hash = (hash ^ (unsigned char)delimiter->escape) * 0x01000193;
+    }
+    return hash;
+}
+
+/* everything the output of a file depends on besides its path and its contents */
+static DWORD cache_options(read_options const *options, comment_display comment_mode)
+{
+    DWORD key = (comment_mode & (DEFINED_COMMENT_DISPLAY | (DEFINED_COMMENT_DISPLAY - 1)))
+        | (options->show_line_number << 8) | (options->count_only << 9) | (options->format << 10);
+    if (comment_mode & DEFINED_COMMENT_DISPLAY) {
+        DWORD const hash = language_key(&defined_languages.languages[DEFINED_LANGUAGE_INDEX(comment_mode)]);
+        key |= (hash ^ (hash << 16)) & 0xffff0000;
+    }
+    if (options->filter != NULL) {
+        DWORD const hash = filter_key(options->filter);
+        key ^= ((hash ^ (hash << 16)) & 0xffff0000) | (1 << 12);
+    }
+    if (options->read_oversized_head && options->max_file_size != 0) {
+        /* the head of a file is only as long as --max-file-size */
+        ULONGLONG const size_hash = hash_bytes((char const *)&options->max_file_size, sizeof(options->max_file_size));
+        DWORD const hash = (DWORD)(size_hash ^ (size_hash >> 32));
+        key ^= ((hash ^ (hash << 16)) & 0xffff0000) | (1 << 13);
+    }
+    key |= options->read_binary << 14;
+    return key;
+}
+
+/* the same as scan_file but files that did not change since they were added to the cache are not read
+ * NOTE: the size and the write time come from the file attributes so a file that did not change is never opened,
+ * if only the write time changed the contents are hashed and if the hash is the same the output still comes from the cache
+ */
+static char const *scan_cached_file(char const *filename, read_options const *options, comment_display *comment_mode, output_buffer *out,
+                                    comment_count *count, char const **note)
+{
+    result_cache *cache = options->cache;
+    DWORD const key = cache_options(options, *comment_mode);
+    bool const sniff = *comment_mode == AUTO_COMMENT_DISPLAY;
+
+    *note = NULL;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes) == FALSE) {
+        if (options->filter == NULL) {
+            output_file_header(out, options->format, filename);
+        }
+        return "could not open file";
+    }
+    ULONGLONG const file_size = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    ULONGLONG const write_time = ((ULONGLONG)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+
+    /* files that do not look like text are never added so only the size can skip a file that is in the cache */
+    cache_entry const *entry = cache_find(cache, filename, key);
+    if (entry != NULL && entry->file_size == file_size && entry->write_time == write_time && write_time != 0) {
+        if (options->max_file_size != 0 && file_size > options->max_file_size) {
+            *note = options->read_oversized_head ? oversized_head_note : oversized_skip_note;
+            if (!options->read_oversized_head) {
+                return NULL;
+            }
+        }
+        if (options->filter == NULL) {
+            output_file_header(out, options->format, filename);
+        }
+        output_write(out, cache_entry_output(entry), (size_t)entry->output_size);
+        *count = cache_entry_count(entry);
+        if (sniff) {
+            *comment_mode = entry->content_mode;
+        }
+        return NULL;
+    }
+
+    stats_span span = stats_begin();
+    input_file file;
+    char const *error = open_source_file(filename, NULL, options, &file, note);
+    stats_end(span, READ_PHASE, filename);
+    if (error == NULL && file.data == NULL) {
+        return NULL;
+    }
+    if (options->filter == NULL) {
+        output_file_header(out, options->format, filename);
+    }
+    if (error != NULL) {
+        return error;
+    }
+    stats_add_file(file.size);
+
+    span = stats_begin();
+    ULONGLONG const content_hash = hash_bytes(file.data, file.size);
+
+    /* the output is kept in memory so that it can be added to the cache */
+    output_buffer file_output = make_memory_buffer();
+    char const *output_data;
+    size_t output_size;
+    if (entry != NULL && entry->file_size == file.file_size && entry->content_hash == content_hash) {
+        output_data = cache_entry_output(entry);
+        output_size = (size_t)entry->output_size;
+        *count = cache_entry_count(entry);
+        if (sniff) {
+            *comment_mode = entry->content_mode;
+        }
+    }
+    else {
+        if (sniff) {
+            *comment_mode = sniff_comment_mode(file.data, file.size);
+        }
+        *count = options->count_only && options->filter == NULL
+            ? count_comments(file.data, file.size, options, *comment_mode)
+            : read_comments(file.data, file.size, options, *comment_mode, filename, &file_output);
+        output_flush(&file_output);
+        output_data = file_output.data;
+        output_size = file_output.size;
+    }
+    stats_end(span, LEX_PHASE, filename);
+
+    if (!cache_add(cache, filename, key, sniff ? *comment_mode : 0, file.file_size, write_time, content_hash, *count, output_data, output_size)) {
+        close_input_file(&file);
+        output_free(&file_output);
+        return "could not add to the cache";
+    }
+    close_input_file(&file);
+
+    output_write(out, output_data, output_size);
+    output_free(&file_output);
+    return NULL;
+}
+
+/* AUTO_COMMENT_DISPLAY is returned for files without an extension, their mode is sniffed once they are read */
+static comment_display file_comment_mode(char const *filename, read_options const *options)
+{
+    comment_display comment_mode = options->comment_mode;
+    if (comment_mode & AUTO_COMMENT_DISPLAY) {
+        comment_mode = get_comment_mode(options->languages, filename);
+    }
+    return comment_mode;
+}
+
+/* writes the comments of filename to out and what was counted to file_totals, returns a description of what went wrong or NULL
+ * pending is a read of the file that was started ahead of time or NULL, it can only be given for files that are not skipped
+ * by their comment mode and when there is no cache, note is set to why the file was skipped or only partly read, or NULL
+ * NOTE: the caller reports errors, notes and adds up the totals so that the parallel walker can do all of them in the same order as the serial one
+ */
+static char const *read_file_comments(char const *filename, pending_input *pending, read_options const *options, output_buffer *out,
+                                      run_totals *file_totals, char const **note)
+{
+    *note = NULL;
+    comment_display comment_mode = file_comment_mode(filename, options);
+    if (!(comment_mode & ~NO_COMMENT_DISPLAY)) {
+        return NULL;
+    }
+    if (total_matches_reached(options)) {
+        /* the read that was started ahead still has to be finished to free it */
+        input_file file;
+        if (pending != NULL && finish_input_read(pending, &file) == NULL) {
+            close_input_file(&file);
+        }
+        return NULL;
+    }
+
+    /* NOTE: the output of a file in the cache has every match of it so it is not used with --max-total,
+     * the cache does not keep the lines of a file so it is not used with --metrics either
+     */
+    stats_span span = stats_begin();
+    comment_count count;
+    line_metrics lines = { 0 };
+    char const *error = options->cache != NULL && !options->metrics && (options->filter == NULL || options->filter->max_total == 0)
+        ? scan_cached_file(filename, options, &comment_mode, out, &count, note)
+        : scan_file(filename, pending, options, &comment_mode, out, &count, &lines, note);
+    stats_end_file(span, filename);
+    if (error != NULL || (*note != NULL && *note != oversized_head_note)) {
+        return error;
+    }
+
+    /* the record formats only have comments */
+    if (options->display_comment_count && options->format == TEXT_OUTPUT_FORMAT && !options->metrics && (options->filter == NULL || has_comments(&count))) {
+        output_comment_count(out, comment_mode, count);
+    }
+
+    *file_totals = (run_totals) { .comment_mode = comment_mode, .file_count = 1, .count = count, .lines = lines };
+    return NULL;
+}
+
+/* reads the comments of filename straight to stdout and exits on errors */
+static void print_file_comments(char const *filename, pending_input *pending, read_options const *options)
+{
+    run_totals file_totals = { 0 };
+    char const *note;
+    enter_metrics_directory(options, filename);
+    char const *error = read_file_comments(filename, pending, options, &output, &file_totals, &note);
+    if (error != NULL) {
+        error_messagea("Error: ", error, " \"", filename, "\"");
+    }
+    add_skip_note(filename, note);
+    add_file_metrics(options, &file_totals);
+    add_totals(&totals, &file_totals);
+}
+
+/* how many bytes of stdin are read at a time, this is all the memory reading stdin needs besides the output */
+#define STDIN_CHUNK_SIZE (1 << 16)
+
+/* returns how many bytes were read into chunk, 0 at the end of stdin */
+static DWORD read_stdin_chunk(HANDLE stdin, char *chunk)
+{
+    DWORD bytes_read = 0;
+    stats_count_call(READ_FILE_CALL);
+    if (ReadFile(stdin, chunk, STDIN_CHUNK_SIZE, &bytes_read, NULL) == FALSE) {
+        /* the other end of a pipe closing is the end of the input */
+        if (GetLastError() == ERROR_BROKEN_PIPE) return 0;
+        error_messagea("Error: could not read from stdin");
+    }
+    return bytes_read;
+}
+
+/* reads the comments of stdin straight to stdout one chunk at a time so that pipes of any size can be read */
+static void print_stdin_comments(read_options const *options)
+{
+    static char const stdin_name[] = "<stdin>";
+
+    comment_display comment_mode = file_comment_mode(stdin_name, options);
+    if (comment_mode == NO_COMMENT_DISPLAY || total_matches_reached(options)) {
+        return;
+    }
+
+    char *chunk = HeapAlloc(GetProcessHeap(), 0, STDIN_CHUNK_SIZE);
+    if (chunk == NULL) {
+        error_messagea("Error: could not allocate memory for reading stdin");
+    }
+
+    /* stdin has no extension or size so its mode and whether it is text are sniffed from the first chunk */
+    HANDLE stdin = GetStdHandle(STD_INPUT_HANDLE);
+    DWORD bytes_read = read_stdin_chunk(stdin, chunk);
+    char const *binary = options->read_binary ? NULL : sniff_binary(chunk, bytes_read);
+    if (binary != NULL) {
+        HeapFree(GetProcessHeap(), 0, chunk);
+        add_skip_note(stdin_name, binary);
+        return;
+    }
+    if (comment_mode == AUTO_COMMENT_DISPLAY) {
+        comment_mode = sniff_comment_mode(chunk, bytes_read);
+    }
+
+    if (options->metrics) {
+        /* the lines are classified from the offsets of the comments so all of stdin is kept */
+        output_buffer input = make_memory_buffer();
+        for (; bytes_read != 0; bytes_read = read_stdin_chunk(stdin, chunk)) {
+            output_write(&input, chunk, bytes_read);
+        }
+        HeapFree(GetProcessHeap(), 0, chunk);
+
+        run_totals stdin_totals = { .comment_mode = comment_mode, .file_count = 1 };
+        stdin_totals.count = read_line_metrics(input.data, input.size, comment_mode, stdin_name, options->format, &output, &stdin_totals.lines);
+        output_free(&input);
+        add_file_metrics(options, &stdin_totals);
+        add_totals(&totals, &stdin_totals);
+        return;
+    }
+
+    if (options->filter == NULL) {
+        output_file_header(&output, options->format, stdin_name);
+    }
+
+    /* the text of the comments is needed to filter them */
+    bool const count_only = options->count_only && options->filter == NULL;
+    comment_lexer lexer;
+    comment_writer writer;
+    start_comments(&lexer, &writer, comment_mode, count_only, options, stdin_name, &output);
+
+    /* NOTE: once the lexer stopped the rest of stdin is not read */
+    for (; bytes_read != 0 && !lexer.stopped; bytes_read = read_stdin_chunk(stdin, chunk)) {
+        if (count_only) {
+            lexer_count(&lexer, chunk, bytes_read);
+        }
+        else {
+            feed_comments(&lexer, chunk, bytes_read);
+        }
+    }
+
+    comment_count count = finish_comments(&lexer, &writer);
+    HeapFree(GetProcessHeap(), 0, chunk);
+
+    if (options->display_comment_count && options->format == TEXT_OUTPUT_FORMAT && (options->filter == NULL || has_comments(&count))) {
+        output_comment_count(&output, comment_mode, count);
+    }
+
+    run_totals stdin_totals = { .comment_mode = comment_mode, .file_count = 1, .count = count };
+    add_totals(&totals, &stdin_totals);
+}
+
+static void append_path(path_builder *path, char const *str, size_t size)
+{
+    if (!path_append(path, str, size)) {
+        error_messagea("Error: could not allocate memory for a path");
+    }
+}
+
+/* FindFirstFileA and FindNextFileA measured for --stats, the last error is what the call left */
+static HANDLE find_first_file(char const *spec, WIN32_FIND_DATAA *find_data)
+{
+    stats_span span = stats_begin();
+    stats_count_call(FIND_FIRST_FILE_CALL);
+    HANDLE find_handle = FindFirstFileA(spec, find_data);
+    DWORD const error = GetLastError();
+    stats_end(span, ENUMERATE_PHASE, spec);
+    SetLastError(error);
+    return find_handle;
+}
+
+static BOOL find_next_file(HANDLE find_handle, WIN32_FIND_DATAA *find_data)
+{
+    stats_span span = stats_begin();
+    stats_count_call(FIND_NEXT_FILE_CALL);
+    BOOL const found = FindNextFileA(find_handle, find_data);
+    DWORD const error = GetLastError();
+    stats_end(span, ENUMERATE_PHASE, NULL);
+    SetLastError(error);
+    return found;
+}
+
+static ULONGLONG file_size(WIN32_FIND_DATAA const *find_data)
+{
+    return ((ULONGLONG)find_data->nFileSizeHigh << 32) | find_data->nFileSizeLow;
+}
+
+/* whether the walkers leave out the file or directory at path, see is_ignored */
+static bool walk_ignores(read_options const *options, ignore_rules const *rules, char const *path, size_t path_size, size_t root_size,
+                         bool is_directory)
+{
+    return options->ignore != NULL && is_ignored(options->ignore, rules, path, path_size, root_size, is_directory);
+}
+
+/* the rules for what is in the directory, the ones of parent and the ones of its ignore files allocated in a */
+static ignore_rules const *walk_ignore_rules(read_options const *options, arena *a, ignore_rules const *parent, char const *directory,
+                                             size_t directory_size)
+{
+    ignore_rules const *rules = parent;
+    if (options->ignore != NULL && options->ignore->read_ignore_files && !load_ignore_rules(a, parent, directory, directory_size, &rules)) {
+        error_messagea("Error: could not allocate memory for the ignore files of \"", directory, "\"");
+    }
+    return rules;
+}
+
+/* how many files the serial walkers keep reading ahead of the one that is being scanned */
+#define READ_AHEAD_COUNT 32
+
+typedef struct read_ahead_slot
+{
+    path_builder path;
+    pending_input pending;
+    bool started;
+} read_ahead_slot;
+
+/* the files the serial walkers found that were not scanned yet, they are scanned in the order they were found
+ * so the output is the same as scanning each file as soon as it is found
+ */
+typedef struct read_ahead
+{
+    read_options const *options;
+
+    /* a ring buffer, head is the oldest file */
+    read_ahead_slot slots[READ_AHEAD_COUNT];
+    size_t head;
+    size_t count;
+} read_ahead;
+
+static read_ahead *start_read_ahead(read_options const *options)
+{
+    read_ahead *ahead = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(read_ahead));
+    if (ahead == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    ahead->options = options;
+    return ahead;
+}
+
+/* scans the oldest file */
+static void scan_read_ahead_file(read_ahead *ahead)
+{
+    read_ahead_slot *slot = &ahead->slots[ahead->head];
+    print_file_comments(slot->path.data, slot->started ? &slot->pending : NULL, ahead->options);
+    ahead->head = (ahead->head + 1) % READ_AHEAD_COUNT;
+    --ahead->count;
+}
+
+/* queues the file at path which was size bytes long when it was found and starts reading it if it is small enough */
+static void read_ahead_file(read_ahead *ahead, char const *path, size_t path_size, ULONGLONG file_size)
+{
+    if (ahead->count == READ_AHEAD_COUNT) {
+        scan_read_ahead_file(ahead);
+    }
+
+    read_ahead_slot *slot = &ahead->slots[(ahead->head + ahead->count) % READ_AHEAD_COUNT];
+    slot->path.size = 0;
+    append_path(&slot->path, path, path_size);
+
+    /* files that are skipped are never opened and the cache may not need to read the file at all */
+    read_options const *options = ahead->options;
+    slot->started = options->cache == NULL && file_size <= READ_AHEAD_MAX_FILE_SIZE &&
+                    (options->max_file_size == 0 || file_size <= options->max_file_size) &&
+                    file_comment_mode(slot->path.data, options) != NO_COMMENT_DISPLAY &&
+                    start_input_read(slot->path.data, (size_t)file_size, &slot->pending);
+    ++ahead->count;
+}
+
+/* scans every file that was queued so far */
+static void scan_read_ahead_files(read_ahead *ahead)
+{
+    while (ahead->count != 0) {
+        scan_read_ahead_file(ahead);
+    }
+}
+
+/* scans the files that are left, this has to be done before reporting an error so the output before it is complete */
+static void finish_read_ahead(read_ahead *ahead)
+{
+    scan_read_ahead_files(ahead);
+
+    for (size_t i = 0; i < READ_AHEAD_COUNT; ++i) {
+        path_free(&ahead->slots[i].path);
+    }
+    HeapFree(GetProcessHeap(), 0, ahead);
+}
+
+/* a directory on the stack of the serial walker, its path is the first parent_size bytes of the path
+ * of the directory it was found in followed by its name which starts with the \ between them
+ */
+typedef struct pending_directory
+{
+    struct pending_directory *below;
+
+    /* releasing this frees the directory and everything pushed after it */
+    arena_mark mark;
+
+    /* the rules of the directory it was found in, the ones of its own ignore files are put on the stack once it is taken off */
+    ignore_rules const *rules;
+
+    size_t parent_size;
+    size_t name_size;
+} pending_directory;
+
+static char const *pending_directory_name(pending_directory const *directory)
+{
+    return (char const *)(directory + 1);
+}
+
+static pending_directory *push_pending_directory(arena *stack, pending_directory *below, ignore_rules const *rules, size_t parent_size,
+                                                 bool separator, char const *name, size_t name_size)
+{
+    arena_mark mark = arena_get_mark(stack);
+    pending_directory *directory = arena_alloc(stack, sizeof(pending_directory) + separator + name_size);
+    if (directory == NULL) {
+        error_messagea("Error: could not allocate memory for a path");
+    }
+
+    *directory = (pending_directory) {
+        .below = below,
+        .mark = mark,
+        .rules = rules,
+        .parent_size = parent_size,
+        .name_size = separator + name_size
+    };
+
+    char *first = (char *)(directory + 1);
+    if (separator) {
+        *first++ = '\\';
+    }
+    for (size_t i = 0; i != name_size; ++i) {
+        first[i] = name[i];
+    }
+    return directory;
+}
+
+/* NOTE: every path is built in one path_builder, a directory that is taken off the stack only has to put its own name
+ * after the path of its parent since everything that was pushed after its parent is under that path too,
+ * the rules of the ignore files of a directory go on the stack under its subdirectories so they last until those are done
+ */
+void read_comments_in_directory(char const *input_path, read_options const *options)
+{
+    arena stack = { 0 };
+    path_builder path = { 0 };
+    read_ahead *ahead = start_read_ahead(options);
+
+    size_t const root_size = lstrlenA(input_path);
+    pending_directory *top = push_pending_directory(&stack, NULL, NULL, 0, false, input_path, root_size);
+    while (top != NULL) {
+        pending_directory *directory = top;
+        top = directory->below;
+
+        if (path.data != NULL) {
+            path_truncate(&path, directory->parent_size);
+        }
+        append_path(&path, pending_directory_name(directory), directory->name_size);
+        ignore_rules const *rules = directory->rules;
+        arena_release(&stack, directory->mark);
+
+        size_t const directory_size = path.size;
+        rules = walk_ignore_rules(options, &stack, rules, path.data, directory_size);
+        append_path(&path, "\\*", 2);
+
+        WIN32_FIND_DATAA file_find_data;
+        HANDLE find_handle = find_first_file(path.data, &file_find_data);
+        if (find_handle == INVALID_HANDLE_VALUE) {
+            DWORD error = GetLastError();
+            finish_read_ahead(ahead);
+            arena_free(&stack);
+            path_free(&path);
+            SetLastError(error);
+            error_messagea("Error: FindFirstFileA failed");
+        }
+
+        do {
+            if (lstrcmpA(file_find_data.cFileName, ".") != 0 &&
+                lstrcmpA(file_find_data.cFileName, "..") != 0) {
+                size_t const name_size = lstrlenA(file_find_data.cFileName);
+                bool const is_directory = (file_find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+                path_truncate(&path, directory_size);
+                append_path(&path, "\\", 1);
+                append_path(&path, file_find_data.cFileName, name_size);
+                if (walk_ignores(options, rules, path.data, path.size, root_size, is_directory)) {
+                    continue;
+                }
+
+                if (is_directory) {
+                    top = push_pending_directory(&stack, top, rules, directory_size, true, file_find_data.cFileName, name_size);
+                }
+                else {
+                    read_ahead_file(ahead, path.data, path.size, file_size(&file_find_data));
+                }
+            }
+        } while (find_next_file(find_handle, &file_find_data) != 0);
+
+        if (GetLastError() != ERROR_NO_MORE_FILES) {
+            DWORD error = GetLastError();
+            FindClose(find_handle);
+            finish_read_ahead(ahead);
+            SetLastError(error);
+            error_messagea("Error: FindNextFileA failed");
+        }
+
+        FindClose(find_handle);
+    }
+
+    finish_read_ahead(ahead);
+    arena_free(&stack);
+    path_free(&path);
+}
+
+void read_comments_in_directory_non_recursive(char const *input_path, read_options const *options)
+{
+    path_builder path = { 0 };
+    append_path(&path, input_path, lstrlenA(input_path));
+    size_t const directory_size = path.size;
+
+    arena rules_arena = { 0 };
+    ignore_rules const *rules = walk_ignore_rules(options, &rules_arena, NULL, path.data, directory_size);
+    append_path(&path, "\\*", 2);
+
+    WIN32_FIND_DATAA file_find_data;
+    HANDLE find_handle = find_first_file(path.data, &file_find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        path_free(&path);
+        error_messagea("Error: FindFirstFileA failed");
+    }
+
+    read_ahead *ahead = start_read_ahead(options);
+    do {
+        if (lstrcmpA(file_find_data.cFileName, ".") != 0 &&
+            lstrcmpA(file_find_data.cFileName, "..") != 0) {
+            if (file_find_data.dwFileAttributes & ~FILE_ATTRIBUTE_DIRECTORY) {
+                path_truncate(&path, directory_size);
+                append_path(&path, "\\", 1);
+                append_path(&path, file_find_data.cFileName, lstrlenA(file_find_data.cFileName));
+                if (!walk_ignores(options, rules, path.data, path.size, directory_size, false)) {
+                    read_ahead_file(ahead, path.data, path.size, file_size(&file_find_data));
+                }
+            }
+        }
+    } while (find_next_file(find_handle, &file_find_data) != 0);
+
+    FindClose(find_handle);
+    finish_read_ahead(ahead);
+    arena_free(&rules_arena);
+    path_free(&path);
+}
+
+/* the output of a file or a directory in the parallel walker
+ * these form a tree that the main thread writes out in the same order the serial walker would have
+ */
+typedef struct output_node
+{
+    char const *path;
+    size_t path_size;
+    bool is_directory;
+
+    /* for a directory the rules of the one it was found in and the size of the path of the directory that is walked */
+    ignore_rules const *rules;
+    size_t root_size;
+
+    /* the paths and the nodes of the children of a directory, all of them are freed at once after the directory is written */
+    arena level;
+
+    /* the comments of a file */
+    output_buffer buffer;
+
+    /* the children of a directory in the order their output has to appear in */
+    struct output_node **children;
+    size_t child_count;
+
+    /* reported after the buffer and the children have been written, error_path is NULL for directory errors */
+    char const *error;
+    char const *error_path;
+    DWORD error_code;
+
+    /* what was counted in the file, added to the totals when the node is written */
+    run_totals totals;
+
+    /* why the file was skipped or only partly read, or NULL */
+    char const *note;
+
+    /* set once the buffer or the list of children is complete */
+    volatile LONG done;
+} output_node;
+
+typedef struct parallel_walk
+{
+    read_options const *options;
+    bool recursive;
+
+    /* the paths of a file list that are all under the root node, see read_file_list */
+    char const *list;
+    size_t list_size;
+
+    /* the main thread waits on this for the next node it has to write */
+    SRWLOCK lock;
+    CONDITION_VARIABLE node_done;
+} parallel_walk;
+
+/* the path of the node is parent followed by a \\ and name, or just parent when there is no name */
+static output_node *make_output_node(arena *level, char const *parent, size_t parent_size, char const *name, size_t name_size,
+                                     bool is_directory)
+{
+    size_t const path_size = parent_size + (name_size != 0) + name_size;
+    output_node *node = arena_alloc(level, sizeof(output_node) + path_size + 1);
+    if (node == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+
+    char *path = (char *)(node + 1);
+    for (size_t i = 0; i != parent_size; ++i) {
+        path[i] = parent[i];
+    }
+    if (name_size != 0) {
+        path[parent_size] = '\\';
+        for (size_t i = 0; i != name_size; ++i) {
+            path[parent_size + 1 + i] = name[i];
+        }
+    }
+    path[path_size] = '\0';
+
+    *node = (output_node) {
+        .path = path,
+        .path_size = path_size,
+        .is_directory = is_directory,
+        .root_size = path_size,
+        .buffer = make_memory_buffer()
+    };
+    return node;
+}
+
+static void finish_output_node(parallel_walk *walk, output_node *node)
+{
+    AcquireSRWLockExclusive(&walk->lock);
+    node->done = true;
+    ReleaseSRWLockExclusive(&walk->lock);
+    WakeAllConditionVariable(&walk->node_done);
+}
+
+static void scan_file_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    (void)worker_index;
+    parallel_walk *walk = pool->context;
+    output_node *node = data;
+
+    node->error = read_file_comments(node->path, NULL, walk->options, &node->buffer, &node->totals, &node->note);
+    node->error_path = node->path;
+    node->error_code = GetLastError();
+    finish_output_node(walk, node);
+}
+
+static void add_child(output_node *node, size_t *capacity, output_node *child)
+{
+    if (node->child_count == *capacity) {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        node->children = node->children == NULL
+            ? HeapAlloc(GetProcessHeap(), 0, sizeof(output_node *) * *capacity)
+            : HeapReAlloc(GetProcessHeap(), 0, node->children, sizeof(output_node *) * *capacity);
+        if (node->children == NULL) {
+            error_messagea("Error: could not allocate memory");
+        }
+    }
+
+    node->children[node->child_count++] = child;
+}
+
+static void expand_directory_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    parallel_walk *walk = pool->context;
+    output_node *node = data;
+
+    /* NOTE: the rules are in the level of the node so they last until everything under it is written */
+    ignore_rules const *rules = walk_ignore_rules(walk->options, &node->level, node->rules, node->path, node->path_size);
+
+    /* the search spec is only needed until the search starts */
+    arena_mark spec_mark = arena_get_mark(&node->level);
+    char *spec = arena_alloc(&node->level, node->path_size + 3);
+    if (spec == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    for (size_t i = 0; i != node->path_size; ++i) {
+        spec[i] = node->path[i];
+    }
+    spec[node->path_size] = '\\';
+    spec[node->path_size + 1] = '*';
+    spec[node->path_size + 2] = '\0';
+
+    WIN32_FIND_DATAA file_find_data;
+    HANDLE find_handle = find_first_file(spec, &file_find_data);
+    arena_release(&node->level, spec_mark);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        node->error = "FindFirstFileA failed";
+        node->error_code = GetLastError();
+        finish_output_node(walk, node);
+        return;
+    }
+
+    /* the serial walker writes the files of a directory first and then each subdirectory in the reverse order
+     * they were found in since it keeps them on a stack, so collect the subdirectories and add them in reverse
+     */
+    size_t capacity = 0;
+    size_t directory_count = 0;
+    size_t directory_capacity = 0;
+    output_node directories = { 0 };
+    do {
+        if (lstrcmpA(file_find_data.cFileName, ".") != 0 &&
+            lstrcmpA(file_find_data.cFileName, "..") != 0) {
+            bool is_directory = walk->recursive
+                ? (file_find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0
+                : (file_find_data.dwFileAttributes & ~FILE_ATTRIBUTE_DIRECTORY) == 0;
+            if (is_directory && !walk->recursive) continue;
+
+            arena_mark child_mark = arena_get_mark(&node->level);
+            output_node *child = make_output_node(&node->level, node->path, node->path_size,
+                                                  file_find_data.cFileName, lstrlenA(file_find_data.cFileName), is_directory);
+            if (walk_ignores(walk->options, rules, child->path, child->path_size, node->root_size, is_directory)) {
+                arena_release(&node->level, child_mark);
+                continue;
+            }
+
+            if (is_directory) {
+                child->rules = rules;
+                child->root_size = node->root_size;
+                add_child(&directories, &directory_capacity, child);
+                ++directory_count;
+            }
+            else {
+                add_child(node, &capacity, child);
+                if (!pool_push(pool, worker_index, scan_file_task, child)) {
+                    scan_file_task(pool, worker_index, child);
+                }
+            }
+        }
+    } while (find_next_file(find_handle, &file_find_data) != 0);
+
+    if (GetLastError() != ERROR_NO_MORE_FILES) {
+        /* the serial walker stops before any subdirectory is written */
+        node->error = "FindNextFileA failed";
+        node->error_code = GetLastError();
+        directory_count = 0;
+    }
+    FindClose(find_handle);
+
+    for (size_t i = directory_count; i != 0; --i) {
+        output_node *child = directories.children[i - 1];
+        add_child(node, &capacity, child);
+        if (!pool_push(pool, worker_index, expand_directory_task, child)) {
+            expand_directory_task(pool, worker_index, child);
+        }
+    }
+    HeapFree(GetProcessHeap(), 0, directories.children);
+
+    finish_output_node(walk, node);
+}
+
+/* writes out node and everything under it in order as soon as it is ready */
+static void write_output_node(parallel_walk *walk, output_node *node)
+{
+    AcquireSRWLockExclusive(&walk->lock);
+    while (!node->done) {
+        SleepConditionVariableSRW(&walk->node_done, &walk->lock, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&walk->lock);
+
+    if (!node->is_directory) {
+        enter_metrics_directory(walk->options, node->path);
+    }
+    if (node->buffer.size != 0) {
+        output_write(&output, node->buffer.data, node->buffer.size);
+    }
+    output_free(&node->buffer);
+    add_skip_note(node->path, node->note);
+    add_file_metrics(walk->options, &node->totals);
+    add_totals(&totals, &node->totals);
+
+    for (size_t i = 0; i < node->child_count; ++i) {
+        write_output_node(walk, node->children[i]);
+    }
+
+    if (node->error != NULL) {
+        /* error_messagea exits with the last error so restore the one the worker got */
+        SetLastError(node->error_code);
+        if (node->error_path != NULL) {
+            error_messagea("Error: ", node->error, " \"", node->error_path, "\"");
+        }
+        else {
+            error_messagea("Error: ", node->error);
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, node->children);
+    arena_free(&node->level);
+}
+
+/* scans the files under input_path on thread_count threads, the output is the same as the serial walkers */
+static void read_comments_in_directory_parallel(char const *input_path, read_options const *options, bool recursive, size_t thread_count)
+{
+    thread_pool pool;
+    read_options pool_options = *options;
+    pool_options.pool = &pool;
+    parallel_walk walk = { .options = &pool_options, .recursive = recursive };
+    InitializeSRWLock(&walk.lock);
+    InitializeConditionVariable(&walk.node_done);
+
+    arena root_level = { 0 };
+    output_node *root = make_output_node(&root_level, input_path, lstrlenA(input_path), NULL, 0, true);
+
+    if (!pool_start(&pool, thread_count, &walk, expand_directory_task, root)) {
+        error_messagea("Error: could not start the worker threads");
+    }
+
+    write_output_node(&walk, root);
+    pool_join(&pool);
+    arena_free(&root_level);
+}
+
+/* a list of paths from --files-from or @file, the paths are separated by null bytes if there are any
+ * so the list can come from git ls-files -z or find -print0 and by new lines otherwise
+ * NOTE: read_file_list turns every separator into a null byte so the paths can be used as they are
+ */
+typedef struct file_list
+{
+    char *data;
+    size_t size;
+} file_list;
+
+/* reads all of stdin into list, returns false if it could not be read */
+static bool read_stdin_list(file_list *list)
+{
+    size_t capacity = STDIN_CHUNK_SIZE;
+    list->data = HeapAlloc(GetProcessHeap(), 0, capacity);
+    list->size = 0;
+    if (list->data == NULL) {
+        return false;
+    }
+
+    HANDLE stdin = GetStdHandle(STD_INPUT_HANDLE);
+    for (;;) {
+        if (list->size == capacity) {
+            capacity *= 2;
+            char *data = HeapReAlloc(GetProcessHeap(), 0, list->data, capacity);
+            if (data == NULL) {
+                return false;
+            }
+            list->data = data;
+        }
+
+        DWORD bytes_read = 0;
+        DWORD chunk_size = capacity - list->size > (1 << 30) ? (1 << 30) : (DWORD)(capacity - list->size);
+        stats_count_call(READ_FILE_CALL);
+        if (ReadFile(stdin, list->data + list->size, chunk_size, &bytes_read, NULL) == FALSE) {
+            if (GetLastError() == ERROR_BROKEN_PIPE) break;
+            return false;
+        }
+        if (bytes_read == 0) break;
+        list->size += bytes_read;
+    }
+    return true;
+}
+
+/* reads the list at path or stdin for -, returns a description of what went wrong or NULL on success */
+static char const *read_file_list(char const *path, file_list *list)
+{
+    if (!lstrcmpA(path, "-")) {
+        if (!read_stdin_list(list)) {
+            return "could not read the file list from stdin";
+        }
+    }
+    else {
+        /* NOTE: the list is read into a heap buffer since the separators are written over */
+        input_file file;
+        char const *error = open_input_file(path, false, &file);
+        if (error != NULL) {
+            return error;
+        }
+        list->data = (char *)file.data;
+        list->size = file.size;
+        CloseHandle(file.file_handle);
+        if (list->size == 0) {
+            list->data = NULL;
+            return NULL;
+        }
+    }
+
+    bool null_separated = false;
+    for (size_t i = 0; i < list->size && !null_separated; ++i) {
+        null_separated = list->data[i] == '\0';
+    }
+
+    if (!null_separated) {
+        for (size_t i = 0; i < list->size; ++i) {
+            if (list->data[i] == '\n') {
+                list->data[i] = '\0';
+                if (i != 0 && list->data[i - 1] == '\r') {
+                    list->data[i - 1] = '\0';
+                }
+            }
+        }
+    }
+
+    /* the last path does not need a separator after it */
+    if (list->size != 0 && list->data[list->size - 1] != '\0') {
+        char *data = HeapReAlloc(GetProcessHeap(), 0, list->data, list->size + 1);
+        if (data == NULL) {
+            return "could not allocate memory for the file list";
+        }
+        list->data = data;
+        list->data[list->size++] = '\0';
+    }
+    return NULL;
+}
+
+/* returns the path at offset in list and moves offset to the next one, empty paths are skipped and NULL is returned at the end */
+static char const *next_list_path(char const *list, size_t list_size, size_t *offset, size_t *path_size)
+{
+    while (*offset < list_size && list[*offset] == '\0') {
+        ++*offset;
+    }
+    if (*offset == list_size) {
+        return NULL;
+    }
+
+    char const *path = list + *offset;
+    size_t size = 0;
+    while (path[size] != '\0') {
+        ++size;
+    }
+    *offset += size + 1;
+    *path_size = size;
+    return path;
+}
+
+static void free_file_list(file_list *list)
+{
+    if (list->data != NULL) {
+        HeapFree(GetProcessHeap(), 0, list->data);
+    }
+    *list = (file_list) { 0 };
+}
+
+/* reads the comments of every path in the list in one go, files are read ahead like the files of a directory
+ * and directories are walked like the ones given as arguments
+ */
+static void read_comments_in_list(file_list const *list, read_options const *options, bool recursive)
+{
+    read_ahead *ahead = start_read_ahead(options);
+
+    size_t offset = 0;
+    size_t path_size;
+    char const *path;
+    while ((path = next_list_path(list->data, list->size, &offset, &path_size)) != NULL) {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (GetFileAttributesExA(path, GetFileExInfoStandard, &attributes) == FALSE) {
+            /* scanning the file reports that it could not be opened once the files before it are written */
+            read_ahead_file(ahead, path, path_size, (ULONGLONG)-1);
+            continue;
+        }
+
+        if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            scan_read_ahead_files(ahead);
+
+            if (recursive) {
+                read_comments_in_directory(path, options);
+            }
+            else {
+                read_comments_in_directory_non_recursive(path, options);
+            }
+        }
+        else {
+            read_ahead_file(ahead, path, path_size, ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow);
+        }
+    }
+
+    finish_read_ahead(ahead);
+}
+
+/* adds every path of the list to the root node, the same as expand_directory_task does for the files of a directory */
+static void expand_file_list_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    parallel_walk *walk = pool->context;
+    output_node *node = data;
+
+    size_t capacity = 0;
+    size_t offset = 0;
+    size_t path_size;
+    char const *path;
+    while ((path = next_list_path(walk->list, walk->list_size, &offset, &path_size)) != NULL) {
+        /* NOTE: paths that do not exist are scanned as files so the error comes in order */
+        DWORD attributes = GetFileAttributesA(path);
+        bool is_directory = attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+
+        output_node *child = make_output_node(&node->level, path, path_size, NULL, 0, is_directory);
+        add_child(node, &capacity, child);
+
+        task_function *task = is_directory ? expand_directory_task : scan_file_task;
+        if (!pool_push(pool, worker_index, task, child)) {
+            task(pool, worker_index, child);
+        }
+    }
+
+    finish_output_node(walk, node);
+}
+
+/* the same as read_comments_in_list on thread_count threads */
+static void read_comments_in_list_parallel(file_list const *list, read_options const *options, bool recursive, size_t thread_count)
+{
+    thread_pool pool;
+    read_options pool_options = *options;
+    pool_options.pool = &pool;
+    parallel_walk walk = { .options = &pool_options, .recursive = recursive, .list = list->data, .list_size = list->size };
+    InitializeSRWLock(&walk.lock);
+    InitializeConditionVariable(&walk.node_done);
+
+    arena root_level = { 0 };
+    output_node *root = make_output_node(&root_level, "", 0, NULL, 0, true);
+
+    if (!pool_start(&pool, thread_count, &walk, expand_file_list_task, root)) {
+        error_messagea("Error: could not start the worker threads");
+    }
+
+    write_output_node(&walk, root);
+    pool_join(&pool);
+    arena_free(&root_level);
+}
+
+/* a file that is read from memory instead of from disk, a blob of --git-rev or a member of an --archive
+ * NOTE: it is read without a file name so what it gave can be written for any path, the header is written for the path
+ * and its jsonl records have a null file that is replaced with the path, see output_memory_records
+ */
+typedef struct memory_file
+{
+    /* set once it is read, content_mode is the comment mode with auto replaced by the one that was sniffed */
+    comment_display content_mode;
+    output_buffer buffer;
+    comment_count count;
+    line_metrics lines;
+    char const *note;
+    char const *error;
+    DWORD error_code;
+    volatile LONG done;
+} memory_file;
+
+/* the same as scan_file for the size bytes at data, path is only for --stats and --trace
+ * NOTE: a file larger than --max-file-size has to be skipped before it is read without --oversized=head,
+ * a caller that only read the start of a larger file sets its note first
+ */
+static void scan_memory_file(read_options const *options, comment_display comment_mode, char const *data, size_t size, char const *path,
+                             memory_file *file)
+{
+    if (options->max_file_size != 0 && size > options->max_file_size) {
+        size = (size_t)options->max_file_size;
+        file->note = oversized_head_note;
+    }
+    if (!options->read_binary) {
+        char const *binary = sniff_binary(data, size);
+        if (binary != NULL) {
+            file->note = binary;
+            return;
+        }
+    }
+    stats_add_file(size);
+
+    stats_span span = stats_begin();
+    if (comment_mode == AUTO_COMMENT_DISPLAY) {
+        comment_mode = sniff_comment_mode(data, size);
+    }
+    file->content_mode = comment_mode;
+    file->count = options->metrics ? count_line_metrics(data, size, comment_mode, &file->lines)
+        : options->count_only && options->filter == NULL ? count_comments(data, size, options, comment_mode)
+        : read_comments(data, size, options, comment_mode, NULL, &file->buffer);
+    output_flush(&file->buffer);
+    stats_end(span, LEX_PHASE, path);
+}
+
+/* writes the jsonl records of a memory file with the path as their file */
+static void output_memory_records(output_buffer *out, char const *records, size_t size, char const *path, size_t path_size)
+{
+    static char const null_file[] = "{\"file\":null";
+    char const *const end = records + size;
+    while (records != end) {
+        char const *rest = records + sizeof(null_file) - 1;
+        char const *line_end = rest;
+        while (*line_end++ != '\n');
+
+        output_write(out, "{\"file\":", 8);
+        output_json_string(out, path, path_size);
+        output_write(out, rest, line_end - rest);
+        records = line_end;
+    }
+}
+
+/* writes what was read from the file for path and adds it up the same way print_file_comments does for a file on disk */
+static void write_memory_file(read_options const *options, char const *path, size_t path_size, memory_file const *file)
+{
+    if (file->note != NULL && file->note != oversized_head_note) {
+        add_skip_note(path, file->note);
+        return;
+    }
+
+    enter_metrics_directory(options, path);
+    if (file->error != NULL) {
+        if (options->filter == NULL && !options->metrics) {
+            output_file_header(&output, options->format, path);
+        }
+        SetLastError(file->error_code);
+        error_messagea("Error: ", file->error, " \"", path, "\"");
+    }
+
+    run_totals file_totals = { .comment_mode = file->content_mode, .file_count = 1, .count = file->count, .lines = file->lines };
+    if (options->metrics) {
+        output_metrics_row(&output, options->format, FILE_METRICS_ROW, path, path_size, file->content_mode, &file_totals);
+    }
+    else if (options->filter == NULL || has_comments(&file->count)) {
+        output_file_header(&output, options->format, path);
+        if (options->format == JSON_LINES_OUTPUT_FORMAT) {
+            output_memory_records(&output, file->buffer.data, file->buffer.size, path, path_size);
+        }
+        else if (file->buffer.size != 0) {
+            output_write(&output, file->buffer.data, file->buffer.size);
+        }
+        if (options->display_comment_count && options->format == TEXT_OUTPUT_FORMAT) {
+            output_comment_count(&output, file->content_mode, file->count);
+        }
+    }
+    add_skip_note(path, file->note);
+    add_file_metrics(options, &file_totals);
+    add_totals(&totals, &file_totals);
+}
+
+/* a path and the memory file that is written for it */
+typedef struct queued_file
+{
+    struct queued_file *next;
+    memory_file *file;
+    char const *path;
+    size_t path_size;
+} queued_file;
+
+/* the files of a --git-rev or an --archive in the order they are written, with -j they are found on a worker
+ * that adds them to the end while the main thread writes them from the start as soon as they are read
+ */
+typedef struct file_queue
+{
+    /* the entries and the copies of the paths, only the thread that finds the files allocates from it */
+    arena files;
+    queued_file *first;
+    queued_file *last;
+    bool ended;
+
+    SRWLOCK lock;
+    CONDITION_VARIABLE changed;
+} file_queue;
+
+static void init_file_queue(file_queue *queue)
+{
+    *queue = (file_queue) { 0 };
+    InitializeSRWLock(&queue->lock);
+    InitializeConditionVariable(&queue->changed);
+}
+
+/* a copy of path that lives as long as the queue */
+static char *copy_queued_path(file_queue *queue, char const *path, size_t path_size)
+{
+    char *copy = arena_alloc(&queue->files, path_size + 1);
+    if (copy == NULL) {
+        error_messagea("Error: could not allocate memory for a path");
+    }
+    for (size_t i = 0; i < path_size; ++i) {
+        copy[i] = path[i];
+    }
+    copy[path_size] = '\0';
+    return copy;
+}
+
+static void queue_file(file_queue *queue, memory_file *file, char const *path, size_t path_size)
+{
+    queued_file *entry = arena_alloc(&queue->files, sizeof(queued_file));
+    if (entry == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    *entry = (queued_file) { .file = file, .path = path, .path_size = path_size };
+
+    AcquireSRWLockExclusive(&queue->lock);
+    if (queue->last != NULL) {
+        queue->last->next = entry;
+    }
+    else {
+        queue->first = entry;
+    }
+    queue->last = entry;
+    ReleaseSRWLockExclusive(&queue->lock);
+    WakeAllConditionVariable(&queue->changed);
+}
+
+/* a worker read the file */
+static void finish_queued_file(file_queue *queue, memory_file *file)
+{
+    AcquireSRWLockExclusive(&queue->lock);
+    file->done = true;
+    ReleaseSRWLockExclusive(&queue->lock);
+    WakeAllConditionVariable(&queue->changed);
+}
+
+/* no more files are added */
+static void end_file_queue(file_queue *queue)
+{
+    AcquireSRWLockExclusive(&queue->lock);
+    queue->ended = true;
+    ReleaseSRWLockExclusive(&queue->lock);
+    WakeAllConditionVariable(&queue->changed);
+}
+
+/* writes a file of the queue on the main thread, context is what write_file_queue was given */
+typedef void queued_file_writer(read_options const *options, void *context, queued_file const *entry);
+
+/* writes the files in the order they were added as soon as each of them is read until the queue ends */
+static void write_file_queue(read_options const *options, file_queue *queue, queued_file_writer *write, void *context)
+{
+    queued_file *entry = NULL;
+    for (;;) {
+        AcquireSRWLockExclusive(&queue->lock);
+        queued_file *next;
+        while ((next = entry == NULL ? queue->first : entry->next) == NULL && !queue->ended) {
+            SleepConditionVariableSRW(&queue->changed, &queue->lock, INFINITE, 0);
+        }
+        while (next != NULL && !next->file->done) {
+            SleepConditionVariableSRW(&queue->changed, &queue->lock, INFINITE, 0);
+        }
+        ReleaseSRWLockExclusive(&queue->lock);
+        if (next == NULL) break;
+
+        write(options, context, next);
+        entry = next;
+    }
+}
+
+/* --git-rev, the blobs of every revision that was read so far, a blob is read once for each comment mode of the paths it is at
+ * and what it gave is written again for every other path and revision that has it so files that did not change are read once
+ * NOTE: the outputs that are kept for that are at most GIT_KEPT_OUTPUT_SIZE bytes together, past that the output of a blob
+ * is freed once it is written and the blob is read again on the main thread for the next path that has it,
+ * the counts and the id of every blob are kept for the whole run
+ */
+#define GIT_KEPT_OUTPUT_SIZE (1 << 26)
+
+typedef struct git_blob
+{
+    unsigned char oid[GIT_OID_SIZE];
+    comment_display comment_mode;
+
+    /* the path it was last read for, for --stats and --trace */
+    char const *path;
+
+    memory_file file;
+
+    /* whether its output counts towards GIT_KEPT_OUTPUT_SIZE or was freed and has to be read again */
+    bool output_kept;
+    bool output_freed;
+} git_blob;
+
+/* open addressing on the start of the ids, they are already random */
+static struct
+{
+    git_blob **slots;
+    size_t capacity;
+    size_t count;
+    arena blobs;
+
+    /* the outputs of the blobs with output_kept */
+    size_t kept_output_size;
+} git_blobs;
+
+static size_t git_blob_slot(unsigned char const *oid, comment_display comment_mode)
+{
+    DWORD const hash = ((DWORD)oid[0] | ((DWORD)oid[1] << 8) | ((DWORD)oid[2] << 16) | ((DWORD)oid[3] << 24)) ^ (comment_mode * 0x9e3779b9);
+    size_t slot = hash & (git_blobs.capacity - 1);
+    for (git_blob *blob; (blob = git_blobs.slots[slot]) != NULL; slot = (slot + 1) & (git_blobs.capacity - 1)) {
+        if (blob->comment_mode == comment_mode && bytes_equal((char const *)blob->oid, (char const *)oid, GIT_OID_SIZE)) break;
+    }
+    return slot;
+}
+
+/* returns the blob for oid and comment_mode, added sets whether it is new and has to be read */
+static git_blob *find_git_blob(unsigned char const *oid, comment_display comment_mode, char const *path, bool *added)
+{
+    if (git_blobs.count * 2 >= git_blobs.capacity) {
+        git_blob **old_slots = git_blobs.slots;
+        size_t const old_capacity = git_blobs.capacity;
+        git_blobs.capacity = old_capacity == 0 ? 1024 : old_capacity * 2;
+        git_blobs.slots = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(git_blob *) * git_blobs.capacity);
+        if (git_blobs.slots == NULL) {
+            error_messagea("Error: could not allocate memory for the blobs");
+        }
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_slots[i] != NULL) {
+                git_blobs.slots[git_blob_slot(old_slots[i]->oid, old_slots[i]->comment_mode)] = old_slots[i];
+            }
+        }
+        HeapFree(GetProcessHeap(), 0, old_slots);
+    }
+
+    size_t const slot = git_blob_slot(oid, comment_mode);
+    *added = git_blobs.slots[slot] == NULL;
+    if (!*added) {
+        return git_blobs.slots[slot];
+    }
+
+    git_blob *blob = arena_alloc(&git_blobs.blobs, sizeof(git_blob));
+    if (blob == NULL) {
+        error_messagea("Error: could not allocate memory for the blobs");
+    }
+    *blob = (git_blob) { .comment_mode = comment_mode, .path = path, .file.buffer = make_memory_buffer() };
+    for (size_t i = 0; i < GIT_OID_SIZE; ++i) {
+        blob->oid[i] = oid[i];
+    }
+    git_blobs.slots[slot] = blob;
+    ++git_blobs.count;
+    return blob;
+}
+
+static void free_git_blobs(void)
+{
+    for (size_t i = 0; i < git_blobs.capacity; ++i) {
+        if (git_blobs.slots[i] != NULL) {
+            output_free(&git_blobs.slots[i]->file.buffer);
+        }
+    }
+    HeapFree(GetProcessHeap(), 0, git_blobs.slots);
+    arena_free(&git_blobs.blobs);
+    git_blobs.slots = NULL;
+    git_blobs.capacity = 0;
+    git_blobs.count = 0;
+    git_blobs.kept_output_size = 0;
+}
+
+/* reads the blob and scans it the way scan_file does, the limits of --max-file-size and the check for binary files work the same way */
+static void scan_git_blob(read_options const *options, git_reader *reader, git_blob *blob)
+{
+    stats_span file_span = stats_begin();
+    stats_span span = stats_begin();
+    size_t max_size = (size_t)-1;
+    if (options->max_file_size != 0 && !options->read_oversized_head && options->max_file_size < max_size) {
+        max_size = (size_t)options->max_file_size;
+    }
+
+    memory_file *file = &blob->file;
+    git_object object;
+    file->error = git_read_object(reader, blob->oid, max_size, &object);
+    file->error_code = GetLastError();
+    stats_end(span, READ_PHASE, blob->path);
+    if (file->error == NULL && object.data != NULL && object.type != GIT_BLOB) {
+        file->error = "is not a blob";
+        git_free_object(&object);
+    }
+
+    /* a blob that is skipped or could not be read still ends its span the way a file on disk does */
+    if (file->error == NULL && object.data == NULL) {
+        file->note = oversized_skip_note;
+    }
+    else if (file->error == NULL) {
+        scan_memory_file(options, blob->comment_mode, object.data, object.size, blob->path, file);
+        git_free_object(&object);
+    }
+    stats_end_file(file_span, blob->path);
+}
+
+/* writes the blob for path, on the main thread since that is the only one that frees the outputs or reads a blob again */
+static void write_git_file(read_options const *options, git_reader *reader, git_blob *blob, char const *path, size_t path_size)
+{
+    if (blob->output_freed) {
+        blob->path = path;
+        blob->file = (memory_file) { .buffer = make_memory_buffer(), .done = true };
+        blob->output_freed = false;
+        scan_git_blob(options, reader, blob);
+    }
+    write_memory_file(options, path, path_size, &blob->file);
+
+    /* an empty output costs nothing to keep */
+    if (blob->output_kept || blob->file.buffer.data == NULL) return;
+    if (git_blobs.kept_output_size + blob->file.buffer.capacity <= GIT_KEPT_OUTPUT_SIZE) {
+        git_blobs.kept_output_size += blob->file.buffer.capacity;
+        blob->output_kept = true;
+    }
+    else {
+        output_free(&blob->file.buffer);
+        blob->output_freed = true;
+    }
+}
+
+/* one revision, with -j the tree is walked on a worker that queues the files for the main thread to write
+ * while the new blobs are read on the other workers, otherwise every file is read and written as soon as it is found
+ */
+typedef struct git_walk
+{
+    read_options const *options;
+    unsigned char tree_oid[GIT_OID_SIZE];
+
+    /* the path of the tree that is walked, it starts with the revision and a : like git show takes them */
+    path_builder path;
+    size_t root_size;
+
+    /* one for each worker and one for the main thread after them, the main thread uses the first one when there are no workers */
+    git_reader *readers;
+
+    /* NULL when the files are read on the main thread */
+    thread_pool *pool;
+    file_queue queue;
+
+    /* why the walk stopped early and the path of the tree it stopped at */
+    char const *error;
+    char const *error_path;
+    DWORD error_code;
+} git_walk;
+
+static void scan_git_blob_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    git_walk *walk = pool->context;
+    git_blob *blob = data;
+    scan_git_blob(walk->options, &walk->readers[worker_index], blob);
+    finish_queued_file(&walk->queue, &blob->file);
+}
+
+/* the walk found the blob at the current path */
+static void add_git_file(git_walk *walk, size_t worker_index, unsigned char const *oid, char const *name)
+{
+    read_options const *options = walk->options;
+    comment_display const comment_mode = file_comment_mode(name, options);
+    if (!(comment_mode & ~NO_COMMENT_DISPLAY)) {
+        return;
+    }
+
+    char const *path = copy_queued_path(&walk->queue, walk->path.data, walk->path.size);
+    if (walk->pool == NULL) {
+        if (total_matches_reached(options)) return;
+
+        /* NOTE: the output of a blob has every match of it so it is never written again with --max-total */
+        bool added = true;
+        git_blob *blob = options->filter != NULL && options->filter->max_total != 0
+            ? &(git_blob) { .comment_mode = comment_mode, .path = path, .file.buffer = make_memory_buffer() }
+            : find_git_blob(oid, comment_mode, path, &added);
+        if (added) {
+            for (size_t i = 0; i < GIT_OID_SIZE; ++i) {
+                blob->oid[i] = oid[i];
+            }
+            scan_git_blob(options, &walk->readers[0], blob);
+            blob->file.done = true;
+        }
+        if (options->filter != NULL && options->filter->max_total != 0) {
+            write_memory_file(options, path, walk->path.size, &blob->file);
+            output_free(&blob->file.buffer);
+        }
+        else {
+            write_git_file(options, &walk->readers[0], blob, path, walk->path.size);
+        }
+        return;
+    }
+
+    bool added;
+    git_blob *blob = find_git_blob(oid, comment_mode, path, &added);
+    if (added && !pool_push(walk->pool, worker_index, scan_git_blob_task, blob)) {
+        scan_git_blob_task(walk->pool, worker_index, blob);
+    }
+    queue_file(&walk->queue, &blob->file, path, walk->path.size);
+}
+
+/* walks the tree with the id oid whose path is in walk->path, returns false if it stopped at an error */
+static bool walk_git_tree(git_walk *walk, size_t worker_index, unsigned char const *oid)
+{
+    stats_span span = stats_begin();
+    git_object tree;
+    char const *error = git_read_object(&walk->readers[worker_index], oid, (size_t)-1, &tree);
+    stats_end(span, ENUMERATE_PHASE, walk->path.data);
+    if (error == NULL && tree.type != GIT_TREE) {
+        git_free_object(&tree);
+        error = "is not a tree";
+    }
+
+    size_t const directory_size = walk->path.size;
+    size_t offset = 0;
+    git_tree_entry entry;
+    while (error == NULL && (error = git_next_tree_entry(&tree, &offset, &entry)) == NULL && entry.name != NULL) {
+        /* symbolic links and submodules have no contents of their own to read */
+        DWORD const type = entry.mode & GIT_MODE_TYPE_MASK;
+        bool const is_directory = type == GIT_DIRECTORY_MODE;
+        if (!is_directory && type != GIT_FILE_MODE) continue;
+
+        if (!path_append(&walk->path, entry.name, entry.name_size)) {
+            error_messagea("Error: could not allocate memory for a path");
+        }
+        if (!walk_ignores(walk->options, NULL, walk->path.data, walk->path.size, walk->root_size, is_directory)) {
+            if (is_directory) {
+                if (!path_append(&walk->path, "/", 1)) {
+                    error_messagea("Error: could not allocate memory for a path");
+                }
+                if (!walk_git_tree(walk, worker_index, entry.oid)) {
+                    git_free_object(&tree);
+                    return false;
+                }
+            }
+            else {
+                add_git_file(walk, worker_index, entry.oid, entry.name);
+            }
+        }
+        path_truncate(&walk->path, directory_size);
+    }
+    git_free_object(&tree);
+    if (error == NULL) {
+        return true;
+    }
+
+    walk->error = error;
+    walk->error_code = GetLastError();
+    walk->error_path = copy_queued_path(&walk->queue, walk->path.data, walk->path.size);
+    return false;
+}
+
+static void walk_git_tree_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    (void)data;
+    git_walk *walk = pool->context;
+    walk->pool = pool;
+    walk_git_tree(walk, worker_index, walk->tree_oid);
+    end_file_queue(&walk->queue);
+}
+
+static void write_queued_git_file(read_options const *options, void *context, queued_file const *entry)
+{
+    write_git_file(options, context, CONTAINING_RECORD(entry->file, git_blob, file), entry->path, entry->path_size);
+}
+
+/* reads the comments of every file in the tree of rev in the order git ls-tree -r lists them */
+static void read_comments_in_git_rev(git_repository const *repo, char const *rev, read_options const *options, size_t thread_count)
+{
+    read_options pool_options = *options;
+    git_walk walk = { .options = &pool_options };
+    init_file_queue(&walk.queue);
+
+    size_t const reader_count = thread_count == 1 ? 1 : thread_count + 1;
+    walk.readers = HeapAlloc(GetProcessHeap(), 0, sizeof(git_reader) * reader_count);
+    if (walk.readers == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    for (size_t i = 0; i < reader_count; ++i) {
+        if (!git_reader_init(&walk.readers[i], repo)) {
+            error_messagea("Error: could not allocate memory");
+        }
+    }
+
+    char const *error = git_resolve_tree(&walk.readers[0], rev, walk.tree_oid);
+    if (error != NULL) {
+        error_messagea("Error: ", error, " \"", rev, "\"");
+    }
+    if (!path_append(&walk.path, rev, lstrlenA(rev)) || !path_append(&walk.path, ":", 1)) {
+        error_messagea("Error: could not allocate memory for a path");
+    }
+    walk.root_size = walk.path.size;
+
+    if (thread_count == 1) {
+        walk_git_tree(&walk, 0, walk.tree_oid);
+    }
+    else {
+        thread_pool pool;
+        pool_options.pool = &pool;
+        if (!pool_start(&pool, thread_count, &walk, walk_git_tree_task, NULL)) {
+            error_messagea("Error: could not start the worker threads");
+        }
+
+        write_file_queue(walk.options, &walk.queue, write_queued_git_file, &walk.readers[thread_count]);
+        pool_join(&pool);
+    }
+
+    if (walk.error != NULL) {
+        SetLastError(walk.error_code);
+        error_messagea("Error: ", walk.error, " \"", walk.error_path, "\"");
+    }
+
+    for (size_t i = 0; i < reader_count; ++i) {
+        git_reader_free(&walk.readers[i]);
+    }
+    HeapFree(GetProcessHeap(), 0, walk.readers);
+    path_free(&walk.path);
+    arena_free(&walk.queue.files);
+}
+
+/* --archive, a member of a tar, tar.gz or zip that is scanned, the members of a tar are lexed straight from the mapped archive,
+ * the ones of a zip are inflated by the worker that lexes them and the ones of a tar.gz are inflated in order by the walker
+ * while the other workers lex the ones before them
+ */
+typedef struct archive_member
+{
+    memory_file file;
+    comment_display comment_mode;
+    char const *path;
+
+    /* the contents in the archive as they are or deflated, from archive_entry */
+    unsigned char const *data;
+    size_t data_size;
+    bool deflated;
+
+    /* how much of the member is read, only its start with --oversized=head */
+    size_t size;
+
+    /* the contents of a member of a tar.gz that the walker inflated, freed once they are lexed */
+    char *buffer;
+} archive_member;
+
+/* how much of a tar.gz the walker inflates ahead of the workers before it lexes the members itself */
+#define ARCHIVE_MAX_PENDING_SIZE (1 << 26)
+
+/* one archive, with -j the archive is walked on a worker that queues the members for the main thread to write
+ * while they are read on the other workers, otherwise every member is read and written as soon as it is found
+ */
+typedef struct archive_walk
+{
+    read_options const *options;
+    archive_reader reader;
+
+    /* the path of the member, it starts with the path of the archive and a : */
+    path_builder path;
+    size_t root_size;
+
+    /* one for each worker for the members of a zip */
+    inflater **inflaters;
+
+    /* NULL when the members are read on the main thread */
+    thread_pool *pool;
+    file_queue queue;
+
+    /* the bytes of the members of a tar.gz that were inflated and not lexed yet */
+    volatile LONGLONG pending_size;
+
+    /* why the walk stopped early */
+    char const *error;
+    DWORD error_code;
+} archive_walk;
+
+static void scan_archive_member(read_options const *options, inflater *z, archive_member *member)
+{
+    stats_span file_span = stats_begin();
+    char const *data = member->buffer != NULL ? member->buffer : (char const *)member->data;
+    char *inflated = NULL;
+    if (member->deflated) {
+        stats_span span = stats_begin();
+        inflated = HeapAlloc(GetProcessHeap(), 0, member->size == 0 ? 1 : member->size);
+        member->file.error = inflated == NULL ? "could not allocate memory for"
+            : inflate_zip_entry(z, member->data, member->data_size, inflated, member->size);
+        member->file.error_code = GetLastError();
+        stats_end(span, READ_PHASE, member->path);
+        data = inflated;
+    }
+
+    if (member->file.error == NULL) {
+        scan_memory_file(options, member->comment_mode, data, member->size, member->path, &member->file);
+    }
+    if (inflated != NULL) {
+        HeapFree(GetProcessHeap(), 0, inflated);
+    }
+    if (member->buffer != NULL) {
+        HeapFree(GetProcessHeap(), 0, member->buffer);
+        member->buffer = NULL;
+    }
+    stats_end_file(file_span, member->path);
+}
+
+static void scan_archive_member_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    archive_walk *walk = pool->context;
+    archive_member *member = data;
+    LONGLONG const inflated_size = member->buffer != NULL ? (LONGLONG)member->size : 0;
+    scan_archive_member(walk->options, walk->inflaters[worker_index], member);
+    InterlockedExchangeAdd64(&walk->pending_size, -inflated_size);
+    finish_queued_file(&walk->queue, &member->file);
+}
+
+/* whether the member at the current path or one of the directories it is in is left out, the directories of an archive
+ * are only in the paths of its members
+ */
+static bool archive_member_ignored(archive_walk const *walk)
+{
+    read_options const *options = walk->options;
+    path_builder const *path = &walk->path;
+    if (options->ignore == NULL) return false;
+
+    for (size_t i = walk->root_size + 1; i < path->size; ++i) {
+        if (is_path_separator(path->data[i]) && !is_path_separator(path->data[i - 1]) &&
+            walk_ignores(options, NULL, path->data, i, walk->root_size, true)) {
+            return true;
+        }
+    }
+    return walk_ignores(options, NULL, path->data, path->size, walk->root_size, false);
+}
+
+/* the walk found the member at the current path */
+static void add_archive_member(archive_walk *walk, size_t worker_index, archive_entry const *entry)
+{
+    read_options const *options = walk->options;
+    char const *name = walk->path.data + walk->path.size;
+    while (name != walk->path.data + walk->root_size && !is_path_separator(name[-1])) --name;
+    comment_display const comment_mode = file_comment_mode(name, options);
+    if (!(comment_mode & ~NO_COMMENT_DISPLAY)) {
+        return;
+    }
+    if (walk->pool == NULL && total_matches_reached(options)) {
+        return;
+    }
+
+    archive_member *member = arena_alloc(&walk->queue.files, sizeof(archive_member));
+    if (member == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    *member = (archive_member) {
+        .file.buffer = make_memory_buffer(),
+        .comment_mode = comment_mode,
+        .path = copy_queued_path(&walk->queue, walk->path.data, walk->path.size),
+        .data = entry->data,
+        .data_size = entry->data_size,
+        .deflated = entry->deflated,
+        .size = (size_t)entry->size
+    };
+
+    /* the size is looked at before reading so that a member that is skipped is never inflated */
+    if (entry->unsupported != NULL) {
+        member->file.note = entry->unsupported;
+    }
+    else if (options->max_file_size != 0 && entry->size > options->max_file_size) {
+        member->file.note = options->read_oversized_head ? oversized_head_note : oversized_skip_note;
+        member->size = (size_t)options->max_file_size;
+    }
+    else if (entry->size > ((size_t)-1 >> 1)) {
+        member->file.error = "the file is too large to fit in memory";
+    }
+    bool const skipped = member->file.error != NULL || (member->file.note != NULL && member->file.note != oversized_head_note);
+
+    if (!skipped && entry->data == NULL) {
+        stats_span span = stats_begin();
+        member->buffer = HeapAlloc(GetProcessHeap(), 0, member->size == 0 ? 1 : member->size);
+        member->file.error = member->buffer == NULL ? "could not allocate memory for"
+            : read_archive_entry(&walk->reader, member->buffer, member->size);
+        member->file.error_code = GetLastError();
+        stats_end(span, READ_PHASE, member->path);
+
+        /* a member that could not be read is never lexed, the lexing frees the buffer of the others */
+        if (member->file.error != NULL && member->buffer != NULL) {
+            HeapFree(GetProcessHeap(), 0, member->buffer);
+            member->buffer = NULL;
+        }
+    }
+
+    if (walk->pool == NULL) {
+        if (!skipped && member->file.error == NULL) {
+            scan_archive_member(options, walk->inflaters[0], member);
+        }
+        write_memory_file(options, member->path, walk->path.size, &member->file);
+        output_free(&member->file.buffer);
+        return;
+    }
+
+    if (skipped || member->file.error != NULL) {
+        member->file.done = true;
+    }
+    else {
+        /* NOTE: when the workers fall behind the walker of a tar.gz it lexes the member itself so what is inflated ahead stays bounded */
+        LONGLONG const pending_size = member->buffer != NULL ? InterlockedExchangeAdd64(&walk->pending_size, (LONGLONG)member->size) : 0;
+        if (pending_size > ARCHIVE_MAX_PENDING_SIZE || !pool_push(walk->pool, worker_index, scan_archive_member_task, member)) {
+            scan_archive_member_task(walk->pool, worker_index, member);
+        }
+    }
+    queue_file(&walk->queue, &member->file, member->path, walk->path.size);
+}
+
+static void walk_archive(archive_walk *walk, size_t worker_index)
+{
+    for (;;) {
+        /* the rest of the member before is skipped here, it is inflated for a tar.gz */
+        stats_span span = stats_begin();
+        archive_entry entry;
+        char const *error = next_archive_entry(&walk->reader, &entry);
+        stats_end(span, ENUMERATE_PHASE, walk->path.data);
+        if (error != NULL) {
+            walk->error = error;
+            walk->error_code = GetLastError();
+            return;
+        }
+        if (entry.name == NULL) return;
+        if (!entry.is_file) continue;
+
+        path_truncate(&walk->path, walk->root_size);
+        if (!path_append(&walk->path, entry.name, entry.name_size)) {
+            error_messagea("Error: could not allocate memory for a path");
+        }
+        if (!archive_member_ignored(walk)) {
+            add_archive_member(walk, worker_index, &entry);
+        }
+    }
+}
+
+static void write_queued_archive_member(read_options const *options, void *context, queued_file const *entry)
+{
+    (void)context;
+    write_memory_file(options, entry->path, entry->path_size, entry->file);
+    output_free(&entry->file->buffer);
+}
+
+static void walk_archive_task(thread_pool *pool, size_t worker_index, void *data)
+{
+    (void)data;
+    archive_walk *walk = pool->context;
+    walk->pool = pool;
+    walk_archive(walk, worker_index);
+    end_file_queue(&walk->queue);
+}
+
+/* reads the comments of every file in the tar, tar.gz or zip at filename in the order they are in it */
+static void read_comments_in_archive(char const *filename, read_options const *options, size_t thread_count)
+{
+    read_options pool_options = *options;
+    archive_walk walk = { .options = &pool_options };
+    init_file_queue(&walk.queue);
+
+    input_file file;
+    char const *error = open_input_file(filename, options->map_files, &file);
+    if (error != NULL) {
+        error_messagea("Error: ", error, " \"", filename, "\"");
+    }
+    error = open_archive(&walk.reader, (unsigned char const *)file.data, file.size);
+    if (error != NULL) {
+        error_messagea("Error: ", error, " \"", filename, "\"");
+    }
+
+    walk.inflaters = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(inflater *) * thread_count);
+    if (walk.inflaters == NULL) {
+        error_messagea("Error: could not allocate memory");
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        if ((walk.inflaters[i] = make_inflater()) == NULL) {
+            error_messagea("Error: could not allocate memory");
+        }
+    }
+
+    if (!path_append(&walk.path, filename, lstrlenA(filename)) || !path_append(&walk.path, ":", 1)) {
+        error_messagea("Error: could not allocate memory for a path");
+    }
+    walk.root_size = walk.path.size;
+
+    if (thread_count == 1) {
+        walk_archive(&walk, 0);
+    }
+    else {
+        thread_pool pool;
+        pool_options.pool = &pool;
+        if (!pool_start(&pool, thread_count, &walk, walk_archive_task, NULL)) {
+            error_messagea("Error: could not start the worker threads");
+        }
+        write_file_queue(walk.options, &walk.queue, write_queued_archive_member, NULL);
+        pool_join(&pool);
+    }
+
+    if (walk.error != NULL) {
+        SetLastError(walk.error_code);
+        error_messagea("Error: ", walk.error, " \"", filename, "\"");
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        HeapFree(GetProcessHeap(), 0, walk.inflaters[i]);
+    }
+    HeapFree(GetProcessHeap(), 0, walk.inflaters);
+    close_archive(&walk.reader);
+    close_input_file(&file);
+    path_free(&walk.path);
+    arena_free(&walk.queue.files);
+}
+
+/* the names of the comment modes that -m, -e, -d and --language-map take */
+static bool parse_comment_mode(char const *name, comment_display *comment_mode)
+{
+    if (!lstrcmpiA(name, "cc") || !lstrcmpiA(name, "cxx") || !lstrcmpiA(name, "cpp")) {
+        *comment_mode = CC_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "c")) {
+        *comment_mode = C_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "asm")) {
+        *comment_mode = ASM_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "c|c++")) {
+        *comment_mode = C_AND_CC_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "auto")) {
+        *comment_mode = AUTO_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "py")) {
+        *comment_mode = PYTHON_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "rs")) {
+        *comment_mode = RUST_COMMENT_DISPLAY;
+    }
+    else if (!lstrcmpiA(name, "all")) {
+        *comment_mode = ALL_COMMENT_DISPLAY;
+    }
+    else {
+        for (size_t i = 0; i < defined_languages.count; ++i) {
+            if (!lstrcmpiA(name, defined_languages.languages[i].name)) {
+                *comment_mode = DEFINED_LANGUAGE_MODE(i);
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+/* adds the languages of definitions to defined_languages and their extensions to map and compiles every language again,
+ * returns a description of what went wrong and the language it went wrong in if there is one or NULL on success
+ */
+static char const *add_language_definitions(char const *str, size_t size, language_map *map, char const **language_name)
+{
+    *language_name = NULL;
+    char const *error = parse_language_definitions(str, size, &defined_languages, map);
+    for (size_t i = 0; i < defined_languages.count && error == NULL; ++i) {
+        lexer_table *table = defined_tables[0][i];
+        if (table == NULL) {
+            table = HeapAlloc(GetProcessHeap(), 0, sizeof(lexer_table));
+            if (table == NULL) {
+                return "could not allocate memory for the lexer";
+            }
+            defined_tables[0][i] = table;
+        }
+
+        error = build_language_table(table, &defined_languages.languages[i]);
+        if (error != NULL) {
+            *language_name = defined_languages.languages[i].name;
+        }
+    }
+    return error;
+}
+
+/* reads a --languages file, see parse_language_definitions for what is in it */
+static char const *read_language_definitions(char const *path, language_map *map, char const **language_name)
+{
+    input_file file;
+    char const *error = open_input_file(path, false, &file);
+    if (error != NULL) {
+        *language_name = NULL;
+        return error;
+    }
+
+    error = add_language_definitions(file.data, file.size, map, language_name);
+    close_input_file(&file);
+    return error;
+}
+
+/* reads a --language-map file into map, every line is an extension and the mode of its files like .inc asm
+ * where none skips the files and auto picks the mode from their contents, lines that start with # are ignored
+ * returns a description of what went wrong or NULL on success
+ */
+static char const *read_language_map(char const *path, language_map *map)
+{
+    input_file file;
+    char const *error = open_input_file(path, false, &file);
+    if (error != NULL) {
+        return error;
+    }
+
+    char const *pos = file.data;
+    char const *const end = file.data + file.size;
+    while (pos < end && error == NULL) {
+        char const *line_end = pos;
+        while (line_end < end && *line_end != '\n') {
+            ++line_end;
+        }
+
+        /* split the line into the extension and the mode */
+        char const *words[2];
+        size_t sizes[2] = { 0 };
+        size_t word_count = 0;
+        for (char const *word = pos; word < line_end && word_count < 3; ) {
+            while (word < line_end && (*word == ' ' || *word == '\t' || *word == '\r')) {
+                ++word;
+            }
+            if (word == line_end || (word_count == 0 && *word == '#')) break;
+
+            char const *word_end = word;
+            while (word_end < line_end && *word_end != ' ' && *word_end != '\t' && *word_end != '\r') {
+                ++word_end;
+            }
+            if (word_count < 2) {
+                words[word_count] = word;
+                sizes[word_count] = (size_t)(word_end - word);
+            }
+            ++word_count;
+            word = word_end;
+        }
+
+        if (word_count != 0) {
+            char name[16];
+            comment_display comment_mode;
+            if (word_count != 2 || sizes[1] >= sizeof(name)) {
+                error = "invalid line in the language map";
+            }
+            else {
+                for (size_t i = 0; i < sizes[1]; ++i) {
+                    name[i] = words[1][i];
+                }
+                name[sizes[1]] = '\0';
+
+                if (!lstrcmpiA(name, "none")) {
+                    comment_mode = NO_COMMENT_DISPLAY;
+                }
+                else if (!parse_comment_mode(name, &comment_mode)) {
+                    error = "unknown comment mode in the language map";
+                }
+
+                if (error == NULL && !language_map_add(map, words[0], sizes[0], comment_mode)) {
+                    error = "invalid extension in the language map";
+                }
+            }
+        }
+        pos = line_end + 1;
+    }
+
+    close_input_file(&file);
+    return error;
+}
+
+/* returns the list of --files-from=list or @list or NULL if arg is neither */
+static char const *file_list_arg(char const *arg)
+{
+    if (arg[0] == '@') {
+        return arg + 1;
+    }
+    return arg_value(arg, "--files-from=");
+}
+
+/* --max-total has to see the files in the order they are written so they are read on one thread */
+static size_t walker_thread_count(read_options const *options)
+{
+    return options->filter != NULL && options->filter->max_total != 0 ? 1 : options->thread_count;
+}
+
+void __cdecl mainCRTStartup(void)
+{
+    static char const *help_message = "Usage: comments [--help] [-r false or true or --recursive= false or true] [-l or --line] [-c or --count] [-nl or --no_line] [-e [mode] or --enable=[mode]] [-m [mode] or --mode=[mode]] [-d [mode] or --disable=[mode]] [--display_comment_count or -dcc] [--hide_comment_count -hcc] [-b [size] or --buffer_size=[size]] [--map] [--no_map] [-j [count] or --jobs=[count]] [--count-only] [--match=[literal]] [--regex=[pattern]] [--max-count=[count]] [--max-total=[count]] [--exclude=[glob]] [--include=[glob]] [--ignore-files] [--max-file-size=[size]] [--oversized=[policy]] [--binary] [--skip-report] [--metrics] [--format=[format]] [--cache=[file]] [--stats] [--trace=[file]] [--git-rev=[rev]] [--git-dir=[path]] [--archive=[file]] [--language-map=[file]] [--languages=[file]] [--files-from=[list] or @[list]] [- or file1 ...]\n\
+                                         Flags: \n\
+                                        --help: displays this message \n\
+                                        -r or --recursive=: using this with true enables recursive directory searching and using with false disables recursive directory search\n\
+                                        -l or --line(disabled by default): makes it so the program shows the line number of each comment\n\
+                                        -nl or --no_line: has the oppsite effect of -l\n\
+                                        -e [mode] or --enable=[mode]: enables the comment mode to [mode] for example -e asm enables asm comments\n\
+                                        -m [mode] or --mode=[mode]: sets the comment mode  to [mode] for example -m asm only allows only asm comments\n\
+                                        -d [mode] or --disable=[mode]: disables the comment mode to [mode] for example -d asm disables asm comments\n\
+                                        [mode](the default mode auto): the different modes are \n\
+                                        c++ style comments //(cc, cxx, cpp), \n\
+                                        c style comments /**/ (c), \n\
+                                        python style comments (py), \n\
+                                        asm style comments ;(asm), \n\
+                                        c and c++ style comments /**/ //(c|c++), \n\
+                                        rust style comments which enables rust style comments /*/* comments can be nested */*/ // /// //!(rs), \n\
+                                        auto which detects the comment style based on file extension or on a #! line or a vim or emacs modeline for files without one(auto), \n\
+                                        and all which enables all the available comment styles(all) \n\
+                                        the name of a defined language like lua, sql, html or haskell picks it on its own, it only works with -m \n\
+                                        -dcc or --display_comment_count(enabled by defualt): displays the number of comments found \n\
+                                        -hcc or --hides_comment_count: hides the number of comments found \n\
+                                        -b [size] or --buffer_size=[size](1m by default): how many bytes of output are buffered before being written, accepts k, m and g suffixes \n\
+                                        --language-map=[file]: adds the extensions in [file] to the ones auto knows, each line is an extension and a mode like .inc asm or .txt none \n\
+                                        --languages=[file]: adds the languages defined in [file] or replaces the ones with the same name, it has to come before the files \n\
+                                        --map(enabled by default): maps files into memory instead of copying them \n\
+                                        --no_map: reads files into a buffer instead of mapping them \n\
+                                        -j [count] or --jobs=[count](the number of processors by default): scans directories on [count] threads and splits files of 16 MB or more across them if there are 4 or more, the output is the same as with -j 1 \n\
+                                        --count-only: only counts the comments of each file without displaying them and displays the totals at the end \n\
+                                        --match=[literal]: only writes and counts the comments that have [literal] in their text, files without one are left out \n\
+                                        --regex=[pattern]: only writes and counts the comments with a match of [pattern] in their text, with --match both have to match, \n\
+                                        the pattern can have . [] [^] ^ $ * + ? | () and \\d \\w \\s \\D \\W \\S \\n \\r \\t, ^ and $ also match at the lines of a comment \n\
+                                        --max-count=[count]: stops reading a file after [count] comments that match \n\
+                                        --max-total=[count]: stops reading files after [count] comments that match over the whole run, the files are read on one thread \n\
+                                        --exclude=[glob]: leaves out the files and directories under the directories that are read that match [glob], \n\
+                                        a glob without a / is matched against the name and one with a / against the path under the directory, ** matches any number of directories \n\
+                                        --include=[glob]: only reads the files under the directories that match [glob] or one of the other --include globs \n\
+                                        --ignore-files: leaves out what the .gitignore and .ignore files of the directories that are read leave out and every .git directory \n\
+                                        --max-file-size=[size]: skips files larger than [size] bytes, k, m and g can follow [size], it does not apply to stdin \n\
+                                        --oversized=[policy](skip by default): skip or head which reads only the first --max-file-size bytes of larger files \n\
+                                        --binary: also reads the files that do not look like text, by default a file with a null byte in its first 8 KB, a utf-16 byte order mark \n\
+                                        or more than a tenth of control bytes and bytes that are not utf-8 in its first 1 KB is skipped \n\
+                                        --skip-report: writes the files that were skipped or only partly read and why to stderr at the end \n\
+                                        --metrics: writes how many lines of each file are code, comments, both (mixed) or blank instead of its comments, \n\
+                                        then a row for each directory after the files under it, one for each language and one for the whole run, \n\
+                                        it has to come before the files and the filters and --count-only do not apply to it \n\
+                                        --format=[format](text by default): text, jsonl which writes a json object for each comment or binary which writes length prefixed records, \n\
+                                        with --metrics text, jsonl or csv which writes a row for each file, directory and language \n\
+                                        the jsonl and binary records hold the file, the kind of comment, its byte offsets, the lines it starts and ends on and its text, they have to come before the files \n\
+                                        --cache=[file]: keeps what was read from each file in [file] and only reads the files that changed since the last run with the same options, it has to come before the files \n\
+                                        --stats: writes where the time of the run went to stderr at the end, the time and cycles of each phase summed over the threads, \n\
+                                        the bytes and files read, the system calls, the peak memory and how many files there were of each size, it has to come before the files \n\
+                                        --trace=[file]: writes a span for each file and each phase of it to [file] in the chrome trace event format, it has to come before the files \n\
+                                        --git-rev=[rev]: reads the comments of every file in the tree of the commit, tag or branch [rev] straight from the git objects without a checkout, \n\
+                                        ~N, ^ and ^N can follow [rev], the files are written as [rev]:path and a file that is the same in several revisions is only read once \n\
+                                        --git-dir=[path]: the repository of the --git-rev after it, the .git directory above the current one by default \n\
+                                        --archive=[file]: reads the comments of every file in the tar, tar.gz or zip [file] without extracting it, the files are written as [file]:path \n\
+                                        --files-from=[list] or @[list]: reads the comments of every file and directory in [list] or in stdin for -, \n\
+                                        the paths are separated by null bytes if there are any (git ls-files -z, find -print0) and by new lines otherwise \n\
+                                        - (or no files with a pipe as stdin): reads the comments of stdin in chunks as they come in \n\
+                                        ";
+    stdout = GetStdHandle(STD_OUTPUT_HANDLE);
+    stderr = GetStdHandle(STD_ERROR_HANDLE);
+    init_scanner();
+
+    /* get command line args */
+    int argc;
+    char **argv = CommandLineToArgvA(GetCommandLineA(), &argc) + 1;
+    --argc;
+
+    bool recursive_directory_search = false;
+    read_options options = {
+        .comment_mode = AUTO_COMMENT_DISPLAY,
+        .show_line_number = false,
+        .display_comment_count = true,
+        .map_files = true,
+        .thread_count = processor_count()
+    };
+    DWORD file_type = -1;
+    bool read_input = false;
+    char const *option_value = NULL;
+
+    /* --git-dir and --git-rev, the repository is opened by the first --git-rev after --git-dir, NULL finds the one the current directory is in */
+    char const *git_dir = NULL;
+    static git_repository repository;
+    bool repository_open = false;
+
+    /* --match, --regex, --max-count and --max-total */
+    static comment_filter filter;
+
+    /* --exclude, --include and --ignore-files */
+    static ignore_options ignore;
+
+    /* the extensions of the defined languages and of --language-map come before the built in ones */
+    static language_map languages;
+    {
+        char const *language_name;
+        char const *error = add_language_definitions(builtin_language_definitions, sizeof(builtin_language_definitions) - 1, &languages, &language_name);
+        if (error != NULL) {
+            error_messagea("Error: ", error, " in the built in language definitions");
+        }
+        options.languages = &languages;
+    }
+
+    /* this makes it easier to add flags
+     * NOTE: a defined language is a mode of its own, it can not be combined with others
+     */
+#define FIND_ARG(op, combine)                                                                       \
+    {                                                                                               \
+        comment_display mode;                                                                       \
+        if (!parse_comment_mode(argv[i], &mode)) {                                                  \
+            error_messagea("Error: invalid arguments\n", help_message);                             \
+        }                                                                                           \
+        if ((combine) && ((mode | options.comment_mode) & DEFINED_COMMENT_DISPLAY)) {               \
+            error_messagea("Error: a defined language can only be picked on its own with -m or --mode\n"); \
+        }                                                                                           \
+        options.comment_mode op mode;                                                               \
+    }                                                                                               \
+
+    /* parse command line args */
+    for (int i = 0; i < argc; ++i) {
+        if (!lstrcmpA(argv[i], "--line") || !lstrcmpA(argv[i], "-l")) {
+            options.show_line_number = true;
+        }
+        else if (i + 1 < argc && !lstrcmpA(argv[i], "-r")) {
+            ++i;
+            if (!lstrcmpiA(argv[i], "true")) {
+                recursive_directory_search = true;
+            }
+            else if (!lstrcmpiA(argv[i], "false")) {
+                recursive_directory_search = false;
+            }
+            else {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-'
+            && argv[i][2] == 'r' && argv[i][3] == 'e'
+            && argv[i][4] == 'c' && argv[i][5] == 'u'
+            && argv[i][6] == 'r' && argv[i][7] == 's'
+            && argv[i][8] == 'i' && argv[i][9] == 'v'
+            && argv[i][10] == 'e' && argv[i][11] == '=') {
+            argv[i] += 12;
+            if (!lstrcmpiA(argv[i], "true")) {
+                recursive_directory_search = true;
+            }
+            else if (!lstrcmpiA(argv[i], "false")) {
+                recursive_directory_search = false;
+            }
+            else {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+        }
+        else if (!lstrcmpA(argv[i], "--no_line") || !lstrcmpA(argv[i], "-nl")) {
+            options.show_line_number = false;
+        }
+        else if (!lstrcmpA(argv[i], "--display_comment_count") || !lstrcmpA(argv[i], "-dcc")) {
+            options.display_comment_count = true;
+        }
+        else if (!lstrcmpA(argv[i], "--hide_comment_count") || !lstrcmpA(argv[i], "-hcc")) {
+            options.display_comment_count = false;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-'
+            && argv[i][2] == 'm' && argv[i][3] == 'o'
+            && argv[i][4] == 'd' && argv[i][5] == 'e'
+            && argv[i][6] == '=') {
+            argv[i] += 7;
+            FIND_ARG(=, false);
+        }
+        else if (i + 1 < argc && !lstrcmpA(argv[i], "-m")) {
+            ++i;
+            FIND_ARG(=, false);
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-'
+            && argv[i][2] == 'm' && argv[i][3] == 'o'
+            && argv[i][4] == 'd' && argv[i][5] == 'e'
+            && argv[i][6] == '=') {
+            argv[i] += 7;
+            FIND_ARG(=, false);
+        }
+        else if (i + 1 < argc && !lstrcmpA(argv[i], "-e")) {
+            ++i;
+            FIND_ARG(|=, true);
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-'
+            && argv[i][2] == 'd' && argv[i][3] == 'i'
+            && argv[i][4] == 's' && argv[i][5] == 'a'
+            && argv[i][6] == 'b' && argv[i][7] == 'l'
+            && argv[i][8] == 'e' && argv[i][9] == '=') {
+            argv[i] += 10;
+            FIND_ARG(&= ~, true);
+        }
+        else if (i + 1 < argc && !lstrcmpA(argv[i], "-d")) {
+            ++i;
+            FIND_ARG(&= ~, true);
+        }
+        else if (i + 1 < argc && !lstrcmpA(argv[i], "-j")) {
+            if (!parse_size(argv[++i], &options.thread_count) || options.thread_count == 0) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+        }
+        else if ((option_value = arg_value(argv[i], "--jobs=")) != NULL) {
+            if (!parse_size(option_value, &options.thread_count) || options.thread_count == 0) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+        }
+        else if (!lstrcmpA(argv[i], "--count-only")) {
+            if (options.format != TEXT_OUTPUT_FORMAT) {
+                error_messagea("Error: --count-only only works with --format=text\n");
+            }
+            options.count_only = true;
+        }
+        else if ((option_value = arg_value(argv[i], "--match=")) != NULL) {
+            char const *error = set_filter_literal(&filter, option_value);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+            options.filter = &filter;
+        }
+        else if ((option_value = arg_value(argv[i], "--regex=")) != NULL) {
+            char const *error = set_filter_pattern(&filter, option_value);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+            options.filter = &filter;
+        }
+        else if ((option_value = arg_value(argv[i], "--max-count=")) != NULL) {
+            if (!parse_size(option_value, &filter.max_count)) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+            options.filter = &filter;
+        }
+        else if ((option_value = arg_value(argv[i], "--max-total=")) != NULL) {
+            if (!parse_size(option_value, &filter.max_total)) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+            options.filter = &filter;
+        }
+        else if ((option_value = arg_value(argv[i], "--exclude=")) != NULL) {
+            char const *error = add_ignore_pattern(&ignore.excludes, option_value);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+            options.ignore = &ignore;
+        }
+        else if ((option_value = arg_value(argv[i], "--include=")) != NULL) {
+            char const *error = add_ignore_pattern(&ignore.includes, option_value);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+            options.ignore = &ignore;
+        }
+        else if (!lstrcmpA(argv[i], "--ignore-files")) {
+            ignore.read_ignore_files = true;
+            options.ignore = &ignore;
+        }
+        else if ((option_value = arg_value(argv[i], "--max-file-size=")) != NULL) {
+            size_t max_file_size;
+            if (!parse_size(option_value, &max_file_size)) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+            options.max_file_size = max_file_size;
+        }
+        else if ((option_value = arg_value(argv[i], "--oversized=")) != NULL) {
+            if (!lstrcmpA(option_value, "skip")) {
+                options.read_oversized_head = false;
+            }
+            else if (!lstrcmpA(option_value, "head")) {
+                options.read_oversized_head = true;
+            }
+            else {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+        }
+        else if (!lstrcmpA(argv[i], "--binary")) {
+            options.read_binary = true;
+        }
+        else if (!lstrcmpA(argv[i], "--skip-report")) {
+            keep_skip_report = true;
+        }
+        else if (!lstrcmpA(argv[i], "--metrics")) {
+            if (read_input) {
+                error_messagea("Error: --metrics has to come before the files\n");
+            }
+            if (options.format == BINARY_OUTPUT_FORMAT) {
+                error_messagea("Error: --metrics does not work with --format=binary\n");
+            }
+            options.metrics = true;
+        }
+        else if ((option_value = arg_value(argv[i], "--format=")) != NULL) {
+            output_format format;
+            if (!lstrcmpA(option_value, "text")) {
+                format = TEXT_OUTPUT_FORMAT;
+            }
+            else if (!lstrcmpA(option_value, "jsonl")) {
+                format = JSON_LINES_OUTPUT_FORMAT;
+            }
+            else if (!lstrcmpA(option_value, "binary")) {
+                format = BINARY_OUTPUT_FORMAT;
+            }
+            else if (!lstrcmpA(option_value, "csv")) {
+                format = CSV_OUTPUT_FORMAT;
+            }
+            else {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+            if ((format == CSV_OUTPUT_FORMAT && !options.metrics) || (format == BINARY_OUTPUT_FORMAT && options.metrics)) {
+                error_messagea("Error: --format=csv only works with --metrics and --format=binary only without it, --metrics has to come first\n");
+            }
+
+            /* NOTE: the binary header has to be the first thing written so the format can not change once something was read or once it is binary */
+            if ((read_input || options.format == BINARY_OUTPUT_FORMAT) && format != options.format) {
+                error_messagea("Error: --format has to come before the files\n");
+            }
+            if (options.count_only && format != TEXT_OUTPUT_FORMAT) {
+                error_messagea("Error: --count-only only works with --format=text\n");
+            }
+            if (format == BINARY_OUTPUT_FORMAT && options.format != BINARY_OUTPUT_FORMAT) {
+                output_binary_header(&output);
+            }
+            if (format == CSV_OUTPUT_FORMAT && options.format != CSV_OUTPUT_FORMAT) {
+                output_csv_header(&output);
+            }
+            options.format = format;
+        }
+        else if ((option_value = arg_value(argv[i], "--cache=")) != NULL) {
+            /* NOTE: the files that were already read are not in the cache */
+            if (options.cache != NULL || read_input) {
+                error_messagea("Error: --cache can only be given once and has to come before the files\n");
+            }
+
+            static result_cache cache;
+            char const *error = cache_open(&cache, option_value);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+            options.cache = &cache;
+        }
+        else if (!lstrcmpA(argv[i], "--stats")) {
+            if (read_input) {
+                error_messagea("Error: --stats has to come before the files\n");
+            }
+            stats_start(true, NULL);
+        }
+        else if ((option_value = arg_value(argv[i], "--trace=")) != NULL) {
+            if (read_input) {
+                error_messagea("Error: --trace has to come before the files\n");
+            }
+            if (!stats_start(false, option_value)) {
+                error_messagea("Error: could not create the trace \"", option_value, "\"");
+            }
+        }
+        else if ((option_value = arg_value(argv[i], "--language-map=")) != NULL) {
+            char const *error = read_language_map(option_value, &languages);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+        }
+        else if ((option_value = arg_value(argv[i], "--languages=")) != NULL) {
+            /* NOTE: the tables of the languages are built again so no file can be read with an older one */
+            if (read_input) {
+                error_messagea("Error: --languages has to come before the files\n");
+            }
+
+            char const *language_name;
+            char const *error = read_language_definitions(option_value, &languages, &language_name);
+            if (error != NULL && language_name != NULL) {
+                error_messagea("Error: ", error, " in the language ", language_name, " of \"", option_value, "\"");
+            }
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+        }
+        else if (!lstrcmpA(argv[i], "--map")) {
+            options.map_files = true;
+        }
+        else if (!lstrcmpA(argv[i], "--no_map")) {
+            options.map_files = false;
+        }
+        else if (i + 1 < argc && !lstrcmpA(argv[i], "-b")) {
+            size_t buffer_size;
+            if (!parse_size(argv[++i], &buffer_size)) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+            output_set_capacity(&output, buffer_size);
+        }
+        else if ((option_value = arg_value(argv[i], "--buffer_size=")) != NULL) {
+            size_t buffer_size;
+            if (!parse_size(option_value, &buffer_size)) {
+                error_messagea("Error: invalid arguments\n", help_message);
+            }
+            output_set_capacity(&output, buffer_size);
+        }
+        else if ((option_value = arg_value(argv[i], "--git-dir=")) != NULL) {
+            if (repository_open) {
+                close_git_repository(&repository);
+                repository_open = false;
+            }
+            git_dir = option_value;
+        }
+        else if ((option_value = arg_value(argv[i], "--git-rev=")) != NULL) {
+            if (!repository_open) {
+                path_builder found = { 0 };
+                if (git_dir == NULL && !find_git_directory(&found)) {
+                    error_messagea("Error: the current directory is not in a git repository, --git-dir has to be given\n");
+                }
+                char const *error = open_git_repository(&repository, git_dir != NULL ? git_dir : found.data);
+                if (error != NULL) {
+                    error_messagea("Error: ", error, " \"", git_dir != NULL ? git_dir : found.data, "\"");
+                }
+                path_free(&found);
+                repository_open = true;
+            }
+            read_comments_in_git_rev(&repository, option_value, &options, walker_thread_count(&options));
+            read_input = true;
+        }
+        else if ((option_value = arg_value(argv[i], "--archive=")) != NULL) {
+            read_comments_in_archive(option_value, &options, walker_thread_count(&options));
+            read_input = true;
+        }
+        else if (!lstrcmpiA(argv[i], "--help")) {
+            output_write(&output, help_message, lstrlenA(help_message));
+        }
+        else if (!lstrcmpA(argv[i], "-")) {
+            print_stdin_comments(&options);
+            read_input = true;
+        }
+        else if ((option_value = file_list_arg(argv[i])) != NULL) {
+            file_list list;
+            char const *error = read_file_list(option_value, &list);
+            if (error != NULL) {
+                error_messagea("Error: ", error, " \"", option_value, "\"");
+            }
+
+            if (walker_thread_count(&options) > 1) {
+                read_comments_in_list_parallel(&list, &options, recursive_directory_search, options.thread_count);
+            }
+            else {
+                read_comments_in_list(&list, &options, recursive_directory_search);
+            }
+            free_file_list(&list);
+            read_input = true;
+        }
+        else if (((file_type = GetFileAttributesA(argv[i])) & ~FILE_ATTRIBUTE_DIRECTORY) && file_type != INVALID_FILE_ATTRIBUTES) {
+            print_file_comments(argv[i], NULL, &options);
+            read_input = true;
+        }
+        else if (file_type != INVALID_FILE_ATTRIBUTES && (file_type & FILE_ATTRIBUTE_DIRECTORY)) {
+            if (walker_thread_count(&options) > 1) {
+                read_comments_in_directory_parallel(argv[i], &options, recursive_directory_search, options.thread_count);
+            }
+            else if (recursive_directory_search) {
+                read_comments_in_directory(argv[i], &options);
+            }
+            else {
+                read_comments_in_directory_non_recursive(argv[i], &options);
+            }
+            read_input = true;
+        }
+        else {
+            error_messagea("Error: invalid arguments\n", help_message);
+        }
+    }
+
+    /* with no files to read, read what is piped in */
+    if (!read_input && GetFileType(GetStdHandle(STD_INPUT_HANDLE)) == FILE_TYPE_PIPE) {
+        print_stdin_comments(&options);
+    }
+
+    if (options.metrics) {
+        finish_metrics(options.format);
+    }
+    else if (options.count_only) {
+        output_write(&output, "total: \r\n", 9);
+        output_write(&output, "files: ", 7);
+        output_number(&output, totals.file_count);
+        output_write(&output, "\r\n", 2);
+        output_comment_count(&output, totals.comment_mode, totals.count);
+    }
+
+    if (options.cache != NULL && !cache_close(options.cache)) {
+        error_messagea("Error: could not write to the cache \"", options.cache->path, "\"");
+    }
+
+    /* cleanup */
+    if (repository_open) {
+        close_git_repository(&repository);
+    }
+    free_git_blobs();
+    LocalFree(argv - 1);
+    flush_stdout();
+    if (keep_skip_report) {
+        write_skip_report(stderr);
+    }
+    stats_finish(stderr);
+
+    ExitProcess(0);
 }
\ No newline at end of file
@@ -0,0 +1,787 @@
+/* finds the comments of a buffer that is already in memory, this is what comments.exe is built on
+ * and it can be included on its own by anything else that wants the comments of some source code, an editor or an indexer for example
+ * NOTE: nothing in here does any i/o or keeps any state between calls besides the choice of the simd kernels in scan.c,
+ * one comment_extractor can be used by any number of threads at the same time
+ */
+
+#include <windows.h>
+#include <stdbool.h>
+
+#include "scan.c"
+#include "lexer.c"
+
+/* a comment that was found in the buffer */
+typedef struct comment_span
+{
+    comment_kind kind;
+
+    /* the offsets of the first byte of the comment and one past its last byte including the delimiters,
+     * comments that end at the end of a line stop before the new line
+     */
+    size_t begin;
+    size_t end;
+
+    /* the lines the comment starts and ends on, the first line is 1 */
+    size_t begin_line;
+    size_t end_line;
+} comment_span;
+
+/* called for every comment in the order they are in the buffer */
+typedef void comment_callback(void *context, comment_span const *span);
+
+/* the lexer table of one comment_display mode or of one defined language */
+typedef struct comment_extractor
+{
+    lexer_table *table;
+} comment_extractor;
+
+/* returns false when there was not enough memory
+ * NOTE: comment_mode can not be AUTO_COMMENT_DISPLAY, get_comment_mode and sniff_comment_mode pick the mode of a file
+ */
+static bool comment_extractor_init(comment_extractor *extractor, comment_display comment_mode)
+{
+    init_scanner();
+
+    extractor->table = HeapAlloc(GetProcessHeap(), 0, sizeof(lexer_table));
+    if (extractor->table == NULL) {
+        return false;
+    }
+    build_lexer_table(extractor->table, comment_mode & (AUTO_COMMENT_DISPLAY - 1));
+    return true;
+}
+
+static void comment_extractor_free(comment_extractor *extractor)
+{
+    HeapFree(GetProcessHeap(), 0, extractor->table);
+    extractor->table = NULL;
+}
+
+/* the same as comment_extractor_init for a defined language, returns a description of what went wrong or NULL on success */
+static char const *comment_extractor_init_language(comment_extractor *extractor, language_definition const *language)
+{
+    init_scanner();
+
+    extractor->table = HeapAlloc(GetProcessHeap(), 0, sizeof(lexer_table));
+    if (extractor->table == NULL) {
+        return "could not allocate memory for the lexer";
+    }
+
+    char const *error = build_language_table(extractor->table, language);
+    if (error != NULL) {
+        comment_extractor_free(extractor);
+    }
+    return error;
+}
+
+/* the state of one call to extract_comments */
+typedef struct span_collector
+{
+    comment_callback *callback;
+    void *context;
+    comment_span span;
+} span_collector;
+
+static void collect_span_begin(void *context, comment_kind kind, ULONGLONG begin, size_t line, size_t column)
+{
+    (void)column;
+    span_collector *collector = context;
+    collector->span = (comment_span) { .kind = kind, .begin = (size_t)begin, .begin_line = line };
+}
+
+static void collect_span_text(void *context, char const *text, size_t size)
+{
+    (void)context;
+    (void)text;
+    (void)size;
+}
+
+static void collect_span_line_end(void *context, size_t line)
+{
+    (void)context;
+    (void)line;
+}
+
+static void collect_span_end(void *context, ULONGLONG end, size_t line)
+{
+    span_collector *collector = context;
+    collector->span.end = (size_t)end;
+    collector->span.end_line = line;
+    collector->callback(collector->context, &collector->span);
+}
+
+static comment_sink const span_sink = {
+    .begin = collect_span_begin,
+    .text = collect_span_text,
+    .line_end = collect_span_line_end,
+    .end = collect_span_end
+};
+
+/* calls callback with every comment of the mode of the extractor in str, returns false when there was not enough memory
+ * NOTE: str does not need to be null terminated, a null byte is still treated as the end of the input
+ */
+static bool extract_comments(comment_extractor const *extractor, char const *str, size_t size, comment_callback *callback, void *context)
+{
+    span_collector collector = { .callback = callback, .context = context };
+
+    comment_lexer lexer;
+    lexer_init(&lexer, extractor->table, &span_sink, &collector, true);
+    bool result = lexer_feed(&lexer, str, size);
+    lexer_finish(&lexer);
+    return result;
+}
+
+/* extensions longer than this are never looked up, the dot is not part of it */
+#define MAX_EXTENSION_SIZE 15
+
+typedef struct language_extension
+{
+    /* lowercase and null terminated, an empty extension is a free slot */
+    char extension[MAX_EXTENSION_SIZE + 1];
+    comment_display comment_mode;
+} language_extension;
+
+/* extensions that are added to or replace the built in ones, see language_map_add
+ * NOTE: this is an open addressing hash table whose capacity is a power of two
+ */
+typedef struct language_map
+{
+    language_extension *entries;
+    size_t capacity;
+    size_t count;
+} language_map;
+
+static DWORD extension_hash(char const *extension, size_t size)
+{
+    DWORD hash = 0;
+    for (size_t i = 0; i < size; ++i) {
+        hash = hash * 31 + (unsigned char)extension[i];
+    }
+    return hash;
+}
+
+/* the built in extensions are in a perfect hash table, the slot of an extension is the top 5 bits of its hash times
+ * EXTENSION_HASH_MULTIPLIER and no two extensions share a slot so a lookup is one hash and one compare
+ * NOTE: the multiplier was found by trying random odd numbers until the extensions below did not collide,
+ * adding an extension means finding a new one or using a language map instead
+ */
+#define EXTENSION_HASH_MULTIPLIER 0xd4620a8bu
+#define EXTENSION_TABLE_BITS 5
+
+static language_extension const builtin_extensions[1 << EXTENSION_TABLE_BITS] = {
+    [0] = { "hpp", C_AND_CC_COMMENT_DISPLAY },
+    [1] = { "cxx", C_AND_CC_COMMENT_DISPLAY },
+    [2] = { "go", C_AND_CC_COMMENT_DISPLAY },
+    [4] = { "c", C_AND_CC_COMMENT_DISPLAY },
+    [5] = { "cu", C_AND_CC_COMMENT_DISPLAY },
+    [6] = { "h++", C_AND_CC_COMMENT_DISPLAY },
+    [7] = { "cc", C_AND_CC_COMMENT_DISPLAY },
+    [8] = { "h", C_AND_CC_COMMENT_DISPLAY },
+    [9] = { "rs", RUST_COMMENT_DISPLAY },
+    [10] = { "java", C_AND_CC_COMMENT_DISPLAY },
+    [12] = { "hxx", C_AND_CC_COMMENT_DISPLAY },
+    [13] = { "s", ASM_COMMENT_DISPLAY },
+    [16] = { "cs", C_AND_CC_COMMENT_DISPLAY },
+    [20] = { "cuh", C_AND_CC_COMMENT_DISPLAY },
+    [21] = { "cpp", C_AND_CC_COMMENT_DISPLAY },
+    [25] = { "asm", ASM_COMMENT_DISPLAY },
+    [26] = { "py", PYTHON_COMMENT_DISPLAY },
+    [27] = { "c++", C_AND_CC_COMMENT_DISPLAY },
+    [31] = { "hh", C_AND_CC_COMMENT_DISPLAY }
+};
+
+static bool extension_equals(char const *extension, char const *lowercase, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (extension[i] != lowercase[i]) return false;
+    }
+    return extension[size] == '\0';
+}
+
+static char lowercase_char(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static language_extension const *language_map_find(language_map const *map, char const *extension, size_t size, DWORD hash)
+{
+    size_t const mask = map->capacity - 1;
+    for (size_t i = (hash * 0x9e3779b1u) & mask; map->entries[i].extension[0] != '\0'; i = (i + 1) & mask) {
+        if (extension_equals(map->entries[i].extension, extension, size)) {
+            return &map->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* maps extension with or without its dot to comment_mode, returns false when it is too long or there is not enough memory */
+static bool language_map_add(language_map *map, char const *extension, size_t size, comment_display comment_mode)
+{
+    if (size != 0 && extension[0] == '.') {
+        ++extension;
+        --size;
+    }
+    if (size == 0 || size > MAX_EXTENSION_SIZE) {
+        return false;
+    }
+
+    char lowercase[MAX_EXTENSION_SIZE + 1];
+    for (size_t i = 0; i < size; ++i) {
+        lowercase[i] = lowercase_char(extension[i]);
+    }
+    lowercase[size] = '\0';
+
+    /* keep the table at most half full */
+    if ((map->count + 1) * 2 > map->capacity) {
+        language_map grown = { .capacity = map->capacity == 0 ? 16 : map->capacity * 2 };
+        grown.entries = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(language_extension) * grown.capacity);
+        if (grown.entries == NULL) {
+            return false;
+        }
+
+        for (size_t i = 0; i < map->capacity; ++i) {
+            language_extension const *entry = &map->entries[i];
+            if (entry->extension[0] != '\0') {
+                size_t entry_size = lstrlenA(entry->extension);
+                size_t j = (extension_hash(entry->extension, entry_size) * 0x9e3779b1u) & (grown.capacity - 1);
+                while (grown.entries[j].extension[0] != '\0') {
+                    j = (j + 1) & (grown.capacity - 1);
+                }
+                grown.entries[j] = *entry;
+            }
+        }
+
+        grown.count = map->count;
+        if (map->entries != NULL) {
+            HeapFree(GetProcessHeap(), 0, map->entries);
+        }
+        *map = grown;
+    }
+
+    DWORD const hash = extension_hash(lowercase, size);
+    language_extension *entry = (language_extension *)language_map_find(map, lowercase, size, hash);
+    if (entry == NULL) {
+        size_t const mask = map->capacity - 1;
+        size_t i = (hash * 0x9e3779b1u) & mask;
+        while (map->entries[i].extension[0] != '\0') {
+            i = (i + 1) & mask;
+        }
+        entry = &map->entries[i];
+        for (size_t j = 0; j <= size; ++j) {
+            entry->extension[j] = lowercase[j];
+        }
+        ++map->count;
+    }
+    entry->comment_mode = comment_mode;
+    return true;
+}
+
+static void language_map_free(language_map *map)
+{
+    if (map->entries != NULL) {
+        HeapFree(GetProcessHeap(), 0, map->entries);
+    }
+    *map = (language_map) { 0 };
+}
+
+/* picks the comment mode of path from its extension, map can be NULL and its extensions come before the built in ones
+ * returns AUTO_COMMENT_DISPLAY for a path without an extension, sniff_comment_mode picks the mode of those from their contents
+ */
+static comment_display get_comment_mode(language_map const *map, char const *path)
+{
+    /* the extension is what comes after the last dot of the file name, dots in directory names do not count */
+    char const *extension = NULL;
+    char const *pos = path;
+    for (; *pos != '\0'; ++pos) {
+        if (*pos == '.') {
+            extension = pos + 1;
+        }
+        else if (*pos == '\\' || *pos == '/') {
+            extension = NULL;
+        }
+    }
+
+    if (extension == NULL) {
+        return AUTO_COMMENT_DISPLAY;
+    }
+
+    size_t const size = (size_t)(pos - extension);
+    if (size > MAX_EXTENSION_SIZE) {
+        return NO_COMMENT_DISPLAY;
+    }
+
+    char lowercase[MAX_EXTENSION_SIZE + 1];
+    for (size_t i = 0; i < size; ++i) {
+        lowercase[i] = lowercase_char(extension[i]);
+    }
+
+    DWORD const hash = extension_hash(lowercase, size);
+    if (map != NULL && map->count != 0) {
+        language_extension const *entry = language_map_find(map, lowercase, size, hash);
+        if (entry != NULL) {
+            return entry->comment_mode;
+        }
+    }
+
+    language_extension const *entry = &builtin_extensions[(DWORD)(hash * EXTENSION_HASH_MULTIPLIER) >> (32 - EXTENSION_TABLE_BITS)];
+    return extension_equals(entry->extension, lowercase, size) ? entry->comment_mode : NO_COMMENT_DISPLAY;
+}
+
+/* the languages that a #! line or a modeline can name, languages with # comments are read as python */
+static language_extension const sniffed_languages[] = {
+    { "c", C_AND_CC_COMMENT_DISPLAY },
+    { "cpp", C_AND_CC_COMMENT_DISPLAY },
+    { "c++", C_AND_CC_COMMENT_DISPLAY },
+    { "cuda", C_AND_CC_COMMENT_DISPLAY },
+    { "java", C_AND_CC_COMMENT_DISPLAY },
+    { "cs", C_AND_CC_COMMENT_DISPLAY },
+    { "go", C_AND_CC_COMMENT_DISPLAY },
+    { "rust", RUST_COMMENT_DISPLAY },
+    { "asm", ASM_COMMENT_DISPLAY },
+    { "nasm", ASM_COMMENT_DISPLAY },
+    { "masm", ASM_COMMENT_DISPLAY },
+    { "python", PYTHON_COMMENT_DISPLAY },
+    { "sh", PYTHON_COMMENT_DISPLAY },
+    { "bash", PYTHON_COMMENT_DISPLAY },
+    { "zsh", PYTHON_COMMENT_DISPLAY },
+    { "perl", PYTHON_COMMENT_DISPLAY },
+    { "ruby", PYTHON_COMMENT_DISPLAY }
+};
+
+/* returns the mode of the language named at the start of [pos, end) or NO_COMMENT_DISPLAY,
+ * a version after the name like the 3 of python3 is ignored
+ */
+static comment_display sniffed_language(char const *pos, char const *end)
+{
+    char name[MAX_EXTENSION_SIZE + 1];
+    size_t size = 0;
+    for (; pos < end && size < MAX_EXTENSION_SIZE; ++pos) {
+        char c = lowercase_char(*pos);
+        if (!((c >= 'a' && c <= 'z') || c == '+')) break;
+        name[size++] = c;
+    }
+
+    for (size_t i = 0; i < sizeof(sniffed_languages) / sizeof(sniffed_languages[0]); ++i) {
+        if (extension_equals(sniffed_languages[i].extension, name, size)) {
+            return sniffed_languages[i].comment_mode;
+        }
+    }
+    return NO_COMMENT_DISPLAY;
+}
+
+/* returns where needle starts in [pos, end) or NULL */
+static char const *find_text(char const *pos, char const *end, char const *needle)
+{
+    size_t const size = lstrlenA(needle);
+    for (; (size_t)(end - pos) >= size; ++pos) {
+        size_t i = 0;
+        while (i < size && pos[i] == needle[i]) {
+            ++i;
+        }
+        if (i == size) return pos;
+    }
+    return NULL;
+}
+
+static char const *skip_spaces(char const *pos, char const *end)
+{
+    while (pos < end && (*pos == ' ' || *pos == '\t')) {
+        ++pos;
+    }
+    return pos;
+}
+
+/* the interpreter of a #! line, /usr/bin/env is skipped along with its options */
+static comment_display sniff_interpreter(char const *pos, char const *end)
+{
+    for (;;) {
+        pos = skip_spaces(pos, end);
+        char const *word = pos;
+        while (pos < end && *pos != ' ' && *pos != '\t') {
+            if (*pos == '/') {
+                word = pos + 1;
+            }
+            ++pos;
+        }
+
+        if (pos == word) {
+            return NO_COMMENT_DISPLAY;
+        }
+        if (word[0] == '-' || ((size_t)(pos - word) == 3 && word[0] == 'e' && word[1] == 'n' && word[2] == 'v')) {
+            continue;
+        }
+        return sniffed_language(word, pos);
+    }
+}
+
+/* a vim modeline like vim: set ft=c: or an emacs one like -*- mode: python -*- */
+static comment_display sniff_modeline(char const *line, char const *end)
+{
+    char const *vim = find_text(line, end, "vim:");
+    if (vim == NULL) {
+        vim = find_text(line, end, "vi:");
+    }
+    if (vim != NULL) {
+        static char const *const settings[] = { "ft=", "filetype=", "syntax=" };
+        for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); ++i) {
+            char const *setting = find_text(vim, end, settings[i]);
+            if (setting != NULL) {
+                return sniffed_language(setting + lstrlenA(settings[i]), end);
+            }
+        }
+    }
+
+    char const *emacs = find_text(line, end, "-*-");
+    if (emacs != NULL) {
+        char const *emacs_end = find_text(emacs + 3, end, "-*-");
+        if (emacs_end == NULL) {
+            return NO_COMMENT_DISPLAY;
+        }
+
+        char const *mode = find_text(emacs + 3, emacs_end, "mode:");
+        return sniffed_language(skip_spaces(mode == NULL ? emacs + 3 : mode + 5, emacs_end), emacs_end);
+    }
+    return NO_COMMENT_DISPLAY;
+}
+
+/* modelines are only looked for in this many bytes at the start and at the end of the contents */
+#define SNIFF_SIZE 512
+
+/* picks the mode of contents that came without an extension from a #! line or a modeline,
+ * when neither names a language it is taken to be c or c++
+ */
+static comment_display sniff_comment_mode(char const *str, size_t size)
+{
+    char const *const end = str + size;
+
+    if (size > 2 && str[0] == '#' && str[1] == '!') {
+        char const *line_end = str + 2;
+        while (line_end < end && *line_end != '\n' && *line_end != '\r') {
+            ++line_end;
+        }
+        comment_display comment_mode = sniff_interpreter(str + 2, line_end);
+        if (comment_mode != NO_COMMENT_DISPLAY) {
+            return comment_mode;
+        }
+    }
+
+    char const *const head_end = size > SNIFF_SIZE ? str + SNIFF_SIZE : end;
+    char const *const tail = size > SNIFF_SIZE * 2 ? end - SNIFF_SIZE : head_end;
+    char const *const windows[2][2] = { { str, head_end }, { tail, end } };
+    for (size_t i = 0; i < 2; ++i) {
+        for (char const *line = windows[i][0]; line < windows[i][1]; ) {
+            char const *line_end = line;
+            while (line_end < windows[i][1] && *line_end != '\n') {
+                ++line_end;
+            }
+
+            comment_display comment_mode = sniff_modeline(line, line_end);
+            if (comment_mode != NO_COMMENT_DISPLAY) {
+                return comment_mode;
+            }
+            line = line_end + 1;
+        }
+    }
+
+    return C_AND_CC_COMMENT_DISPLAY;
+}
+
+/* the languages that are defined by text like the built in definitions below, a language is picked by its name
+ * or by one of its extensions with the mode DEFINED_LANGUAGE_MODE of its index
+ */
+#define MAX_DEFINED_LANGUAGES 64
+#define MAX_DEFINITION_WORDS 32
+
+typedef struct language_list
+{
+    language_definition languages[MAX_DEFINED_LANGUAGES];
+    size_t count;
+} language_list;
+
+/* the languages every comments.exe knows besides the built in modes, a definitions file can add to them or replace them */
+static char const builtin_language_definitions[] =
+    "language sh\n"
+    "extensions sh bash zsh ksh\n"
+    "line #\n"
+    "string \" \" \\\n"
+    "string ' '\n"
+    "\n"
+    "language perl\n"
+    "extensions pl pm\n"
+    "line #\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "\n"
+    "language ruby\n"
+    "extensions rb\n"
+    "line #\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "\n"
+    "language r\n"
+    "extensions r\n"
+    "line #\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "\n"
+    "language yaml\n"
+    "extensions yml yaml\n"
+    "line #\n"
+    "string \" \" \\\n"
+    "\n"
+    "language toml\n"
+    "extensions toml\n"
+    "line #\n"
+    "string \"\"\" \"\"\" \\\n"
+    "string \" \" \\\n"
+    "string ''' '''\n"
+    "string ' '\n"
+    "\n"
+    "language make\n"
+    "extensions mk mak\n"
+    "line #\n"
+    "\n"
+    "language cmake\n"
+    "extensions cmake\n"
+    "line #\n"
+    "block #[[ ]]\n"
+    "string \" \" \\\n"
+    "\n"
+    "language powershell\n"
+    "extensions ps1 psm1 psd1\n"
+    "line #\n"
+    "block <# #>\n"
+    "string \" \" `\n"
+    "string ' '\n"
+    "\n"
+    "language sql\n"
+    "extensions sql\n"
+    "line --\n"
+    "block /* */\n"
+    "string ' '\n"
+    "string \" \"\n"
+    "\n"
+    "language lua\n"
+    "extensions lua\n"
+    "line --\n"
+    "block --[[ ]]\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "string [[ ]]\n"
+    "\n"
+    "language haskell\n"
+    "extensions hs\n"
+    "line --\n"
+    "nested {- -}\n"
+    "string \" \" \\\n"
+    "\n"
+    "language elm\n"
+    "extensions elm\n"
+    "line --\n"
+    "nested {- -}\n"
+    "string \" \" \\\n"
+    "\n"
+    "language html\n"
+    "extensions html htm xhtml xml svg\n"
+    "block <!-- -->\n"
+    "\n"
+    "language css\n"
+    "extensions css\n"
+    "block /* */\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "\n"
+    "language javascript\n"
+    "extensions js mjs cjs jsx ts mts cts tsx\n"
+    "line //\n"
+    "block /* */\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "string ` ` \\\n"
+    "\n"
+    "language php\n"
+    "extensions php\n"
+    "line //\n"
+    "line #\n"
+    "block /* */\n"
+    "string \" \" \\\n"
+    "string ' ' \\\n"
+    "\n"
+    "language lisp\n"
+    "extensions lisp lsp el scm ss rkt\n"
+    "line ;\n"
+    "nested #| |#\n"
+    "string \" \" \\\n"
+    "\n"
+    "language erlang\n"
+    "extensions erl hrl\n"
+    "line %\n"
+    "string \" \" \\\n"
+    "\n"
+    "language ocaml\n"
+    "extensions ml mli\n"
+    "nested (* *)\n"
+    "string \" \" \\\n"
+    "\n"
+    "language pascal\n"
+    "extensions pas pp dpr\n"
+    "line //\n"
+    "block { }\n"
+    "block (* *)\n"
+    "string ' '\n";
+
+/* copies a delimiter from the definitions, returns false if it is too long */
+static bool copy_delimiter(char *destination, unsigned char *destination_size, char const *word, size_t size)
+{
+    if (size > MAX_DELIMITER_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        destination[i] = word[i];
+    }
+    *destination_size = (unsigned char)size;
+    return true;
+}
+
+/* adds the languages of definitions like the built in ones to list and their extensions to map, every line is a keyword and
+ * its words and lines that start with # are ignored:
+ *     language name           starts a language or replaces the one with that name
+ *     extensions ext ...      the files of the language
+ *     line open               a comment that ends at the end of the line
+ *     block open close        a comment that ends with close
+ *     nested open close       the same but it can have comments of the same kind inside of it
+ *     string open close [esc] a string whose delimiters are not looked for in it, the byte after esc is always part of it
+ * NOTE: the languages are not compiled here, build_language_table has to be called for them
+ * returns a description of what went wrong or NULL on success
+ */
+static char const *parse_language_definitions(char const *str, size_t size, language_list *list, language_map *map)
+{
+    language_definition *language = NULL;
+    size_t language_index = 0;
+
+    char const *pos = str;
+    char const *const end = str + size;
+    while (pos < end) {
+        char const *line_end = pos;
+        while (line_end < end && *line_end != '\n') {
+            ++line_end;
+        }
+
+        /* split the line into words, the first one is the keyword */
+        char const *words[MAX_DEFINITION_WORDS];
+        size_t sizes[MAX_DEFINITION_WORDS];
+        size_t word_count = 0;
+        for (char const *word = pos; word < line_end; ) {
+            while (word < line_end && (*word == ' ' || *word == '\t' || *word == '\r')) {
+                ++word;
+            }
+            if (word == line_end || (word_count == 0 && *word == '#')) break;
+            if (word_count == MAX_DEFINITION_WORDS) {
+                return "too many words on a line of the language definitions";
+            }
+
+            char const *word_end = word;
+            while (word_end < line_end && *word_end != ' ' && *word_end != '\t' && *word_end != '\r') {
+                ++word_end;
+            }
+            words[word_count] = word;
+            sizes[word_count++] = (size_t)(word_end - word);
+            word = word_end;
+        }
+        pos = line_end + 1;
+        if (word_count == 0) continue;
+
+        char keyword[16];
+        if (sizes[0] >= sizeof(keyword)) {
+            return "unknown keyword in the language definitions";
+        }
+        for (size_t i = 0; i < sizes[0]; ++i) {
+            keyword[i] = words[0][i];
+        }
+        keyword[sizes[0]] = '\0';
+
+        if (!lstrcmpA(keyword, "language")) {
+            if (word_count != 2 || sizes[1] > MAX_LANGUAGE_NAME_SIZE) {
+                return "invalid language name in the language definitions";
+            }
+
+            for (language_index = 0; language_index < list->count; ++language_index) {
+                if (extension_equals(list->languages[language_index].name, words[1], sizes[1])) break;
+            }
+            if (language_index == MAX_DEFINED_LANGUAGES) {
+                return "too many languages in the language definitions";
+            }
+            if (language_index == list->count) {
+                ++list->count;
+            }
+
+            language = &list->languages[language_index];
+            for (size_t i = 0; i < sizes[1]; ++i) {
+                language->name[i] = words[1][i];
+            }
+            language->name[sizes[1]] = '\0';
+            language->delimiter_count = 0;
+            continue;
+        }
+
+        if (language == NULL) {
+            return "the language definitions have to start with a language";
+        }
+
+        if (!lstrcmpA(keyword, "extensions")) {
+            for (size_t i = 1; i < word_count; ++i) {
+                if (!language_map_add(map, words[i], sizes[i], DEFINED_LANGUAGE_MODE(language_index))) {
+                    return "invalid extension in the language definitions";
+                }
+            }
+            continue;
+        }
+
+        language_delimiter delimiter = { 0 };
+        size_t word_counts[2];
+        if (!lstrcmpA(keyword, "line")) {
+            delimiter.type = LINE_COMMENT_DELIMITER;
+            word_counts[0] = word_counts[1] = 2;
+        }
+        else if (!lstrcmpA(keyword, "block")) {
+            delimiter.type = BLOCK_COMMENT_DELIMITER;
+            word_counts[0] = word_counts[1] = 3;
+        }
+        else if (!lstrcmpA(keyword, "nested")) {
+            delimiter.type = NESTED_COMMENT_DELIMITER;
+            word_counts[0] = word_counts[1] = 3;
+        }
+        else if (!lstrcmpA(keyword, "string")) {
+            delimiter.type = STRING_DELIMITER;
+            word_counts[0] = 3;
+            word_counts[1] = 4;
+        }
+        else {
+            return "unknown keyword in the language definitions";
+        }
+
+        if (word_count < word_counts[0] || word_count > word_counts[1]) {
+            return "invalid delimiter in the language definitions";
+        }
+        if (!copy_delimiter(delimiter.opener, &delimiter.opener_size, words[1], sizes[1])
+            || (word_count > 2 && !copy_delimiter(delimiter.closer, &delimiter.closer_size, words[2], sizes[2]))) {
+            return "a delimiter in the language definitions is too long";
+        }
+        if (word_count > 3) {
+            bool in_closer = false;
+            for (size_t i = 0; i < delimiter.closer_size; ++i) {
+                in_closer |= delimiter.closer[i] == words[3][0];
+            }
+            if (sizes[3] != 1 || in_closer) {
+                return "the escape of a string has to be one byte that is not part of its closer";
+            }
+            delimiter.escape = words[3][0];
+        }
+
+        if (language->delimiter_count == MAX_LANGUAGE_DELIMITERS) {
+            return "a language has too many delimiters in the language definitions";
+        }
+        language->delimiters[language->delimiter_count++] = delimiter;
+    }
+
+    return NULL;
+}
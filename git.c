@@ -0,0 +1,1121 @@
+/* --git-rev, reading the trees and blobs of a revision straight from the object database of a git repository
+ * so a commit can be scanned without checking it out, an object is either a loose file that is one zlib stream
+ * or in a pack where most objects are a delta against another object of the pack
+ * the packs are mapped and their .idx files are searched for the ids, a thread keeps the bases of the last deltas
+ * it resolved since the objects of a tree are often deltas against the same few bases
+ * NOTE: only repositories with sha-1 object ids are read, alternates and the commit graph are not looked at
+ */
+
+#define GIT_OID_SIZE 20
+#define GIT_HEX_SIZE 40
+
+/* git packs never make chains this long, a longer one is a pack that refers back to itself */
+#define GIT_MAX_DELTA_DEPTH 10000
+
+typedef enum git_object_type
+{
+    GIT_NO_OBJECT = 0,
+    GIT_COMMIT = 1,
+    GIT_TREE = 2,
+    GIT_BLOB = 3,
+    GIT_TAG = 4,
+
+    /* only in packs, the data is a delta against an object earlier in the pack or against the object with an id */
+    GIT_OFS_DELTA = 6,
+    GIT_REF_DELTA = 7
+} git_object_type;
+
+/* the modes of the entries of a tree */
+#define GIT_MODE_TYPE_MASK 0170000
+#define GIT_FILE_MODE 0100000
+#define GIT_DIRECTORY_MODE 0040000
+
+typedef struct git_object
+{
+    git_object_type type;
+    char const *data;
+    size_t size;
+
+    /* what is freed, the data of a loose object comes after its header in it */
+    char *buffer;
+} git_object;
+
+typedef struct git_pack
+{
+    input_file index;
+    input_file pack;
+    DWORD object_count;
+
+    /* the tables of a version 2 .idx file, every number in them is big endian */
+    unsigned char const *fanout;
+    unsigned char const *oids;
+    unsigned char const *offsets;
+    unsigned char const *large_offsets;
+    size_t large_offset_count;
+} git_pack;
+
+typedef struct git_repository
+{
+    /* the .git directory and the one with the objects and the refs that the worktrees of a repository share */
+    path_builder git_dir;
+    path_builder common_dir;
+
+    git_pack *packs;
+    size_t pack_count;
+
+    /* the refs that git pack-refs moved out of their files, empty if there is no packed-refs file */
+    input_file packed_refs;
+} git_repository;
+
+/* how many bases a thread keeps and the largest one it keeps */
+#define GIT_BASE_CACHE_SIZE 64
+#define GIT_BASE_CACHE_MAX_OBJECT_SIZE (1 << 19)
+
+typedef struct git_cached_base
+{
+    git_pack const *pack;
+    size_t offset;
+    git_object object;
+} git_cached_base;
+
+/* what one thread keeps between the objects it reads */
+typedef struct git_reader
+{
+    git_repository const *repo;
+    inflater *z;
+    git_cached_base bases[GIT_BASE_CACHE_SIZE];
+} git_reader;
+
+static DWORD read_big_endian(unsigned char const *data)
+{
+    return ((DWORD)data[0] << 24) | ((DWORD)data[1] << 16) | ((DWORD)data[2] << 8) | data[3];
+}
+
+static int hex_digit_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool is_hex(char const *str, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (hex_digit_value(str[i]) < 0) return false;
+    }
+    return true;
+}
+
+/* hex has to be GIT_HEX_SIZE hex digits */
+static void parse_oid(char const *hex, unsigned char *oid)
+{
+    for (size_t i = 0; i < GIT_OID_SIZE; ++i) {
+        oid[i] = (unsigned char)((hex_digit_value(hex[2 * i]) << 4) | hex_digit_value(hex[2 * i + 1]));
+    }
+}
+
+static void format_oid(unsigned char const *oid, char *hex)
+{
+    static char const digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < GIT_OID_SIZE; ++i) {
+        hex[2 * i] = digits[oid[i] >> 4];
+        hex[2 * i + 1] = digits[oid[i] & 15];
+    }
+}
+
+/* compares the start of oid with the size hex digits of a prefix */
+static int compare_oid_prefix(unsigned char const *oid, char const *hex, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        int const digit = (i & 1) ? oid[i / 2] & 15 : oid[i / 2] >> 4;
+        int const other = hex_digit_value(hex[i]);
+        if (digit != other) return digit < other ? -1 : 1;
+    }
+    return 0;
+}
+
+/* the path of a file in directory, returns false when out of memory */
+static bool git_path(path_builder *path, path_builder const *directory, char const *name)
+{
+    path->size = 0;
+    return path_append(path, directory->data, directory->size) && path_append(path, "\\", 1) && path_append(path, name, lstrlenA(name));
+}
+
+/* reads the small text file at path, git writes them with a new line at the end that is taken off */
+static char const *read_git_file(char const *path, input_file *file)
+{
+    char const *error = open_input_file(path, false, file);
+    while (error == NULL && file->size != 0 && (file->data[file->size - 1] == '\n' || file->data[file->size - 1] == '\r')) {
+        --file->size;
+    }
+    return error;
+}
+
+/* sets directory to where a path in a file points to, a relative one is relative to the directory base_size bytes of base */
+static bool set_linked_path(path_builder *directory, char const *base, size_t base_size, char const *link, size_t link_size)
+{
+    bool const absolute = (link_size >= 1 && is_path_separator(link[0])) || (link_size >= 2 && link[1] == ':');
+    directory->size = 0;
+    if (!absolute && (!path_append(directory, base, base_size) || !path_append(directory, "\\", 1))) {
+        return false;
+    }
+    if (!path_append(directory, link, link_size)) {
+        return false;
+    }
+    while (directory->size > 1 && is_path_separator(directory->data[directory->size - 1])) {
+        path_truncate(directory, directory->size - 1);
+    }
+    return true;
+}
+
+static char const *open_git_pack(git_pack *pack, char const *index_path, path_builder *pack_path)
+{
+    *pack = (git_pack) { 0 };
+    char const *error = open_input_file(index_path, true, &pack->index);
+    if (error != NULL) {
+        return error;
+    }
+
+    /* a version 2 index has a magic number, the version, 256 counts of the ids that start with each byte or less, the ids,
+     * a crc of each object, the offsets and then the offsets that do not fit in 31 bits
+     */
+    unsigned char const *data = (unsigned char const *)pack->index.data;
+    size_t const size = pack->index.size;
+    if (size < 8 + 256 * 4 || data[0] != 0xff || data[1] != 't' || data[2] != 'O' || data[3] != 'c' || read_big_endian(data + 4) != 2) {
+        close_input_file(&pack->index);
+        return "is not a version 2 pack index";
+    }
+    pack->fanout = data + 8;
+    pack->object_count = read_big_endian(pack->fanout + 255 * 4);
+    size_t const table_size = (size_t)pack->object_count * (GIT_OID_SIZE + 4 + 4);
+    if (pack->object_count > size / (GIT_OID_SIZE + 4 + 4) || size - (8 + 256 * 4) < table_size) {
+        close_input_file(&pack->index);
+        return "is not a version 2 pack index";
+    }
+    pack->oids = pack->fanout + 256 * 4;
+    pack->offsets = pack->oids + (size_t)pack->object_count * (GIT_OID_SIZE + 4);
+    pack->large_offsets = pack->offsets + (size_t)pack->object_count * 4;
+    pack->large_offset_count = (size - (8 + 256 * 4) - table_size) / 8;
+
+    /* the pack has the same name with .pack instead of .idx */
+    path_truncate(pack_path, pack_path->size - 4);
+    if (!path_append(pack_path, ".pack", 5)) {
+        close_input_file(&pack->index);
+        return "could not allocate memory for a path";
+    }
+    error = open_input_file(pack_path->data, true, &pack->pack);
+    if (error == NULL && (pack->pack.size < 12 || !bytes_equal(pack->pack.data, "PACK", 4))) {
+        close_input_file(&pack->pack);
+        error = "is not a pack";
+    }
+    if (error != NULL) {
+        close_input_file(&pack->index);
+    }
+    return error;
+}
+
+static char const *open_git_packs(git_repository *repo)
+{
+    path_builder path = { 0 };
+    if (!git_path(&path, &repo->common_dir, "objects\\pack\\*.idx")) {
+        return "could not allocate memory for a path";
+    }
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(path.data, &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        /* a repository that was never packed has no pack directory */
+        path_free(&path);
+        return NULL;
+    }
+
+    char const *error = NULL;
+    size_t capacity = 0;
+    do {
+        if (repo->pack_count == capacity) {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            git_pack *packs = repo->packs == NULL
+                ? HeapAlloc(GetProcessHeap(), 0, sizeof(git_pack) * capacity)
+                : HeapReAlloc(GetProcessHeap(), 0, repo->packs, sizeof(git_pack) * capacity);
+            if (packs == NULL) {
+                error = "could not allocate memory for the packs of";
+                break;
+            }
+            repo->packs = packs;
+        }
+
+        if (!git_path(&path, &repo->common_dir, "objects\\pack\\") || !path_append(&path, find_data.cFileName, lstrlenA(find_data.cFileName))) {
+            error = "could not allocate memory for a path";
+            break;
+        }
+        error = open_git_pack(&repo->packs[repo->pack_count], path.data, &path);
+        if (error != NULL) break;
+        ++repo->pack_count;
+    } while (FindNextFileA(find_handle, &find_data));
+
+    FindClose(find_handle);
+    path_free(&path);
+    return error;
+}
+
+static void close_git_repository(git_repository *repo)
+{
+    for (size_t i = 0; i < repo->pack_count; ++i) {
+        close_input_file(&repo->packs[i].index);
+        close_input_file(&repo->packs[i].pack);
+    }
+    HeapFree(GetProcessHeap(), 0, repo->packs);
+    if (repo->packed_refs.data != NULL) {
+        close_input_file(&repo->packed_refs);
+    }
+    path_free(&repo->git_dir);
+    path_free(&repo->common_dir);
+    *repo = (git_repository) { 0 };
+}
+
+/* opens the repository whose .git directory is at path, a .git file of a worktree or a submodule points to the directory,
+ * returns a description of what went wrong or NULL on success
+ */
+static char const *open_git_repository(git_repository *repo, char const *path)
+{
+    *repo = (git_repository) { 0 };
+    size_t const path_size = lstrlenA(path);
+    DWORD const attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return "could not find the git directory";
+    }
+
+    char const *error = NULL;
+    input_file file = { 0 };
+    if (!(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        error = read_git_file(path, &file);
+        if (error != NULL) {
+            return error;
+        }
+        if (file.size < 8 || !bytes_equal(file.data, "gitdir: ", 8)) {
+            close_input_file(&file);
+            return "is not a git directory or a .git file";
+        }
+
+        size_t base_size = path_size;
+        while (base_size != 0 && !is_path_separator(path[base_size - 1])) --base_size;
+        bool const linked = base_size != 0
+            ? set_linked_path(&repo->git_dir, path, base_size - 1, file.data + 8, file.size - 8)
+            : set_linked_path(&repo->git_dir, ".", 1, file.data + 8, file.size - 8);
+        close_input_file(&file);
+        if (!linked) {
+            error = "could not allocate memory for a path";
+        }
+    }
+    else if (!path_append(&repo->git_dir, path, path_size)) {
+        error = "could not allocate memory for a path";
+    }
+
+    /* a worktree has its own HEAD, everything else is in the directory its commondir file points to */
+    path_builder file_path = { 0 };
+    if (error == NULL && !git_path(&file_path, &repo->git_dir, "commondir")) {
+        error = "could not allocate memory for a path";
+    }
+    if (error == NULL && read_git_file(file_path.data, &file) == NULL) {
+        if (!set_linked_path(&repo->common_dir, repo->git_dir.data, repo->git_dir.size, file.data, file.size)) {
+            error = "could not allocate memory for a path";
+        }
+        close_input_file(&file);
+    }
+    else if (error == NULL && !path_append(&repo->common_dir, repo->git_dir.data, repo->git_dir.size)) {
+        error = "could not allocate memory for a path";
+    }
+
+    if (error == NULL && !git_path(&file_path, &repo->common_dir, "objects")) {
+        error = "could not allocate memory for a path";
+    }
+    if (error == NULL && GetFileAttributesA(file_path.data) == INVALID_FILE_ATTRIBUTES) {
+        error = "is not a git directory";
+    }
+    if (error == NULL && git_path(&file_path, &repo->common_dir, "packed-refs") && read_git_file(file_path.data, &file) == NULL) {
+        repo->packed_refs = file;
+    }
+    path_free(&file_path);
+
+    if (error == NULL) {
+        error = open_git_packs(repo);
+    }
+    if (error != NULL) {
+        close_git_repository(repo);
+    }
+    return error;
+}
+
+/* returns the index of oid in pack or -1 */
+static LONGLONG find_packed_oid(git_pack const *pack, unsigned char const *oid)
+{
+    DWORD low = oid[0] == 0 ? 0 : read_big_endian(pack->fanout + (oid[0] - 1) * 4);
+    DWORD high = read_big_endian(pack->fanout + oid[0] * 4);
+    while (low < high) {
+        DWORD const middle = low + (high - low) / 2;
+        unsigned char const *found = pack->oids + (size_t)middle * GIT_OID_SIZE;
+        size_t i = 0;
+        while (i < GIT_OID_SIZE && found[i] == oid[i]) ++i;
+        if (i == GIT_OID_SIZE) return middle;
+        if (found[i] < oid[i]) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return -1;
+}
+
+/* returns false if the offset of the object is not in the pack */
+static bool packed_object_offset(git_pack const *pack, DWORD index, size_t *offset)
+{
+    DWORD const small = read_big_endian(pack->offsets + (size_t)index * 4);
+    ULONGLONG large = small;
+    if (small & 0x80000000) {
+        DWORD const large_index = small & 0x7fffffff;
+        if (large_index >= pack->large_offset_count) return false;
+        unsigned char const *data = pack->large_offsets + (size_t)large_index * 8;
+        large = ((ULONGLONG)read_big_endian(data) << 32) | read_big_endian(data + 4);
+    }
+    if (large >= pack->pack.size) return false;
+    *offset = (size_t)large;
+    return true;
+}
+
+static void git_free_object(git_object *object)
+{
+    if (object->buffer != NULL) {
+        HeapFree(GetProcessHeap(), 0, object->buffer);
+    }
+    *object = (git_object) { 0 };
+}
+
+static bool git_reader_init(git_reader *reader, git_repository const *repo)
+{
+    reader->repo = repo;
+    reader->z = make_inflater();
+    for (size_t i = 0; i < GIT_BASE_CACHE_SIZE; ++i) {
+        reader->bases[i] = (git_cached_base) { 0 };
+    }
+    return reader->z != NULL;
+}
+
+static void git_reader_free(git_reader *reader)
+{
+    for (size_t i = 0; i < GIT_BASE_CACHE_SIZE; ++i) {
+        git_free_object(&reader->bases[i].object);
+    }
+    HeapFree(GetProcessHeap(), 0, reader->z);
+    reader->z = NULL;
+}
+
+/* inflates the zlib stream in data to out which has to be exactly as big as what it inflates to */
+static bool inflate_zlib(inflater *z, unsigned char const *data, size_t size, char *out, size_t out_size)
+{
+    size_t const header_size = zlib_header_size(data, size);
+    if (header_size == 0) return false;
+
+    inflate_start(z, data + header_size, size - header_size, out, out_size);
+    inflate_status const status = inflate_run(z);
+    return status != INFLATE_ERROR && z->out_size == out_size;
+}
+
+/* a heap buffer for an object of size bytes, empty objects still get one so that data is never NULL */
+static char *allocate_object(size_t size)
+{
+    return HeapAlloc(GetProcessHeap(), 0, size == 0 ? 1 : size);
+}
+
+/* the sizes in a delta are little endian with 7 bits in each byte and the high bit set if another byte follows */
+static bool read_delta_size(unsigned char const **pos, unsigned char const *end, size_t *size)
+{
+    *size = 0;
+    for (size_t shift = 0; *pos != end; shift += 7) {
+        if (shift >= sizeof(size_t) * 8) return false;
+        unsigned char const byte = *(*pos)++;
+        *size |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+/* a delta is the size of the base, the size of the result and then instructions that copy a part of the base or insert new bytes */
+static char const *apply_delta(git_object const *base, char const *delta, size_t delta_size, git_object *object)
+{
+    unsigned char const *pos = (unsigned char const *)delta;
+    unsigned char const *const end = pos + delta_size;
+    size_t base_size;
+    size_t size;
+    if (!read_delta_size(&pos, end, &base_size) || !read_delta_size(&pos, end, &size) || base_size != base->size) {
+        return "has a corrupt delta";
+    }
+
+    char *buffer = allocate_object(size);
+    if (buffer == NULL) {
+        return "could not allocate memory for the object";
+    }
+
+    char *to = buffer;
+    char *const to_end = buffer + size;
+    while (pos != end) {
+        unsigned char const instruction = *pos++;
+        char const *from;
+        size_t copy_size = 0;
+        if (instruction & 0x80) {
+            /* the bits that are set say which bytes of the offset and the size follow, a size of 0 is 0x10000 */
+            size_t copy_offset = 0;
+            for (size_t i = 0; i < 7; ++i) {
+                if (!(instruction & (1 << i))) continue;
+                if (pos == end) {
+                    copy_offset = (size_t)-1;
+                    break;
+                }
+                if (i < 4) {
+                    copy_offset |= (size_t)*pos++ << (i * 8);
+                }
+                else {
+                    copy_size |= (size_t)*pos++ << ((i - 4) * 8);
+                }
+            }
+            if (copy_size == 0) {
+                copy_size = 0x10000;
+            }
+            if (copy_offset > base->size || base->size - copy_offset < copy_size) {
+                HeapFree(GetProcessHeap(), 0, buffer);
+                return "has a corrupt delta";
+            }
+            from = base->data + copy_offset;
+        }
+        else {
+            copy_size = instruction;
+            if (copy_size == 0 || (size_t)(end - pos) < copy_size) {
+                HeapFree(GetProcessHeap(), 0, buffer);
+                return "has a corrupt delta";
+            }
+            from = (char const *)pos;
+            pos += copy_size;
+        }
+
+        if ((size_t)(to_end - to) < copy_size) {
+            HeapFree(GetProcessHeap(), 0, buffer);
+            return "has a corrupt delta";
+        }
+        while (copy_size-- != 0) {
+            *to++ = *from++;
+        }
+    }
+
+    if (to != to_end) {
+        HeapFree(GetProcessHeap(), 0, buffer);
+        return "has a corrupt delta";
+    }
+    object->data = object->buffer = buffer;
+    object->size = size;
+    object->type = base->type;
+    return NULL;
+}
+
+static char const *read_git_object(git_reader *reader, unsigned char const *oid, size_t max_size, git_object *object, size_t depth);
+
+static char const *read_packed_object(git_reader *reader, git_pack const *pack, size_t offset, size_t max_size, git_object *object,
+                                      size_t depth);
+
+/* the base of a delta, the ones that were resolved last are kept, cached is set if the base is kept and must not be freed */
+static char const *read_delta_base(git_reader *reader, git_pack const *pack, size_t offset, git_object *base, bool *cached, size_t depth)
+{
+    git_cached_base *slot = &reader->bases[(offset ^ (offset >> 12)) % GIT_BASE_CACHE_SIZE];
+    if (slot->pack == pack && slot->offset == offset && slot->object.buffer != NULL) {
+        *base = slot->object;
+        *cached = true;
+        return NULL;
+    }
+
+    *cached = false;
+    char const *error = read_packed_object(reader, pack, offset, (size_t)-1, base, depth + 1);
+    if (error == NULL && base->size <= GIT_BASE_CACHE_MAX_OBJECT_SIZE) {
+        git_free_object(&slot->object);
+        slot->pack = pack;
+        slot->offset = offset;
+        slot->object = *base;
+        *cached = true;
+    }
+    return error;
+}
+
+/* reads the object at offset of pack, if it is larger than max_size its data is NULL and only its size is set
+ * NOTE: the type of a delta is only known once its base is read so it is not set when the object is too large
+ */
+static char const *read_packed_object(git_reader *reader, git_pack const *pack, size_t offset, size_t max_size, git_object *object,
+                                      size_t depth)
+{
+    *object = (git_object) { 0 };
+    if (depth > GIT_MAX_DELTA_DEPTH) {
+        return "has a delta chain that is too long";
+    }
+
+    /* the header is the type and the size with 4 bits in the first byte and 7 bits in the ones after it */
+    unsigned char const *pos = (unsigned char const *)pack->pack.data + offset;
+    unsigned char const *const end = (unsigned char const *)pack->pack.data + pack->pack.size;
+    unsigned char byte = *pos++;
+    git_object_type const type = (byte >> 4) & 7;
+    size_t size = byte & 15;
+    for (size_t shift = 4; byte & 0x80; shift += 7) {
+        if (pos == end || shift >= sizeof(size_t) * 8) return "has a corrupt pack";
+        byte = *pos++;
+        size |= (size_t)(byte & 0x7f) << shift;
+    }
+
+    size_t base_offset = 0;
+    unsigned char const *base_oid = NULL;
+    if (type == GIT_OFS_DELTA) {
+        /* the distance back to the base is big endian with one added to every byte but the last */
+        size_t distance = 0;
+        do {
+            if (pos == end || distance > ((size_t)-1 >> 7) - 1) return "has a corrupt pack";
+            byte = *pos++;
+            distance = (distance << 7) | (byte & 0x7f);
+            if (byte & 0x80) ++distance;
+        } while (byte & 0x80);
+        if (distance == 0 || distance > offset) return "has a corrupt pack";
+        base_offset = offset - distance;
+    }
+    else if (type == GIT_REF_DELTA) {
+        if ((size_t)(end - pos) < GIT_OID_SIZE) return "has a corrupt pack";
+        base_oid = pos;
+        pos += GIT_OID_SIZE;
+    }
+    else if (type < GIT_COMMIT || type > GIT_TAG) {
+        return "has a corrupt pack";
+    }
+
+    if (base_oid == NULL && type != GIT_OFS_DELTA) {
+        if (size > max_size) {
+            object->type = type;
+            object->size = size;
+            return NULL;
+        }
+        char *buffer = allocate_object(size);
+        if (buffer == NULL) {
+            return "could not allocate memory for the object";
+        }
+        if (!inflate_zlib(reader->z, pos, end - pos, buffer, size)) {
+            HeapFree(GetProcessHeap(), 0, buffer);
+            return "has a corrupt pack";
+        }
+        *object = (git_object) { .type = type, .data = buffer, .size = size, .buffer = buffer };
+        return NULL;
+    }
+
+    char *delta = allocate_object(size);
+    if (delta == NULL) {
+        return "could not allocate memory for the object";
+    }
+    if (!inflate_zlib(reader->z, pos, end - pos, delta, size)) {
+        HeapFree(GetProcessHeap(), 0, delta);
+        return "has a corrupt pack";
+    }
+
+    /* the size of the result is at the start of the delta so a large object is skipped without reading its base */
+    unsigned char const *sizes = (unsigned char const *)delta;
+    size_t base_size;
+    size_t result_size;
+    if (!read_delta_size(&sizes, sizes + size, &base_size) || !read_delta_size(&sizes, (unsigned char const *)delta + size, &result_size)) {
+        HeapFree(GetProcessHeap(), 0, delta);
+        return "has a corrupt delta";
+    }
+    if (result_size > max_size) {
+        HeapFree(GetProcessHeap(), 0, delta);
+        object->size = result_size;
+        return NULL;
+    }
+
+    git_object base;
+    bool cached = false;
+    char const *error = base_oid != NULL
+        ? read_git_object(reader, base_oid, (size_t)-1, &base, depth + 1)
+        : read_delta_base(reader, pack, base_offset, &base, &cached, depth);
+    if (error == NULL) {
+        error = apply_delta(&base, delta, size, object);
+        if (!cached) {
+            git_free_object(&base);
+        }
+    }
+    HeapFree(GetProcessHeap(), 0, delta);
+    return error;
+}
+
+/* a loose object is objects\xx\ and the other 38 hex digits of its id, it is one zlib stream of a header like blob 12 and a null byte
+ * and then the data, the header is inflated on its own first to get the size of the object
+ */
+static char const *read_loose_object(git_reader *reader, unsigned char const *oid, size_t max_size, git_object *object)
+{
+    *object = (git_object) { 0 };
+    char name[sizeof("objects\\xx\\") + GIT_HEX_SIZE - 2];
+    char hex[GIT_HEX_SIZE];
+    format_oid(oid, hex);
+    char *pos = name;
+    for (char const *prefix = "objects\\"; *prefix != '\0'; ++prefix) {
+        *pos++ = *prefix;
+    }
+    *pos++ = hex[0];
+    *pos++ = hex[1];
+    *pos++ = '\\';
+    for (size_t i = 2; i < GIT_HEX_SIZE; ++i) {
+        *pos++ = hex[i];
+    }
+    *pos = '\0';
+
+    path_builder path = { 0 };
+    if (!git_path(&path, &reader->repo->common_dir, name)) {
+        return "could not allocate memory for a path";
+    }
+    input_file file;
+    char const *error = open_input_file(path.data, true, &file);
+    path_free(&path);
+    if (error != NULL) {
+        return "could not find the object";
+    }
+
+    unsigned char const *data = (unsigned char const *)file.data;
+    size_t const header_size = zlib_header_size(data, file.size);
+    char header[32];
+    inflate_start(reader->z, data + header_size, file.size - header_size, header, sizeof(header));
+    inflate_status status = header_size == 0 ? INFLATE_ERROR : inflate_run(reader->z);
+    size_t const header_end = status == INFLATE_ERROR ? 0 : reader->z->out_size;
+
+    git_object_type type = GIT_NO_OBJECT;
+    size_t type_size = 0;
+    while (type_size < header_end && header[type_size] != ' ') ++type_size;
+    if (type_size == 6 && bytes_equal(header, "commit", 6)) type = GIT_COMMIT;
+    else if (type_size == 4 && bytes_equal(header, "tree", 4)) type = GIT_TREE;
+    else if (type_size == 4 && bytes_equal(header, "blob", 4)) type = GIT_BLOB;
+    else if (type_size == 3 && bytes_equal(header, "tag", 3)) type = GIT_TAG;
+
+    size_t size = 0;
+    size_t offset = type_size + 1;
+    for (; offset < header_end && header[offset] >= '0' && header[offset] <= '9'; ++offset) {
+        if (size > ((size_t)-1 - 9) / 10) {
+            type = GIT_NO_OBJECT;
+            break;
+        }
+        size = size * 10 + (header[offset] - '0');
+    }
+    if (type == GIT_NO_OBJECT || offset >= header_end || header[offset] != '\0') {
+        close_input_file(&file);
+        return "is a corrupt loose object";
+    }
+    ++offset;
+
+    object->type = type;
+    object->size = size;
+    if (size > max_size) {
+        close_input_file(&file);
+        return NULL;
+    }
+    if (size > (size_t)-1 - offset) {
+        close_input_file(&file);
+        return "is too large to fit in memory";
+    }
+
+    /* NOTE: the matches of the data can go back into the header so it is inflated again with the data */
+    object->buffer = allocate_object(offset + size);
+    if (object->buffer == NULL) {
+        close_input_file(&file);
+        return "could not allocate memory for the object";
+    }
+    inflate_start(reader->z, data + header_size, file.size - header_size, object->buffer, offset + size);
+    status = inflate_run(reader->z);
+    close_input_file(&file);
+    if (status == INFLATE_ERROR || reader->z->out_size != offset + size) {
+        git_free_object(object);
+        return "is a corrupt loose object";
+    }
+    object->data = object->buffer + offset;
+    return NULL;
+}
+
+static char const *read_git_object(git_reader *reader, unsigned char const *oid, size_t max_size, git_object *object, size_t depth)
+{
+    git_repository const *repo = reader->repo;
+    for (size_t i = 0; i < repo->pack_count; ++i) {
+        LONGLONG const index = find_packed_oid(&repo->packs[i], oid);
+        if (index < 0) continue;
+
+        size_t offset;
+        if (!packed_object_offset(&repo->packs[i], (DWORD)index, &offset)) {
+            return "has a corrupt pack index";
+        }
+        return read_packed_object(reader, &repo->packs[i], offset, max_size, object, depth);
+    }
+    return read_loose_object(reader, oid, max_size, object);
+}
+
+/* reads the object with the id oid, if it is larger than max_size its data is NULL and only its size is set,
+ * returns a description of what went wrong or NULL on success, the object is freed with git_free_object
+ */
+static char const *git_read_object(git_reader *reader, unsigned char const *oid, size_t max_size, git_object *object)
+{
+    return read_git_object(reader, oid, max_size, object, 0);
+}
+
+/* an entry of a tree, the name is null terminated in the data of the tree */
+typedef struct git_tree_entry
+{
+    DWORD mode;
+    char const *name;
+    size_t name_size;
+    unsigned char const *oid;
+} git_tree_entry;
+
+/* a tree is a list of an octal mode, a space, the name, a null byte and the 20 bytes of the id for each entry,
+ * gets the entry at offset and moves offset to the next one, name is NULL at the end of the tree
+ */
+static char const *git_next_tree_entry(git_object const *tree, size_t *offset, git_tree_entry *entry)
+{
+    entry->name = NULL;
+    char const *pos = tree->data + *offset;
+    char const *const end = tree->data + tree->size;
+    if (pos == end) {
+        return NULL;
+    }
+
+    DWORD mode = 0;
+    for (; pos != end && *pos >= '0' && *pos <= '7'; ++pos) {
+        mode = (mode << 3) | (*pos - '0');
+    }
+    if (pos == end || *pos++ != ' ') {
+        return "is a corrupt tree";
+    }
+
+    char const *name = pos;
+    while (pos != end && *pos != '\0') ++pos;
+    if (pos == name || (size_t)(end - pos) < 1 + GIT_OID_SIZE) {
+        return "is a corrupt tree";
+    }
+
+    *entry = (git_tree_entry) { .mode = mode, .name = name, .name_size = (size_t)(pos - name), .oid = (unsigned char const *)pos + 1 };
+    *offset = (size_t)(pos + 1 + GIT_OID_SIZE - tree->data);
+    return NULL;
+}
+
+/* returned when a name is not a ref so the next way to read it can be tried */
+static char const git_not_found[] = "could not find the revision";
+
+/* a ref is a file with the id or with ref: and the name of another ref, or a line of packed-refs */
+static char const *read_git_ref(git_repository const *repo, char const *name, size_t name_size, unsigned char *oid, size_t depth)
+{
+    if (depth > 8) {
+        return "has refs that point to each other";
+    }
+
+    /* only the refs under refs\ are shared by the worktrees, HEAD and the others are their own */
+    path_builder path = { 0 };
+    bool const shared = name_size >= 5 && bytes_equal(name, "refs/", 5);
+    path_builder const *directory = shared ? &repo->common_dir : &repo->git_dir;
+    if (!path_append(&path, directory->data, directory->size) || !path_append(&path, "\\", 1) || !path_append(&path, name, name_size)) {
+        path_free(&path);
+        return "could not allocate memory for a path";
+    }
+
+    input_file file;
+    DWORD const attributes = GetFileAttributesA(path.data);
+    bool const is_file = attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+    char const *error = is_file ? read_git_file(path.data, &file) : git_not_found;
+    path_free(&path);
+    if (error == NULL) {
+        if (file.size >= 5 && bytes_equal(file.data, "ref: ", 5)) {
+            error = read_git_ref(repo, file.data + 5, file.size - 5, oid, depth + 1);
+        }
+        else if (file.size >= GIT_HEX_SIZE && is_hex(file.data, GIT_HEX_SIZE)) {
+            parse_oid(file.data, oid);
+        }
+        else {
+            error = "has a ref that is not an object id";
+        }
+        close_input_file(&file);
+        return error;
+    }
+
+    /* every line of packed-refs is an id and a name, a line with ^ is the commit of the tag before it */
+    char const *line = repo->packed_refs.data;
+    char const *const end = line + repo->packed_refs.size;
+    while (line < end) {
+        char const *line_end = line;
+        while (line_end != end && *line_end != '\n') ++line_end;
+        size_t line_size = (size_t)(line_end - line);
+        if (line_size != 0 && line[line_size - 1] == '\r') --line_size;
+
+        if (line_size == GIT_HEX_SIZE + 1 + name_size && line[GIT_HEX_SIZE] == ' ' && is_hex(line, GIT_HEX_SIZE)
+            && bytes_equal(line + GIT_HEX_SIZE + 1, name, name_size)) {
+            parse_oid(line, oid);
+            return NULL;
+        }
+        line = line_end + 1;
+    }
+    return git_not_found;
+}
+
+/* finds the one object whose id starts with the size hex digits of prefix in the packs and the loose objects */
+static char const *find_abbreviated_oid(git_repository const *repo, char const *prefix, size_t size, unsigned char *oid)
+{
+    bool found = false;
+    for (size_t i = 0; i < repo->pack_count; ++i) {
+        git_pack const *pack = &repo->packs[i];
+        DWORD low = 0;
+        DWORD high = pack->object_count;
+        while (low < high) {
+            DWORD const middle = low + (high - low) / 2;
+            if (compare_oid_prefix(pack->oids + (size_t)middle * GIT_OID_SIZE, prefix, size) < 0) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        for (; low < pack->object_count && compare_oid_prefix(pack->oids + (size_t)low * GIT_OID_SIZE, prefix, size) == 0; ++low) {
+            unsigned char const *match = pack->oids + (size_t)low * GIT_OID_SIZE;
+            if (found && !bytes_equal((char const *)match, (char const *)oid, GIT_OID_SIZE)) {
+                return "is an ambiguous object id";
+            }
+            for (size_t j = 0; j < GIT_OID_SIZE; ++j) {
+                oid[j] = match[j];
+            }
+            found = true;
+        }
+    }
+
+    /* the loose objects are found by the start of their file name */
+    char name[sizeof("objects\\xx\\*") + GIT_HEX_SIZE - 2];
+    char *pos = name;
+    for (char const *start = "objects\\"; *start != '\0'; ++start) {
+        *pos++ = *start;
+    }
+    *pos++ = prefix[0];
+    *pos++ = prefix[1];
+    *pos++ = '\\';
+    for (size_t i = 2; i < size; ++i) {
+        *pos++ = prefix[i];
+    }
+    *pos++ = '*';
+    *pos = '\0';
+
+    path_builder path = { 0 };
+    if (!git_path(&path, &repo->common_dir, name)) {
+        return "could not allocate memory for a path";
+    }
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(path.data, &find_data);
+    path_free(&path);
+    if (find_handle != INVALID_HANDLE_VALUE) {
+        do {
+            char hex[GIT_HEX_SIZE];
+            hex[0] = prefix[0];
+            hex[1] = prefix[1];
+            if (lstrlenA(find_data.cFileName) != GIT_HEX_SIZE - 2 || !is_hex(find_data.cFileName, GIT_HEX_SIZE - 2)) continue;
+            for (size_t i = 2; i < GIT_HEX_SIZE; ++i) {
+                hex[i] = find_data.cFileName[i - 2];
+            }
+
+            unsigned char match[GIT_OID_SIZE];
+            parse_oid(hex, match);
+            if (found && !bytes_equal((char const *)match, (char const *)oid, GIT_OID_SIZE)) {
+                FindClose(find_handle);
+                return "is an ambiguous object id";
+            }
+            for (size_t j = 0; j < GIT_OID_SIZE; ++j) {
+                oid[j] = match[j];
+            }
+            found = true;
+        } while (FindNextFileA(find_handle, &find_data));
+        FindClose(find_handle);
+    }
+    return found ? NULL : git_not_found;
+}
+
+/* the object a name is, tried the same way git does as an id, a ref, a tag, a branch, a remote and then an abbreviated id */
+static char const *resolve_git_name(git_repository const *repo, char const *name, size_t size, unsigned char *oid)
+{
+    if (size == GIT_HEX_SIZE && is_hex(name, size)) {
+        parse_oid(name, oid);
+        return NULL;
+    }
+
+    static char const *const prefixes[] = { "", "refs/", "refs/tags/", "refs/heads/", "refs/remotes/", "refs/remotes/" };
+    static char const *const suffixes[] = { "", "", "", "", "", "/HEAD" };
+    path_builder ref = { 0 };
+    char const *error = git_not_found;
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]) && error == git_not_found; ++i) {
+        ref.size = 0;
+        if (!path_append(&ref, prefixes[i], lstrlenA(prefixes[i])) || !path_append(&ref, name, size)
+            || !path_append(&ref, suffixes[i], lstrlenA(suffixes[i]))) {
+            error = "could not allocate memory for a path";
+            break;
+        }
+        error = read_git_ref(repo, ref.data, ref.size, oid, 0);
+    }
+    path_free(&ref);
+
+    if (error == git_not_found && size >= 4 && size < GIT_HEX_SIZE && is_hex(name, size)) {
+        error = find_abbreviated_oid(repo, name, size, oid);
+    }
+    return error;
+}
+
+/* finds the id after a line that starts with the field of a commit or a tag, a commit has one parent line for each parent */
+static bool find_object_field(git_object const *object, char const *field, size_t index, unsigned char *oid)
+{
+    size_t const field_size = lstrlenA(field);
+    char const *line = object->data;
+    char const *const end = line + object->size;
+    while (line < end && *line != '\n') {
+        char const *line_end = line;
+        while (line_end != end && *line_end != '\n') ++line_end;
+        if ((size_t)(line_end - line) >= field_size + 1 + GIT_HEX_SIZE && bytes_equal(line, field, field_size) && line[field_size] == ' '
+            && is_hex(line + field_size + 1, GIT_HEX_SIZE)) {
+            if (index-- == 0) {
+                parse_oid(line + field_size + 1, oid);
+                return true;
+            }
+        }
+        line = line_end + 1;
+    }
+    return false;
+}
+
+/* follows tags until oid is a commit or a tree, or until it is the type that is wanted */
+static char const *peel_git_object(git_reader *reader, unsigned char *oid, git_object_type wanted, git_object_type *type)
+{
+    for (size_t depth = 0; depth < 64; ++depth) {
+        git_object object;
+        char const *error = git_read_object(reader, oid, (size_t)-1, &object);
+        if (error != NULL) {
+            return error;
+        }
+        *type = object.type;
+        if (object.type == wanted || object.type != GIT_TAG) {
+            git_free_object(&object);
+            return NULL;
+        }
+        bool const found = find_object_field(&object, "object", 0, oid);
+        git_free_object(&object);
+        if (!found) {
+            return "has a corrupt tag";
+        }
+    }
+    return "has tags that point to each other";
+}
+
+/* moves oid to its parent number index, 0 is the first parent */
+static char const *git_parent(git_reader *reader, unsigned char *oid, size_t index)
+{
+    git_object_type type;
+    char const *error = peel_git_object(reader, oid, GIT_COMMIT, &type);
+    if (error != NULL) {
+        return error;
+    }
+    if (type != GIT_COMMIT) {
+        return "is not a commit";
+    }
+
+    git_object commit;
+    error = git_read_object(reader, oid, (size_t)-1, &commit);
+    if (error != NULL) {
+        return error;
+    }
+    bool const found = find_object_field(&commit, "parent", index, oid);
+    git_free_object(&commit);
+    return found ? NULL : "has no such parent";
+}
+
+/* finds the tree of a revision, a name followed by any number of ~n and ^n that go back to the first or the nth parent,
+ * returns a description of what went wrong or NULL on success
+ */
+static char const *git_resolve_tree(git_reader *reader, char const *rev, unsigned char *tree_oid)
+{
+    size_t name_size = 0;
+    while (rev[name_size] != '\0' && rev[name_size] != '~' && rev[name_size] != '^') ++name_size;
+    if (name_size == 0) {
+        return "could not parse the revision";
+    }
+
+    char const *error = resolve_git_name(reader->repo, rev, name_size, tree_oid);
+    for (char const *pos = rev + name_size; error == NULL && *pos != '\0';) {
+        char const operator = *pos++;
+        if (operator != '~' && operator != '^') {
+            return "could not parse the revision";
+        }
+
+        size_t number = 1;
+        if (*pos >= '0' && *pos <= '9') {
+            number = 0;
+            while (*pos >= '0' && *pos <= '9') {
+                if (number > 100000000) return "could not parse the revision";
+                number = number * 10 + (*pos++ - '0');
+            }
+        }
+
+        if (operator == '~') {
+            while (error == NULL && number-- != 0) {
+                error = git_parent(reader, tree_oid, 0);
+            }
+        }
+        else if (number != 0) {
+            error = git_parent(reader, tree_oid, number - 1);
+        }
+    }
+    if (error != NULL) {
+        return error;
+    }
+
+    git_object_type type;
+    error = peel_git_object(reader, tree_oid, GIT_TREE, &type);
+    if (error == NULL && type == GIT_COMMIT) {
+        git_object commit;
+        error = git_read_object(reader, tree_oid, (size_t)-1, &commit);
+        if (error == NULL) {
+            if (!find_object_field(&commit, "tree", 0, tree_oid)) {
+                error = "has a corrupt commit";
+            }
+            git_free_object(&commit);
+            type = GIT_TREE;
+        }
+    }
+    if (error == NULL && type != GIT_TREE) {
+        error = "is not a commit or a tree";
+    }
+    return error;
+}
+
+/* finds the .git of the working tree the current directory is in the way git does, by going up until a directory has one,
+ * returns false if there is none
+ */
+static bool find_git_directory(path_builder *path)
+{
+    DWORD const size = GetCurrentDirectoryA(0, NULL);
+    char *directory = size == 0 ? NULL : HeapAlloc(GetProcessHeap(), 0, size);
+    if (directory == NULL) {
+        return false;
+    }
+    DWORD const length = GetCurrentDirectoryA(size, directory);
+    bool const copied = length != 0 && length < size && path_append(path, directory, length);
+    HeapFree(GetProcessHeap(), 0, directory);
+
+    while (copied) {
+        size_t const directory_size = path->size;
+        if (!path_append(path, "\\.git", 5)) break;
+        if (GetFileAttributesA(path->data) != INVALID_FILE_ATTRIBUTES) {
+            return true;
+        }
+        path_truncate(path, directory_size);
+
+        /* a root like C:\ has no parent */
+        size_t parent_size = directory_size;
+        while (parent_size != 0 && !is_path_separator(path->data[parent_size - 1])) --parent_size;
+        if (parent_size == 0 || parent_size == directory_size) break;
+        path_truncate(path, parent_size - 1);
+    }
+    path_free(path);
+    return false;
+}
@@ -0,0 +1,377 @@
+/* --exclude, --include and --ignore-files, the files and directories the walkers leave out
+ * the patterns are globs like the ones of .gitignore, a pattern with a / before its end is matched against the path
+ * under the directory it comes from and one without against the name alone, ! keeps what an earlier pattern left out,
+ * a trailing / only matches directories and ** matches any number of directories
+ * a directory that is left out is never opened so nothing under it costs anything, the ignore files of a directory
+ * are read and compiled once when the walker gets to it and the rules of every directory point to the ones of its parent
+ */
+
+typedef enum ignore_glob_kind
+{
+    /* the name is the text */
+    EXACT_IGNORE_GLOB,
+
+    /* the name ends with the text, *.o */
+    SUFFIX_IGNORE_GLOB,
+
+    /* anything else goes through glob_matches */
+    WILDCARD_IGNORE_GLOB
+} ignore_glob_kind;
+
+typedef struct ignore_pattern
+{
+    char const *text;
+    size_t size;
+    ignore_glob_kind kind;
+    bool negated;
+    bool directory_only;
+
+    /* matched against the path under the directory of the rules instead of the name */
+    bool anchored;
+} ignore_pattern;
+
+/* the patterns of the ignore files of one directory or of --exclude or --include, a later pattern wins over an earlier one */
+typedef struct ignore_rules
+{
+    struct ignore_rules const *parent;
+
+    /* the paths the anchored patterns are matched against start after this many bytes of the path of a file */
+    size_t base_size;
+
+    ignore_pattern *patterns;
+    size_t count;
+} ignore_rules;
+
+typedef struct ignore_options
+{
+    /* --exclude and --include, matched against the paths under the directory that is walked */
+    ignore_rules excludes;
+    ignore_rules includes;
+
+    /* --ignore-files, the .gitignore and .ignore files of the directories are read and .git directories are left out */
+    bool read_ignore_files;
+} ignore_options;
+
+static bool is_path_separator(char c)
+{
+    return c == '\\' || c == '/';
+}
+
+/* returns whether byte is in the [] class that starts at glob and sets glob past it, glob_end if it is not closed */
+static bool glob_class_matches(char const **glob, char const *glob_end, char byte)
+{
+    char const *pos = *glob + 1;
+    bool const complement = pos != glob_end && (*pos == '!' || *pos == '^');
+    pos += complement;
+
+    bool matched = false;
+    bool first = true;
+    char const folded = lowercase_char(byte);
+    while (pos != glob_end && (*pos != ']' || first)) {
+        first = false;
+        char low = *pos++;
+        if (low == '\\' && pos != glob_end) {
+            low = *pos++;
+        }
+
+        char high = low;
+        if (pos + 1 < glob_end && *pos == '-' && pos[1] != ']') {
+            high = pos[1];
+            pos += 2;
+            if (high == '\\' && pos != glob_end) {
+                high = *pos++;
+            }
+        }
+        matched |= (byte >= low && byte <= high) || (folded >= lowercase_char(low) && folded <= lowercase_char(high));
+    }
+
+    if (pos == glob_end) {
+        *glob = glob_end;
+        return false;
+    }
+    *glob = pos + 1;
+    return matched != complement;
+}
+
+/* matches all of str, * ? and [] do not match a separator, ** does and ** followed by a / matches any number of directories including none
+ * NOTE: the file system is not case sensitive so neither is this
+ */
+static bool glob_matches(char const *glob, char const *glob_end, char const *str, char const *end)
+{
+    while (glob != glob_end) {
+        if (*glob == '*') {
+            bool const any_directory = glob + 1 != glob_end && glob[1] == '*';
+            glob += 1 + any_directory;
+            if (any_directory && glob != glob_end && *glob == '/') {
+                ++glob;
+                for (char const *pos = str;; ++pos) {
+                    if ((pos == str || is_path_separator(pos[-1])) && glob_matches(glob, glob_end, pos, end)) return true;
+                    if (pos == end) return false;
+                }
+            }
+            for (char const *pos = str;; ++pos) {
+                if (glob_matches(glob, glob_end, pos, end)) return true;
+                if (pos == end || (!any_directory && is_path_separator(*pos))) return false;
+            }
+        }
+
+        if (str == end) {
+            return false;
+        }
+        switch (*glob) {
+            case '?':
+                if (is_path_separator(*str)) return false;
+                ++glob;
+                break;
+            case '[':
+                if (is_path_separator(*str) || !glob_class_matches(&glob, glob_end, *str)) return false;
+                break;
+            case '/':
+                if (!is_path_separator(*str)) return false;
+                ++glob;
+                break;
+            default:
+                glob += *glob == '\\' && glob + 1 != glob_end;
+                if (lowercase_char(*glob) != lowercase_char(*str)) return false;
+                ++glob;
+                break;
+        }
+        ++str;
+    }
+    return str == end;
+}
+
+static bool equals_ignore_case(char const *str, char const *end, char const *text, size_t size)
+{
+    if ((size_t)(end - str) != size) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (lowercase_char(str[i]) != lowercase_char(text[i])) return false;
+    }
+    return true;
+}
+
+/* compiles a line of an ignore file or a pattern of --exclude or --include into pattern and copies its text to text,
+ * which has to hold size bytes, returns false for lines with no pattern
+ */
+static bool compile_ignore_pattern(char const *line, size_t size, char *text, ignore_pattern *pattern)
+{
+    /* trailing spaces are left out unless they are escaped */
+    while (size != 0 && (line[size - 1] == '\r' || line[size - 1] == '\n')) --size;
+    while (size != 0 && line[size - 1] == ' ' && (size == 1 || line[size - 2] != '\\')) --size;
+    if (size == 0 || line[0] == '#') {
+        return false;
+    }
+
+    *pattern = (ignore_pattern) { .text = text };
+    if (line[0] == '!') {
+        pattern->negated = true;
+        ++line;
+        --size;
+    }
+    else if (line[0] == '\\' && size > 1 && (line[1] == '#' || line[1] == '!')) {
+        ++line;
+        --size;
+    }
+    if (size != 0 && line[size - 1] == '/') {
+        pattern->directory_only = true;
+        --size;
+    }
+
+    bool special = false;
+    for (size_t i = 0; i < size; ++i) {
+        pattern->anchored |= line[i] == '/';
+        special |= line[i] == '*' || line[i] == '?' || line[i] == '[' || line[i] == '\\';
+    }
+    if (size != 0 && line[0] == '/') {
+        ++line;
+        --size;
+    }
+    if (size == 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        text[i] = line[i];
+    }
+    pattern->size = size;
+
+    pattern->kind = WILDCARD_IGNORE_GLOB;
+    if (!pattern->anchored && !special) {
+        pattern->kind = EXACT_IGNORE_GLOB;
+    }
+    else if (!pattern->anchored && size > 1 && line[0] == '*') {
+        bool rest_special = false;
+        for (size_t i = 1; i < size; ++i) {
+            rest_special |= line[i] == '*' || line[i] == '?' || line[i] == '[' || line[i] == '\\';
+        }
+        if (!rest_special) {
+            pattern->kind = SUFFIX_IGNORE_GLOB;
+            ++pattern->text;
+            --pattern->size;
+        }
+    }
+    return true;
+}
+
+static bool ignore_pattern_matches(ignore_pattern const *pattern, char const *relative, char const *name, char const *end)
+{
+    switch (pattern->kind) {
+        case EXACT_IGNORE_GLOB:
+            return equals_ignore_case(name, end, pattern->text, pattern->size);
+        case SUFFIX_IGNORE_GLOB:
+            return (size_t)(end - name) >= pattern->size && equals_ignore_case(end - pattern->size, end, pattern->text, pattern->size);
+        default:
+            return pattern->anchored
+                ? glob_matches(pattern->text, pattern->text + pattern->size, relative, end)
+                : glob_matches(pattern->text, pattern->text + pattern->size, name, end);
+    }
+}
+
+/* returns 1 if the last pattern of rules that matches leaves the path out, -1 if it keeps it and 0 if none matches */
+static int match_ignore_rules(ignore_rules const *rules, char const *relative, char const *name, char const *end, bool is_directory)
+{
+    while (relative != end && is_path_separator(*relative)) ++relative;
+    for (size_t i = rules->count; i != 0; --i) {
+        ignore_pattern const *pattern = &rules->patterns[i - 1];
+        if (pattern->directory_only && !is_directory) continue;
+        if (ignore_pattern_matches(pattern, relative, name, end)) {
+            return pattern->negated ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* returns whether the file or directory at path is left out, the first root_size bytes of path are the directory
+ * that is walked and rules are the ones of the directory path is in or NULL
+ */
+static bool is_ignored(ignore_options const *options, ignore_rules const *rules, char const *path, size_t path_size, size_t root_size,
+                       bool is_directory)
+{
+    char const *const end = path + path_size;
+    /* NOTE: the name never starts before the root, the root of a --git-rev or --archive walk ends with a : */
+    char const *name = end;
+    while (name != path + root_size && !is_path_separator(name[-1])) --name;
+
+    if (options->read_ignore_files && is_directory && equals_ignore_case(name, end, ".git", 4)) {
+        return true;
+    }
+    if (match_ignore_rules(&options->excludes, path + root_size, name, end, is_directory) > 0) {
+        return true;
+    }
+
+    /* the rules of a directory come before the ones of its parents */
+    for (; rules != NULL; rules = rules->parent) {
+        int const matched = match_ignore_rules(rules, path + rules->base_size, name, end, is_directory);
+        if (matched > 0) return true;
+        if (matched < 0) break;
+    }
+
+    return !is_directory && options->includes.count != 0 && match_ignore_rules(&options->includes, path + root_size, name, end, false) <= 0;
+}
+
+/* adds a pattern of --exclude or --include, returns a description of what went wrong or NULL */
+static char const *add_ignore_pattern(ignore_rules *rules, char const *glob)
+{
+    size_t const size = lstrlenA(glob);
+    char *text = HeapAlloc(GetProcessHeap(), 0, size + 1);
+    ignore_pattern *patterns = rules->patterns == NULL
+        ? HeapAlloc(GetProcessHeap(), 0, sizeof(ignore_pattern) * (rules->count + 1))
+        : HeapReAlloc(GetProcessHeap(), 0, rules->patterns, sizeof(ignore_pattern) * (rules->count + 1));
+    if (text == NULL || patterns == NULL) {
+        return "could not allocate memory for the pattern";
+    }
+    rules->patterns = patterns;
+
+    if (!compile_ignore_pattern(glob, size, text, &rules->patterns[rules->count])) {
+        HeapFree(GetProcessHeap(), 0, text);
+        return "there is no pattern in";
+    }
+    ++rules->count;
+    return NULL;
+}
+
+static char const *const ignore_file_names[] = { ".gitignore", ".ignore" };
+#define IGNORE_FILE_COUNT (sizeof(ignore_file_names) / sizeof(ignore_file_names[0]))
+
+/* reads the ignore files of the directory and sets rules to its rules in a, or to parent if it has none, returns false when out of memory
+ * NOTE: the rules are freed with a so everything walked under the directory has to be done by then,
+ * .ignore comes after .gitignore so its patterns win
+ */
+static bool load_ignore_rules(arena *a, ignore_rules const *parent, char const *directory, size_t directory_size, ignore_rules const **rules)
+{
+    *rules = parent;
+
+    /* the path of each file is only needed to open it */
+    arena_mark path_mark = arena_get_mark(a);
+    char *path = arena_alloc(a, directory_size + 16);
+    if (path == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < directory_size; ++i) {
+        path[i] = directory[i];
+    }
+    path[directory_size] = '\\';
+
+    input_file files[IGNORE_FILE_COUNT];
+    bool opened[IGNORE_FILE_COUNT];
+    size_t line_count = 0;
+    size_t text_size = 0;
+    for (size_t i = 0; i < IGNORE_FILE_COUNT; ++i) {
+        char const *name = ignore_file_names[i];
+        size_t j = 0;
+        for (; name[j] != '\0'; ++j) {
+            path[directory_size + 1 + j] = name[j];
+        }
+        path[directory_size + 1 + j] = '\0';
+
+        opened[i] = open_input_file(path, false, &files[i]) == NULL;
+        if (opened[i]) {
+            text_size += files[i].size;
+            for (size_t k = 0; k < files[i].size; ++k) {
+                line_count += files[i].data[k] == '\n';
+            }
+            ++line_count;
+        }
+    }
+    arena_release(a, path_mark);
+    if (line_count == 0) {
+        return true;
+    }
+
+    ignore_rules *loaded = arena_alloc(a, sizeof(ignore_rules));
+    ignore_pattern *patterns = arena_alloc(a, sizeof(ignore_pattern) * line_count);
+    char *text = arena_alloc(a, text_size + 1);
+    if (loaded == NULL || patterns == NULL || text == NULL) {
+        for (size_t i = 0; i < IGNORE_FILE_COUNT; ++i) {
+            if (opened[i]) {
+                close_input_file(&files[i]);
+            }
+        }
+        return false;
+    }
+    *loaded = (ignore_rules) { .parent = parent, .base_size = directory_size, .patterns = patterns };
+
+    for (size_t i = 0; i < IGNORE_FILE_COUNT; ++i) {
+        if (!opened[i]) continue;
+
+        char const *line = files[i].data;
+        char const *const end = files[i].data + files[i].size;
+        while (line != end) {
+            char const *line_end = line;
+            while (line_end != end && *line_end != '\n') ++line_end;
+            if (compile_ignore_pattern(line, (size_t)(line_end - line), text, &patterns[loaded->count])) {
+                text += patterns[loaded->count].size + (patterns[loaded->count].kind == SUFFIX_IGNORE_GLOB);
+                ++loaded->count;
+            }
+            line = line_end + (line_end != end);
+        }
+        close_input_file(&files[i]);
+    }
+
+    if (loaded->count != 0) {
+        *rules = loaded;
+    }
+    return true;
+}
@@ -0,0 +1,468 @@
+/* a decoder for deflate streams (rfc 1951), the format of git objects and packs and of gzip and zip files
+ * the codes are looked up in a table of their first INFLATE_FAST_BITS bits, the few that are longer than that
+ * are decoded a bit at a time from how many codes there are of each length
+ * NOTE: the whole input has to be in memory, the output is written to a buffer of the caller that can be emptied
+ * whenever it is full so a stream of any size can be inflated with the last INFLATE_WINDOW_SIZE bytes kept for the matches
+ */
+
+#define INFLATE_FAST_BITS 9
+#define INFLATE_MAX_BITS 15
+#define INFLATE_WINDOW_SIZE (1 << 15)
+
+/* 286 length and literal codes are used and two more are only there so the fixed codes are complete */
+#define INFLATE_MAX_SYMBOLS 288
+
+typedef struct huffman_table
+{
+    /* the symbol of the code each INFLATE_FAST_BITS bit value starts with shifted left by 4 and the length of the code,
+     * 0 if the code is longer
+     */
+    unsigned short fast[1 << INFLATE_FAST_BITS];
+
+    /* how many codes there are of each length and the symbols in the order of their codes */
+    unsigned short counts[INFLATE_MAX_BITS + 1];
+    unsigned short symbols[INFLATE_MAX_SYMBOLS];
+} huffman_table;
+
+typedef enum inflate_state
+{
+    BLOCK_HEADER_STATE,
+    STORED_BLOCK_STATE,
+    HUFFMAN_BLOCK_STATE,
+    INFLATE_DONE_STATE
+} inflate_state;
+
+typedef enum inflate_status
+{
+    INFLATE_ERROR,
+
+    /* the output buffer is full, inflate_run goes on from where it stopped once there is room in it */
+    INFLATE_FULL,
+
+    /* the end of the last block was reached */
+    INFLATE_DONE
+} inflate_status;
+
+/* NOTE: this is too big for the stack of a thread that has no stack probes so it is allocated with make_inflater */
+typedef struct inflater
+{
+    unsigned char const *in;
+    unsigned char const *in_end;
+
+    /* the bits that were read ahead of in with the next one in the lowest bit, padding is how many zero bytes past the end are in it */
+    DWORD bits;
+    size_t bit_count;
+    size_t padding;
+
+    /* the bytes before out_size are the output so far, matches can go back to any of them */
+    unsigned char *out;
+    size_t out_size;
+    size_t out_capacity;
+
+    inflate_state state;
+    bool last_block;
+    size_t stored_size;
+    size_t match_size;
+    size_t match_distance;
+
+    huffman_table literals;
+    huffman_table distances;
+} inflater;
+
+/* the base and the extra bits of the length and distance codes */
+static unsigned short const length_bases[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static unsigned char const length_extra_bits[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static unsigned short const distance_bases[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static unsigned char const distance_extra_bits[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* the order the lengths of the code length codes come in */
+static unsigned char const code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/* returns NULL when out of memory, the inflater is freed with HeapFree */
+static inflater *make_inflater(void)
+{
+    return HeapAlloc(GetProcessHeap(), 0, sizeof(inflater));
+}
+
+/* starts inflating the deflate stream in in, its output goes to out which can hold capacity bytes */
+static void inflate_start(inflater *z, void const *in, size_t in_size, void *out, size_t capacity)
+{
+    z->in = in;
+    z->in_end = z->in + in_size;
+    z->bits = 0;
+    z->bit_count = 0;
+    z->padding = 0;
+    z->out = out;
+    z->out_size = 0;
+    z->out_capacity = capacity;
+    z->state = BLOCK_HEADER_STATE;
+    z->last_block = false;
+    z->match_size = 0;
+}
+
+/* keeps at least 25 bits in the bit buffer, past the end of the input zero bytes are added so a code near the end can be looked up */
+static void inflate_refill(inflater *z)
+{
+    while (z->bit_count <= 24) {
+        DWORD byte = 0;
+        if (z->in != z->in_end) {
+            byte = *z->in++;
+        }
+        else {
+            ++z->padding;
+        }
+        z->bits |= byte << z->bit_count;
+        z->bit_count += 8;
+    }
+}
+
+/* NOTE: count can be at most 24 */
+static DWORD inflate_bits(inflater *z, size_t count)
+{
+    inflate_refill(z);
+    DWORD const value = z->bits & ((1u << count) - 1);
+    z->bits >>= count;
+    z->bit_count -= count;
+    return value;
+}
+
+/* whether more bits were used than there are in the input */
+static bool inflate_overran(inflater const *z)
+{
+    return z->padding * 8 > z->bit_count;
+}
+
+/* returns false if the lengths do not make a prefix code, codes that are left over are allowed like zlib does for a single distance */
+static bool build_huffman_table(huffman_table *table, unsigned char const *lengths, size_t count)
+{
+    for (size_t i = 0; i <= INFLATE_MAX_BITS; ++i) {
+        table->counts[i] = 0;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ++table->counts[lengths[i]];
+    }
+    table->counts[0] = 0;
+
+    int left = 1;
+    unsigned short offsets[INFLATE_MAX_BITS + 2];
+    offsets[1] = 0;
+    for (size_t length = 1; length <= INFLATE_MAX_BITS; ++length) {
+        left = (left << 1) - table->counts[length];
+        if (left < 0) return false;
+        offsets[length + 1] = offsets[length] + table->counts[length];
+    }
+    for (size_t symbol = 0; symbol < count; ++symbol) {
+        if (lengths[symbol] != 0) {
+            table->symbols[offsets[lengths[symbol]]++] = (unsigned short)symbol;
+        }
+    }
+
+    /* the codes are canonical, the ones of a length are consecutive and come after all the shorter ones,
+     * they are read starting with their highest bit so the table is indexed by the reversed code
+     */
+    for (size_t i = 0; i < (1 << INFLATE_FAST_BITS); ++i) {
+        table->fast[i] = 0;
+    }
+    DWORD code = 0;
+    size_t index = 0;
+    for (size_t length = 1; length <= INFLATE_FAST_BITS; ++length) {
+        for (size_t i = 0; i < table->counts[length]; ++i) {
+            DWORD reversed = 0;
+            for (size_t bit = 0; bit < length; ++bit) {
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            }
+            unsigned short const entry = (unsigned short)((table->symbols[index++] << 4) | length);
+            for (DWORD fill = reversed; fill < (1 << INFLATE_FAST_BITS); fill += 1u << length) {
+                table->fast[fill] = entry;
+            }
+            ++code;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+/* returns the next symbol or -1 if the bits are not a code */
+static int decode_symbol(inflater *z, huffman_table const *table)
+{
+    inflate_refill(z);
+    unsigned short const entry = table->fast[z->bits & ((1 << INFLATE_FAST_BITS) - 1)];
+    if (entry & 15) {
+        z->bits >>= entry & 15;
+        z->bit_count -= entry & 15;
+        return entry >> 4;
+    }
+
+    /* a long code, the first code of each length is where the codes of the lengths before it end shifted left by one */
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (size_t length = 1; length <= INFLATE_MAX_BITS; ++length) {
+        code |= (z->bits >> (length - 1)) & 1;
+        int const count = table->counts[length];
+        if (code - first < count) {
+            z->bits >>= length;
+            z->bit_count -= length;
+            return table->symbols[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void build_fixed_tables(inflater *z)
+{
+    unsigned char lengths[INFLATE_MAX_SYMBOLS];
+    size_t symbol = 0;
+    for (; symbol < 144; ++symbol) lengths[symbol] = 8;
+    for (; symbol < 256; ++symbol) lengths[symbol] = 9;
+    for (; symbol < 280; ++symbol) lengths[symbol] = 7;
+    for (; symbol < INFLATE_MAX_SYMBOLS; ++symbol) lengths[symbol] = 8;
+    build_huffman_table(&z->literals, lengths, INFLATE_MAX_SYMBOLS);
+
+    for (symbol = 0; symbol < 30; ++symbol) lengths[symbol] = 5;
+    build_huffman_table(&z->distances, lengths, 30);
+}
+
+/* the code lengths are themselves coded with a code whose lengths come first, the table for it is built in the distances table */
+static bool read_dynamic_tables(inflater *z)
+{
+    size_t const literal_count = inflate_bits(z, 5) + 257;
+    size_t const distance_count = inflate_bits(z, 5) + 1;
+    size_t const code_length_count = inflate_bits(z, 4) + 4;
+    if (literal_count > 286 || distance_count > 30) return false;
+
+    unsigned char lengths[INFLATE_MAX_SYMBOLS + 32];
+    for (size_t i = 0; i < 19; ++i) {
+        lengths[code_length_order[i]] = i < code_length_count ? (unsigned char)inflate_bits(z, 3) : 0;
+    }
+    if (!build_huffman_table(&z->distances, lengths, 19)) return false;
+
+    /* the lengths of the literals and the distances are one list, a repeat can go from one into the other */
+    size_t const total = literal_count + distance_count;
+    for (size_t i = 0; i < total;) {
+        int const symbol = decode_symbol(z, &z->distances);
+        if (symbol < 0 || inflate_overran(z)) return false;
+        if (symbol < 16) {
+            lengths[i++] = (unsigned char)symbol;
+            continue;
+        }
+
+        unsigned char repeated = 0;
+        size_t repeat;
+        if (symbol == 16) {
+            if (i == 0) return false;
+            repeated = lengths[i - 1];
+            repeat = 3 + inflate_bits(z, 2);
+        }
+        else if (symbol == 17) {
+            repeat = 3 + inflate_bits(z, 3);
+        }
+        else {
+            repeat = 11 + inflate_bits(z, 7);
+        }
+        if (i + repeat > total) return false;
+        while (repeat-- != 0) {
+            lengths[i++] = repeated;
+        }
+    }
+
+    /* a block without an end of block code could never end */
+    if (lengths[256] == 0) return false;
+    return build_huffman_table(&z->literals, lengths, literal_count)
+        && build_huffman_table(&z->distances, lengths + literal_count, distance_count);
+}
+
+static bool read_block_header(inflater *z)
+{
+    z->last_block = inflate_bits(z, 1) != 0;
+    switch (inflate_bits(z, 2)) {
+        case 0: {
+            /* a stored block starts at the next byte, the whole bytes that were read ahead are given back */
+            z->bits >>= z->bit_count & 7;
+            z->bit_count -= z->bit_count & 7;
+            if (z->padding > z->bit_count / 8) return false;
+            z->in -= z->bit_count / 8 - z->padding;
+            z->bits = 0;
+            z->bit_count = 0;
+            z->padding = 0;
+
+            if (z->in_end - z->in < 4) return false;
+            DWORD const size = (DWORD)z->in[0] | ((DWORD)z->in[1] << 8);
+            if (((DWORD)z->in[2] | ((DWORD)z->in[3] << 8)) != (~size & 0xffff)) return false;
+            z->in += 4;
+            z->stored_size = size;
+            z->state = STORED_BLOCK_STATE;
+            return true;
+        }
+        case 1:
+            build_fixed_tables(z);
+            z->state = HUFFMAN_BLOCK_STATE;
+            return true;
+        case 2:
+            z->state = HUFFMAN_BLOCK_STATE;
+            return read_dynamic_tables(z);
+        default:
+            return false;
+    }
+}
+
+/* copies as much of the match as fits */
+static void copy_match(inflater *z)
+{
+    size_t size = z->out_capacity - z->out_size;
+    if (size > z->match_size) {
+        size = z->match_size;
+    }
+    z->match_size -= size;
+
+    /* NOTE: the match can overlap what it writes so it is copied a byte at a time */
+    unsigned char *to = z->out + z->out_size;
+    unsigned char const *from = to - z->match_distance;
+    z->out_size += size;
+    while (size-- != 0) {
+        *to++ = *from++;
+    }
+}
+
+static inflate_status inflate_huffman_block(inflater *z)
+{
+    for (;;) {
+        if (z->out_size == z->out_capacity) return INFLATE_FULL;
+
+        int const symbol = decode_symbol(z, &z->literals);
+        if (symbol < 256) {
+            if (symbol < 0) return INFLATE_ERROR;
+            z->out[z->out_size++] = (unsigned char)symbol;
+            continue;
+        }
+        if (symbol == 256) {
+            z->state = BLOCK_HEADER_STATE;
+            return INFLATE_DONE;
+        }
+        if (symbol > 285) return INFLATE_ERROR;
+
+        size_t const length_code = (size_t)symbol - 257;
+        z->match_size = length_bases[length_code] + inflate_bits(z, length_extra_bits[length_code]);
+        int const distance_code = decode_symbol(z, &z->distances);
+        if (distance_code < 0 || distance_code >= 30) return INFLATE_ERROR;
+        z->match_distance = distance_bases[distance_code] + inflate_bits(z, distance_extra_bits[distance_code]);
+        if (z->match_distance > z->out_size || inflate_overran(z)) return INFLATE_ERROR;
+
+        copy_match(z);
+    }
+}
+
+/* inflates until the output is full or the stream ends */
+static inflate_status inflate_run(inflater *z)
+{
+    for (;;) {
+        if (z->match_size != 0) {
+            copy_match(z);
+            if (z->match_size != 0) return INFLATE_FULL;
+        }
+
+        switch (z->state) {
+            case BLOCK_HEADER_STATE:
+                if (z->last_block) {
+                    z->state = INFLATE_DONE_STATE;
+                    return INFLATE_DONE;
+                }
+                if (!read_block_header(z) || inflate_overran(z)) return INFLATE_ERROR;
+                break;
+
+            case STORED_BLOCK_STATE: {
+                size_t size = z->out_capacity - z->out_size;
+                if (size > z->stored_size) {
+                    size = z->stored_size;
+                }
+                if ((size_t)(z->in_end - z->in) < size) return INFLATE_ERROR;
+
+                unsigned char *to = z->out + z->out_size;
+                z->out_size += size;
+                z->stored_size -= size;
+                while (size-- != 0) {
+                    *to++ = *z->in++;
+                }
+                if (z->stored_size != 0) return INFLATE_FULL;
+                z->state = BLOCK_HEADER_STATE;
+                break;
+            }
+
+            case HUFFMAN_BLOCK_STATE: {
+                inflate_status const status = inflate_huffman_block(z);
+                if (status != INFLATE_DONE) return status;
+                if (inflate_overran(z)) return INFLATE_ERROR;
+                break;
+            }
+
+            default:
+                return INFLATE_DONE;
+        }
+    }
+}
+
+/* moves the last INFLATE_WINDOW_SIZE bytes of the output to the start of the buffer once everything after them was used */
+static void inflate_slide(inflater *z)
+{
+    if (z->out_size <= INFLATE_WINDOW_SIZE) return;
+
+    unsigned char const *from = z->out + z->out_size - INFLATE_WINDOW_SIZE;
+    for (size_t i = 0; i < INFLATE_WINDOW_SIZE; ++i) {
+        z->out[i] = from[i];
+    }
+    z->out_size = INFLATE_WINDOW_SIZE;
+}
+
+/* the first byte after the stream once inflate_run returned INFLATE_DONE, the checksums of zlib and gzip come after it */
+static unsigned char const *inflate_input_end(inflater const *z)
+{
+    return z->in - (z->bit_count / 8 - z->padding);
+}
+
+/* a zlib stream is a deflate stream with a two byte header and a checksum after it, returns the size of the header or 0 if it is not one */
+static size_t zlib_header_size(unsigned char const *data, size_t size)
+{
+    if (size < 2 || (data[0] & 15) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+        return 0;
+    }
+    return 2;
+}
+
+/* a gzip member is a deflate stream with a header of at least 10 bytes before it and its crc and size after it,
+ * returns the size of the header or 0 if it is not one
+ */
+static size_t gzip_header_size(unsigned char const *data, size_t size)
+{
+    if (size < 10 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || (data[3] & 0xe0)) {
+        return 0;
+    }
+
+    unsigned char const flags = data[3];
+    size_t offset = 10;
+    if (flags & 4) {
+        if (size - offset < 2) return 0;
+        offset += 2 + (data[offset] | ((size_t)data[offset + 1] << 8));
+    }
+
+    /* the name and the comment are null terminated */
+    for (unsigned char flag = 8; flag <= 16; flag <<= 1) {
+        if (!(flags & flag)) continue;
+        while (offset < size && data[offset] != 0) ++offset;
+        ++offset;
+    }
+    if (flags & 2) {
+        offset += 2;
+    }
+    return offset <= size ? offset : 0;
+}
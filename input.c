@@ -0,0 +1,209 @@
+/* getting the contents of input files into memory
+ * files are mapped into memory by default so no copy of the file is made and nothing has to be freed
+ * besides the view, if a file can not be mapped it is read into a heap buffer instead
+ */
+
+typedef struct input_file
+{
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+
+    /* the contents of the file, NOTE: this is not null terminated */
+    char const *data;
+    size_t size;
+
+    /* the size of the whole file, data can be only the start of it */
+    ULONGLONG file_size;
+
+    /* true if data is a view of mapping_handle instead of a heap buffer */
+    bool mapped;
+} input_file;
+
+static bool map_input_file(input_file *file)
+{
+    file->mapping_handle = CreateFileMappingA(file->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping_handle == NULL) {
+        return false;
+    }
+
+    stats_count_call(MAP_VIEW_OF_FILE_CALL);
+    file->data = MapViewOfFile(file->mapping_handle, FILE_MAP_READ, 0, 0, file->size);
+    if (file->data == NULL) {
+        CloseHandle(file->mapping_handle);
+        file->mapping_handle = NULL;
+        return false;
+    }
+
+    file->mapped = true;
+    return true;
+}
+
+static bool read_input_file(input_file *file)
+{
+    char *buffer = HeapAlloc(GetProcessHeap(), 0, file->size);
+    if (buffer == NULL) {
+        return false;
+    }
+
+    /* ReadFile can only read a DWORD worth of bytes at a time */
+    for (size_t offset = 0; offset != file->size; ) {
+        size_t remaining = file->size - offset;
+        DWORD chunk_size = remaining > (1 << 30) ? (1 << 30) : (DWORD)remaining;
+        DWORD bytes_read = 0;
+        stats_count_call(READ_FILE_CALL);
+        if (ReadFile(file->file_handle, buffer + offset, chunk_size, &bytes_read, NULL) == FALSE || bytes_read == 0) {
+            HeapFree(GetProcessHeap(), 0, buffer);
+            return false;
+        }
+        offset += bytes_read;
+    }
+
+    file->data = buffer;
+    return true;
+}
+
+/* opens filename without reading any of it so that its file_size can be looked at first,
+ * returns a description of what went wrong or NULL on success, the file has to be loaded or closed after
+ */
+static char const *open_input_handle(char const *filename, input_file *file)
+{
+    *file = (input_file) { 0 };
+
+    stats_count_call(CREATE_FILE_CALL);
+    file->file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN | FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file_handle == INVALID_HANDLE_VALUE) {
+        return "could not open file";
+    }
+
+    /* get the file size */
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file->file_handle, &file_size) == FALSE) {
+        CloseHandle(file->file_handle);
+        return "could not get the file size of";
+    }
+    file->file_size = (ULONGLONG)file_size.QuadPart;
+    return NULL;
+}
+
+/* gets the first size bytes of a file from open_input_handle into memory, returns a description of what went wrong or NULL on success
+ * NOTE: the file is closed when this fails
+ */
+static char const *load_input_file(input_file *file, bool map, ULONGLONG size)
+{
+    /* what is read has to fit in the address space, this can only fail for 32 bit builds */
+    if (size > ((size_t)-1 >> 1)) {
+        CloseHandle(file->file_handle);
+        return "the file is too large to fit in memory";
+    }
+    file->size = (size_t)size;
+
+    /* empty files can not be mapped and there is nothing to read */
+    if (file->size == 0) {
+        file->data = "";
+        return NULL;
+    }
+
+    if ((map && map_input_file(file)) || read_input_file(file)) {
+        return NULL;
+    }
+
+    CloseHandle(file->file_handle);
+    return "could not read";
+}
+
+/* opens filename and gets its contents into memory, returns a description of what went wrong or NULL on success */
+static char const *open_input_file(char const *filename, bool map, input_file *file)
+{
+    char const *error = open_input_handle(filename, file);
+    return error != NULL ? error : load_input_file(file, map, file->file_size);
+}
+
+static void close_input_file(input_file *file)
+{
+    if (file->mapped) {
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->mapping_handle);
+    }
+    else if (file->size != 0) {
+        HeapFree(GetProcessHeap(), 0, (void *)file->data);
+    }
+
+    CloseHandle(file->file_handle);
+    *file = (input_file) { 0 };
+}
+
+/* small files are read with overlapped i/o a few files ahead of the one that is being scanned
+ * so that waiting on the disk overlaps with the scanning, files larger than this are mapped or read when they are scanned
+ */
+#define READ_AHEAD_MAX_FILE_SIZE (1 << 18)
+
+/* the read of a whole file that was started before it is needed */
+typedef struct pending_input
+{
+    input_file file;
+    OVERLAPPED overlapped;
+} pending_input;
+
+/* starts reading filename which is size bytes long, returns false if the file could not be opened or the read could not be started
+ * NOTE: the file is opened without waiting on the read, the caller decides what to do with the files that fail here
+ * since scanning them opens them again and reports the error in order
+ */
+static bool start_input_read(char const *filename, size_t size, pending_input *pending)
+{
+    *pending = (pending_input) { 0 };
+    if (size == 0 || size > READ_AHEAD_MAX_FILE_SIZE) {
+        return false;
+    }
+
+    input_file *file = &pending->file;
+    stats_count_call(CREATE_FILE_CALL);
+    file->file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                    FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN | FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    file->size = size;
+    file->data = HeapAlloc(GetProcessHeap(), 0, size);
+    if (file->data == NULL) {
+        CloseHandle(file->file_handle);
+        return false;
+    }
+
+    /* NOTE: with only one read on the handle the handle itself is signaled when it completes so no event is needed */
+    stats_count_call(READ_FILE_CALL);
+    if (ReadFile(file->file_handle, (void *)file->data, (DWORD)size, NULL, &pending->overlapped) == FALSE &&
+        GetLastError() != ERROR_IO_PENDING) {
+        HeapFree(GetProcessHeap(), 0, (void *)file->data);
+        CloseHandle(file->file_handle);
+        return false;
+    }
+    return true;
+}
+
+/* waits for a read started by start_input_read, returns a description of what went wrong or NULL on success
+ * NOTE: the file may have changed size since the read started, whatever was read is what gets scanned
+ */
+static char const *finish_input_read(pending_input *pending, input_file *file)
+{
+    DWORD bytes_read = 0;
+    BOOL read = GetOverlappedResult(pending->file.file_handle, &pending->overlapped, &bytes_read, TRUE);
+
+    *file = pending->file;
+    if (read == FALSE && GetLastError() != ERROR_HANDLE_EOF) {
+        close_input_file(file);
+        return "could not read";
+    }
+
+    if (read == FALSE || bytes_read == 0) {
+        /* the file was emptied since it was found */
+        HeapFree(GetProcessHeap(), 0, (void *)file->data);
+        file->data = "";
+        file->size = 0;
+    }
+    else {
+        file->size = bytes_read;
+    }
+    file->file_size = file->size;
+    return NULL;
+}
@@ -0,0 +1,1525 @@
+/* the lexer is a table driven state machine, every comment_display mode gets its own transition table
+ * that maps a state and the class of the current byte to the next state and a small set of actions
+ * so the loop that drives it does not have to test the mode for every byte
+ * NOTE: the built in modes have hand written tables, the languages from a definitions file are compiled
+ * into the same kind of table by build_language_table so they run through the same loop
+ */
+
+typedef enum comment_display
+{
+    NO_COMMENT_DISPLAY = 0x0,
+    C_COMMENT_DISPLAY = 0x1,
+    CC_COMMENT_DISPLAY = C_COMMENT_DISPLAY << 1,
+    ASM_COMMENT_DISPLAY = CC_COMMENT_DISPLAY << 1,
+    PYTHON_COMMENT_DISPLAY = ASM_COMMENT_DISPLAY << 1,
+    RUST_COMMENT_DISPLAY = PYTHON_COMMENT_DISPLAY << 1,
+    AUTO_COMMENT_DISPLAY = RUST_COMMENT_DISPLAY << 1,
+
+    /* a language from a definitions file, its index is in the bits from DEFINED_LANGUAGE_SHIFT on */
+    DEFINED_COMMENT_DISPLAY = AUTO_COMMENT_DISPLAY << 1,
+    C_AND_CC_COMMENT_DISPLAY = C_COMMENT_DISPLAY | CC_COMMENT_DISPLAY,
+    ALL_COMMENT_DISPLAY = C_COMMENT_DISPLAY | CC_COMMENT_DISPLAY | ASM_COMMENT_DISPLAY
+} comment_display;
+
+#define DEFINED_LANGUAGE_SHIFT 8
+#define DEFINED_LANGUAGE_MODE(index) ((comment_display)(DEFINED_COMMENT_DISPLAY | ((unsigned)(index) << DEFINED_LANGUAGE_SHIFT)))
+#define DEFINED_LANGUAGE_INDEX(comment_mode) ((size_t)((unsigned)(comment_mode) >> DEFINED_LANGUAGE_SHIFT))
+
+typedef struct comment_count
+{
+    /* c comment count */
+    size_t c_comment_count;
+
+    /* c++ comment count */
+    size_t cc_comment_count;
+
+    /* asm comment count */
+    size_t asm_comment_count;
+
+    /* python comment count */
+    size_t python_comment_count;
+
+    /* rust comment count */
+    size_t rust_comment_count;
+
+    /* line and block comments of defined languages */
+    size_t line_comment_count;
+    size_t block_comment_count;
+} comment_count;
+
+typedef enum comment_kind
+{
+    C_COMMENT_KIND,
+    CC_COMMENT_KIND,
+    RUST_COMMENT_KIND, /* c comments that can be nested */
+    ASM_COMMENT_KIND,
+    PYTHON_DOC_COMMENT_KIND,
+    PYTHON_COMMENT_KIND,
+
+    /* the comments of defined languages, nested ones are block comments too */
+    LINE_COMMENT_KIND,
+    BLOCK_COMMENT_KIND,
+    COMMENT_KIND_COUNT
+} comment_kind;
+
+typedef enum byte_class
+{
+    OTHER_CLASS,
+    NULL_CLASS,
+    TAB_CLASS,
+    NEWLINE_CLASS,
+    CARRIAGE_RETURN_CLASS,
+    DOUBLE_QUOTE_CLASS,
+    SINGLE_QUOTE_CLASS,
+    SLASH_CLASS,
+    STAR_CLASS,
+    BACKSLASH_CLASS,
+    SEMICOLON_CLASS,
+    HASH_CLASS,
+    BANG_CLASS,
+    BYTE_CLASS_COUNT
+} byte_class;
+
+/* the tables of defined languages use the classes up to CARRIAGE_RETURN_CLASS the same way and give every other byte
+ * of their delimiters a class of its own after those
+ */
+#define MAX_BYTE_CLASSES 32
+
+/* NOTE: the states ending in _CR have seen a carriage return that may be the start of a \r\n
+ * and the states ending in _STAR, _SLASH or a quote count have seen part of a delimiter
+ */
+typedef enum lexer_state
+{
+    CODE_STATE,
+    SLASH_STATE,
+
+    /* "" strings, the first quote, two quotes which may be the start of a doc string, inside and after a backslash */
+    DOUBLE_QUOTE_STATE,
+    DOUBLE_QUOTE_2_STATE,
+    DOUBLE_STRING_STATE,
+    DOUBLE_STRING_ESCAPE_STATE,
+
+    /* '' strings */
+    SINGLE_QUOTE_STATE,
+    SINGLE_QUOTE_2_STATE,
+    SINGLE_STRING_STATE,
+    SINGLE_STRING_ESCAPE_STATE,
+
+    /* // comments, the first state checks for the rust //! and /// doc comments */
+    CC_START_STATE,
+    CC_STATE,
+    CC_CR_STATE,
+    CC_BACKSLASH_STATE,
+
+    /* ; and # comments */
+    LINE_STATE,
+    LINE_CR_STATE,
+
+    /* c comments */
+    C_STATE,
+    C_STAR_STATE,
+    C_CR_STATE,
+
+    /* rust comments, the first state checks for the ! of inner doc comments */
+    RUST_START_STATE,
+    RUST_STATE,
+    RUST_STAR_STATE,
+    RUST_SLASH_STATE,
+    RUST_CR_STATE,
+
+    /* python doc strings */
+    DOUBLE_DOC_STATE,
+    DOUBLE_DOC_1_STATE,
+    DOUBLE_DOC_2_STATE,
+    DOUBLE_DOC_CR_STATE,
+    SINGLE_DOC_STATE,
+    SINGLE_DOC_1_STATE,
+    SINGLE_DOC_2_STATE,
+    SINGLE_DOC_CR_STATE,
+
+    LEXER_STATE_COUNT
+} lexer_state;
+
+/* a transition is the next state in the low bits followed by the actions to take */
+#define TRANSITION_STATE_MASK 0x3f
+#define MAX_LEXER_STATES (TRANSITION_STATE_MASK + 1)
+
+/* count the byte towards the indentation of the next comment, tabs count as 4 */
+#define LAND_ACTION (1u << 6)
+
+/* a comment starts, the kind is in the bits above and the size of its opening delimiter in the OPENER bits
+ * the delimiter usually ends with this byte but when it is also the start of a longer one the lexer only knows which one
+ * it was some bytes later, AFTER is how many bytes of the text were already read including this one
+ */
+#define BEGIN_ACTION (1u << 7)
+#define KIND_SHIFT 8
+#define KIND_MASK (7u << KIND_SHIFT)
+
+/* the comment text up to here is a line of the comment */
+#define BREAK_ACTION (1u << 11)
+
+/* the comment ends, the last TRIM bytes before this one are the closing delimiter */
+#define END_ACTION (1u << 12)
+#define TRIM_SHIFT 13
+#define TRIM_MASK (7u << TRIM_SHIFT)
+
+/* the text of a break or an end stops at the mark instead of at this byte */
+#define AT_MARK_ACTION (1u << 16)
+
+/* remember this byte as the start of a \r\n or a backslash continuation */
+#define MARK_ACTION (1u << 17)
+
+/* this is a new line in the code so the indentation starts over
+ * NOTE: lines are not counted by the table, every \n is a new line so they are counted with count_newlines when they are needed
+ */
+#define RESET_COLUMN_ACTION (1u << 18)
+
+/* the comment text starts after this byte, used to drop the ! of doc comments */
+#define RESTART_TEXT_ACTION (1u << 19)
+
+/* write a space in place of the third / of a /// doc comment */
+#define SPACE_ACTION (1u << 20)
+
+/* nested comments, the end of a nested comment goes to the state of the transition and the end of the outermost one to code */
+#define NEST_ACTION (1u << 21)
+#define NESTED_END_ACTION (1u << 22)
+
+/* a null byte ends the input */
+#define STOP_ACTION (1u << 23)
+
+#define OPENER_SHIFT 24
+#define OPENER_MASK (15u << OPENER_SHIFT)
+#define AFTER_SHIFT 28
+#define AFTER_MASK (7u << AFTER_SHIFT)
+
+/* every byte from the mark on may be part of a \r\n or a backslash continuation */
+#define PENDING_FROM_MARK 0xff
+
+#define BEGIN(kind, opener_size) (BEGIN_ACTION | ((unsigned)(kind) << KIND_SHIFT) | ((unsigned)(opener_size) << OPENER_SHIFT))
+#define BEGIN_AFTER(count) ((unsigned)(count) << AFTER_SHIFT)
+#define TRIM(count) ((unsigned)(count) << TRIM_SHIFT)
+
+typedef struct lexer_table
+{
+    /* the number of states and byte classes that are used, the built in modes use LEXER_STATE_COUNT and BYTE_CLASS_COUNT */
+    int state_count;
+    int class_count;
+
+    unsigned char byte_classes[256];
+    DWORD transitions[MAX_LEXER_STATES][MAX_BYTE_CLASSES];
+
+    /* the bytes that leave a state or do anything besides landing so that runs of other bytes can be skipped */
+    delimiter_set skip_sets[MAX_LEXER_STATES];
+    bool can_skip[MAX_LEXER_STATES];
+
+    /* true for the states that are inside a comment */
+    bool in_comment[MAX_LEXER_STATES];
+
+    /* how many of the last bytes read may still be part of a delimiter or PENDING_FROM_MARK,
+     * the streaming lexer holds these back at the end of a chunk until it knows if they are text
+     */
+    unsigned char pending[MAX_LEXER_STATES];
+
+    /* how many of the last bytes read are after a delimiter that starts a comment unless it turns out to be the start
+     * of a longer one, they are held back at the end of a chunk because they are the start of the text if it does not
+     */
+    unsigned char read_ahead[MAX_LEXER_STATES];
+
+    /* the comment of a delimiter that was still being read when the input ended starts at the end, 0 for the other states */
+    DWORD end_transitions[MAX_LEXER_STATES];
+
+    /* comments that are not displayed are still skipped so that their contents are not lexed as code */
+    bool display[COMMENT_KIND_COUNT];
+} lexer_table;
+
+static void set_state(lexer_table *table, lexer_state state, DWORD transition)
+{
+    for (int i = 0; i < table->class_count; ++i) {
+        table->transitions[state][i] = transition;
+    }
+}
+
+static void copy_state(lexer_table *table, lexer_state destination, lexer_state source, DWORD removed_actions)
+{
+    for (int i = 0; i < table->class_count; ++i) {
+        table->transitions[destination][i] = table->transitions[source][i] & ~removed_actions;
+    }
+}
+
+static void build_string_states(lexer_table *table, byte_class quote, lexer_state first_quote, lexer_state second_quote,
+                                lexer_state string, lexer_state escape, lexer_state doc, lexer_state doc_1, lexer_state doc_2,
+                                lexer_state doc_cr, bool python)
+{
+    set_state(table, string, string);
+    table->transitions[string][quote] = CODE_STATE;
+    table->transitions[string][BACKSLASH_CLASS] = escape;
+
+    set_state(table, escape, string);
+
+    /* "" is either an empty string or the start of a doc string */
+    copy_state(table, first_quote, string, 0);
+    table->transitions[first_quote][quote] = second_quote;
+
+    /* anything but a third quote is code again */
+    copy_state(table, second_quote, CODE_STATE, 0);
+    if (!python) return;
+
+    table->transitions[second_quote][quote] = doc | BEGIN(PYTHON_DOC_COMMENT_KIND, 3);
+
+    set_state(table, doc, doc);
+    table->transitions[doc][quote] = doc_1;
+    table->transitions[doc][CARRIAGE_RETURN_CLASS] = doc_cr | MARK_ACTION;
+    table->transitions[doc][NEWLINE_CLASS] = doc | BREAK_ACTION;
+
+    copy_state(table, doc_1, doc, 0);
+    table->transitions[doc_1][quote] = doc_2;
+
+    copy_state(table, doc_2, doc, 0);
+    table->transitions[doc_2][quote] = CODE_STATE | END_ACTION | TRIM(2);
+
+    copy_state(table, doc_cr, doc, 0);
+    table->transitions[doc_cr][NEWLINE_CLASS] = doc | BREAK_ACTION | AT_MARK_ACTION;
+
+    table->in_comment[doc] = table->in_comment[doc_1] = table->in_comment[doc_2] = table->in_comment[doc_cr] = true;
+    table->pending[doc_1] = 1;
+    table->pending[doc_2] = 2;
+    table->pending[doc_cr] = PENDING_FROM_MARK;
+}
+
+/* find the bytes each state has to stop at, if there are too many of them the state is run one byte at a time */
+static void build_skip_sets(lexer_table *table)
+{
+    for (int state = 0; state < table->state_count; ++state) {
+        delimiter_set *set = &table->skip_sets[state];
+        set->count = 0;
+        table->can_skip[state] = true;
+        for (int i = 0; i < 256; ++i) {
+            DWORD transition = table->transitions[state][table->byte_classes[i]];
+            bool const plain = (transition & TRANSITION_STATE_MASK) == (DWORD)state && (transition & ~(TRANSITION_STATE_MASK | LAND_ACTION)) == 0;
+            if (plain) continue;
+
+            if (set->count == MAX_DELIMITERS) {
+                table->can_skip[state] = false;
+                break;
+            }
+            set->bytes[set->count++] = (char)i;
+        }
+    }
+}
+
+static void build_lexer_table(lexer_table *table, comment_display comment_mode)
+{
+    table->state_count = LEXER_STATE_COUNT;
+    table->class_count = BYTE_CLASS_COUNT;
+
+    bool const c_family = (comment_mode & (C_COMMENT_DISPLAY | CC_COMMENT_DISPLAY | RUST_COMMENT_DISPLAY)) != 0;
+    bool const rust = (comment_mode & RUST_COMMENT_DISPLAY) != 0;
+    bool const python = (comment_mode & PYTHON_COMMENT_DISPLAY) != 0;
+    bool const assembly = (comment_mode & ASM_COMMENT_DISPLAY) != 0;
+
+    table->display[C_COMMENT_KIND] = (comment_mode & C_COMMENT_DISPLAY) != 0;
+    table->display[CC_COMMENT_KIND] = (comment_mode & (CC_COMMENT_DISPLAY | RUST_COMMENT_DISPLAY)) != 0;
+    table->display[RUST_COMMENT_KIND] = rust;
+    table->display[ASM_COMMENT_KIND] = assembly;
+    table->display[PYTHON_DOC_COMMENT_KIND] = python;
+    table->display[PYTHON_COMMENT_KIND] = python;
+    table->display[LINE_COMMENT_KIND] = false;
+    table->display[BLOCK_COMMENT_KIND] = false;
+
+    for (int i = 0; i < 256; ++i) {
+        table->byte_classes[i] = OTHER_CLASS;
+    }
+    table->byte_classes['\0'] = NULL_CLASS;
+    table->byte_classes['\t'] = TAB_CLASS;
+    table->byte_classes['\n'] = NEWLINE_CLASS;
+    table->byte_classes['\r'] = CARRIAGE_RETURN_CLASS;
+    table->byte_classes['"'] = DOUBLE_QUOTE_CLASS;
+    table->byte_classes['\''] = SINGLE_QUOTE_CLASS;
+    table->byte_classes['/'] = SLASH_CLASS;
+    table->byte_classes['*'] = STAR_CLASS;
+    table->byte_classes['\\'] = BACKSLASH_CLASS;
+    table->byte_classes[';'] = SEMICOLON_CLASS;
+    table->byte_classes['#'] = HASH_CLASS;
+    table->byte_classes['!'] = BANG_CLASS;
+
+    /* states that are not used by this mode just stay where they are */
+    for (int i = 0; i < LEXER_STATE_COUNT; ++i) {
+        set_state(table, i, i);
+        table->in_comment[i] = false;
+        table->pending[i] = 0;
+        table->read_ahead[i] = 0;
+        table->end_transitions[i] = 0;
+    }
+
+    /* code */
+    set_state(table, CODE_STATE, CODE_STATE | LAND_ACTION);
+    table->transitions[CODE_STATE][NEWLINE_CLASS] = CODE_STATE | RESET_COLUMN_ACTION;
+    table->transitions[CODE_STATE][DOUBLE_QUOTE_CLASS] = DOUBLE_QUOTE_STATE | LAND_ACTION;
+    table->transitions[CODE_STATE][SINGLE_QUOTE_CLASS] = SINGLE_QUOTE_STATE | LAND_ACTION;
+    table->transitions[CODE_STATE][SLASH_CLASS] = SLASH_STATE | LAND_ACTION;
+    if (assembly) {
+        table->transitions[CODE_STATE][SEMICOLON_CLASS] = LINE_STATE | LAND_ACTION | BEGIN(ASM_COMMENT_KIND, 1);
+    }
+    if (python) {
+        table->transitions[CODE_STATE][HASH_CLASS] = LINE_STATE | LAND_ACTION | BEGIN(PYTHON_COMMENT_KIND, 1);
+    }
+
+    /* the byte after a / that does not start a comment is handled like code but does not count towards the indentation */
+    copy_state(table, SLASH_STATE, CODE_STATE, LAND_ACTION);
+    if (c_family) {
+        table->transitions[SLASH_STATE][SLASH_CLASS] = (rust ? CC_START_STATE : CC_STATE) | BEGIN(CC_COMMENT_KIND, 2);
+        table->transitions[SLASH_STATE][STAR_CLASS] = rust
+            ? RUST_START_STATE | BEGIN(RUST_COMMENT_KIND, 2)
+            : C_STATE | BEGIN(C_COMMENT_KIND, 2);
+    }
+
+    build_string_states(table, DOUBLE_QUOTE_CLASS, DOUBLE_QUOTE_STATE, DOUBLE_QUOTE_2_STATE, DOUBLE_STRING_STATE, DOUBLE_STRING_ESCAPE_STATE,
+                        DOUBLE_DOC_STATE, DOUBLE_DOC_1_STATE, DOUBLE_DOC_2_STATE, DOUBLE_DOC_CR_STATE, python);
+    build_string_states(table, SINGLE_QUOTE_CLASS, SINGLE_QUOTE_STATE, SINGLE_QUOTE_2_STATE, SINGLE_STRING_STATE, SINGLE_STRING_ESCAPE_STATE,
+                        SINGLE_DOC_STATE, SINGLE_DOC_1_STATE, SINGLE_DOC_2_STATE, SINGLE_DOC_CR_STATE, python);
+
+    /* // comments end at the end of the line unless it ends with a backslash */
+    set_state(table, CC_STATE, CC_STATE);
+    table->transitions[CC_STATE][NEWLINE_CLASS] = CODE_STATE | END_ACTION | RESET_COLUMN_ACTION;
+    table->transitions[CC_STATE][CARRIAGE_RETURN_CLASS] = CC_CR_STATE | MARK_ACTION;
+    table->transitions[CC_STATE][BACKSLASH_CLASS] = CC_BACKSLASH_STATE | MARK_ACTION;
+
+    copy_state(table, CC_CR_STATE, CC_STATE, 0);
+    table->transitions[CC_CR_STATE][NEWLINE_CLASS] = CODE_STATE | END_ACTION | AT_MARK_ACTION | RESET_COLUMN_ACTION;
+
+    /* NOTE: the continuation can be nested like \\\\ and have \r before the new line */
+    copy_state(table, CC_BACKSLASH_STATE, CC_STATE, 0);
+    table->transitions[CC_BACKSLASH_STATE][BACKSLASH_CLASS] = CC_BACKSLASH_STATE;
+    table->transitions[CC_BACKSLASH_STATE][CARRIAGE_RETURN_CLASS] = CC_BACKSLASH_STATE;
+    table->transitions[CC_BACKSLASH_STATE][NEWLINE_CLASS] = CC_STATE | BREAK_ACTION | AT_MARK_ACTION;
+
+    copy_state(table, CC_START_STATE, CC_STATE, 0);
+    table->transitions[CC_START_STATE][BANG_CLASS] = CC_STATE | RESTART_TEXT_ACTION;
+    table->transitions[CC_START_STATE][SLASH_CLASS] = CC_STATE | RESTART_TEXT_ACTION | SPACE_ACTION;
+
+    /* ; and # comments */
+    set_state(table, LINE_STATE, LINE_STATE);
+    table->transitions[LINE_STATE][NEWLINE_CLASS] = CODE_STATE | END_ACTION | RESET_COLUMN_ACTION;
+    table->transitions[LINE_STATE][CARRIAGE_RETURN_CLASS] = LINE_CR_STATE | MARK_ACTION;
+
+    copy_state(table, LINE_CR_STATE, LINE_STATE, 0);
+    table->transitions[LINE_CR_STATE][NEWLINE_CLASS] = CODE_STATE | END_ACTION | AT_MARK_ACTION | RESET_COLUMN_ACTION;
+
+    /* c comments */
+    set_state(table, C_STATE, C_STATE);
+    table->transitions[C_STATE][STAR_CLASS] = C_STAR_STATE;
+    table->transitions[C_STATE][CARRIAGE_RETURN_CLASS] = C_CR_STATE | MARK_ACTION;
+    table->transitions[C_STATE][NEWLINE_CLASS] = C_STATE | BREAK_ACTION;
+
+    copy_state(table, C_STAR_STATE, C_STATE, 0);
+    table->transitions[C_STAR_STATE][SLASH_CLASS] = CODE_STATE | END_ACTION | TRIM(1);
+
+    copy_state(table, C_CR_STATE, C_STATE, 0);
+    table->transitions[C_CR_STATE][NEWLINE_CLASS] = C_STATE | BREAK_ACTION | AT_MARK_ACTION;
+
+    /* rust comments */
+    set_state(table, RUST_STATE, RUST_STATE);
+    table->transitions[RUST_STATE][STAR_CLASS] = RUST_STAR_STATE;
+    table->transitions[RUST_STATE][SLASH_CLASS] = RUST_SLASH_STATE;
+    table->transitions[RUST_STATE][CARRIAGE_RETURN_CLASS] = RUST_CR_STATE | MARK_ACTION;
+    table->transitions[RUST_STATE][NEWLINE_CLASS] = RUST_STATE | BREAK_ACTION;
+
+    copy_state(table, RUST_STAR_STATE, RUST_STATE, 0);
+    table->transitions[RUST_STAR_STATE][SLASH_CLASS] = RUST_STATE | END_ACTION | NESTED_END_ACTION | TRIM(1);
+
+    copy_state(table, RUST_SLASH_STATE, RUST_STATE, 0);
+    table->transitions[RUST_SLASH_STATE][STAR_CLASS] = RUST_STATE | NEST_ACTION;
+
+    copy_state(table, RUST_CR_STATE, RUST_STATE, 0);
+    table->transitions[RUST_CR_STATE][NEWLINE_CLASS] = RUST_STATE | BREAK_ACTION | AT_MARK_ACTION;
+
+    copy_state(table, RUST_START_STATE, RUST_STATE, 0);
+    table->transitions[RUST_START_STATE][BANG_CLASS] = RUST_STATE | RESTART_TEXT_ACTION;
+
+    table->in_comment[CC_START_STATE] = table->in_comment[CC_STATE] = true;
+    table->in_comment[CC_CR_STATE] = table->in_comment[CC_BACKSLASH_STATE] = true;
+    table->in_comment[LINE_STATE] = table->in_comment[LINE_CR_STATE] = true;
+    table->in_comment[C_STATE] = table->in_comment[C_STAR_STATE] = table->in_comment[C_CR_STATE] = true;
+    table->in_comment[RUST_START_STATE] = table->in_comment[RUST_STATE] = true;
+    table->in_comment[RUST_STAR_STATE] = table->in_comment[RUST_SLASH_STATE] = table->in_comment[RUST_CR_STATE] = true;
+
+    table->pending[C_STAR_STATE] = table->pending[RUST_STAR_STATE] = 1;
+    table->pending[CC_CR_STATE] = table->pending[CC_BACKSLASH_STATE] = table->pending[LINE_CR_STATE] = PENDING_FROM_MARK;
+    table->pending[C_CR_STATE] = table->pending[RUST_CR_STATE] = PENDING_FROM_MARK;
+
+    /* a null byte ends the input in every state */
+    for (int i = 0; i < LEXER_STATE_COUNT; ++i) {
+        table->transitions[i][NULL_CLASS] = i | STOP_ACTION;
+    }
+
+    build_skip_sets(table);
+}
+
+/* the actions that still matter when only the number of comments is needed */
+#define COUNT_ACTIONS (BEGIN_ACTION | KIND_MASK | NEST_ACTION | NESTED_END_ACTION | STOP_ACTION)
+
+/* turns a table into one that only counts comments, without the actions for the output most states that only
+ * exist to find the end of a line or a \r\n behave the same, they are merged so that the skip sets get smaller
+ */
+static void build_count_table(lexer_table *table)
+{
+    for (int state = 0; state < table->state_count; ++state) {
+        for (int i = 0; i < table->class_count; ++i) {
+            table->transitions[state][i] &= TRANSITION_STATE_MASK | COUNT_ACTIONS;
+        }
+        table->end_transitions[state] &= TRANSITION_STATE_MASK | COUNT_ACTIONS;
+    }
+    for (int i = 0; i < COMMENT_KIND_COUNT; ++i) {
+        table->display[i] = false;
+    }
+
+    /* NOTE: two states are the same if every byte class has the same actions and goes to states that are the same,
+     * start with the states grouped by what they do at the end of the input and split the groups until nothing changes
+     */
+    unsigned char group[MAX_LEXER_STATES];
+    for (int state = 0; state < table->state_count; ++state) {
+        DWORD const end_transition = table->end_transitions[state];
+        group[state] = (end_transition & BEGIN_ACTION) ? (unsigned char)(1 + ((end_transition & KIND_MASK) >> KIND_SHIFT)) : 0;
+    }
+    for (bool changed = true; changed; ) {
+        changed = false;
+
+        unsigned char next_group[MAX_LEXER_STATES];
+        int group_count = 0;
+        for (int state = 0; state < table->state_count; ++state) {
+            next_group[state] = (unsigned char)group_count;
+            for (int other = 0; other < state; ++other) {
+                bool same = group[state] == group[other];
+                for (int i = 0; same && i < table->class_count; ++i) {
+                    DWORD a = table->transitions[state][i];
+                    DWORD b = table->transitions[other][i];
+                    same = (a & ~TRANSITION_STATE_MASK) == (b & ~TRANSITION_STATE_MASK)
+                        && group[a & TRANSITION_STATE_MASK] == group[b & TRANSITION_STATE_MASK];
+                }
+
+                if (same) {
+                    next_group[state] = next_group[other];
+                    break;
+                }
+            }
+
+            if (next_group[state] == group_count) {
+                ++group_count;
+            }
+        }
+
+        for (int state = 0; state < table->state_count; ++state) {
+            changed |= next_group[state] != group[state];
+            group[state] = next_group[state];
+        }
+    }
+
+    /* send every transition to the first state of its group */
+    for (int state = 0; state < table->state_count; ++state) {
+        for (int i = 0; i < table->class_count; ++i) {
+            DWORD transition = table->transitions[state][i];
+            int target = 0;
+            while (group[target] != group[transition & TRANSITION_STATE_MASK]) {
+                ++target;
+            }
+            table->transitions[state][i] = (transition & ~TRANSITION_STATE_MASK) | target;
+        }
+    }
+
+    build_skip_sets(table);
+}
+
+/* the languages of a definitions file, see parse_language_definitions for the format
+ * NOTE: a delimiter is matched wherever it is in the code so a language can only have comments and strings
+ * that start with a fixed sequence of bytes and end with one or at the end of the line
+ */
+#define MAX_DELIMITER_SIZE 8
+#define MAX_LANGUAGE_DELIMITERS 16
+#define MAX_LANGUAGE_NAME_SIZE 15
+
+typedef enum delimiter_type
+{
+    LINE_COMMENT_DELIMITER,
+    BLOCK_COMMENT_DELIMITER,
+    NESTED_COMMENT_DELIMITER,
+    STRING_DELIMITER
+} delimiter_type;
+
+typedef struct language_delimiter
+{
+    delimiter_type type;
+    char opener[MAX_DELIMITER_SIZE];
+    unsigned char opener_size;
+
+    /* line comments do not have a closer, escape is the byte that makes the next one part of a string or 0 */
+    char closer[MAX_DELIMITER_SIZE];
+    unsigned char closer_size;
+    char escape;
+} language_delimiter;
+
+typedef struct language_definition
+{
+    char name[MAX_LANGUAGE_NAME_SIZE + 1];
+    language_delimiter delimiters[MAX_LANGUAGE_DELIMITERS];
+    size_t delimiter_count;
+} language_definition;
+
+/* a delimiter that one of the matchers of build_language_table looks for and what happens when it is found */
+typedef struct delimiter_pattern
+{
+    char const *bytes;
+    size_t size;
+    DWORD transition;
+} delimiter_pattern;
+
+/* the part of a delimiter each state of a matcher has seen */
+typedef struct language_builder
+{
+    char prefixes[MAX_LEXER_STATES][MAX_DELIMITER_SIZE];
+    unsigned char prefix_sizes[MAX_LEXER_STATES];
+
+    /* a byte of each class, the classes before the first one of the delimiters are never part of one */
+    unsigned char class_bytes[MAX_BYTE_CLASSES];
+    int first_delimiter_class;
+} language_builder;
+
+/* returns the new state or -1 if there are too many */
+static int add_language_state(lexer_table *table)
+{
+    if (table->state_count == MAX_LEXER_STATES) {
+        return -1;
+    }
+
+    int const state = table->state_count++;
+    set_state(table, state, state);
+    table->in_comment[state] = false;
+    table->pending[state] = 0;
+    table->read_ahead[state] = 0;
+    table->end_transitions[state] = 0;
+    return state;
+}
+
+static bool bytes_equal(char const *a, char const *b, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+/* the state of the matcher from first to last that has seen prefix or -1 */
+static int find_prefix_state(language_builder const *builder, int first, int last, char const *prefix, size_t size)
+{
+    for (int state = first; state < last; ++state) {
+        if (builder->prefix_sizes[state] == size && bytes_equal(builder->prefixes[state], prefix, size)) {
+            return state;
+        }
+    }
+    return -1;
+}
+
+/* builds the states that find patterns in the input from root, it is an aho-corasick automaton that is turned into a table:
+ * there is a state for every start of a pattern and a byte that does not continue one goes to where the longest end
+ * of what was seen so far that does would have gone
+ * in code a pattern that is also the start of a longer one is only known to be the shorter one when the longer one
+ * fails to match, the comment then starts AFTER the bytes that were read ahead and those have to be plain text of it
+ * the rows of root and of the states the patterns lead to have to be filled in before this is called
+ * returns a description of what went wrong or NULL
+ */
+static char const *build_matcher(lexer_table *table, language_builder *builder, int root, delimiter_pattern const *patterns,
+                                 size_t pattern_count, bool in_code)
+{
+    builder->prefix_sizes[root] = 0;
+
+    /* a state for every start of a pattern, shortest first so that the states they fall back to are built before them */
+    int const first = table->state_count;
+    for (size_t size = 1; size < MAX_DELIMITER_SIZE; ++size) {
+        for (size_t i = 0; i < pattern_count; ++i) {
+            delimiter_pattern const *pattern = &patterns[i];
+            if (pattern->size <= size || find_prefix_state(builder, first, table->state_count, pattern->bytes, size) >= 0) continue;
+
+            /* NOTE: inside a comment or a string a pattern ends as soon as it is seen so nothing after it needs a state */
+            bool reachable = true;
+            for (size_t j = 0; j < pattern_count && !in_code; ++j) {
+                reachable &= patterns[j].size > size || !bytes_equal(patterns[j].bytes, pattern->bytes, patterns[j].size);
+            }
+            if (!reachable) continue;
+
+            int const state = add_language_state(table);
+            if (state < 0) {
+                return "the language has too many delimiters";
+            }
+            for (size_t j = 0; j < size; ++j) {
+                builder->prefixes[state][j] = pattern->bytes[j];
+            }
+            builder->prefix_sizes[state] = (unsigned char)size;
+            table->in_comment[state] = table->in_comment[root];
+            table->pending[state] = table->in_comment[root] ? (unsigned char)size : 0;
+        }
+    }
+    int const last = table->state_count;
+
+    for (int state = root; state < last; state = state == root ? first : state + 1) {
+        char seen[MAX_DELIMITER_SIZE];
+        size_t const size = builder->prefix_sizes[state];
+        for (size_t i = 0; i < size; ++i) {
+            seen[i] = builder->prefixes[state][i];
+        }
+
+        /* in code the longest pattern that what was seen starts with and the state a byte that continues nothing falls back to */
+        delimiter_pattern const *read_ahead = NULL;
+        for (size_t i = 0; i < pattern_count && in_code; ++i) {
+            if (patterns[i].size <= size && bytes_equal(patterns[i].bytes, seen, patterns[i].size)
+                && (read_ahead == NULL || patterns[i].size > read_ahead->size)) {
+                read_ahead = &patterns[i];
+            }
+        }
+        int fallback = root;
+        for (size_t suffix = 1; suffix < size && fallback == root; ++suffix) {
+            int const found = find_prefix_state(builder, first, last, seen + suffix, size - suffix);
+            if (found >= 0) {
+                fallback = found;
+            }
+        }
+
+        if (read_ahead != NULL && (read_ahead->transition & BEGIN_ACTION)) {
+            table->read_ahead[state] = (unsigned char)(size - read_ahead->size);
+            table->end_transitions[state] = read_ahead->transition | BEGIN_AFTER(size - read_ahead->size + 1);
+        }
+
+        for (int class = 0; class < table->class_count; ++class) {
+            DWORD transition;
+            delimiter_pattern const *exact = NULL;
+            bool longer = false;
+            if (class >= builder->first_delimiter_class) {
+                seen[size] = (char)builder->class_bytes[class];
+                for (size_t i = 0; i < pattern_count; ++i) {
+                    if (patterns[i].size == size + 1 && bytes_equal(patterns[i].bytes, seen, size + 1)) {
+                        exact = &patterns[i];
+                    }
+                    else if (patterns[i].size > size + 1 && bytes_equal(patterns[i].bytes, seen, size + 1)) {
+                        longer = true;
+                    }
+                }
+            }
+
+            if (exact != NULL && !(in_code && longer)) {
+                transition = exact->transition;
+            }
+            else if (exact != NULL || longer) {
+                transition = find_prefix_state(builder, first, last, seen, size + 1);
+            }
+            else if (state == root) {
+                continue;
+            }
+            else if (read_ahead != NULL) {
+                /* run what was read after the shorter pattern through the state it leads to and then this byte */
+                int next = read_ahead->transition & TRANSITION_STATE_MASK;
+                for (size_t i = read_ahead->size; i < size; ++i) {
+                    DWORD const step = table->transitions[next][table->byte_classes[(unsigned char)seen[i]]];
+                    if (step & ~(TRANSITION_STATE_MASK | LAND_ACTION)) {
+                        return "the delimiters of the language overlap";
+                    }
+                    next = step & TRANSITION_STATE_MASK;
+                }
+
+                transition = table->transitions[next][class];
+                DWORD const actions = read_ahead->transition & ~TRANSITION_STATE_MASK;
+                if (actions != 0) {
+                    if (transition & BEGIN_ACTION) {
+                        return "the delimiters of the language overlap";
+                    }
+                    transition = (transition & ~LAND_ACTION) | actions | BEGIN_AFTER(size - read_ahead->size + 1);
+                }
+            }
+            else {
+                transition = table->transitions[fallback][class] & ~LAND_ACTION;
+            }
+
+            /* the first byte of a delimiter counts towards the indentation like in the built in modes */
+            if (state == root && in_code) {
+                transition |= LAND_ACTION;
+            }
+            table->transitions[state][class] = transition;
+        }
+    }
+    return NULL;
+}
+
+/* the rows of a comment that ends at root with patterns are filled in by build_matcher, cr is the state after a \r */
+static void build_comment_body(lexer_table *table, int root, int cr, DWORD line_end)
+{
+    set_state(table, root, root);
+    table->transitions[root][NEWLINE_CLASS] = line_end;
+    table->transitions[root][CARRIAGE_RETURN_CLASS] = cr | MARK_ACTION;
+    table->in_comment[root] = table->in_comment[cr] = true;
+    table->pending[cr] = PENDING_FROM_MARK;
+}
+
+/* the \r of a \r\n is not part of the text of a line */
+static void build_comment_cr(lexer_table *table, int root, int cr, DWORD line_end)
+{
+    copy_state(table, cr, root, 0);
+    table->transitions[cr][NEWLINE_CLASS] = line_end | AT_MARK_ACTION;
+}
+
+/* compiles the delimiters of a language into a table for the same lexer as the built in modes,
+ * returns a description of what went wrong or NULL
+ */
+static char const *build_language_table(lexer_table *table, language_definition const *language)
+{
+    table->state_count = 0;
+    table->class_count = CARRIAGE_RETURN_CLASS + 1;
+    for (int i = 0; i < COMMENT_KIND_COUNT; ++i) {
+        table->display[i] = i == LINE_COMMENT_KIND || i == BLOCK_COMMENT_KIND;
+    }
+
+    language_builder *builder = HeapAlloc(GetProcessHeap(), 0, sizeof(language_builder));
+    if (builder == NULL) {
+        return "could not allocate memory for the language";
+    }
+    builder->first_delimiter_class = table->class_count;
+
+    for (int i = 0; i < 256; ++i) {
+        table->byte_classes[i] = OTHER_CLASS;
+    }
+    table->byte_classes['\0'] = NULL_CLASS;
+    table->byte_classes['\t'] = TAB_CLASS;
+    table->byte_classes['\n'] = NEWLINE_CLASS;
+    table->byte_classes['\r'] = CARRIAGE_RETURN_CLASS;
+
+    /* every byte that is part of a delimiter gets a class of its own */
+    char const *error = NULL;
+    for (size_t i = 0; i < language->delimiter_count && error == NULL; ++i) {
+        language_delimiter const *delimiter = &language->delimiters[i];
+        char bytes[MAX_DELIMITER_SIZE * 2 + 1];
+        size_t size = 0;
+        for (size_t j = 0; j < delimiter->opener_size; ++j) {
+            bytes[size++] = delimiter->opener[j];
+        }
+        for (size_t j = 0; j < delimiter->closer_size; ++j) {
+            bytes[size++] = delimiter->closer[j];
+        }
+        if (delimiter->escape != '\0') {
+            bytes[size++] = delimiter->escape;
+        }
+
+        for (size_t j = 0; j < size; ++j) {
+            unsigned char const byte = (unsigned char)bytes[j];
+            if (table->byte_classes[byte] != OTHER_CLASS) continue;
+
+            if (table->class_count == MAX_BYTE_CLASSES) {
+                error = "the delimiters of the language use too many different bytes";
+                break;
+            }
+            builder->class_bytes[table->class_count] = byte;
+            table->byte_classes[byte] = (unsigned char)table->class_count++;
+        }
+    }
+
+    /* code is the first state like in the built in modes */
+    int const code = add_language_state(table);
+    set_state(table, code, code | LAND_ACTION);
+    table->transitions[code][NEWLINE_CLASS] = code | RESET_COLUMN_ACTION;
+
+    /* every line comment ends the same way so they share their states */
+    int line = -1;
+    for (size_t i = 0; i < language->delimiter_count && error == NULL && line < 0; ++i) {
+        if (language->delimiters[i].type == LINE_COMMENT_DELIMITER) {
+            line = add_language_state(table);
+            int const cr = add_language_state(table);
+            if (cr < 0) {
+                error = "the language has too many delimiters";
+                break;
+            }
+
+            DWORD const line_end = code | END_ACTION | RESET_COLUMN_ACTION;
+            build_comment_body(table, line, cr, line_end);
+            build_comment_cr(table, line, cr, line_end);
+        }
+    }
+
+    delimiter_pattern openers[MAX_LANGUAGE_DELIMITERS];
+    for (size_t i = 0; i < language->delimiter_count && error == NULL; ++i) {
+        language_delimiter const *delimiter = &language->delimiters[i];
+        openers[i] = (delimiter_pattern) { .bytes = delimiter->opener, .size = delimiter->opener_size };
+        for (size_t j = 0; j < i; ++j) {
+            if (openers[j].size == openers[i].size && bytes_equal(openers[j].bytes, openers[i].bytes, openers[i].size)) {
+                error = "two delimiters of the language start the same way";
+            }
+        }
+        if (error != NULL) break;
+
+        if (delimiter->type == LINE_COMMENT_DELIMITER) {
+            openers[i].transition = line | BEGIN(LINE_COMMENT_KIND, delimiter->opener_size);
+            continue;
+        }
+
+        int const root = add_language_state(table);
+        int const other = add_language_state(table);
+        if (other < 0) {
+            error = "the language has too many delimiters";
+            break;
+        }
+
+        delimiter_pattern closers[2] = { { .bytes = delimiter->closer, .size = delimiter->closer_size, .transition = code } };
+        size_t closer_count = 1;
+        if (delimiter->type == STRING_DELIMITER) {
+            /* other is the state after the escape, the byte after it is always part of the string */
+            set_state(table, root, root);
+            if (delimiter->escape != '\0') {
+                table->transitions[root][table->byte_classes[(unsigned char)delimiter->escape]] = other;
+            }
+            set_state(table, other, root);
+            openers[i].transition = root;
+        }
+        else {
+            /* other is the state after a \r, a nested comment ends where it started unless it is the outermost one */
+            build_comment_body(table, root, other, root | BREAK_ACTION);
+            closers[0].transition = code | END_ACTION | TRIM(delimiter->closer_size - 1);
+            if (delimiter->type == NESTED_COMMENT_DELIMITER) {
+                closers[0].transition = root | END_ACTION | NESTED_END_ACTION | TRIM(delimiter->closer_size - 1);
+                closers[closer_count++] = (delimiter_pattern) { .bytes = delimiter->opener, .size = delimiter->opener_size, .transition = root | NEST_ACTION };
+            }
+            openers[i].transition = root | BEGIN(BLOCK_COMMENT_KIND, delimiter->opener_size);
+        }
+
+        error = build_matcher(table, builder, root, closers, closer_count, false);
+        if (error == NULL && delimiter->type != STRING_DELIMITER) {
+            build_comment_cr(table, root, other, root | BREAK_ACTION);
+        }
+    }
+
+    if (error == NULL) {
+        error = build_matcher(table, builder, code, openers, language->delimiter_count, true);
+    }
+    HeapFree(GetProcessHeap(), 0, builder);
+    if (error != NULL) {
+        return error;
+    }
+
+    /* a null byte ends the input in every state */
+    for (int i = 0; i < table->state_count; ++i) {
+        table->transitions[i][NULL_CLASS] = i | STOP_ACTION;
+    }
+
+    build_skip_sets(table);
+    return NULL;
+}
+
+
+/* where the lexer reports the comments it finds, the text of a comment comes in pieces
+ * that are only valid until the call returns because they can point into text that was held back from an earlier chunk
+ */
+typedef struct comment_sink
+{
+    /* a comment starts at the offset begin on line, column is the indentation of the code before it since the last comment */
+    void (*begin)(void *context, comment_kind kind, ULONGLONG begin, size_t line, size_t column);
+
+    /* a piece of the text of the current line of the comment */
+    void (*text)(void *context, char const *text, size_t size);
+
+    /* the current line of the comment ends on line and the text after this is on the next one */
+    void (*line_end)(void *context, size_t line);
+
+    /* the comment ends on line right before the offset end */
+    void (*end)(void *context, ULONGLONG end, size_t line);
+
+    /* the third / of a /// comment is reported as a space */
+    bool doc_space;
+} comment_sink;
+
+/* the lexer can be fed its input in chunks, everything it needs to continue in the next chunk is kept in here */
+typedef struct comment_lexer
+{
+    lexer_table const *table;
+    comment_sink const *sink;
+    void *context;
+
+    lexer_state state;
+    comment_count count;
+
+    /* the indentation of the next comment */
+    size_t column;
+
+    /* the line of the byte at line_offset, lines are only counted up to where one is needed and only when count_lines is set */
+    size_t line;
+    ULONGLONG line_offset;
+    bool count_lines;
+
+    /* the comment that is being read and how deep rust comments are nested */
+    comment_kind kind;
+    bool display;
+    size_t depth;
+
+    /* NOTE: these are offsets from the start of the input because the text of a comment can start in an earlier chunk
+     * offset is where the current chunk starts, text_begin is where the text of the comment starts
+     * and mark is where a \r\n or a backslash continuation that may end the text started
+     */
+    ULONGLONG offset;
+    ULONGLONG text_begin;
+    ULONGLONG mark;
+
+    /* the comment text right before offset that could not be reported yet because it may be part of a delimiter */
+    char *held;
+    size_t held_size;
+    size_t held_capacity;
+
+    /* a null byte ends the input, anything after it is ignored, the sink can also stop the lexer with lexer_stop */
+    bool stopped;
+
+    /* the memory for the held text could not be allocated, nothing else is reported */
+    bool failed;
+} comment_lexer;
+
+/* the lines passed to the sink are 0 unless count_lines is set,
+ * a lexer that only counts gets a table from build_count_table and no sink and has to be fed with lexer_count
+ */
+static void lexer_init(comment_lexer *lexer, lexer_table const *table, comment_sink const *sink, void *context, bool count_lines)
+{
+    *lexer = (comment_lexer) {
+        .table = table,
+        .sink = sink,
+        .context = context,
+        .state = CODE_STATE,
+        .line = 1,
+        .count_lines = count_lines
+    };
+}
+
+/* starts the lexer at the offset begin of the input on line instead of at the start, in state with depth nested comments
+ * NOTE: this is for a lexer that reads a part of the input that starts right after a new line,
+ * in code nothing is carried over from before a new line except the state and the depth
+ */
+static void lexer_start_at(comment_lexer *lexer, ULONGLONG begin, size_t line, lexer_state state, size_t depth)
+{
+    lexer->offset = begin;
+    lexer->line_offset = begin;
+    lexer->line = line;
+    lexer->state = state;
+    lexer->depth = depth;
+}
+
+/* called by the sink when it does not need any more comments, the input after the one that just ended is ignored */
+static void lexer_stop(comment_lexer *lexer)
+{
+    lexer->stopped = true;
+}
+
+/* reports the input between the offsets begin and end, the part before the current chunk comes from the held text */
+static void lexer_output_text(comment_lexer *lexer, char const *chunk, ULONGLONG begin, ULONGLONG end)
+{
+    if (begin < lexer->offset) {
+        ULONGLONG held_end = end < lexer->offset ? end : lexer->offset;
+        char const *held = lexer->held + lexer->held_size - (size_t)(lexer->offset - begin);
+        lexer->sink->text(lexer->context, held, (size_t)(held_end - begin));
+        begin = held_end;
+    }
+
+    if (begin < end) {
+        lexer->sink->text(lexer->context, chunk + (size_t)(begin - lexer->offset), (size_t)(end - begin));
+    }
+}
+
+#define LINE_COUNT_SCALAR_SIZE 64
+
+/* returns the line of the byte at offset in chunk or 0 if lines are not needed,
+ * the newlines since the last offset that was asked for are counted with simd so the lexer does not have to stop at them
+ */
+static size_t lexer_line(comment_lexer *lexer, char const *chunk, ULONGLONG offset)
+{
+    if (!lexer->count_lines) {
+        return 0;
+    }
+
+    char const *first = chunk + (size_t)(lexer->line_offset - lexer->offset);
+    char const *last = chunk + (size_t)(offset - lexer->offset);
+    if (last - first <= LINE_COUNT_SCALAR_SIZE) {
+        /* comments usually come one per line or closer, a short span is counted here instead of calling the kernel */
+        for (; first < last; ++first) {
+            lexer->line += *first == '\n';
+        }
+    }
+    else {
+        lexer->line += count_newlines(first, last);
+    }
+    lexer->line_offset = offset;
+    return lexer->line;
+}
+
+/* keeps the input from the offset begin to the end of the chunk for the next chunk, returns false when out of memory */
+static bool lexer_hold_text(comment_lexer *lexer, char const *chunk, size_t chunk_size, ULONGLONG begin)
+{
+    ULONGLONG const end = lexer->offset + chunk_size;
+    size_t const size = (size_t)(end - begin);
+    if (size > lexer->held_capacity) {
+        size_t capacity = size < 16 ? 16 : size * 2;
+        char *held = lexer->held == NULL
+            ? HeapAlloc(GetProcessHeap(), 0, capacity)
+            : HeapReAlloc(GetProcessHeap(), 0, lexer->held, capacity);
+        if (held == NULL) {
+            return false;
+        }
+        lexer->held = held;
+        lexer->held_capacity = capacity;
+    }
+
+    /* move the part that was already held to the front and then add the part from this chunk */
+    size_t held_size = 0;
+    if (begin < lexer->offset) {
+        char const *first = lexer->held + lexer->held_size - (size_t)(lexer->offset - begin);
+        for (; held_size != (size_t)(lexer->offset - begin); ++held_size) {
+            lexer->held[held_size] = first[held_size];
+        }
+        begin = lexer->offset;
+    }
+
+    for (char const *first = chunk + (size_t)(begin - lexer->offset); first != chunk + chunk_size; ++first) {
+        lexer->held[held_size++] = *first;
+    }
+    lexer->held_size = held_size;
+    return true;
+}
+
+static void count_comment(comment_count *count, comment_kind kind)
+{
+    switch (kind) {
+        case C_COMMENT_KIND:
+            ++count->c_comment_count;
+            break;
+        case CC_COMMENT_KIND:
+            ++count->cc_comment_count;
+            ++count->rust_comment_count;
+            break;
+        case RUST_COMMENT_KIND:
+            ++count->rust_comment_count;
+            break;
+        case ASM_COMMENT_KIND:
+            ++count->asm_comment_count;
+            break;
+        case LINE_COMMENT_KIND:
+            ++count->line_comment_count;
+            break;
+        case BLOCK_COMMENT_KIND:
+            ++count->block_comment_count;
+            break;
+        default:
+            ++count->python_comment_count;
+            break;
+    }
+}
+
+/* starts the comment of a transition with BEGIN_ACTION at the byte at pos_offset, returns the indentation of the next comment */
+static size_t lexer_begin(comment_lexer *lexer, char const *chunk, DWORD transition, ULONGLONG pos_offset, size_t column)
+{
+    lexer->kind = (transition & KIND_MASK) >> KIND_SHIFT;
+    lexer->display = lexer->table->display[lexer->kind];
+    lexer->text_begin = pos_offset + 1 - ((transition & AFTER_MASK) >> AFTER_SHIFT);
+    lexer->depth = 0;
+    count_comment(&lexer->count, lexer->kind);
+
+    if (lexer->display) {
+        ULONGLONG const begin = lexer->text_begin - ((transition & OPENER_MASK) >> OPENER_SHIFT);
+        lexer->sink->begin(lexer->context, lexer->kind, begin, lexer_line(lexer, chunk, pos_offset), column);
+        return 0;
+    }
+    return column;
+}
+
+/* a comment that is still open at the end of the input ends there, so does one whose delimiter was still being read */
+static void lexer_end_input(comment_lexer *lexer, char const *chunk, ULONGLONG end)
+{
+    DWORD const transition = lexer->table->end_transitions[lexer->state];
+    if (transition & BEGIN_ACTION) {
+        lexer->column = lexer_begin(lexer, chunk, transition, end, lexer->column);
+        lexer->state = transition & TRANSITION_STATE_MASK;
+    }
+
+    if (lexer->table->in_comment[lexer->state] && lexer->display) {
+        lexer_output_text(lexer, chunk, lexer->text_begin, end);
+        lexer->sink->end(lexer->context, end, lexer_line(lexer, chunk, end));
+    }
+    lexer->state = CODE_STATE;
+}
+
+/* returns false when the lexer ran out of memory, the input after that is ignored
+ * NOTE: str does not need to be null terminated, a null byte is still treated as the end of the input
+ */
+static bool lexer_feed(comment_lexer *lexer, char const *str, size_t size)
+{
+    if (lexer->stopped) return !lexer->failed;
+
+    lexer_table const *const table = lexer->table;
+    comment_sink const *const sink = lexer->sink;
+    void *const context = lexer->context;
+    ULONGLONG const offset = lexer->offset;
+
+    char const *pos = str;
+    char const *const end = str + size;
+
+    lexer_state state = lexer->state;
+    size_t column = lexer->column;
+    comment_kind kind = lexer->kind;
+    bool display = lexer->display;
+
+    /* NOTE: the first byte of the input always counts as one */
+    if (offset == 0 && size != 0 && *str == '\t') {
+        column -= 3;
+    }
+
+    while (pos < end) {
+        /* skip the bytes that do not leave the state, in code they only count towards the indentation */
+        if (table->can_skip[state]) {
+            size_t tab_count;
+            char const *next = find_delimiter(pos, end, &table->skip_sets[state], state == CODE_STATE ? &tab_count : NULL);
+            if (state == CODE_STATE) {
+                column += (size_t)(next - pos) + tab_count * 3;
+            }
+            pos = next;
+            if (pos == end) break;
+        }
+
+        byte_class const class = table->byte_classes[(unsigned char)*pos];
+        DWORD const transition = table->transitions[state][class];
+        state = transition & TRANSITION_STATE_MASK;
+
+        if (transition & ~TRANSITION_STATE_MASK) {
+            ULONGLONG const pos_offset = offset + (size_t)(pos - str);
+
+            if (transition & STOP_ACTION) {
+                lexer->state = state;
+                lexer->column = column;
+                lexer->kind = kind;
+                lexer->display = display;
+                lexer_end_input(lexer, str, pos_offset);
+                lexer->stopped = true;
+                break;
+            }
+
+            if (transition & LAND_ACTION) {
+                column += class == TAB_CLASS ? 4 : 1;
+            }
+
+            if (transition & BEGIN_ACTION) {
+                column = lexer_begin(lexer, str, transition, pos_offset, column);
+                kind = lexer->kind;
+                display = lexer->display;
+            }
+
+            if (transition & MARK_ACTION) {
+                lexer->mark = pos_offset;
+            }
+
+            if (transition & RESTART_TEXT_ACTION) {
+                lexer->text_begin = pos_offset + 1;
+                if (display && (transition & SPACE_ACTION) && sink->doc_space) {
+                    sink->text(context, " ", 1);
+                }
+            }
+
+            if (transition & NEST_ACTION) {
+                ++lexer->depth;
+            }
+
+            if ((transition & END_ACTION) && (transition & NESTED_END_ACTION) && lexer->depth != 0) {
+                /* closing a nested comment keeps it as part of the text */
+                --lexer->depth;
+            }
+            else if (transition & (BREAK_ACTION | END_ACTION)) {
+                ULONGLONG text_end = (transition & AT_MARK_ACTION) ? lexer->mark : pos_offset - ((transition & TRIM_MASK) >> TRIM_SHIFT);
+                if (display) {
+                    lexer_output_text(lexer, str, lexer->text_begin, text_end);
+
+                    /* comments that end at the end of a line end where their text does */
+                    if (transition & END_ACTION) {
+                        sink->end(context, class == NEWLINE_CLASS ? text_end : pos_offset + 1, lexer_line(lexer, str, pos_offset));
+                        if (lexer->stopped) break;
+                    }
+                    else {
+                        sink->line_end(context, lexer_line(lexer, str, pos_offset));
+                    }
+                }
+                lexer->text_begin = pos_offset + 1;
+                if (transition & NESTED_END_ACTION) {
+                    state = CODE_STATE;
+                }
+            }
+
+            if (transition & RESET_COLUMN_ACTION) {
+                column = 0;
+            }
+        }
+
+        ++pos;
+    }
+
+    if (!lexer->stopped) {
+        lexer->state = state;
+        lexer->column = column;
+        lexer->kind = kind;
+        lexer->display = display;
+
+        /* report the text of the comment that is known to be text and hold back what may be part of a delimiter */
+        if (table->in_comment[state] && display) {
+            ULONGLONG const chunk_end = offset + size;
+            ULONGLONG keep = table->pending[state] == PENDING_FROM_MARK ? lexer->mark : chunk_end - table->pending[state];
+            if (keep < lexer->text_begin) {
+                keep = lexer->text_begin;
+            }
+
+            lexer_output_text(lexer, str, lexer->text_begin, keep);
+            if (!lexer_hold_text(lexer, str, size, keep)) {
+                lexer->failed = lexer->stopped = true;
+            }
+            lexer->text_begin = keep;
+        }
+        else if (table->read_ahead[state] != 0) {
+            /* NOTE: there are never more bytes read ahead than what was in this chunk and what was held from the last one */
+            if (!lexer_hold_text(lexer, str, size, offset + size - table->read_ahead[state])) {
+                lexer->failed = lexer->stopped = true;
+            }
+        }
+        else {
+            lexer->held_size = 0;
+        }
+    }
+
+    /* the newlines of this chunk have to be counted before it is gone */
+    lexer_line(lexer, str, offset + size);
+    lexer->offset = offset + size;
+    return !lexer->failed;
+}
+
+/* the same as lexer_feed without a sink, only the starts and ends of comments are looked for */
+static void lexer_count(comment_lexer *lexer, char const *str, size_t size)
+{
+    if (lexer->stopped) return;
+
+    lexer_table const *const table = lexer->table;
+    char const *pos = str;
+    char const *const end = str + size;
+    lexer_state state = lexer->state;
+    comment_count count = lexer->count;
+
+    while (pos < end) {
+        if (table->can_skip[state]) {
+            pos = find_delimiter(pos, end, &table->skip_sets[state], NULL);
+            if (pos == end) break;
+        }
+
+        DWORD const transition = table->transitions[state][table->byte_classes[(unsigned char)*pos]];
+        state = transition & TRANSITION_STATE_MASK;
+
+        if (transition & ~TRANSITION_STATE_MASK) {
+            if (transition & STOP_ACTION) {
+                /* NOTE: lexer_finish does not end the input of a lexer that stopped, the delimiter that was being read is counted here */
+                if (table->end_transitions[state] & BEGIN_ACTION) {
+                    count_comment(&count, (table->end_transitions[state] & KIND_MASK) >> KIND_SHIFT);
+                }
+                lexer->stopped = true;
+                break;
+            }
+
+            if (transition & BEGIN_ACTION) {
+                lexer->depth = 0;
+                count_comment(&count, (transition & KIND_MASK) >> KIND_SHIFT);
+            }
+
+            if (transition & NEST_ACTION) {
+                ++lexer->depth;
+            }
+
+            if (transition & NESTED_END_ACTION) {
+                if (lexer->depth != 0) {
+                    --lexer->depth;
+                }
+                else {
+                    state = CODE_STATE;
+                }
+            }
+        }
+
+        ++pos;
+    }
+
+    lexer->state = state;
+    lexer->count = count;
+    lexer->offset += size;
+}
+
+/* the state a part of the input leaves a count table in for every state it could start in, see lexer_speculate */
+typedef struct lexer_speculation
+{
+    /* the state and depth at the end for a start in each state that can follow a new line with nothing nested */
+    unsigned char end_states[MAX_LEXER_STATES];
+    size_t end_depths[MAX_LEXER_STATES];
+
+    /* a null byte ends the input in this part */
+    bool stopped;
+} lexer_speculation;
+
+/* the bytes that any of states has to stop at, returns false if there are too many of them to skip the others */
+static bool merge_skip_sets(lexer_table const *table, lexer_state const *states, int count, delimiter_set *result)
+{
+    result->count = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!table->can_skip[states[i]]) {
+            return false;
+        }
+
+        delimiter_set const *set = &table->skip_sets[states[i]];
+        for (int j = 0; j < set->count; ++j) {
+            int k = 0;
+            while (k < result->count && result->bytes[k] != set->bytes[j]) {
+                ++k;
+            }
+            if (k == result->count) {
+                if (result->count == MAX_DELIMITERS) {
+                    return false;
+                }
+                result->bytes[result->count++] = set->bytes[j];
+            }
+        }
+    }
+    return true;
+}
+
+/* runs a count table over a part of the input that starts right after a new line from every state that can follow one,
+ * the state the part really starts in is only known once the parts before it are read but then where it ends is known too
+ * NOTE: the states are run together and stop at the bytes of all their skip sets, starts that reach the same state
+ * and depth are merged so in most code there are only one or two left after the first few lines
+ */
+static void lexer_speculate(lexer_table const *table, char const *str, size_t size, lexer_speculation *result)
+{
+    /* the states and depths that are still being run and which of them each start is in */
+    lexer_state states[MAX_LEXER_STATES];
+    size_t depths[MAX_LEXER_STATES];
+    unsigned char runs[MAX_LEXER_STATES];
+    int run_count = 0;
+
+    byte_class const newline_class = table->byte_classes['\n'];
+    for (int state = 0; state < table->state_count; ++state) {
+        runs[state] = MAX_LEXER_STATES;
+    }
+    for (int state = 0; state < table->state_count; ++state) {
+        lexer_state const start = table->transitions[state][newline_class] & TRANSITION_STATE_MASK;
+        if (runs[start] == MAX_LEXER_STATES) {
+            runs[start] = (unsigned char)run_count;
+            states[run_count] = start;
+            depths[run_count] = 0;
+            ++run_count;
+        }
+    }
+    result->stopped = false;
+
+    /* NOTE: which states are being run is kept as a bit set, the skip set only changes when it does
+     * and not when two runs swap states like they do in and out of strings
+     */
+    DWORD active[MAX_LEXER_STATES / 32] = { 0 };
+    for (int i = 0; i < run_count; ++i) {
+        active[states[i] / 32] |= 1u << (states[i] % 32);
+    }
+    delimiter_set skip_set;
+    bool can_skip = merge_skip_sets(table, states, run_count, &skip_set);
+
+    char const *pos = str;
+    char const *const end = str + size;
+    while (pos < end) {
+        if (can_skip) {
+            pos = find_delimiter(pos, end, &skip_set, NULL);
+            if (pos == end) break;
+        }
+
+        byte_class const class = table->byte_classes[(unsigned char)*pos];
+        DWORD next_active[MAX_LEXER_STATES / 32] = { 0 };
+        bool same_state = false;
+        for (int i = 0; i < run_count; ++i) {
+            DWORD const transition = table->transitions[states[i]][class];
+            lexer_state state = transition & TRANSITION_STATE_MASK;
+            if (transition & ~TRANSITION_STATE_MASK) {
+                if (transition & STOP_ACTION) {
+                    /* NOTE: every state stops at a null byte so where the part ends does not matter any more */
+                    result->stopped = true;
+                    return;
+                }
+
+                if (transition & BEGIN_ACTION) {
+                    depths[i] = 0;
+                }
+
+                if (transition & NEST_ACTION) {
+                    ++depths[i];
+                }
+
+                if (transition & NESTED_END_ACTION) {
+                    if (depths[i] != 0) {
+                        --depths[i];
+                    }
+                    else {
+                        state = CODE_STATE;
+                    }
+                }
+            }
+
+            DWORD const bit = 1u << (state % 32);
+            same_state |= (next_active[state / 32] & bit) != 0;
+            next_active[state / 32] |= bit;
+            states[i] = state;
+        }
+
+        if (same_state) {
+            /* merge the runs that are the same now, the last run takes the place of the one that is removed */
+            for (int i = run_count - 1; i > 0; --i) {
+                int same = 0;
+                while (same < i && (states[same] != states[i] || depths[same] != depths[i])) {
+                    ++same;
+                }
+                if (same == i) continue;
+
+                --run_count;
+                for (int state = 0; state < table->state_count; ++state) {
+                    if (runs[state] == i) {
+                        runs[state] = (unsigned char)same;
+                    }
+                    else if (runs[state] == run_count) {
+                        runs[state] = (unsigned char)i;
+                    }
+                }
+                states[i] = states[run_count];
+                depths[i] = depths[run_count];
+            }
+        }
+
+        bool changed = false;
+        for (int i = 0; i < MAX_LEXER_STATES / 32; ++i) {
+            changed |= next_active[i] != active[i];
+            active[i] = next_active[i];
+        }
+        if (changed) {
+            can_skip = merge_skip_sets(table, states, run_count, &skip_set);
+        }
+
+        ++pos;
+    }
+
+    for (int state = 0; state < table->state_count; ++state) {
+        if (runs[state] != MAX_LEXER_STATES) {
+            result->end_states[state] = (unsigned char)states[runs[state]];
+            result->end_depths[state] = depths[runs[state]];
+        }
+    }
+}
+
+/* ends the input and frees the lexer, returns the number of comments found */
+static comment_count lexer_finish(comment_lexer *lexer)
+{
+    if (!lexer->stopped) {
+        lexer_end_input(lexer, NULL, lexer->offset);
+    }
+
+    if (lexer->held != NULL) {
+        HeapFree(GetProcessHeap(), 0, lexer->held);
+    }
+
+    return lexer->count;
+}
@@ -0,0 +1,591 @@
+/* --match and --regex, only the comments with a literal or a pattern in their text are written
+ * the text a comment is matched against is the text the record formats write, its lines are joined by a new line
+ * a literal is found by looking for its rarest byte with find_delimiter and comparing the rest where it is found
+ * so a comment without that byte costs no more than looking at it 16 or more bytes at a time,
+ * a pattern is compiled to a thompson nfa that is run on every position of the text at once so its time is linear in the text
+ */
+
+#define MAX_PATTERN_STATES 128
+#define MAX_PATTERN_CLASSES 16
+#define MAX_PATTERN_DEPTH 32
+
+typedef enum pattern_op
+{
+    /* the byte in arg */
+    BYTE_PATTERN_OP,
+
+    /* any byte but a new line */
+    ANY_PATTERN_OP,
+
+    /* a byte in the class arg */
+    CLASS_PATTERN_OP,
+
+    /* goes on at out and at out1 without reading a byte */
+    SPLIT_PATTERN_OP,
+
+    /* goes on at out without reading a byte, this is what an empty pattern is */
+    EMPTY_PATTERN_OP,
+
+    /* ^ and $, the start and the end of the text or of a line in it */
+    LINE_BEGIN_PATTERN_OP,
+    LINE_END_PATTERN_OP,
+
+    MATCH_PATTERN_OP
+} pattern_op;
+
+typedef struct pattern_state
+{
+    unsigned char op;
+    unsigned char arg;
+
+    /* NOTE: while the pattern is compiled an out that is not known yet links to the next one of its fragment, see pattern_patch */
+    unsigned short out;
+    unsigned short out1;
+} pattern_state;
+
+typedef struct comment_filter
+{
+    /* --match, NULL if there is none, needle is the byte of the literal that is looked for */
+    char const *literal;
+    size_t literal_size;
+    size_t needle;
+    delimiter_set needle_set;
+
+    /* --regex, state_count is 0 if there is none */
+    pattern_state states[MAX_PATTERN_STATES];
+    size_t state_count;
+    size_t start;
+    DWORD classes[MAX_PATTERN_CLASSES][8];
+    size_t class_count;
+
+    /* --max-count and --max-total, 0 if there is no limit */
+    size_t max_count;
+    size_t max_total;
+} comment_filter;
+
+/* a byte that is rare in comments is better to look for, lower case letters and spaces are in most of them */
+static int literal_byte_rank(unsigned char byte)
+{
+    if (byte == ' ' || byte == '\t' || byte == '\n') return 3;
+    if (byte >= 'a' && byte <= 'z') return 2;
+    if (byte >= 'A' && byte <= 'Z') return 0;
+    return 1;
+}
+
+/* returns a description of what is wrong with the literal or NULL */
+static char const *set_filter_literal(comment_filter *filter, char const *literal)
+{
+    size_t const size = lstrlenA(literal);
+    if (size == 0) {
+        return "the literal is empty";
+    }
+
+    filter->literal = literal;
+    filter->literal_size = size;
+    filter->needle = 0;
+    for (size_t i = 1; i < size; ++i) {
+        if (literal_byte_rank((unsigned char)literal[i]) < literal_byte_rank((unsigned char)literal[filter->needle])) {
+            filter->needle = i;
+        }
+    }
+    filter->needle_set = (delimiter_set) { .bytes = { literal[filter->needle] }, .count = 1 };
+    return NULL;
+}
+
+static bool find_literal(comment_filter const *filter, char const *text, size_t size)
+{
+    size_t const literal_size = filter->literal_size;
+    if (size < literal_size) {
+        return false;
+    }
+
+    /* the needle is looked for where the literal around it fits in the text */
+    char const *pos = text + filter->needle;
+    char const *const end = text + size - (literal_size - 1 - filter->needle);
+    for (;;) {
+        pos = find_delimiter(pos, end, &filter->needle_set, NULL);
+        if (pos == end) {
+            return false;
+        }
+
+        char const *first = pos - filter->needle;
+        size_t i = 0;
+        while (i != literal_size && first[i] == filter->literal[i]) {
+            ++i;
+        }
+        if (i == literal_size) {
+            return true;
+        }
+        ++pos;
+    }
+}
+
+/* a part of the pattern that was compiled, its outs that do not go anywhere yet are linked from dangling */
+typedef struct pattern_fragment
+{
+    size_t start;
+
+    /* (state << 1 | 1 for out1) + 1 of the first dangling out, 0 if there is none */
+    size_t dangling;
+} pattern_fragment;
+
+typedef struct pattern_parser
+{
+    comment_filter *filter;
+    char const *pos;
+    char const *error;
+
+    /* how many groups pos is in, they are compiled by recursion */
+    size_t depth;
+} pattern_parser;
+
+static unsigned short *pattern_out(comment_filter *filter, size_t link)
+{
+    pattern_state *state = &filter->states[(link - 1) >> 1];
+    return ((link - 1) & 1) ? &state->out1 : &state->out;
+}
+
+/* points every dangling out of a fragment at state */
+static void pattern_patch(comment_filter *filter, size_t dangling, size_t state)
+{
+    while (dangling != 0) {
+        unsigned short *out = pattern_out(filter, dangling);
+        dangling = *out;
+        *out = (unsigned short)state;
+    }
+}
+
+static size_t pattern_append(comment_filter *filter, size_t dangling, size_t more)
+{
+    if (dangling == 0) {
+        return more;
+    }
+
+    size_t last = dangling;
+    for (size_t next = *pattern_out(filter, last); next != 0; next = *pattern_out(filter, last)) {
+        last = next;
+    }
+    *pattern_out(filter, last) = (unsigned short)more;
+    return dangling;
+}
+
+/* returns the new state with a dangling out or MAX_PATTERN_STATES if there is no room for it */
+static size_t pattern_add_state(pattern_parser *parser, pattern_op op, unsigned char arg)
+{
+    comment_filter *filter = parser->filter;
+    if (filter->state_count == MAX_PATTERN_STATES) {
+        parser->error = "the pattern is too long";
+        return MAX_PATTERN_STATES;
+    }
+    filter->states[filter->state_count] = (pattern_state) { .op = (unsigned char)op, .arg = arg };
+    return filter->state_count++;
+}
+
+static pattern_fragment pattern_single(pattern_parser *parser, pattern_op op, unsigned char arg)
+{
+    size_t const state = pattern_add_state(parser, op, arg);
+    if (state == MAX_PATTERN_STATES) {
+        return (pattern_fragment) { 0 };
+    }
+    return (pattern_fragment) { .start = state, .dangling = (state << 1) + 1 };
+}
+
+static void class_add(DWORD *class, unsigned char byte)
+{
+    class[byte >> 5] |= (DWORD)1 << (byte & 31);
+}
+
+static void class_add_range(DWORD *class, unsigned char first, unsigned char last)
+{
+    for (unsigned byte = first; byte <= last; ++byte) {
+        class_add(class, (unsigned char)byte);
+    }
+}
+
+/* adds the bytes of \d, \w and \s or their upper case complements, returns false for any other escape */
+static bool class_add_escape(DWORD *class, char escape)
+{
+    DWORD named[8] = { 0 };
+    switch (escape | 0x20) {
+        case 'd':
+            class_add_range(named, '0', '9');
+            break;
+        case 'w':
+            class_add_range(named, '0', '9');
+            class_add_range(named, 'a', 'z');
+            class_add_range(named, 'A', 'Z');
+            class_add(named, '_');
+            break;
+        case 's':
+            class_add(named, ' ');
+            class_add_range(named, '\t', '\r');
+            break;
+        default:
+            return false;
+    }
+
+    bool const complement = escape >= 'A' && escape <= 'Z';
+    for (int i = 0; i < 8; ++i) {
+        class[i] |= complement ? ~named[i] : named[i];
+    }
+    return true;
+}
+
+static unsigned char pattern_escaped_byte(char escape)
+{
+    switch (escape) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        default: return (unsigned char)escape;
+    }
+}
+
+static DWORD *pattern_add_class(pattern_parser *parser, unsigned char *index)
+{
+    comment_filter *filter = parser->filter;
+    if (filter->class_count == MAX_PATTERN_CLASSES) {
+        parser->error = "the pattern has too many classes";
+        return NULL;
+    }
+    *index = (unsigned char)filter->class_count;
+    DWORD *class = filter->classes[filter->class_count++];
+    for (int i = 0; i < 8; ++i) {
+        class[i] = 0;
+    }
+    return class;
+}
+
+/* [...] with pos right after the [ */
+static pattern_fragment pattern_bracket(pattern_parser *parser)
+{
+    unsigned char index;
+    DWORD *class = pattern_add_class(parser, &index);
+    if (class == NULL) {
+        return (pattern_fragment) { 0 };
+    }
+
+    bool const complement = *parser->pos == '^';
+    parser->pos += complement;
+
+    /* a ] right at the start is a byte of the class */
+    bool first = true;
+    while (*parser->pos != ']' || first) {
+        first = false;
+        unsigned char byte = (unsigned char)*parser->pos++;
+        if (byte == '\0') {
+            parser->error = "a [ is not closed";
+            return (pattern_fragment) { 0 };
+        }
+        if (byte == '\\') {
+            if (*parser->pos == '\0') {
+                parser->error = "the pattern ends in a \\";
+                return (pattern_fragment) { 0 };
+            }
+            if (class_add_escape(class, *parser->pos)) {
+                ++parser->pos;
+                continue;
+            }
+            byte = pattern_escaped_byte(*parser->pos++);
+        }
+
+        if (parser->pos[0] == '-' && parser->pos[1] != ']' && parser->pos[1] != '\0') {
+            unsigned char last = (unsigned char)parser->pos[1];
+            parser->pos += 2;
+            if (last == '\\') {
+                if (*parser->pos == '\0') {
+                    parser->error = "the pattern ends in a \\";
+                    return (pattern_fragment) { 0 };
+                }
+                last = pattern_escaped_byte(*parser->pos++);
+            }
+            if (last < byte) {
+                parser->error = "a range in [] is backwards";
+                return (pattern_fragment) { 0 };
+            }
+            class_add_range(class, byte, last);
+        }
+        else {
+            class_add(class, byte);
+        }
+    }
+    ++parser->pos;
+
+    if (complement) {
+        for (int i = 0; i < 8; ++i) {
+            class[i] = ~class[i];
+        }
+    }
+    return pattern_single(parser, CLASS_PATTERN_OP, index);
+}
+
+static pattern_fragment pattern_alternation(pattern_parser *parser);
+
+static pattern_fragment pattern_atom(pattern_parser *parser)
+{
+    char const c = *parser->pos++;
+    switch (c) {
+        case '(': {
+            if (++parser->depth > MAX_PATTERN_DEPTH) {
+                parser->error = "the groups of the pattern are nested too deep";
+                return (pattern_fragment) { 0 };
+            }
+            pattern_fragment group = pattern_alternation(parser);
+            --parser->depth;
+            if (parser->error != NULL) {
+                return group;
+            }
+            if (*parser->pos != ')') {
+                parser->error = "a ( is not closed";
+                return group;
+            }
+            ++parser->pos;
+            return group;
+        }
+        case ')':
+            parser->error = "a ) is not opened";
+            return (pattern_fragment) { 0 };
+        case '*':
+        case '+':
+        case '?':
+            parser->error = "a repetition has nothing to repeat";
+            return (pattern_fragment) { 0 };
+        case '.':
+            return pattern_single(parser, ANY_PATTERN_OP, 0);
+        case '^':
+            return pattern_single(parser, LINE_BEGIN_PATTERN_OP, 0);
+        case '$':
+            return pattern_single(parser, LINE_END_PATTERN_OP, 0);
+        case '[':
+            return pattern_bracket(parser);
+        case '\\': {
+            char const escape = *parser->pos++;
+            if (escape == '\0') {
+                parser->error = "the pattern ends in a \\";
+                return (pattern_fragment) { 0 };
+            }
+
+            unsigned char index;
+            DWORD named[8] = { 0 };
+            if (class_add_escape(named, escape)) {
+                DWORD *class = pattern_add_class(parser, &index);
+                if (class == NULL) {
+                    return (pattern_fragment) { 0 };
+                }
+                for (int i = 0; i < 8; ++i) {
+                    class[i] = named[i];
+                }
+                return pattern_single(parser, CLASS_PATTERN_OP, index);
+            }
+            return pattern_single(parser, BYTE_PATTERN_OP, pattern_escaped_byte(escape));
+        }
+        default:
+            return pattern_single(parser, BYTE_PATTERN_OP, (unsigned char)c);
+    }
+}
+
+static pattern_fragment pattern_repetition(pattern_parser *parser)
+{
+    pattern_fragment fragment = pattern_atom(parser);
+    while (parser->error == NULL && (*parser->pos == '*' || *parser->pos == '+' || *parser->pos == '?')) {
+        char const c = *parser->pos++;
+        size_t const split = pattern_add_state(parser, SPLIT_PATTERN_OP, 0);
+        if (split == MAX_PATTERN_STATES) break;
+
+        comment_filter *filter = parser->filter;
+        filter->states[split].out = (unsigned short)fragment.start;
+        size_t const skip = (split << 1) + 2;
+        if (c == '?') {
+            fragment = (pattern_fragment) { .start = split, .dangling = pattern_append(filter, fragment.dangling, skip) };
+        }
+        else {
+            /* * can skip the fragment, + has to go through it once */
+            pattern_patch(filter, fragment.dangling, split);
+            fragment = (pattern_fragment) { .start = c == '*' ? split : fragment.start, .dangling = skip };
+        }
+    }
+    return fragment;
+}
+
+static pattern_fragment pattern_concatenation(pattern_parser *parser)
+{
+    if (*parser->pos == '\0' || *parser->pos == '|' || *parser->pos == ')') {
+        return pattern_single(parser, EMPTY_PATTERN_OP, 0);
+    }
+
+    pattern_fragment fragment = pattern_repetition(parser);
+    while (parser->error == NULL && *parser->pos != '\0' && *parser->pos != '|' && *parser->pos != ')') {
+        pattern_fragment next = pattern_repetition(parser);
+        if (parser->error != NULL) break;
+        pattern_patch(parser->filter, fragment.dangling, next.start);
+        fragment.dangling = next.dangling;
+    }
+    return fragment;
+}
+
+static pattern_fragment pattern_alternation(pattern_parser *parser)
+{
+    pattern_fragment fragment = pattern_concatenation(parser);
+    while (parser->error == NULL && *parser->pos == '|') {
+        ++parser->pos;
+        pattern_fragment other = pattern_concatenation(parser);
+        if (parser->error != NULL) break;
+
+        size_t const split = pattern_add_state(parser, SPLIT_PATTERN_OP, 0);
+        if (split == MAX_PATTERN_STATES) break;
+        parser->filter->states[split].out = (unsigned short)fragment.start;
+        parser->filter->states[split].out1 = (unsigned short)other.start;
+        fragment = (pattern_fragment) { .start = split, .dangling = pattern_append(parser->filter, fragment.dangling, other.dangling) };
+    }
+    return fragment;
+}
+
+/* compiles pattern, returns a description of what is wrong with it or NULL
+ * NOTE: the syntax is a small part of the posix extended one, . [] [^] ^ $ * + ? | () and the escapes \d \w \s \D \W \S \n \r \t,
+ * a \ before any other byte is that byte
+ */
+static char const *set_filter_pattern(comment_filter *filter, char const *pattern)
+{
+    filter->state_count = 0;
+    filter->class_count = 0;
+
+    pattern_parser parser = { .filter = filter, .pos = pattern };
+    pattern_fragment fragment = pattern_alternation(&parser);
+    if (parser.error == NULL && *parser.pos == ')') {
+        parser.error = "a ) is not opened";
+    }
+    if (parser.error != NULL) {
+        filter->state_count = 0;
+        return parser.error;
+    }
+
+    size_t const match = pattern_add_state(&parser, MATCH_PATTERN_OP, 0);
+    if (match == MAX_PATTERN_STATES) {
+        filter->state_count = 0;
+        return parser.error;
+    }
+    pattern_patch(filter, fragment.dangling, match);
+    filter->start = fragment.start;
+    return NULL;
+}
+
+/* the states the nfa is in at one position of the text */
+typedef struct pattern_list
+{
+    unsigned char states[MAX_PATTERN_STATES];
+    size_t count;
+} pattern_list;
+
+/* adds state and every state that can be reached from it without reading a byte at pos, returns true when that reaches the match
+ * NOTE: listed holds the step each state was last added in so that no state is in a list twice
+ */
+static bool pattern_add(comment_filter const *filter, pattern_list *list, DWORD *listed, DWORD step, size_t state,
+                        char const *text, size_t size, size_t pos)
+{
+    /* NOTE: a state pushes at most two others and only the first time it is popped */
+    unsigned char stack[MAX_PATTERN_STATES * 2 + 1];
+    size_t stack_size = 0;
+    stack[stack_size++] = (unsigned char)state;
+    while (stack_size != 0) {
+        state = stack[--stack_size];
+        if (listed[state] == step) continue;
+        listed[state] = step;
+
+        pattern_state const *current = &filter->states[state];
+        switch (current->op) {
+            case SPLIT_PATTERN_OP:
+                stack[stack_size++] = (unsigned char)current->out1;
+                stack[stack_size++] = (unsigned char)current->out;
+                break;
+            case EMPTY_PATTERN_OP:
+                stack[stack_size++] = (unsigned char)current->out;
+                break;
+            case LINE_BEGIN_PATTERN_OP:
+                if (pos == 0 || text[pos - 1] == '\n') {
+                    stack[stack_size++] = (unsigned char)current->out;
+                }
+                break;
+            case LINE_END_PATTERN_OP:
+                if (pos == size || text[pos] == '\n') {
+                    stack[stack_size++] = (unsigned char)current->out;
+                }
+                break;
+            case MATCH_PATTERN_OP:
+                return true;
+            default:
+                list->states[list->count++] = (unsigned char)state;
+                break;
+        }
+    }
+    return false;
+}
+
+static bool match_pattern(comment_filter const *filter, char const *text, size_t size)
+{
+    pattern_list lists[2];
+    DWORD listed[MAX_PATTERN_STATES];
+    for (size_t i = 0; i < filter->state_count; ++i) {
+        listed[i] = 0;
+    }
+
+    pattern_list *current = &lists[0];
+    pattern_list *next = &lists[1];
+    current->count = 0;
+    for (size_t pos = 0;; ++pos) {
+        /* a match can start at any position */
+        DWORD const step = (DWORD)pos + 1;
+        if (pattern_add(filter, current, listed, step, filter->start, text, size, pos)) {
+            return true;
+        }
+        if (pos == size) {
+            return false;
+        }
+
+        unsigned char const byte = (unsigned char)text[pos];
+        next->count = 0;
+        for (size_t i = 0; i < current->count; ++i) {
+            pattern_state const *state = &filter->states[current->states[i]];
+            bool matches;
+            switch (state->op) {
+                case BYTE_PATTERN_OP: matches = byte == state->arg; break;
+                case ANY_PATTERN_OP: matches = byte != '\n'; break;
+                default: matches = (filter->classes[state->arg][byte >> 5] >> (byte & 31)) & 1; break;
+            }
+            if (matches && pattern_add(filter, next, listed, step + 1, state->out, text, size, pos + 1)) {
+                return true;
+            }
+        }
+
+        pattern_list *swap = current;
+        current = next;
+        next = swap;
+    }
+}
+
+/* returns whether the text of a comment has the literal and matches the pattern of filter */
+static bool filter_matches(comment_filter const *filter, char const *text, size_t size)
+{
+    if (filter->literal != NULL && !find_literal(filter, text, size)) {
+        return false;
+    }
+    return filter->state_count == 0 || match_pattern(filter, text, size);
+}
+
+/* the literal, the pattern and the limits are part of the key of a file in the cache */
+static DWORD filter_key(comment_filter const *filter)
+{
+    DWORD hash = 0x811c9dc5;
+    for (size_t i = 0; i < filter->literal_size; ++i) {
+        hash = (hash ^ (unsigned char)filter->literal[i]) * 0x01000193;
+    }
+    char const *states = (char const *)filter->states;
+    for (size_t i = 0; i < filter->state_count * sizeof(pattern_state); ++i) {
+        hash = (hash ^ (unsigned char)states[i]) * 0x01000193;
+    }
+    char const *classes = (char const *)filter->classes;
+    for (size_t i = 0; i < filter->class_count * sizeof(filter->classes[0]); ++i) {
+        hash = (hash ^ (unsigned char)classes[i]) * 0x01000193;
+    }
+    hash = (hash ^ (DWORD)filter->start) * 0x01000193;
+    return (hash ^ (DWORD)filter->max_count) * 0x01000193;
+}
@@ -0,0 +1,138 @@
+/* --metrics, how many lines of a file are code, comments, both or blank, found in the same pass that finds its comments
+ * the lexer reports where each comment begins and ends and the bytes between two comments are the code,
+ * a line of code is only looked at up to its first byte that is not white space and from there find_delimiter
+ * skips to the next new line so the code costs little more than the lexer already spends on it
+ * NOTE: a line is a comment line if all of its bytes that are not white space are in comments, a mixed line if it also has code,
+ * the lines in the middle of a block comment are comment lines even when they are empty
+ */
+
+typedef struct line_metrics
+{
+    size_t code_lines;
+    size_t comment_lines;
+    size_t mixed_lines;
+    size_t blank_lines;
+} line_metrics;
+
+/* the state of one call to measure_lines */
+typedef struct line_classifier
+{
+    char const *str;
+
+    /* every byte before cursor was looked at, the line it is on has code or comments if the flags are set */
+    size_t cursor;
+    bool has_code;
+    bool has_comment;
+
+    line_metrics lines;
+} line_classifier;
+
+static void add_line_metrics(line_metrics *to, line_metrics const *from)
+{
+    to->code_lines += from->code_lines;
+    to->comment_lines += from->comment_lines;
+    to->mixed_lines += from->mixed_lines;
+    to->blank_lines += from->blank_lines;
+}
+
+static void end_classified_line(line_classifier *classifier)
+{
+    if (classifier->has_code) {
+        ++*(classifier->has_comment ? &classifier->lines.mixed_lines : &classifier->lines.code_lines);
+    }
+    else {
+        ++*(classifier->has_comment ? &classifier->lines.comment_lines : &classifier->lines.blank_lines);
+    }
+    classifier->has_code = false;
+    classifier->has_comment = false;
+}
+
+/* looks at the code from the cursor up to end */
+static void classify_code(line_classifier *classifier, size_t end)
+{
+    static delimiter_set const new_line = DELIMITERS("\n");
+
+    char const *pos = classifier->str + classifier->cursor;
+    char const *const code_end = classifier->str + end;
+    while (pos < code_end) {
+        if (!classifier->has_code) {
+            while (pos != code_end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\f' || *pos == '\v')) {
+                ++pos;
+            }
+            if (pos == code_end) break;
+            if (*pos == '\n') {
+                end_classified_line(classifier);
+                ++pos;
+                continue;
+            }
+            classifier->has_code = true;
+        }
+
+        /* the rest of a line that has code does not change what it is */
+        pos = find_delimiter(pos, code_end, &new_line, NULL);
+        if (pos == code_end) break;
+        end_classified_line(classifier);
+        ++pos;
+    }
+    classifier->cursor = end;
+}
+
+static void classify_comment_begin(void *context, comment_kind kind, ULONGLONG begin, size_t line, size_t column)
+{
+    (void)kind;
+    (void)line;
+    (void)column;
+    line_classifier *classifier = context;
+    classify_code(classifier, (size_t)begin);
+    classifier->has_comment = true;
+}
+
+static void classify_comment_text(void *context, char const *text, size_t size)
+{
+    (void)context;
+    (void)text;
+    (void)size;
+}
+
+/* every line a comment ends on but its first is a comment line, the last one can still get code after it */
+static void classify_comment_line_end(void *context, size_t line)
+{
+    (void)line;
+    line_classifier *classifier = context;
+    end_classified_line(classifier);
+    classifier->has_comment = true;
+}
+
+static void classify_comment_end(void *context, ULONGLONG end, size_t line)
+{
+    (void)line;
+    line_classifier *classifier = context;
+    classifier->cursor = (size_t)end;
+}
+
+static comment_sink const line_sink = {
+    .begin = classify_comment_begin,
+    .text = classify_comment_text,
+    .line_end = classify_comment_line_end,
+    .end = classify_comment_end
+};
+
+/* counts the lines of str by what is on them and its comments with the table of a comment mode,
+ * returns false when there was not enough memory for the lexer
+ */
+static bool measure_lines(lexer_table const *table, char const *str, size_t size, line_metrics *lines, comment_count *count)
+{
+    line_classifier classifier = { .str = str };
+    comment_lexer lexer;
+    lexer_init(&lexer, table, &line_sink, &classifier, false);
+    bool const fed = lexer_feed(&lexer, str, size);
+    *count = lexer_finish(&lexer);
+
+    classify_code(&classifier, size);
+    if (size != 0 && str[size - 1] != '\n') {
+        /* the last line has no new line after it */
+        end_classified_line(&classifier);
+    }
+    *lines = classifier.lines;
+    return fed;
+}
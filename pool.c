@@ -0,0 +1,232 @@
+/* a pool of worker threads that share work by stealing tasks from each other
+ * every worker owns a double ended queue, it pushes and pops tasks at the back of its own queue
+ * so it keeps working on what it just discovered and when it runs out it steals the oldest task
+ * from the front of another worker's queue
+ */
+
+typedef struct thread_pool thread_pool;
+typedef void task_function(thread_pool *pool, size_t worker_index, void *data);
+
+typedef struct task
+{
+    task_function *run;
+    void *data;
+} task;
+
+typedef struct work_queue
+{
+    SRWLOCK lock;
+
+    /* ring buffer of tasks, head is the oldest task */
+    task *tasks;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} work_queue;
+
+struct thread_pool
+{
+    work_queue *queues;
+    HANDLE *threads;
+    size_t thread_count;
+
+    /* tasks that have been pushed but have not finished yet, the workers stop once this reaches zero */
+    volatile LONG pending_tasks;
+
+    /* used to hand out worker indices when the threads start */
+    volatile LONG next_worker_index;
+
+    /* whatever the tasks need to share */
+    void *context;
+};
+
+static bool work_queue_push(work_queue *queue, task new_task)
+{
+    AcquireSRWLockExclusive(&queue->lock);
+    if (queue->count == queue->capacity) {
+        size_t new_capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        task *new_tasks = HeapAlloc(GetProcessHeap(), 0, sizeof(task) * new_capacity);
+        if (new_tasks == NULL) {
+            ReleaseSRWLockExclusive(&queue->lock);
+            return false;
+        }
+
+        for (size_t i = 0; i < queue->count; ++i) {
+            new_tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+        }
+
+        HeapFree(GetProcessHeap(), 0, queue->tasks);
+        queue->tasks = new_tasks;
+        queue->head = 0;
+        queue->capacity = new_capacity;
+    }
+
+    queue->tasks[(queue->head + queue->count) % queue->capacity] = new_task;
+    ++queue->count;
+    ReleaseSRWLockExclusive(&queue->lock);
+    return true;
+}
+
+/* the owner of a queue takes the newest task */
+static bool work_queue_pop(work_queue *queue, task *result)
+{
+    bool found = false;
+    AcquireSRWLockExclusive(&queue->lock);
+    if (queue->count != 0) {
+        --queue->count;
+        *result = queue->tasks[(queue->head + queue->count) % queue->capacity];
+        found = true;
+    }
+    ReleaseSRWLockExclusive(&queue->lock);
+    return found;
+}
+
+/* other workers take the oldest task, for a directory walk that is the one closest to the root */
+static bool work_queue_steal(work_queue *queue, task *result)
+{
+    bool found = false;
+    AcquireSRWLockExclusive(&queue->lock);
+    if (queue->count != 0) {
+        *result = queue->tasks[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        --queue->count;
+        found = true;
+    }
+    ReleaseSRWLockExclusive(&queue->lock);
+    return found;
+}
+
+/* adds a task to the queue of worker_index, usually the worker that is calling this, code that does not know which worker
+ * it is on or is not on one at all pushes onto the first queue and the workers steal from there
+ */
+static bool pool_push(thread_pool *pool, size_t worker_index, task_function *run, void *data)
+{
+    InterlockedIncrement(&pool->pending_tasks);
+    if (!work_queue_push(&pool->queues[worker_index], (task) { run, data })) {
+        InterlockedDecrement(&pool->pending_tasks);
+        return false;
+    }
+
+    return true;
+}
+
+/* lets a thread that is not running a task of the pool push tasks, it returns false if the workers already ran out of tasks and stopped
+ * NOTE: the workers only stop once there are no pending tasks and nothing can be pushed after that, so while a thread is in
+ * the pool it counts as a pending task until pool_leave
+ */
+static bool pool_enter(thread_pool *pool)
+{
+    for (;;) {
+        LONG const pending_tasks = pool->pending_tasks;
+        if (pending_tasks == 0) {
+            return false;
+        }
+        if (InterlockedCompareExchange(&pool->pending_tasks, pending_tasks + 1, pending_tasks) == pending_tasks) {
+            return true;
+        }
+    }
+}
+
+static void pool_leave(thread_pool *pool)
+{
+    InterlockedDecrement(&pool->pending_tasks);
+}
+
+/* back off the longer a thread goes without finding anything to do */
+static void pool_back_off(size_t idle_count)
+{
+    if (idle_count < 64) {
+        YieldProcessor();
+    }
+    else if (idle_count < 128) {
+        SwitchToThread();
+    }
+    else {
+        Sleep(1);
+    }
+}
+
+static DWORD WINAPI pool_worker(LPVOID parameter)
+{
+    thread_pool *pool = parameter;
+    size_t const worker_index = (size_t)InterlockedIncrement(&pool->next_worker_index) - 1;
+
+    size_t idle_count = 0;
+    for (;;) {
+        task next_task;
+        bool found = work_queue_pop(&pool->queues[worker_index], &next_task);
+        for (size_t i = 1; !found && i < pool->thread_count; ++i) {
+            found = work_queue_steal(&pool->queues[(worker_index + i) % pool->thread_count], &next_task);
+        }
+
+        if (found) {
+            next_task.run(pool, worker_index, next_task.data);
+            InterlockedDecrement(&pool->pending_tasks);
+            idle_count = 0;
+            continue;
+        }
+
+        /* nothing is queued and nothing is running that could queue more work */
+        if (pool->pending_tasks == 0) {
+            break;
+        }
+
+        pool_back_off(++idle_count);
+    }
+
+    return 0;
+}
+
+/* starts thread_count workers with first_task queued, returns false if the pool could not be started */
+static bool pool_start(thread_pool *pool, size_t thread_count, void *context, task_function *run, void *data)
+{
+    *pool = (thread_pool) { .thread_count = thread_count, .context = context };
+    pool->queues = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(work_queue) * thread_count);
+    pool->threads = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(HANDLE) * thread_count);
+    if (pool->queues == NULL || pool->threads == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        InitializeSRWLock(&pool->queues[i].lock);
+    }
+
+    if (!pool_push(pool, 0, run, data)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        pool->threads[i] = CreateThread(NULL, 0, pool_worker, pool, 0, NULL);
+        if (pool->threads[i] == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* waits for every task to finish and frees the pool */
+static void pool_join(thread_pool *pool)
+{
+    /* NOTE: WaitForMultipleObjects can only wait for 64 handles so wait for each thread on its own */
+    for (size_t i = 0; i < pool->thread_count; ++i) {
+        if (pool->threads[i] != NULL) {
+            WaitForSingleObject(pool->threads[i], INFINITE);
+            CloseHandle(pool->threads[i]);
+        }
+    }
+
+    for (size_t i = 0; i < pool->thread_count; ++i) {
+        HeapFree(GetProcessHeap(), 0, pool->queues[i].tasks);
+    }
+
+    HeapFree(GetProcessHeap(), 0, pool->queues);
+    HeapFree(GetProcessHeap(), 0, pool->threads);
+}
+
+/* the number of logical processors across all processor groups */
+static size_t processor_count(void)
+{
+    DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    return count == 0 ? 1 : count;
+}
@@ -0,0 +1,403 @@
+/* vectorized search for the next byte the lexer cares about
+ * the lexer spends most of its time in code or comment text that contains none of the bytes
+ * it switches on so instead of looking at one byte at a time we look at 16, 32 or 64 at once
+ * and jump straight to the next interesting one
+ */
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define SCAN_SIMD
+#endif
+
+#define MAX_DELIMITERS 8
+
+typedef struct delimiter_set
+{
+    char bytes[MAX_DELIMITERS];
+    int count;
+} delimiter_set;
+
+/* use this to initialize a delimiter_set from a string literal, the literal may contain '\0' */
+#define DELIMITERS(bytes) { bytes, sizeof(bytes) - 1 }
+
+/* returns the first byte in [str, end) that is in set or end if there is none,
+ * if tab_count is not NULL it is set to the number of tabs before the returned position, tabs are not counted if it is NULL
+ */
+typedef char const *find_delimiter_function(char const *str, char const *end, delimiter_set const *set, size_t *tab_count);
+
+static char const *find_delimiter_scalar(char const *str, char const *end, delimiter_set const *set, size_t *tab_count)
+{
+    size_t tabs = 0;
+    for (; str < end; ++str) {
+        for (int i = 0; i < set->count; ++i) {
+            if (*str == set->bytes[i]) goto found;
+        }
+        tabs += *str == '\t';
+    }
+
+found:
+    if (tab_count != NULL) {
+        *tab_count = tabs;
+    }
+
+    return str;
+}
+
+/* returns the number of \n bytes in [str, end), the lexer uses this to find the line of a comment only when it is needed */
+typedef size_t count_newlines_function(char const *str, char const *end);
+
+static size_t count_newlines_scalar(char const *str, char const *end)
+{
+    size_t count = 0;
+    for (; str < end; ++str) {
+        count += *str == '\n';
+    }
+
+    return count;
+}
+
+#ifdef SCAN_SIMD
+
+static unsigned count_bits(unsigned mask)
+{
+    mask = mask - ((mask >> 1) & 0x55555555);
+    mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+    return (((mask + (mask >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+/* NOTE: all the kernels below only use aligned loads, an aligned load never crosses a page boundary
+ * so reading the bytes of a block that lie outside of [str, end) can not fault, those bytes are masked off
+ */
+
+static char const *find_delimiter_sse2(char const *str, char const *end, delimiter_set const *set, size_t *tab_count)
+{
+    if (str >= end) {
+        if (tab_count != NULL) *tab_count = 0;
+        return str;
+    }
+
+    __m128i needles[MAX_DELIMITERS];
+    for (int i = 0; i < set->count; ++i) {
+        needles[i] = _mm_set1_epi8(set->bytes[i]);
+    }
+    __m128i const tab = _mm_set1_epi8('\t');
+
+    size_t offset = (size_t)((uintptr_t)str & 15);
+    char const *block = str - offset;
+    unsigned valid_mask = 0xffffu << offset;
+    size_t tabs = 0;
+    for (;;) {
+        if ((size_t)(end - block) < 16) {
+            valid_mask &= (1u << (end - block)) - 1;
+        }
+
+        __m128i data = _mm_load_si128((__m128i const *)block);
+        __m128i found = _mm_cmpeq_epi8(data, needles[0]);
+        for (int i = 1; i < set->count; ++i) {
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(data, needles[i]));
+        }
+
+        unsigned found_mask = (unsigned)_mm_movemask_epi8(found) & valid_mask;
+        unsigned tab_mask = tab_count != NULL ? (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(data, tab)) & valid_mask : 0;
+        if (found_mask != 0) {
+            unsigned long index;
+            _BitScanForward(&index, found_mask);
+            tabs += count_bits(tab_mask & ((1u << index) - 1));
+            block += index;
+            break;
+        }
+
+        tabs += count_bits(tab_mask);
+        block += 16;
+        if (block >= end) {
+            block = end;
+            break;
+        }
+        valid_mask = 0xffff;
+    }
+
+    if (tab_count != NULL) {
+        *tab_count = tabs;
+    }
+
+    return block;
+}
+
+/* the full blocks are counted by subtracting the compare results from byte counters which are added up
+ * with psadbw before they can overflow, only the partial blocks at the ends need a movemask
+ */
+static size_t count_newlines_sse2(char const *str, char const *end)
+{
+    if (str >= end) return 0;
+
+    __m128i const newline = _mm_set1_epi8('\n');
+    __m128i const zero = _mm_setzero_si128();
+
+    size_t offset = (size_t)((uintptr_t)str & 15);
+    char const *block = str - offset;
+    unsigned valid_mask = 0xffffu << offset;
+    if ((size_t)(end - block) <= 16) {
+        valid_mask &= 0xffffu >> (16 - (end - block));
+    }
+    size_t count = count_bits((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i const *)block), newline)) & valid_mask);
+    block += 16;
+    if (block >= end) {
+        return count;
+    }
+
+    while ((size_t)(end - block) >= 16) {
+        size_t block_count = (size_t)(end - block) / 16;
+        if (block_count > 255) {
+            block_count = 255;
+        }
+
+        __m128i counters = zero;
+        for (size_t i = 0; i < block_count; ++i, block += 16) {
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(_mm_load_si128((__m128i const *)block), newline));
+        }
+
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        count += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+
+    if (block < end) {
+        unsigned const tail_mask = (1u << (end - block)) - 1;
+        count += count_bits((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i const *)block), newline)) & tail_mask);
+    }
+
+    return count;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SCAN_TARGET(features) __attribute__((target(features)))
+#else
+#define SCAN_TARGET(features)
+#endif
+
+SCAN_TARGET("avx2,popcnt,bmi")
+static char const *find_delimiter_avx2(char const *str, char const *end, delimiter_set const *set, size_t *tab_count)
+{
+    if (str >= end) {
+        if (tab_count != NULL) *tab_count = 0;
+        return str;
+    }
+
+    __m256i needles[MAX_DELIMITERS];
+    for (int i = 0; i < set->count; ++i) {
+        needles[i] = _mm256_set1_epi8(set->bytes[i]);
+    }
+    __m256i const tab = _mm256_set1_epi8('\t');
+
+    size_t offset = (size_t)((uintptr_t)str & 31);
+    char const *block = str - offset;
+    unsigned valid_mask = 0xffffffffu << offset;
+    size_t tabs = 0;
+    for (;;) {
+        if ((size_t)(end - block) < 32) {
+            valid_mask &= (1u << (end - block)) - 1;
+        }
+
+        __m256i data = _mm256_load_si256((__m256i const *)block);
+        __m256i found = _mm256_cmpeq_epi8(data, needles[0]);
+        for (int i = 1; i < set->count; ++i) {
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(data, needles[i]));
+        }
+
+        unsigned found_mask = (unsigned)_mm256_movemask_epi8(found) & valid_mask;
+        unsigned tab_mask = tab_count != NULL ? (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, tab)) & valid_mask : 0;
+        if (found_mask != 0) {
+            unsigned index = _tzcnt_u32(found_mask);
+            tabs += _mm_popcnt_u32(tab_mask & ((1u << index) - 1));
+            block += index;
+            break;
+        }
+
+        tabs += _mm_popcnt_u32(tab_mask);
+        block += 32;
+        if (block >= end) {
+            block = end;
+            break;
+        }
+        valid_mask = 0xffffffff;
+    }
+    _mm256_zeroupper();
+
+    if (tab_count != NULL) {
+        *tab_count = tabs;
+    }
+
+    return block;
+}
+
+SCAN_TARGET("avx2,popcnt,bmi")
+static size_t count_newlines_avx2(char const *str, char const *end)
+{
+    if (str >= end) return 0;
+
+    __m256i const newline = _mm256_set1_epi8('\n');
+    __m256i const zero = _mm256_setzero_si256();
+
+    size_t offset = (size_t)((uintptr_t)str & 31);
+    char const *block = str - offset;
+    unsigned valid_mask = 0xffffffffu << offset;
+    if ((size_t)(end - block) <= 32) {
+        valid_mask &= 0xffffffffu >> (32 - (end - block));
+    }
+    size_t count = _mm_popcnt_u32((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((__m256i const *)block), newline)) & valid_mask);
+    block += 32;
+    if (block >= end) {
+        return count;
+    }
+
+    while ((size_t)(end - block) >= 32) {
+        size_t block_count = (size_t)(end - block) / 32;
+        if (block_count > 255) {
+            block_count = 255;
+        }
+
+        __m256i counters = zero;
+        for (size_t i = 0; i < block_count; ++i, block += 32) {
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(_mm256_load_si256((__m256i const *)block), newline));
+        }
+
+        __m256i sums = _mm256_sad_epu8(counters, zero);
+        __m128i half_sums = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        count += (size_t)_mm_cvtsi128_si32(half_sums) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(half_sums, 8));
+    }
+
+    if (block < end) {
+        unsigned const tail_mask = (1u << (end - block)) - 1;
+        count += _mm_popcnt_u32((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((__m256i const *)block), newline)) & tail_mask);
+    }
+    _mm256_zeroupper();
+
+    return count;
+}
+
+#ifdef _M_X64
+SCAN_TARGET("avx512f,avx512bw,popcnt,bmi")
+static char const *find_delimiter_avx512(char const *str, char const *end, delimiter_set const *set, size_t *tab_count)
+{
+    if (str >= end) {
+        if (tab_count != NULL) *tab_count = 0;
+        return str;
+    }
+
+    __m512i needles[MAX_DELIMITERS];
+    for (int i = 0; i < set->count; ++i) {
+        needles[i] = _mm512_set1_epi8(set->bytes[i]);
+    }
+    __m512i const tab = _mm512_set1_epi8('\t');
+
+    size_t offset = (size_t)((uintptr_t)str & 63);
+    char const *block = str - offset;
+    unsigned __int64 valid_mask = ~0ull << offset;
+    size_t tabs = 0;
+    for (;;) {
+        if ((size_t)(end - block) < 64) {
+            valid_mask &= (1ull << (end - block)) - 1;
+        }
+
+        __m512i data = _mm512_load_si512((void const *)block);
+        __mmask64 found_mask = _mm512_cmpeq_epi8_mask(data, needles[0]);
+        for (int i = 1; i < set->count; ++i) {
+            found_mask |= _mm512_cmpeq_epi8_mask(data, needles[i]);
+        }
+        found_mask &= valid_mask;
+
+        unsigned __int64 tab_mask = tab_count != NULL ? _mm512_cmpeq_epi8_mask(data, tab) & valid_mask : 0;
+        if (found_mask != 0) {
+            unsigned __int64 index = _tzcnt_u64(found_mask);
+            tabs += _mm_popcnt_u64(tab_mask & ((1ull << index) - 1));
+            block += index;
+            break;
+        }
+
+        tabs += _mm_popcnt_u64(tab_mask);
+        block += 64;
+        if (block >= end) {
+            block = end;
+            break;
+        }
+        valid_mask = ~0ull;
+    }
+    _mm256_zeroupper();
+
+    if (tab_count != NULL) {
+        *tab_count = tabs;
+    }
+
+    return block;
+}
+
+/* the compare already gives a mask so every block is one popcount */
+SCAN_TARGET("avx512f,avx512bw,popcnt,bmi")
+static size_t count_newlines_avx512(char const *str, char const *end)
+{
+    if (str >= end) return 0;
+
+    __m512i const newline = _mm512_set1_epi8('\n');
+
+    size_t offset = (size_t)((uintptr_t)str & 63);
+    char const *block = str - offset;
+    unsigned __int64 valid_mask = ~0ull << offset;
+    size_t count = 0;
+    for (;;) {
+        if ((size_t)(end - block) < 64) {
+            valid_mask &= (1ull << (end - block)) - 1;
+        }
+
+        count += _mm_popcnt_u64(_mm512_cmpeq_epi8_mask(_mm512_load_si512((void const *)block), newline) & valid_mask);
+        block += 64;
+        if (block >= end) break;
+        valid_mask = ~0ull;
+    }
+    _mm256_zeroupper();
+
+    return count;
+}
+#endif
+
+#endif
+
+static find_delimiter_function *find_delimiter = find_delimiter_scalar;
+static count_newlines_function *count_newlines = count_newlines_scalar;
+
+/* picks the widest kernel the cpu and os support, this must be called before any scanning happens */
+static void init_scanner(void)
+{
+#ifdef SCAN_SIMD
+    find_delimiter = find_delimiter_sse2;
+    count_newlines = count_newlines_sse2;
+
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return;
+
+    /* check that the os saves the ymm registers before using avx */
+    __cpuid(info, 1);
+    bool const osxsave = (info[2] & (1 << 27)) != 0;
+    bool const avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return;
+
+    unsigned __int64 const xcr0 = _xgetbv(0);
+    if ((xcr0 & 0x6) != 0x6) return;
+
+    __cpuidex(info, 7, 0);
+    bool const avx2 = (info[1] & (1 << 5)) != 0;
+    bool const bmi1 = (info[1] & (1 << 3)) != 0;
+    if (!avx2 || !bmi1) return;
+    find_delimiter = find_delimiter_avx2;
+    count_newlines = count_newlines_avx2;
+
+#ifdef _M_X64
+    /* avx512 also needs the os to save the opmask and zmm registers */
+    bool const avx512f = (info[1] & (1 << 16)) != 0;
+    bool const avx512bw = (info[1] & (1 << 30)) != 0;
+    if (avx512f && avx512bw && (xcr0 & 0xe6) == 0xe6) {
+        find_delimiter = find_delimiter_avx512;
+        count_newlines = count_newlines_avx512;
+    }
+#endif
+#endif
+}
@@ -0,0 +1,77 @@
+/* helpers that both comments.exe and bench.exe use, bench.c is built as its own program so it includes this file too
+ * NOTE: neither program links the crt, on 32 bit builds the compiler calls crt helpers for multiplies, divisions and
+ * remainders of 64 bit numbers, for shifts of them by a variable count and for conversions between them and doubles, so
+ * none of those are used, shifts by a constant, adds, subtracts and compares of 64 bit numbers are done inline
+ */
+
+/* the compiler references this when floating point is used, normally the crt defines it */
+int _fltused = 0;
+
+static double to_double(ULONGLONG number)
+{
+    return (double)(DWORD)(number >> 32) * 4294967296.0 + (double)(DWORD)number;
+}
+
+#define DECIMAL_MAX_SIZE 14
+
+/* writes a number with 3 decimals to digits which has room for DECIMAL_MAX_SIZE characters and returns how many were written
+ * the number is clamped to 0 to 4000000000 so that it fits in a DWORD
+ */
+static size_t format_decimal(char *digits, double number)
+{
+    if (number < 0.0) number = 0.0;
+    if (number > 4000000000.0) number = 4000000000.0;
+
+    DWORD whole = (DWORD)number;
+    DWORD fraction = (DWORD)((number - whole) * 1000.0 + 0.5);
+    if (fraction == 1000) {
+        ++whole;
+        fraction = 0;
+    }
+
+    char reversed[10];
+    size_t count = 0;
+    do {
+        reversed[count++] = (char)(whole % 10 + '0');
+        whole /= 10;
+    } while (whole != 0);
+
+    size_t size = 0;
+    while (count != 0) {
+        digits[size++] = reversed[--count];
+    }
+    digits[size++] = '.';
+    digits[size++] = (char)(fraction / 100 + '0');
+    digits[size++] = (char)(fraction / 10 % 10 + '0');
+    digits[size++] = (char)(fraction % 10 + '0');
+    return size;
+}
+
+/* returns the part of arg after prefix or NULL if arg does not start with prefix */
+static char const *arg_value(char const *arg, char const *prefix)
+{
+    while (*prefix != '\0') {
+        if (*arg++ != *prefix++) return NULL;
+    }
+
+    return arg;
+}
+
+/* parses a decimal number with an optional k, m or g suffix */
+static bool parse_size(char const *str, size_t *result)
+{
+    size_t number = 0;
+    if (*str < '0' || *str > '9') return false;
+    while (*str >= '0' && *str <= '9') {
+        number = number * 10 + (*str++ - '0');
+    }
+
+    switch (*str) {
+        case 'k': case 'K': number <<= 10; ++str; break;
+        case 'm': case 'M': number <<= 20; ++str; break;
+        case 'g': case 'G': number <<= 30; ++str; break;
+    }
+
+    *result = number;
+    return *str == '\0';
+}
@@ -0,0 +1,416 @@
+/* --stats and --trace, where the time of a run goes
+ * the phases are timed with QueryPerformanceCounter and QueryThreadCycleTime on the thread that runs them and added up over
+ * every thread, so with -j the time of a phase can be more than the wall time of the run, the cycles are those of the thread
+ * that measures the phase so a file that is split across threads only has the cycles of the parts its own thread read
+ * NOTE: nothing is measured unless one of the options is given, everything here is only a check of stats_enabled otherwise
+ */
+
+#include <psapi.h>
+
+typedef enum stats_phase
+{
+    /* FindFirstFileA and FindNextFileA */
+    ENUMERATE_PHASE,
+
+    /* opening files and getting them into memory, a mapped file is only read from the disk when the lexer gets to it */
+    READ_PHASE,
+
+    LEX_PHASE,
+
+    /* the WriteFiles of stdout */
+    WRITE_PHASE,
+
+    STATS_PHASE_COUNT
+} stats_phase;
+
+static char const *const stats_phase_names[STATS_PHASE_COUNT] = { "enumerate", "read", "lex", "write" };
+
+/* the system calls that are counted */
+typedef enum stats_call
+{
+    CREATE_FILE_CALL,
+    READ_FILE_CALL,
+    MAP_VIEW_OF_FILE_CALL,
+    WRITE_FILE_CALL,
+    FIND_FIRST_FILE_CALL,
+    FIND_NEXT_FILE_CALL,
+    STATS_CALL_COUNT
+} stats_call;
+
+static char const *const stats_call_names[STATS_CALL_COUNT] = {
+    "CreateFileA", "ReadFile", "MapViewOfFile", "WriteFile", "FindFirstFileA", "FindNextFileA"
+};
+
+/* the files are counted by size in buckets that are 4 times bigger each, the first is under 1 KB and the last is 64 MB or more */
+#define SIZE_BUCKET_COUNT 10
+
+static char const *const size_bucket_names[SIZE_BUCKET_COUNT] = {
+    "under 1 KB", "under 4 KB", "under 16 KB", "under 64 KB", "under 256 KB",
+    "under 1 MB", "under 4 MB", "under 16 MB", "under 64 MB", "64 MB or more"
+};
+
+/* the trace is written to its file once this much of it is buffered */
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+/* a growable buffer for the report and the trace */
+typedef struct stats_text
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+} stats_text;
+
+typedef struct run_stats
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start;
+
+    /* what every phase took summed over the threads */
+    volatile LONGLONG phase_ticks[STATS_PHASE_COUNT];
+    volatile LONGLONG phase_cycles[STATS_PHASE_COUNT];
+    volatile LONGLONG calls[STATS_CALL_COUNT];
+
+    volatile LONGLONG file_count;
+    volatile LONGLONG byte_count;
+    volatile LONGLONG output_byte_count;
+    volatile LONGLONG size_buckets[SIZE_BUCKET_COUNT];
+
+    /* --stats, the report is written to stderr at the end of the run */
+    bool report;
+
+    /* --trace, INVALID_HANDLE_VALUE if there is no trace, the events of every thread go through trace_lock */
+    HANDLE trace_handle;
+    SRWLOCK trace_lock;
+    stats_text trace;
+    bool trace_empty;
+} run_stats;
+
+static bool stats_enabled;
+static run_stats stats = { .trace_handle = INVALID_HANDLE_VALUE };
+
+/* where a span of time started, see stats_begin */
+typedef struct stats_span
+{
+    LONGLONG ticks;
+    ULONG64 cycles;
+} stats_span;
+
+static void stats_write(stats_text *text, char const *data, size_t size)
+{
+    if (text->size + size > text->capacity) {
+        size_t capacity = (text->size + size) * 2;
+        char *new_data = text->data == NULL
+            ? HeapAlloc(GetProcessHeap(), 0, capacity)
+            : HeapReAlloc(GetProcessHeap(), 0, text->data, capacity);
+        if (new_data == NULL) {
+            /* NOTE: the stats are left out instead of stopping the run */
+            return;
+        }
+        text->data = new_data;
+        text->capacity = capacity;
+    }
+
+    for (char *first = text->data + text->size; size != 0; --size) {
+        *first++ = *data++;
+        ++text->size;
+    }
+}
+
+static void stats_string(stats_text *text, char const *str)
+{
+    stats_write(text, str, lstrlenA(str));
+}
+
+/* NOTE: there is no 64 bit division in 32 bit builds without the crt so the digits are found by subtracting powers of ten */
+static void stats_number(stats_text *text, ULONGLONG number)
+{
+    static ULONGLONG const powers[] = {
+        10000000000000000000ull, 1000000000000000000ull, 100000000000000000ull, 10000000000000000ull,
+        1000000000000000ull, 100000000000000ull, 10000000000000ull, 1000000000000ull, 100000000000ull,
+        10000000000ull, 1000000000ull, 100000000ull, 10000000ull, 1000000ull, 100000ull, 10000ull, 1000ull,
+        100ull, 10ull, 1ull
+    };
+
+    char digits[20];
+    int count = 0;
+    for (int i = 0; i < (int)(sizeof(powers) / sizeof(powers[0])); ++i) {
+        char digit = '0';
+        while (number >= powers[i]) {
+            number -= powers[i];
+            ++digit;
+        }
+
+        if (digit != '0' || count != 0 || i == (int)(sizeof(powers) / sizeof(powers[0])) - 1) {
+            digits[count++] = digit;
+        }
+    }
+    stats_write(text, digits, count);
+}
+
+static void stats_decimal(stats_text *text, double number)
+{
+    char digits[DECIMAL_MAX_SIZE];
+    stats_write(text, digits, format_decimal(digits, number));
+}
+
+static double ticks_to_seconds(LONGLONG ticks)
+{
+    return to_double((ULONGLONG)ticks) / to_double((ULONGLONG)stats.frequency.QuadPart);
+}
+
+/* writes a number of ticks as whole microseconds for the trace */
+static void stats_microseconds(stats_text *text, LONGLONG ticks)
+{
+    double const seconds = ticks_to_seconds(ticks);
+    DWORD const whole = (DWORD)seconds;
+    DWORD const micro = (DWORD)((seconds - whole) * 1000000.0);
+    if (whole == 0) {
+        stats_number(text, micro);
+        return;
+    }
+
+    char digits[6];
+    DWORD rest = micro;
+    for (int i = 5; i >= 0; --i) {
+        digits[i] = (char)('0' + rest % 10);
+        rest /= 10;
+    }
+    stats_number(text, whole);
+    stats_write(text, digits, sizeof(digits));
+}
+
+static void stats_json_string(stats_text *text, char const *str)
+{
+    static char const hex[] = "0123456789abcdef";
+    stats_write(text, "\"", 1);
+    for (; *str != '\0'; ++str) {
+        unsigned char const c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            char const escaped[2] = { '\\', (char)c };
+            stats_write(text, escaped, 2);
+        }
+        else if (c < 0x20 || c >= 0x80) {
+            /* NOTE: the paths are in the ansi code page, bytes outside ascii are written as latin-1 so the json stays valid */
+            char const escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            stats_write(text, escaped, 6);
+        }
+        else {
+            stats_write(text, str, 1);
+        }
+    }
+    stats_write(text, "\"", 1);
+}
+
+static void stats_flush_trace(void)
+{
+    for (char const *data = stats.trace.data; stats.trace.size != 0; ) {
+        DWORD bytes_written = 0;
+        if (!WriteFile(stats.trace_handle, data, (DWORD)stats.trace.size, &bytes_written, NULL)) break;
+        data += bytes_written;
+        stats.trace.size -= bytes_written;
+    }
+    stats.trace.size = 0;
+}
+
+/* starts measuring the run, with trace_path the events are written to that file, returns false if it could not be created */
+static bool stats_start(bool report, char const *trace_path)
+{
+    if (!stats_enabled) {
+        QueryPerformanceFrequency(&stats.frequency);
+        QueryPerformanceCounter(&stats.start);
+        InitializeSRWLock(&stats.trace_lock);
+        stats_enabled = true;
+    }
+    stats.report |= report;
+
+    if (trace_path != NULL && stats.trace_handle == INVALID_HANDLE_VALUE) {
+        stats.trace_handle = CreateFileA(trace_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (stats.trace_handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        stats_string(&stats.trace, "{\"traceEvents\":[");
+        stats.trace_empty = true;
+    }
+    return true;
+}
+
+static stats_span stats_begin(void)
+{
+    stats_span span = { 0 };
+    if (stats_enabled) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        span.ticks = now.QuadPart;
+        QueryThreadCycleTime(GetCurrentThread(), &span.cycles);
+    }
+    return span;
+}
+
+/* writes a complete event from span to end named name, path is added as an argument if it is not NULL */
+static void stats_trace_event(stats_span span, LONGLONG end, char const *name, char const *category, char const *path)
+{
+    AcquireSRWLockExclusive(&stats.trace_lock);
+    stats_text *text = &stats.trace;
+    stats_string(text, stats.trace_empty ? "\n{\"name\":" : ",\n{\"name\":");
+    stats.trace_empty = false;
+    stats_json_string(text, name);
+    stats_string(text, ",\"cat\":");
+    stats_json_string(text, category);
+    stats_string(text, ",\"ph\":\"X\",\"ts\":");
+    stats_microseconds(text, span.ticks - stats.start.QuadPart);
+    stats_string(text, ",\"dur\":");
+    stats_microseconds(text, end - span.ticks);
+    stats_string(text, ",\"pid\":1,\"tid\":");
+    stats_number(text, GetCurrentThreadId());
+    if (path != NULL) {
+        stats_string(text, ",\"args\":{\"path\":");
+        stats_json_string(text, path);
+        stats_string(text, "}");
+    }
+    stats_string(text, "}");
+
+    if (text->size >= TRACE_BUFFER_SIZE) {
+        stats_flush_trace();
+    }
+    ReleaseSRWLockExclusive(&stats.trace_lock);
+}
+
+/* adds the time since span began to phase, with --trace it is also an event unless path is NULL */
+static void stats_end(stats_span span, stats_phase phase, char const *path)
+{
+    if (!stats_enabled) return;
+
+    LARGE_INTEGER now;
+    ULONG64 cycles;
+    QueryPerformanceCounter(&now);
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    InterlockedExchangeAdd64(&stats.phase_ticks[phase], now.QuadPart - span.ticks);
+    InterlockedExchangeAdd64(&stats.phase_cycles[phase], (LONGLONG)(cycles - span.cycles));
+
+    if (path != NULL && stats.trace_handle != INVALID_HANDLE_VALUE) {
+        stats_trace_event(span, now.QuadPart, stats_phase_names[phase], "phase", path);
+    }
+}
+
+/* the span of a whole file, it is only written to the trace, the phases in it are measured on their own */
+static void stats_end_file(stats_span span, char const *path)
+{
+    if (!stats_enabled || stats.trace_handle == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    stats_trace_event(span, now.QuadPart, path, "file", NULL);
+}
+
+static void stats_count_call(stats_call call)
+{
+    if (stats_enabled) {
+        InterlockedIncrement64(&stats.calls[call]);
+    }
+}
+
+static void stats_add_file(ULONGLONG size)
+{
+    if (!stats_enabled) return;
+
+    int bucket = 0;
+    for (ULONGLONG limit = 1024; bucket != SIZE_BUCKET_COUNT - 1 && size >= limit; limit <<= 2) {
+        ++bucket;
+    }
+    InterlockedIncrement64(&stats.file_count);
+    InterlockedExchangeAdd64(&stats.byte_count, (LONGLONG)size);
+    InterlockedIncrement64(&stats.size_buckets[bucket]);
+}
+
+static void stats_add_output(size_t size)
+{
+    if (stats_enabled) {
+        InterlockedExchangeAdd64(&stats.output_byte_count, (LONGLONG)size);
+    }
+}
+
+static void stats_seconds(stats_text *text, char const *label, double seconds)
+{
+    stats_string(text, label);
+    stats_decimal(text, seconds);
+    stats_string(text, " s\r\n");
+}
+
+static void stats_count(stats_text *text, char const *label, ULONGLONG count)
+{
+    stats_string(text, label);
+    stats_number(text, count);
+    stats_string(text, "\r\n");
+}
+
+/* ends the trace and writes the report to report_handle */
+static void stats_finish(HANDLE report_handle)
+{
+    if (!stats_enabled) return;
+
+    if (stats.trace_handle != INVALID_HANDLE_VALUE) {
+        stats_string(&stats.trace, "\n]}\n");
+        stats_flush_trace();
+        CloseHandle(stats.trace_handle);
+        stats.trace_handle = INVALID_HANDLE_VALUE;
+    }
+
+    if (!stats.report) return;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    double const wall_seconds = ticks_to_seconds(now.QuadPart - stats.start.QuadPart);
+
+    stats_text text = { 0 };
+    stats_string(&text, "stats: \r\n");
+    stats_seconds(&text, "wall time: ", wall_seconds);
+
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+        stats_seconds(&text, "user time: ", to_double(((ULONGLONG)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime) / 10000000.0);
+        stats_seconds(&text, "kernel time: ", to_double(((ULONGLONG)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime) / 10000000.0);
+    }
+
+    for (int i = 0; i < STATS_PHASE_COUNT; ++i) {
+        stats_string(&text, stats_phase_names[i]);
+        stats_string(&text, ": ");
+        stats_decimal(&text, ticks_to_seconds(stats.phase_ticks[i]));
+        stats_string(&text, " s, ");
+        stats_number(&text, (ULONGLONG)stats.phase_cycles[i]);
+        stats_string(&text, " cycles\r\n");
+    }
+
+    stats_count(&text, "files: ", (ULONGLONG)stats.file_count);
+    stats_count(&text, "bytes read: ", (ULONGLONG)stats.byte_count);
+    stats_count(&text, "bytes written: ", (ULONGLONG)stats.output_byte_count);
+    stats_string(&text, "throughput: ");
+    stats_decimal(&text, wall_seconds > 0.0 ? to_double((ULONGLONG)stats.byte_count) / wall_seconds / 1000000.0 : 0.0);
+    stats_string(&text, " MB/s, ");
+    stats_decimal(&text, wall_seconds > 0.0 ? to_double((ULONGLONG)stats.file_count) / wall_seconds : 0.0);
+    stats_string(&text, " files/s\r\n");
+
+    for (int i = 0; i < STATS_CALL_COUNT; ++i) {
+        stats_string(&text, stats_call_names[i]);
+        stats_count(&text, " calls: ", (ULONGLONG)stats.calls[i]);
+    }
+
+    PROCESS_MEMORY_COUNTERS memory;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) {
+        stats_string(&text, "peak working set: ");
+        stats_number(&text, memory.PeakWorkingSetSize);
+        stats_string(&text, " bytes\r\npeak committed memory: ");
+        stats_number(&text, memory.PeakPagefileUsage);
+        stats_string(&text, " bytes\r\n");
+    }
+
+    stats_string(&text, "file sizes: \r\n");
+    for (int i = 0; i < SIZE_BUCKET_COUNT; ++i) {
+        stats_string(&text, "    ");
+        stats_string(&text, size_bucket_names[i]);
+        stats_count(&text, ": ", (ULONGLONG)stats.size_buckets[i]);
+    }
+
+    DWORD bytes_written;
+    WriteFile(report_handle, text.data, (DWORD)text.size, &bytes_written, NULL);
+    HeapFree(GetProcessHeap(), 0, text.data);
+}